@@ -0,0 +1,104 @@
+#include "harness.h"
+
+#define main hashMapDemoMain
+#include "../intro/hash-map/hash-map.c"
+#undef main
+
+#define KEYS 1000
+
+struct Keys {
+  char *keys[KEYS];
+  char *values[KEYS];
+  // Same length as the keys, never inserted
+  char *missing[KEYS];
+};
+
+static void freeNodes(struct HashMap *map) {
+  for (int i = 0; i < map->capacity; i++) {
+    struct Node *node = map->nodes[i];
+    while (node != NULL) {
+      struct Node *next = node->next;
+      free(node);
+      node = next;
+    }
+  }
+  free(map->nodes);
+}
+
+static void fill(struct HashMap *map, struct Keys *keys) {
+  initializeMap(map);
+  for (int i = 0; i < KEYS; i++) {
+    insert(map, keys->keys[i], keys->values[i]);
+  }
+}
+
+static void insertAll(void *ctx) {
+  struct HashMap map;
+  fill(&map, ctx);
+  benchKeep(map.capacity);
+  freeNodes(&map);
+}
+
+struct Lookup {
+  struct HashMap *map;
+  struct Keys *keys;
+};
+
+static void getHits(void *ctx) {
+  struct Lookup *lookup = ctx;
+  uint64_t found = 0;
+  for (int i = 0; i < KEYS; i++) {
+    found += get(lookup->map, lookup->keys->keys[i]) != NULL;
+  }
+  benchKeep(found);
+}
+
+static void getMisses(void *ctx) {
+  struct Lookup *lookup = ctx;
+  uint64_t found = 0;
+  for (int i = 0; i < KEYS; i++) {
+    found += get(lookup->map, lookup->keys->missing[i]) != NULL;
+  }
+  benchKeep(found);
+}
+
+static void hashKeys(void *ctx) {
+  struct Lookup *lookup = ctx;
+  uint64_t sum = 0;
+  for (int i = 0; i < KEYS; i++) {
+    sum += hashFunction(lookup->map, lookup->keys->keys[i]);
+  }
+  benchKeep(sum);
+}
+
+int main(int argc, char **argv) {
+  struct Bench bench;
+  if (benchInit(&bench, "hash_map", argc, argv))
+    return 2;
+
+  static struct Keys keys;
+  for (int i = 0; i < KEYS; i++) {
+    keys.keys[i] = malloc(16);
+    keys.values[i] = malloc(16);
+    keys.missing[i] = malloc(16);
+    sprintf(keys.keys[i], "key%d", i);
+    sprintf(keys.values[i], "value%d", i);
+    sprintf(keys.missing[i], "yek%d", i);
+  }
+
+  struct HashMap map;
+  fill(&map, &keys);
+  struct Lookup lookup = {&map, &keys};
+  benchRun(&bench, "hash_map/insert_1k", insertAll, &keys, KEYS);
+  benchRun(&bench, "hash_map/get_hit_1k", getHits, &lookup, KEYS);
+  benchRun(&bench, "hash_map/get_miss_1k", getMisses, &lookup, KEYS);
+  benchRun(&bench, "hash_map/hash_1k", hashKeys, &lookup, KEYS);
+  freeNodes(&map);
+
+  for (int i = 0; i < KEYS; i++) {
+    free(keys.keys[i]);
+    free(keys.values[i]);
+    free(keys.missing[i]);
+  }
+  return benchFinish(&bench);
+}
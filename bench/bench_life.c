@@ -0,0 +1,41 @@
+#include "harness.h"
+#include "life.h"
+
+#include <stdio.h>
+
+#define SIZE 1024
+#define DENSITY 35
+
+static void step(void *ctx) { lifeStep(ctx); }
+
+int main(int argc, char **argv) {
+  struct Bench bench;
+  if (benchInit(&bench, "life", argc, argv))
+    return 2;
+
+  // A soup keeps changing for thousands of generations, so every repetition
+  // steps a busy grid
+  struct LifeGrid grid;
+  if (lifeGridInit(&grid, SIZE, SIZE)) {
+    fprintf(stderr, "life: out of memory\n");
+    return 1;
+  }
+  lifeGridRandomize(&grid, 1, DENSITY);
+
+  for (int kernel = 0; kernel < LIFE_KERNEL_COUNT; kernel++) {
+    if (!lifeKernelSupported(kernel))
+      continue;
+    lifeSetKernel(kernel);
+    char name[64];
+    snprintf(name, sizeof(name), "life/step_1k_%s", lifeKernelName(kernel));
+    benchRun(&bench, name, step, &grid, (long long)SIZE * SIZE);
+  }
+
+  lifeSetKernel(lifeDetectKernel());
+  lifeGridSetBoundary(&grid, LIFE_BOUNDARY_TORUS);
+  benchRun(&bench, "life/step_1k_torus", step, &grid, (long long)SIZE * SIZE);
+
+  benchKeep(lifeGridPopulation(&grid));
+  lifeGridFree(&grid);
+  return benchFinish(&bench);
+}
@@ -0,0 +1,72 @@
+#include "harness.h"
+
+// Built once per list: LIST_SOURCE is the demo file to bench and LIST_NAME
+// prefixes the benchmark names. Both lists name their functions alike, so
+// they can't share a program.
+#define main listDemoMain
+#include LIST_SOURCE
+#undef main
+
+#define BUILD_NODES 4096
+// insertEnd walks the whole list, so building with it is quadratic
+#define APPEND_NODES 512
+#define SEARCH_NODES 65536
+
+static void freeList(struct Node *head) {
+  while (head != NULL) {
+    struct Node *next = head->next;
+    free(head);
+    head = next;
+  }
+}
+
+// Starts from a node, as the doubly linked insertBeginning needs a head
+static struct Node *buildFront(int nodes) {
+  struct Node *head = createNode(0);
+  for (int i = 1; i < nodes; i++) {
+    head = insertBeginning(head, i);
+  }
+  return head;
+}
+
+static void insertFront(void *ctx) {
+  (void)ctx;
+  struct Node *head = buildFront(BUILD_NODES);
+  benchKeep(head->data);
+  freeList(head);
+}
+
+static void insertBack(void *ctx) {
+  (void)ctx;
+  struct Node *head = NULL;
+  for (int i = 0; i < APPEND_NODES; i++) {
+    head = insertEnd(head, i);
+  }
+  benchKeep(head->data);
+  freeList(head);
+}
+
+// Looks for a value that isn't there, so every node is visited
+static void searchMiss(void *ctx) {
+  benchKeep(searchList(ctx, -1));
+}
+
+static void length(void *ctx) { benchKeep(len(ctx)); }
+
+int main(int argc, char **argv) {
+  struct Bench bench;
+  if (benchInit(&bench, LIST_NAME, argc, argv))
+    return 2;
+
+  benchRun(&bench, LIST_NAME "/insert_front_4k", insertFront, NULL,
+           BUILD_NODES);
+  benchRun(&bench, LIST_NAME "/insert_end_512", insertBack, NULL,
+           APPEND_NODES);
+  struct Node *list = buildFront(SEARCH_NODES);
+  benchRun(&bench, LIST_NAME "/search_miss_64k", searchMiss, list,
+           SEARCH_NODES);
+  benchRun(&bench, LIST_NAME "/len_64k", length, list, SEARCH_NODES);
+  freeList(list);
+
+  return benchFinish(&bench);
+}
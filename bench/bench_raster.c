@@ -0,0 +1,66 @@
+#include "harness.h"
+#include "raster.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define WIDTH 1024
+#define HEIGHT 768
+#define CIRCLES 256
+
+struct Circles {
+  struct PixelBuffer *buffer;
+  int radius;
+  int centres[CIRCLES][2];
+};
+
+static void drawCircles(void *ctx) {
+  struct Circles *circles = ctx;
+  long filled = 0;
+  for (int i = 0; i < CIRCLES; i++) {
+    filled += rasterCircle(circles->buffer, circles->centres[i][0],
+                           circles->centres[i][1], circles->radius,
+                           0xff00ff00u + i);
+  }
+  benchKeep(filled);
+}
+
+static void fade(void *ctx) { rasterFade(ctx, 240); }
+
+int main(int argc, char **argv) {
+  struct Bench bench;
+  if (benchInit(&bench, "raster", argc, argv))
+    return 2;
+
+  struct PixelBuffer buffer = {calloc((size_t)WIDTH * HEIGHT, 4), WIDTH,
+                               HEIGHT, WIDTH};
+  if (buffer.pixels == NULL) {
+    fprintf(stderr, "raster: out of memory\n");
+    return 1;
+  }
+
+  // Whole circles only, so every call fills the same pixels and the ops
+  // are pixels
+  static const int radii[] = {4, 32, 256};
+  uint32_t state = 1;
+  for (size_t r = 0; r < sizeof(radii) / sizeof(radii[0]); r++) {
+    struct Circles circles = {&buffer, radii[r], {{0}}};
+    for (int i = 0; i < CIRCLES; i++) {
+      state = state * 1664525u + 1013904223u;
+      circles.centres[i][0] = radii[r] + (state >> 8) % (WIDTH - 2 * radii[r]);
+      state = state * 1664525u + 1013904223u;
+      circles.centres[i][1] = radii[r] + (state >> 8) % (HEIGHT - 2 * radii[r]);
+    }
+    long pixels = rasterCircle(&buffer, WIDTH / 2, HEIGHT / 2, radii[r], 0);
+
+    char name[64];
+    snprintf(name, sizeof(name), "raster/circle_r%d", radii[r]);
+    benchRun(&bench, name, drawCircles, &circles, (long long)pixels * CIRCLES);
+  }
+
+  benchRun(&bench, "raster/fade_1024x768", fade, &buffer,
+           (long long)WIDTH * HEIGHT);
+
+  free(buffer.pixels);
+  return benchFinish(&bench);
+}
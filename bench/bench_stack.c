@@ -0,0 +1,46 @@
+#include "harness.h"
+
+// The stack is a single demo file; its main is renamed out of the way
+#define main stackDemoMain
+#include "../intro/stack/stack.c"
+#undef main
+
+#define STACK_DEPTH 4096
+
+static void pushPop(void *ctx) {
+  struct Stack *stack = ctx;
+  for (int i = 0; i < STACK_DEPTH; i++) {
+    push(stack, i);
+  }
+  uint64_t sum = 0;
+  while (!isEmpty(stack)) {
+    sum += pop(stack);
+  }
+  benchKeep(sum);
+}
+
+// Alternating pushes and pops on a stack that stays one deep
+static void pushPopPairs(void *ctx) {
+  struct Stack *stack = ctx;
+  uint64_t sum = 0;
+  for (int i = 0; i < STACK_DEPTH; i++) {
+    push(stack, i);
+    sum += top(stack);
+    sum += pop(stack);
+  }
+  benchKeep(sum);
+}
+
+int main(int argc, char **argv) {
+  struct Bench bench;
+  if (benchInit(&bench, "stack", argc, argv))
+    return 2;
+
+  struct Stack *stack = create(STACK_DEPTH);
+  benchRun(&bench, "stack/fill_drain_4k", pushPop, stack, 2 * STACK_DEPTH);
+  benchRun(&bench, "stack/push_top_pop", pushPopPairs, stack, STACK_DEPTH);
+  free(stack->array);
+  free(stack);
+
+  return benchFinish(&bench);
+}
@@ -0,0 +1,202 @@
+#include "harness.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_RECORDS 512
+// Regressions smaller than this share of the old median are ignored
+#define DEFAULT_THRESHOLD 0.05
+// And so are changes within this many standard deviations of noise, which
+// the MADs of both runs give (1.4826 MAD estimates one)
+#define NOISE_SIGMAS 3.0
+
+enum Verdict { VERDICT_SAME, VERDICT_FASTER, VERDICT_SLOWER };
+
+static enum Verdict compareRecords(const struct BenchRecord *before,
+                                   const struct BenchRecord *after,
+                                   double threshold) {
+  double change = after->time.median - before->time.median;
+  double noise = NOISE_SIGMAS * 1.4826 *
+                 sqrt(before->time.mad * before->time.mad +
+                      after->time.mad * after->time.mad);
+  if (fabs(change) <= noise || fabs(change) <= threshold * before->time.median)
+    return VERDICT_SAME;
+  return change > 0 ? VERDICT_SLOWER : VERDICT_FASTER;
+}
+
+static const struct BenchRecord *findRecord(const struct BenchRecord *records,
+                                            int count,
+                                            const struct BenchRecord *record) {
+  for (int i = 0; i < count; i++) {
+    if (strcmp(records[i].program, record->program) == 0 &&
+        strcmp(records[i].name, record->name) == 0)
+      return &records[i];
+  }
+  return NULL;
+}
+
+// Prints a line per benchmark and returns the regressions, or -1 if either
+// file can't be read
+static int compareFiles(const char *beforePath, const char *afterPath,
+                        double threshold) {
+  static struct BenchRecord before[MAX_RECORDS], after[MAX_RECORDS];
+  int beforeCount = benchReadJson(beforePath, before, MAX_RECORDS);
+  int afterCount = benchReadJson(afterPath, after, MAX_RECORDS);
+  if (beforeCount < 0 || afterCount < 0) {
+    fprintf(stderr, "bench-compare: can't read %s\n",
+            beforeCount < 0 ? beforePath : afterPath);
+    return -1;
+  }
+
+  int regressions = 0, compared = 0;
+  printf("%-28s %12s %12s %8s\n", "benchmark", "old ns/op", "new ns/op",
+         "change");
+  for (int i = 0; i < afterCount; i++) {
+    const struct BenchRecord *record = &after[i];
+    const struct BenchRecord *old = findRecord(before, beforeCount, record);
+    if (old == NULL) {
+      printf("%-28s %12s %12.3f %8s  new\n", record->name, "-",
+             record->time.median, "");
+      continue;
+    }
+
+    compared++;
+    enum Verdict verdict = compareRecords(old, record, threshold);
+    regressions += verdict == VERDICT_SLOWER;
+    double change = old->time.median > 0
+                        ? 100 * (record->time.median / old->time.median - 1)
+                        : 0;
+    printf("%-28s %12.3f %12.3f %+7.1f%%%s\n", record->name, old->time.median,
+           record->time.median, change,
+           verdict == VERDICT_SLOWER   ? "  REGRESSION"
+           : verdict == VERDICT_FASTER ? "  faster"
+                                       : "");
+  }
+  for (int i = 0; i < beforeCount; i++) {
+    if (findRecord(after, afterCount, &before[i]) == NULL)
+      printf("%-28s %12.3f %12s %8s  missing\n", before[i].name,
+             before[i].time.median, "-", "");
+  }
+
+  printf("%d regression%s in %d benchmarks compared (threshold %.1f%%)\n",
+         regressions, regressions == 1 ? "" : "s", compared, threshold * 100);
+  return regressions;
+}
+
+static struct BenchRecord makeRecord(const char *name, double median,
+                                     double mad) {
+  struct BenchRecord record;
+  memset(&record, 0, sizeof(record));
+  snprintf(record.program, sizeof(record.program), "check");
+  snprintf(record.name, sizeof(record.name), "%s", name);
+  record.ops = 1000;
+  record.time.samples = 15;
+  record.time.median = record.time.mean = median;
+  record.time.mad = mad;
+  return record;
+}
+
+static int check(void) {
+  int failures = 0;
+
+  // One slow repetition is an outlier, the rest are kept
+  double samples[] = {10.2, 9.8, 10.0, 50.0, 10.1, 9.9, 10.0};
+  struct BenchSummary summary;
+  benchSummarize(samples, 7, &summary);
+  if (summary.outliers != 1 || summary.median != 10.0 || summary.max != 10.2 ||
+      fabs(summary.mean - 10.0) > 1e-9 || fabs(summary.mad - 0.1) > 1e-9) {
+    printf("summary: %d outliers, median %g, max %g, mean %g, mad %g\n",
+           summary.outliers, summary.median, summary.max, summary.mean,
+           summary.mad);
+    failures++;
+  }
+  double flat[] = {3, 3, 3, 3};
+  benchSummarize(flat, 4, &summary);
+  if (summary.outliers != 0 || summary.stddev != 0 || summary.median != 3) {
+    printf("flat summary: %d outliers, stddev %g\n", summary.outliers,
+           summary.stddev);
+    failures++;
+  }
+
+  struct {
+    double before, beforeMad, after, afterMad;
+    enum Verdict expected;
+  } cases[] = {
+      {10, 0.05, 11, 0.05, VERDICT_SLOWER},
+      {10, 0.05, 10.2, 0.05, VERDICT_SAME},
+      {10, 2, 11, 2, VERDICT_SAME},
+      {10, 0.05, 8, 0.05, VERDICT_FASTER},
+  };
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    struct BenchRecord before =
+        makeRecord("case", cases[i].before, cases[i].beforeMad);
+    struct BenchRecord after =
+        makeRecord("case", cases[i].after, cases[i].afterMad);
+    enum Verdict verdict = compareRecords(&before, &after, DEFAULT_THRESHOLD);
+    if (verdict != cases[i].expected) {
+      printf("case %zu: verdict %d, expected %d\n", i, verdict,
+             cases[i].expected);
+      failures++;
+    }
+  }
+
+  // Two writes to one file make one array; the counters round-trip, null
+  // or not
+  const char *beforePath = "compare-check-old.json";
+  const char *afterPath = "compare-check-new.json";
+  remove(beforePath);
+  remove(afterPath);
+  struct BenchRecord records[3] = {makeRecord("check/a", 10, 0.01),
+                                   makeRecord("check/b", 2.5, 0.01),
+                                   makeRecord("check/c", 0.125, 0.001)};
+  records[1].counters[BENCH_CYCLES] = 7.5;
+  records[1].hasCounter[BENCH_CYCLES] = 1;
+  struct BenchRecord read[4];
+  int count = -1;
+  if (benchWriteJson(beforePath, records, 2) == 0 &&
+      benchWriteJson(beforePath, records + 2, 1) == 0)
+    count = benchReadJson(beforePath, read, 4);
+  if (count != 3 || strcmp(read[2].name, "check/c") != 0 ||
+      read[2].time.median != 0.125 || read[1].counters[BENCH_CYCLES] != 7.5 ||
+      !read[1].hasCounter[BENCH_CYCLES] || read[0].hasCounter[BENCH_CYCLES] ||
+      read[0].time.samples != 15) {
+    printf("json: read %d records back\n", count);
+    failures++;
+  }
+
+  // b gets 20% slower, c 20% faster
+  records[1].time.median = 3;
+  records[2].time.median = 0.1;
+  if (benchWriteJson(afterPath, records, 3) != 0 ||
+      compareFiles(beforePath, afterPath, DEFAULT_THRESHOLD) != 1 ||
+      compareFiles(beforePath, beforePath, DEFAULT_THRESHOLD) != 0) {
+    printf("compare: wrong regressions\n");
+    failures++;
+  }
+  remove(beforePath);
+  remove(afterPath);
+
+  printf("%s\n", failures ? "compare check FAILED" : "compare check passed");
+  return failures != 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc == 2 && strcmp(argv[1], "--check") == 0)
+    return check();
+
+  double threshold = DEFAULT_THRESHOLD;
+  if (argc == 5 && strcmp(argv[3], "--threshold") == 0) {
+    threshold = atof(argv[4]) / 100;
+  } else if (argc != 3) {
+    fprintf(stderr,
+            "usage: %s OLD.json NEW.json [--threshold PERCENT]\n"
+            "       %s --check\n",
+            argv[0], argv[0]);
+    return 2;
+  }
+
+  int regressions = compareFiles(argv[1], argv[2], threshold);
+  return regressions < 0 ? 2 : regressions > 0;
+}
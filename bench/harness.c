@@ -0,0 +1,482 @@
+// syscall() and the perf_event_open number
+#define _GNU_SOURCE
+#include "harness.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static volatile uint64_t sink;
+
+void benchKeep(uint64_t value) { sink += value; }
+
+double benchSeconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+const char *benchCounterName(enum BenchCounter counter) {
+  static const char *names[BENCH_COUNTERS] = {"cycles", "instructions",
+                                              "cache_misses", "branch_misses"};
+  return names[counter];
+}
+
+static void openCounters(struct Bench *bench) {
+  for (int c = 0; c < BENCH_COUNTERS; c++) {
+    bench->counterFds[c] = -1;
+  }
+
+#ifdef __linux__
+  static const uint64_t configs[BENCH_COUNTERS] = {
+      PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+  int opened = 0, error = 0;
+  // One event per counter rather than a group, so a CPU that lacks one of
+  // them still gives the others. The kernel may then multiplex them, which
+  // the enabled and running times scale back out.
+  for (int c = 0; c < BENCH_COUNTERS; c++) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = configs[c];
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    long fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd < 0) {
+      error = errno;
+      continue;
+    }
+    bench->counterFds[c] = (int)fd;
+    opened++;
+  }
+
+  if (opened == 0) {
+    fprintf(stderr,
+            "%s: no hardware counters (perf_event_open: %s), timing only%s\n",
+            bench->program, strerror(error),
+            error == EACCES || error == EPERM
+                ? "; see /proc/sys/kernel/perf_event_paranoid"
+                : "");
+    return;
+  }
+  for (int c = 0; c < BENCH_COUNTERS; c++) {
+    if (bench->counterFds[c] < 0)
+      fprintf(stderr, "%s: no %s counter\n", bench->program,
+              benchCounterName(c));
+  }
+#else
+  fprintf(stderr, "%s: no hardware counters here, timing only\n",
+          bench->program);
+#endif
+}
+
+static void startCounters(struct Bench *bench) {
+#ifdef __linux__
+  for (int c = 0; c < BENCH_COUNTERS; c++) {
+    if (bench->counterFds[c] < 0)
+      continue;
+    ioctl(bench->counterFds[c], PERF_EVENT_IOC_RESET, 0);
+    ioctl(bench->counterFds[c], PERF_EVENT_IOC_ENABLE, 0);
+  }
+#else
+  (void)bench;
+#endif
+}
+
+// Fills got[c] with 0 where the counter gave nothing
+static void stopCounters(struct Bench *bench, double values[BENCH_COUNTERS],
+                         int got[BENCH_COUNTERS]) {
+  for (int c = 0; c < BENCH_COUNTERS; c++) {
+    got[c] = 0;
+#ifdef __linux__
+    if (bench->counterFds[c] < 0)
+      continue;
+    ioctl(bench->counterFds[c], PERF_EVENT_IOC_DISABLE, 0);
+    // Count, time enabled, time running
+    uint64_t data[3];
+    if (read(bench->counterFds[c], data, sizeof(data)) != sizeof(data) ||
+        data[2] == 0)
+      continue;
+    values[c] = data[0] * ((double)data[1] / data[2]);
+    got[c] = 1;
+#else
+    (void)bench;
+    (void)values;
+#endif
+  }
+}
+
+static void usage(const char *program) {
+  fprintf(stderr,
+          "usage: %s [--json PATH] [--reps N] [--warmup N] [--min-ms MS] "
+          "[--filter TEXT]\n",
+          program);
+}
+
+int benchInit(struct Bench *bench, const char *program, int argc,
+              char **argv) {
+  memset(bench, 0, sizeof(struct Bench));
+  bench->program = program;
+  bench->warmup = 3;
+  bench->repetitions = 15;
+  bench->minSeconds = 0.005;
+
+  for (int i = 1; i < argc; i++) {
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+    if (value == NULL) {
+      usage(argv[0]);
+      return -1;
+    }
+
+    if (strcmp(argv[i], "--json") == 0) {
+      bench->jsonPath = value;
+    } else if (strcmp(argv[i], "--reps") == 0) {
+      bench->repetitions = atoi(value);
+    } else if (strcmp(argv[i], "--warmup") == 0) {
+      bench->warmup = atoi(value);
+    } else if (strcmp(argv[i], "--min-ms") == 0) {
+      bench->minSeconds = atof(value) / 1000;
+    } else if (strcmp(argv[i], "--filter") == 0) {
+      bench->filter = value;
+    } else {
+      usage(argv[0]);
+      return -1;
+    }
+    i++;
+  }
+
+  if (bench->repetitions < 1 || bench->repetitions > BENCH_MAX_REPS ||
+      bench->warmup < 0) {
+    fprintf(stderr, "%s: --reps takes 1 to %d, --warmup 0 or more\n",
+            program, BENCH_MAX_REPS);
+    return -1;
+  }
+
+  openCounters(bench);
+  return 0;
+}
+
+static int compareDoubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static double sortedMedian(const double *values, int count) {
+  return count % 2 ? values[count / 2]
+                   : (values[count / 2 - 1] + values[count / 2]) / 2;
+}
+
+void benchSummarize(double *samples, int count, struct BenchSummary *summary) {
+  memset(summary, 0, sizeof(struct BenchSummary));
+  count = count < BENCH_MAX_REPS ? count : BENCH_MAX_REPS;
+  summary->samples = count;
+  if (count <= 0)
+    return;
+
+  qsort(samples, count, sizeof(double), compareDoubles);
+  double median = sortedMedian(samples, count);
+  double deviations[BENCH_MAX_REPS];
+  for (int i = 0; i < count; i++) {
+    deviations[i] = fabs(samples[i] - median);
+  }
+  qsort(deviations, count, sizeof(double), compareDoubles);
+  summary->mad = sortedMedian(deviations, count);
+
+  // Sorted, the outliers are at both ends and what is kept lies between
+  int first = 0, last = count;
+  if (summary->mad > 0) {
+    while (0.6745 * (median - samples[first]) / summary->mad > 3.5)
+      first++;
+    while (0.6745 * (samples[last - 1] - median) / summary->mad > 3.5)
+      last--;
+  }
+  int kept = last - first;
+  summary->outliers = count - kept;
+  summary->median = sortedMedian(samples + first, kept);
+  summary->min = samples[first];
+  summary->max = samples[last - 1];
+
+  double sum = 0;
+  for (int i = first; i < last; i++) {
+    sum += samples[i];
+  }
+  summary->mean = sum / kept;
+  double squares = 0;
+  for (int i = first; i < last; i++) {
+    squares += (samples[i] - summary->mean) * (samples[i] - summary->mean);
+  }
+  summary->stddev = kept > 1 ? sqrt(squares / (kept - 1)) : 0;
+}
+
+void benchRun(struct Bench *bench, const char *name, void (*fn)(void *ctx),
+              void *ctx, long long ops) {
+  if (bench->filter != NULL && strstr(name, bench->filter) == NULL)
+    return;
+  if (bench->resultCount == BENCH_MAX_RESULTS) {
+    fprintf(stderr, "%s: more than %d benchmarks, %s skipped\n",
+            bench->program, BENCH_MAX_RESULTS, name);
+    return;
+  }
+
+  // One call says how many make a repetition long enough to time
+  double start = benchSeconds();
+  fn(ctx);
+  double once = benchSeconds() - start;
+  long long calls = 1;
+  if (once < bench->minSeconds)
+    calls = (long long)(bench->minSeconds / (once > 1e-9 ? once : 1e-9)) + 1;
+
+  for (int rep = 0; rep < bench->warmup; rep++) {
+    for (long long call = 0; call < calls; call++) {
+      fn(ctx);
+    }
+  }
+
+  static double samples[BENCH_MAX_REPS];
+  static double counts[BENCH_COUNTERS][BENCH_MAX_REPS];
+  int counted[BENCH_COUNTERS] = {0};
+  double perRep = (double)ops * calls;
+  for (int rep = 0; rep < bench->repetitions; rep++) {
+    double values[BENCH_COUNTERS];
+    int got[BENCH_COUNTERS];
+    startCounters(bench);
+    start = benchSeconds();
+    for (long long call = 0; call < calls; call++) {
+      fn(ctx);
+    }
+    double elapsed = benchSeconds() - start;
+    stopCounters(bench, values, got);
+
+    samples[rep] = elapsed * 1e9 / perRep;
+    for (int c = 0; c < BENCH_COUNTERS; c++) {
+      if (got[c])
+        counts[c][counted[c]++] = values[c] / perRep;
+    }
+  }
+
+  struct BenchRecord *record = &bench->results[bench->resultCount++];
+  memset(record, 0, sizeof(struct BenchRecord));
+  snprintf(record->program, sizeof(record->program), "%s", bench->program);
+  snprintf(record->name, sizeof(record->name), "%s", name);
+  record->ops = ops;
+  benchSummarize(samples, bench->repetitions, &record->time);
+  for (int c = 0; c < BENCH_COUNTERS; c++) {
+    // A counter that dropped out of some repetitions says too little
+    if (counted[c] != bench->repetitions)
+      continue;
+    qsort(counts[c], counted[c], sizeof(double), compareDoubles);
+    record->counters[c] = sortedMedian(counts[c], counted[c]);
+    record->hasCounter[c] = 1;
+  }
+
+  const struct BenchSummary *time = &record->time;
+  printf("%-28s %10.3f ns/op  +-%5.1f%%  %d reps, %d out", name, time->median,
+         time->median > 0 ? 100 * time->mad / time->median : 0,
+         time->samples, time->outliers);
+  if (record->hasCounter[BENCH_CYCLES] &&
+      record->hasCounter[BENCH_INSTRUCTIONS]) {
+    double cycles = record->counters[BENCH_CYCLES];
+    printf("  %.1f cyc  %.2f IPC", cycles,
+           cycles > 0 ? record->counters[BENCH_INSTRUCTIONS] / cycles : 0);
+  }
+  if (record->hasCounter[BENCH_CACHE_MISSES])
+    printf("  %.3f cache-miss", record->counters[BENCH_CACHE_MISSES]);
+  if (record->hasCounter[BENCH_BRANCH_MISSES])
+    printf("  %.3f br-miss", record->counters[BENCH_BRANCH_MISSES]);
+  printf("\n");
+  fflush(stdout);
+}
+
+int benchFinish(struct Bench *bench) {
+  int result = 0;
+  if (bench->jsonPath != NULL &&
+      benchWriteJson(bench->jsonPath, bench->results, bench->resultCount)) {
+    fprintf(stderr, "%s: could not write %s\n", bench->program,
+            bench->jsonPath);
+    result = 1;
+  }
+
+#ifdef __linux__
+  for (int c = 0; c < BENCH_COUNTERS; c++) {
+    if (bench->counterFds[c] >= 0)
+      close(bench->counterFds[c]);
+  }
+#endif
+  return result;
+}
+
+// The whole file, NUL-terminated, or NULL if it can't be read
+static char *readFile(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL)
+    return NULL;
+
+  char *text = NULL;
+  long length = -1;
+  if (fseek(file, 0, SEEK_END) == 0 && (length = ftell(file)) >= 0 &&
+      fseek(file, 0, SEEK_SET) == 0)
+    text = malloc(length + 1);
+  if (text != NULL && fread(text, 1, length, file) != (size_t)length) {
+    free(text);
+    text = NULL;
+  }
+  if (text != NULL)
+    text[length] = '\0';
+  fclose(file);
+  return text;
+}
+
+static void writeRecord(FILE *file, const struct BenchRecord *record) {
+  const struct BenchSummary *time = &record->time;
+  fprintf(file,
+          "  {\"program\": \"%s\", \"name\": \"%s\", \"ops\": %lld, "
+          "\"samples\": %d, \"outliers\": %d, \"median_ns\": %.6g, "
+          "\"mean_ns\": %.6g, \"stddev_ns\": %.6g, \"mad_ns\": %.6g, "
+          "\"min_ns\": %.6g, \"max_ns\": %.6g",
+          record->program, record->name, record->ops, time->samples,
+          time->outliers, time->median, time->mean, time->stddev, time->mad,
+          time->min, time->max);
+  for (int c = 0; c < BENCH_COUNTERS; c++) {
+    if (record->hasCounter[c])
+      fprintf(file, ", \"%s\": %.6g", benchCounterName(c),
+              record->counters[c]);
+    else
+      fprintf(file, ", \"%s\": null", benchCounterName(c));
+  }
+  fprintf(file, "}");
+}
+
+int benchWriteJson(const char *path, const struct BenchRecord *records,
+                   int count) {
+  // What comes before the closing bracket of an existing array is kept
+  char *old = readFile(path);
+  size_t keep = 0;
+  int empty = 1;
+  if (old != NULL) {
+    char *close = strrchr(old, ']');
+    if (close == NULL) {
+      free(old);
+      return -1;
+    }
+    keep = close - old;
+    while (keep > 0 && strchr(" \t\r\n", old[keep - 1]) != NULL)
+      keep--;
+    empty = keep > 0 && old[keep - 1] == '[';
+  }
+
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    free(old);
+    return -1;
+  }
+  if (old != NULL)
+    fwrite(old, 1, keep, file);
+  else
+    fprintf(file, "[");
+  for (int i = 0; i < count; i++) {
+    fprintf(file, i == 0 && empty ? "\n" : ",\n");
+    writeRecord(file, &records[i]);
+  }
+  fprintf(file, "\n]\n");
+  free(old);
+  return fclose(file) == 0 ? 0 : -1;
+}
+
+// Where the value of "key" starts on the line, or NULL
+static const char *jsonValue(const char *line, const char *key) {
+  char pattern[48];
+  snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+  const char *at = strstr(line, pattern);
+  if (at == NULL)
+    return NULL;
+  at += strlen(pattern);
+  while (*at == ' ')
+    at++;
+  return at;
+}
+
+static int jsonString(const char *line, const char *key, char *out,
+                      size_t size) {
+  const char *at = jsonValue(line, key);
+  if (at == NULL || *at != '"')
+    return -1;
+  const char *end = strchr(++at, '"');
+  if (end == NULL || (size_t)(end - at) >= size)
+    return -1;
+  memcpy(out, at, end - at);
+  out[end - at] = '\0';
+  return 0;
+}
+
+// 1 for a number, 0 for null, -1 if there is neither
+static int jsonNumber(const char *line, const char *key, double *out) {
+  const char *at = jsonValue(line, key);
+  if (at == NULL)
+    return -1;
+  if (strncmp(at, "null", 4) == 0)
+    return 0;
+  char *end;
+  *out = strtod(at, &end);
+  return end == at ? -1 : 1;
+}
+
+int benchReadJson(const char *path, struct BenchRecord *records, int max) {
+  char *text = readFile(path);
+  if (text == NULL)
+    return -1;
+
+  int count = 0;
+  for (char *line = strtok(text, "\n"); line != NULL;
+       line = strtok(NULL, "\n")) {
+    if (strstr(line, "\"name\"") == NULL)
+      continue;
+    if (count == max)
+      break;
+
+    struct BenchRecord *record = &records[count];
+    struct BenchSummary *time = &record->time;
+    memset(record, 0, sizeof(struct BenchRecord));
+    double ops = 0, samples = 0, outliers = 0;
+    if (jsonString(line, "program", record->program,
+                   sizeof(record->program)) ||
+        jsonString(line, "name", record->name, sizeof(record->name)) ||
+        jsonNumber(line, "median_ns", &time->median) != 1) {
+      free(text);
+      return -1;
+    }
+    jsonNumber(line, "ops", &ops);
+    jsonNumber(line, "samples", &samples);
+    jsonNumber(line, "outliers", &outliers);
+    jsonNumber(line, "mean_ns", &time->mean);
+    jsonNumber(line, "stddev_ns", &time->stddev);
+    jsonNumber(line, "mad_ns", &time->mad);
+    jsonNumber(line, "min_ns", &time->min);
+    jsonNumber(line, "max_ns", &time->max);
+    record->ops = (long long)ops;
+    time->samples = (int)samples;
+    time->outliers = (int)outliers;
+    for (int c = 0; c < BENCH_COUNTERS; c++) {
+      record->hasCounter[c] =
+          jsonNumber(line, benchCounterName(c), &record->counters[c]) == 1;
+    }
+    count++;
+  }
+
+  free(text);
+  return count;
+}
@@ -0,0 +1,83 @@
+#ifndef HARNESS_H
+#define HARNESS_H
+
+#include <stdint.h>
+
+// Hardware counters read around every timed repetition, in this order
+enum BenchCounter {
+  BENCH_CYCLES,
+  BENCH_INSTRUCTIONS,
+  BENCH_CACHE_MISSES,
+  BENCH_BRANCH_MISSES,
+  BENCH_COUNTERS
+};
+
+// Robust summary of the ns/op of the repetitions. Repetitions whose
+// modified z-score (0.6745 * distance from the median / MAD) is over 3.5
+// are outliers and left out of everything but the count.
+struct BenchSummary {
+  int samples;
+  int outliers;
+  double median, mean, stddev, mad, min, max;
+};
+
+// One benchmark of one program, as written to and read from the JSON.
+// Counters are per op, the median over the repetitions; hasCounter is 0
+// where perf_event_open gave nothing (null in the JSON).
+struct BenchRecord {
+  char program[32];
+  char name[64];
+  long long ops;
+  struct BenchSummary time;
+  double counters[BENCH_COUNTERS];
+  int hasCounter[BENCH_COUNTERS];
+};
+
+#define BENCH_MAX_RESULTS 64
+#define BENCH_MAX_REPS 1000
+
+struct Bench {
+  const char *program;
+  const char *jsonPath;
+  const char *filter;
+  int warmup;
+  int repetitions;
+  // Shortest a repetition may be; quicker benchmarks are run several times
+  // per repetition
+  double minSeconds;
+  int counterFds[BENCH_COUNTERS];
+  struct BenchRecord results[BENCH_MAX_RESULTS];
+  int resultCount;
+};
+
+// Parses --json PATH, --reps N, --warmup N, --min-ms MS and --filter TEXT
+// and opens the counters. Returns -1 after printing the usage on bad
+// arguments.
+int benchInit(struct Bench *bench, const char *program, int argc,
+              char **argv);
+// Times fn, which does ops operations on ctx per call, and prints a line.
+// Skipped if the name doesn't contain the filter.
+void benchRun(struct Bench *bench, const char *name, void (*fn)(void *ctx),
+              void *ctx, long long ops);
+// Appends the results to the JSON file, if any, and closes the counters.
+// Returns nonzero if the file could not be written.
+int benchFinish(struct Bench *bench);
+
+// Keeps a result alive so the compiler can't drop the work behind it
+void benchKeep(uint64_t value);
+
+double benchSeconds(void);
+const char *benchCounterName(enum BenchCounter counter);
+
+// Sorts the samples in place
+void benchSummarize(double *samples, int count, struct BenchSummary *summary);
+
+// The file holds a JSON array with one object per line. Appending to an
+// existing array keeps it valid, so every program of a run can write to the
+// same file.
+int benchWriteJson(const char *path, const struct BenchRecord *records,
+                   int count);
+// Reads what benchWriteJson wrote, returns the records read or -1
+int benchReadJson(const char *path, struct BenchRecord *records, int max);
+
+#endif
@@ -48,6 +48,11 @@ void initializeMap(struct HashMap *map) {
   // Allocate memory for the nodes, which is an array of pointers to Node
   // Size = capacity * sizeof(struct Node *)
   map->nodes = (struct Node **)malloc(sizeof(struct Node *) * map->capacity);
+
+  // Every bucket starts empty
+  for (int i = 0; i < map->capacity; i++) {
+    map->nodes[i] = NULL;
+  }
   return;
 }
 
@@ -4,26 +4,55 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include "damage.h"
+#include "framedump.h"
+#include "pacing.h"
+#include "particles.h"
+#include "raster.h"
+#include "trail.h"
 
 const int SCREEN_WIDTH = 1200;
 const int SCREEN_HEIGHT = 900;
+// --trail N spreads N circles over the same length of trail
 const int TRAIL_LENGTH = 5;
 const float TRAIL_SPACING = 60.0f;
+// --fade halves what is on screen this often instead
+const double FADE_HALF_LIFE = 0.15;
+// Frame rate of --record videos, and of the time each --offscreen frame
+// stands for
+const int RECORD_FPS = 60;
+// --offscreen stops after this many frames unless --frames says otherwise
+const int OFFSCREEN_FRAMES = 600;
+// Share of the window the balls of --balls cover, and their top speed in
+// pixels per frame
+const float PARTICLE_COVERAGE = 0.2f;
+const float PARTICLE_SPEED = 3.0f;
+// The simulation steps this often whatever the frame rate, at most
+// MAX_STEPS_PER_FRAME times a frame
+const int STEPS_PER_SECOND = 120;
+const int MAX_STEPS_PER_FRAME = 8;
+// In pixels per second along each axis
+const float BALL_VELOCITY = 600.0f;
 
 struct Circle {
   int x, y;
   int r;
-  int vx, vy;
 };
 
-struct TrailCircle {
-  int x, y;
+// Where the ball was a step ago is kept to draw it in between
+struct Ball {
+  float x, y;
+  float prevX, prevY;
+  float vx, vy;
   int r;
 };
 
 struct TrailManager {
-  struct TrailCircle *trail;
+  struct TrailRing ring;
   int length;
+  int radius;
   float spacing;
   float distance_since_last_trail;
   float velocity_magnitude;
@@ -38,9 +67,9 @@ int init(void) {
   return sdlInit;
 }
 
-void cleanup(SDL_Window *win, struct TrailCircle *trail) {
-  if (trail != NULL) {
-    free(trail);
+void cleanup(SDL_Window *win, struct TrailManager *manager) {
+  if (manager != NULL) {
+    trailFree(&manager->ring);
   }
 
   if (win != NULL) {
@@ -50,123 +79,587 @@ void cleanup(SDL_Window *win, struct TrailCircle *trail) {
   SDL_Quit();
 }
 
-void drawCircle(SDL_Surface *layer, struct Circle *circle, SDL_Color color) {
+// Locks the layer and points the buffer at its pixels. Only 32-bit
+// surfaces, the usual window format, can be drawn to.
+int beginDraw(SDL_Surface *layer, struct PixelBuffer *buffer) {
+  if (layer->format->BytesPerPixel != 4) {
+    fprintf(stderr, "Only 32-bit surfaces can be drawn to.\n");
+    return -1;
+  }
+
   if (SDL_MUSTLOCK(layer)) {
     if (SDL_LockSurface(layer) < 0) {
       fprintf(stderr, "SDL_LockSurface Error: %s\n", SDL_GetError());
-      return;
+      return -1;
     }
   }
 
-  int rSq = circle->r * circle->r;
-  Uint32 mappedColor = SDL_MapRGB(layer->format, color.r, color.g, color.b);
-  int xStart = (circle->x - circle->r) < 0 ? 0 : circle->x - circle->r;
-  int xEnd = (circle->x + circle->r) > SCREEN_WIDTH ? SCREEN_WIDTH
-                                                    : circle->x + circle->r;
-  int yStart = (circle->y - circle->r) < 0 ? 0 : circle->y - circle->r;
-  int yEnd = (circle->y + circle->r) > SCREEN_HEIGHT ? SCREEN_HEIGHT
-                                                     : circle->y + circle->r;
-
-  for (int x = xStart; x < xEnd; x++) {
-    for (int y = yStart; y < yEnd; y++) {
-      int xDiff = x - circle->x;
-      int yDiff = y - circle->y;
-      int distSq = xDiff * xDiff + yDiff * yDiff;
-      if (distSq <= rSq) {
-        ((Uint32 *)layer->pixels)[y * layer->w + x] = mappedColor;
-      }
-    }
-  }
+  buffer->pixels = layer->pixels;
+  buffer->width = layer->w;
+  buffer->height = layer->h;
+  buffer->pitch = layer->pitch / 4;
+  return 0;
+}
 
+void endDraw(SDL_Surface *layer) {
   if (SDL_MUSTLOCK(layer)) {
     SDL_UnlockSurface(layer);
   }
 }
 
-void updateCircle(struct Circle *circle) {
-  circle->x += circle->vx;
-  circle->y += circle->vy;
+// Any number of circles of one colour under a single lock. Returns the
+// pixels drawn.
+long drawCircles(SDL_Surface *layer, const struct Circle *circles, int count,
+                 SDL_Color color) {
+  struct PixelBuffer buffer;
+  if (beginDraw(layer, &buffer) != 0)
+    return 0;
+
+  Uint32 mappedColor = SDL_MapRGB(layer->format, color.r, color.g, color.b);
+  long filled = 0;
+  for (int i = 0; i < count; i++) {
+    filled += rasterCircle(&buffer, circles[i].x, circles[i].y, circles[i].r,
+                           mappedColor);
+  }
+
+  endDraw(layer);
+  return filled;
+}
+
+long drawCircle(SDL_Surface *layer, struct Circle *circle, SDL_Color color) {
+  return drawCircles(layer, circle, 1, color);
+}
+
+void addCircleDamage(struct DamageList *list, struct Circle *circle) {
+  damageAdd(list, circle->x - circle->r, circle->y - circle->r,
+            2 * circle->r + 1, 2 * circle->r + 1);
+}
+
+// Mirrors a coordinate that went past a wall back inside and turns the
+// velocity away from the wall
+void bounce(float *pos, float *vel, float lo, float hi) {
+  if (*pos < lo) {
+    *pos = 2 * lo - *pos;
+    *vel = fabsf(*vel);
+  } else if (*pos > hi) {
+    *pos = 2 * hi - *pos;
+    *vel = -fabsf(*vel);
+  }
+}
+
+void stepBall(struct Ball *ball, float dt) {
+  ball->prevX = ball->x;
+  ball->prevY = ball->y;
+  ball->x += ball->vx * dt;
+  ball->y += ball->vy * dt;
+  bounce(&ball->x, &ball->vx, ball->r, SCREEN_WIDTH - ball->r);
+  bounce(&ball->y, &ball->vy, ball->r, SCREEN_HEIGHT - ball->r);
+}
+
+// The ball alpha of the way from its last position to its current one
+struct Circle interpolateBall(struct Ball *ball, float alpha) {
+  struct Circle circle = {
+      (int)lroundf(ball->prevX + (ball->x - ball->prevX) * alpha),
+      (int)lroundf(ball->prevY + (ball->y - ball->prevY) * alpha), ball->r};
+  return circle;
+}
+
+// Paces frames to the display's refresh rate and records how long each
+// frame really took. A window surface has no vsync, so this sleeps to the
+// next refresh deadline instead.
+struct FrameClock {
+  double frequency;
+  double period;
+  Uint64 last;
+  Uint64 next;
+  Uint32 lastReport;
+  struct FrameStats stats;
+};
+
+void frameClockInit(struct FrameClock *clock, SDL_Window *win) {
+  SDL_DisplayMode mode;
+  int display = SDL_GetWindowDisplayIndex(win);
+  int refresh = 60;
+  if (display >= 0 && SDL_GetCurrentDisplayMode(display, &mode) == 0 &&
+      mode.refresh_rate > 0)
+    refresh = mode.refresh_rate;
+
+  clock->frequency = (double)SDL_GetPerformanceFrequency();
+  clock->period = 1.0 / refresh;
+  clock->last = SDL_GetPerformanceCounter();
+  clock->next = clock->last;
+  clock->lastReport = SDL_GetTicks();
+  // A frame is late once it has run into the refresh after its own
+  frameStatsInit(&clock->stats, 1.5 * clock->period);
+}
+
+// Starts a frame and returns the seconds since the last one started
+double frameClockTick(struct FrameClock *clock) {
+  Uint64 now = SDL_GetPerformanceCounter();
+  double elapsed = (now - clock->last) / clock->frequency;
+  clock->last = now;
+  frameStatsAdd(&clock->stats, elapsed);
+  return elapsed;
+}
+
+// Sleeps until the next deadline, the last bit spinning as SDL_Delay is only
+// good to a millisecond or so. A frame that overran starts the deadlines
+// afresh rather than rushing to catch up.
+void frameClockWait(struct FrameClock *clock) {
+  Uint64 period = (Uint64)(clock->period * clock->frequency);
+  Uint64 now = SDL_GetPerformanceCounter();
+  clock->next += period;
+  if (clock->next < now) {
+    clock->next = now;
+    return;
+  }
+
+  double remaining = (clock->next - now) / clock->frequency;
+  if (remaining > 0.002)
+    SDL_Delay((Uint32)((remaining - 0.002) * 1000));
+  while (SDL_GetPerformanceCounter() < clock->next) {
+  }
+}
+
+// Once a second prints the frame times and starts a new histogram
+void frameClockReport(struct FrameClock *clock, const struct FixedStep *fs) {
+  if (SDL_GetTicks() - clock->lastReport < 1000)
+    return;
+
+  struct FrameStats *stats = &clock->stats;
+  printf("%.0f fps: p50 %.2f ms, p99 %.2f ms, worst %.2f ms, %d of %d late "
+         "(over %.2f ms), %lld steps dropped\n",
+         stats->frames / stats->total,
+         frameStatsPercentile(stats, 0.5) * 1e3,
+         frameStatsPercentile(stats, 0.99) * 1e3, stats->worst * 1e3,
+         stats->missed, stats->frames, stats->budget * 1e3, fs->dropped);
+  frameStatsInit(stats, stats->budget);
+  clock->lastReport = SDL_GetTicks();
+}
+
+// --record streams every frame to a file from a writer thread. --offscreen
+// draws with SDL's dummy video driver instead of a window, each frame
+// standing for 1 / RECORD_FPS seconds however long it took, and as fast as
+// frames can be drawn and written.
+struct Capture {
+  struct FrameDump dump;
+  int recording;
+  int offscreen;
+  // Stops after this many frames when above 0
+  int frameLimit;
+  int frames;
+  Uint64 start;
+};
 
-  if (circle->x - circle->r < 0 || circle->x + circle->r > SCREEN_WIDTH) {
-    circle->vx = -circle->vx;
-    if (circle->x - circle->r < 0)
-      circle->x = circle->r;
-    if (circle->x + circle->r > SCREEN_WIDTH)
-      circle->x = SCREEN_WIDTH - circle->r;
+int startCapture(struct Capture *capture, SDL_Surface *screen,
+                 const char *path) {
+  capture->frames = 0;
+  capture->start = SDL_GetPerformanceCounter();
+  capture->recording = path != NULL;
+  if (capture->recording &&
+      frameDumpOpen(&capture->dump, path, screen->w, screen->h, RECORD_FPS,
+                    screen->format->Rmask, screen->format->Gmask,
+                    screen->format->Bmask) != 0) {
+    fprintf(stderr, "Failed to start recording to %s\n", path);
+    return -1;
   }
+  return 0;
+}
+
+// Seconds the frame stands for
+double captureElapsed(struct Capture *capture, double elapsed) {
+  return capture->offscreen ? 1.0 / RECORD_FPS : elapsed;
+}
+
+// Hands the finished frame to the writer. On screen a frame the writer has
+// no room for is dropped rather than held up; offscreen there is no
+// display to keep up with, so it waits.
+void captureFrame(struct Capture *capture, SDL_Surface *screen) {
+  capture->frames++;
+  struct PixelBuffer buffer;
+  if (!capture->recording || beginDraw(screen, &buffer) != 0)
+    return;
+
+  frameDumpPush(&capture->dump, buffer.pixels, buffer.pitch,
+                capture->offscreen);
+  endDraw(screen);
+}
+
+int captureDone(struct Capture *capture) {
+  return capture->frameLimit > 0 && capture->frames >= capture->frameLimit;
+}
 
-  if (circle->y - circle->r < 0 || circle->y + circle->r > SCREEN_HEIGHT) {
-    circle->vy = -circle->vy;
-    if (circle->y - circle->r < 0)
-      circle->y = circle->r;
-    if (circle->y + circle->r > SCREEN_HEIGHT)
-      circle->y = SCREEN_HEIGHT - circle->r;
+// Reports the frame rate achieved, and finishes the recording
+int finishCapture(struct Capture *capture) {
+  double seconds = (SDL_GetPerformanceCounter() - capture->start) /
+                   (double)SDL_GetPerformanceFrequency();
+  printf("%d frames in %.2f s: %.1f fps\n", capture->frames, seconds,
+         capture->frames / seconds);
+  if (!capture->recording)
+    return 0;
+
+  long long dropped = capture->dump.dropped;
+  if (frameDumpClose(&capture->dump) != 0) {
+    fprintf(stderr, "Failed to write the recording.\n");
+    return -1;
   }
+  printf("Recorded %lld frames, %lld dropped\n", capture->dump.written,
+         dropped);
+  return 0;
 }
 
-void initializeTrail(struct TrailManager *manager, struct Circle *circle) {
-  manager->trail = malloc(manager->length * sizeof(struct TrailCircle));
-  if (manager->trail == NULL) {
+// Starts the trail as if the ball had always moved the way it is going
+void initializeTrail(struct TrailManager *manager, struct Ball *ball) {
+  if (trailInit(&manager->ring, manager->length) != 0) {
     fprintf(stderr, "Failed to allocate memory for trail.\n");
     exit(1);
   }
 
-  manager->velocity_magnitude = sqrt(pow(circle->vx, 2) + pow(circle->vy, 2));
+  manager->radius = ball->r;
+  manager->velocity_magnitude =
+      sqrtf(ball->vx * ball->vx + ball->vy * ball->vy);
 
-  for (int i = 0; i < manager->length; i++) {
+  for (int i = manager->length - 1; i >= 0; i--) {
     if (manager->velocity_magnitude == 0) {
-      manager->trail[i].x = circle->x;
-      manager->trail[i].y = circle->y;
+      trailPush(&manager->ring, ball->x, ball->y);
     } else {
-      manager->trail[i].x =
-          circle->x - (circle->vx * manager->spacing * (i + 1)) /
-                          manager->velocity_magnitude;
-      manager->trail[i].y =
-          circle->y - (circle->vy * manager->spacing * (i + 1)) /
-                          manager->velocity_magnitude;
+      float back = manager->spacing * (i + 1) / manager->velocity_magnitude;
+      trailPush(&manager->ring, ball->x - ball->vx * back,
+                ball->y - ball->vy * back);
     }
-    manager->trail[i].r = circle->r - ((i + 1) * 4); // Shrinking radius
-    if (manager->trail[i].r < 0)
-      manager->trail[i].r = 0;
   }
 
   manager->distance_since_last_trail = 0.0f;
 }
 
-void addTrail(struct TrailManager *manager, struct Circle *circle) {
-  for (int i = manager->length - 1; i > 0; i--) {
-    manager->trail[i] = manager->trail[i - 1];
-    manager->trail[i].r = circle->r - (i * 4);
-    if (manager->trail[i].r < 0)
-      manager->trail[i].r = 0;
-  }
+void addTrail(struct TrailManager *manager, struct Ball *ball) {
+  trailPush(&manager->ring, ball->x, ball->y);
+}
 
-  manager->trail[0].x = circle->x;
-  manager->trail[0].y = circle->y;
-  manager->trail[0].r = circle->r;
+// Circles shrink by 20 pixels over the trail, newest first
+struct Circle trailCircle(struct TrailManager *manager, int age) {
+  float x, y;
+  trailGet(&manager->ring, age, &x, &y);
+  struct Circle circle = {(int)x, (int)y,
+                          manager->radius - age * 20 / manager->length};
+  return circle;
 }
 
-void drawTrail(SDL_Surface *layer, struct TrailCircle *trail, int length) {
-  for (int i = 0; i < length; i++) {
-    int alpha = 255 - (i * 20);
-    SDL_Color trailColor = {alpha, alpha, 0, 255};
-    struct Circle temp = {(int)trail[i].x, (int)trail[i].y, trail[i].r, 0, 0};
-    drawCircle(layer, &temp, trailColor);
+// Dimming by 100 over the trail, all under one lock. Returns the pixels
+// drawn.
+long drawTrail(SDL_Surface *layer, struct TrailManager *manager) {
+  struct PixelBuffer buffer;
+  if (beginDraw(layer, &buffer) != 0)
+    return 0;
+
+  long filled = 0;
+  for (int i = 0; i < manager->ring.count; i++) {
+    int alpha = 255 - i * 100 / manager->length;
+    struct Circle circle = trailCircle(manager, i);
+    filled += rasterCircle(&buffer, circle.x, circle.y, circle.r,
+                           SDL_MapRGB(layer->format, alpha, alpha, 0));
   }
+
+  endDraw(layer);
+  return filled;
+}
+
+// Only clears, redraws and presents what changed: where the ball and trail
+// were last frame and where they are now. Everything else is still black
+// from before.
+struct Renderer {
+  struct DamageList drawn;
+  struct DamageList dirty;
+  SDL_Rect rects[DAMAGE_MAX];
+  // Set when the whole window has to be redrawn, as on the first frame or
+  // after it was uncovered; fullRedraw always redraws the whole window
+  int full;
+  int fullRedraw;
+
+  double frequency;
+  Uint32 lastReport;
+  int frames;
+  int rectCount;
+  double bytes;
+  double presentSeconds;
+  double worstPresent;
+};
+
+void initRenderer(struct Renderer *renderer, int fullRedraw) {
+  memset(renderer, 0, sizeof(struct Renderer));
+  damageInit(&renderer->drawn, SCREEN_WIDTH, SCREEN_HEIGHT);
+  damageInit(&renderer->dirty, SCREEN_WIDTH, SCREEN_HEIGHT);
+  renderer->full = 1;
+  renderer->fullRedraw = fullRedraw;
+  renderer->frequency = (double)SDL_GetPerformanceFrequency();
+  renderer->lastReport = SDL_GetTicks();
 }
 
 void drawUpdate(SDL_Surface *layer, SDL_Window *win, struct Circle *circle,
-                struct TrailManager *manager) {
-  SDL_FillRect(layer, NULL, SDL_MapRGB(layer->format, 0, 0, 0));
+                struct TrailManager *manager, struct Renderer *renderer) {
+  struct DamageList drawing;
+  damageInit(&drawing, SCREEN_WIDTH, SCREEN_HEIGHT);
+  addCircleDamage(&drawing, circle);
+  for (int i = 0; i < manager->ring.count; i++) {
+    struct Circle trail = trailCircle(manager, i);
+    addCircleDamage(&drawing, &trail);
+  }
 
+  struct DamageList *dirty = &renderer->dirty;
+  damageClear(dirty);
+  if (renderer->full || renderer->fullRedraw) {
+    damageAdd(dirty, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+  } else {
+    damageAddList(dirty, &renderer->drawn);
+    damageAddList(dirty, &drawing);
+    damageMerge(dirty);
+  }
+
+  Uint32 black = SDL_MapRGB(layer->format, 0, 0, 0);
+  for (int i = 0; i < dirty->count; i++) {
+    struct DamageRect *r = &dirty->rects[i];
+    SDL_Rect rect = {r->x, r->y, r->w, r->h};
+    renderer->rects[i] = rect;
+    SDL_FillRect(layer, &rect, black);
+  }
+
+  // Everything drawn lies in the rectangles just cleared
   SDL_Color circleColor = {255, 255, 255, 255};
-  drawTrail(layer, manager->trail, manager->length);
-  drawCircle(layer, circle, circleColor);
+  long filled = damageArea(dirty) + drawTrail(layer, manager) +
+                drawCircle(layer, circle, circleColor);
+
+  Uint64 start = SDL_GetPerformanceCounter();
+  SDL_UpdateWindowSurfaceRects(win, renderer->rects, dirty->count);
+  double present = (SDL_GetPerformanceCounter() - start) /
+                   renderer->frequency;
+
+  renderer->drawn = drawing;
+  renderer->full = 0;
+  renderer->frames++;
+  renderer->rectCount += dirty->count;
+  renderer->bytes += filled * sizeof(Uint32);
+  renderer->presentSeconds += present;
+  if (present > renderer->worstPresent)
+    renderer->worstPresent = present;
+}
+
+// Once a second prints what a frame touched and how long presenting took
+void rendererReport(struct Renderer *renderer) {
+  if (SDL_GetTicks() - renderer->lastReport < 1000 || renderer->frames == 0)
+    return;
+
+  int frames = renderer->frames;
+  printf("%.1f rects, %.0f KB touched a frame of %.0f KB, present %.3f ms "
+         "(worst %.3f ms)\n",
+         (double)renderer->rectCount / frames, renderer->bytes / frames / 1024,
+         SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(Uint32) / 1024.0,
+         renderer->presentSeconds * 1e3 / frames,
+         renderer->worstPresent * 1e3);
+  renderer->frames = 0;
+  renderer->rectCount = 0;
+  renderer->bytes = 0;
+  renderer->presentSeconds = 0;
+  renderer->worstPresent = 0;
+  renderer->lastReport = SDL_GetTicks();
+}
+
+// Off-screen picture that is only ever faded and drawn over, never
+// cleared, so whatever was drawn leaves a trail however long for one pass
+// over the pixels a frame
+int initFade(struct PixelBuffer *fade) {
+  fade->pixels = calloc((size_t)SCREEN_WIDTH * SCREEN_HEIGHT, sizeof(Uint32));
+  fade->width = SCREEN_WIDTH;
+  fade->height = SCREEN_HEIGHT;
+  fade->pitch = SCREEN_WIDTH;
+  if (fade->pixels == NULL) {
+    fprintf(stderr, "Failed to allocate the fade buffer.\n");
+    return -1;
+  }
+  return 0;
+}
+
+// Fades by however much FADE_HALF_LIFE says elapsed seconds should, so
+// trails are as long at any frame rate
+void fadeFor(struct PixelBuffer *fade, double elapsed) {
+  rasterFade(fade, (int)lround(256 * pow(0.5, elapsed / FADE_HALF_LIFE)));
+}
+
+// Puts the fade buffer on the layer, for drawing on top of before updating
+void showFade(SDL_Surface *layer, struct PixelBuffer *fade) {
+  struct PixelBuffer buffer;
+  if (beginDraw(layer, &buffer) != 0)
+    return;
+
+  rasterCopy(&buffer, fade);
+  endDraw(layer);
+}
+
+// Radius at which count balls cover PARTICLE_COVERAGE of the window, but
+// never under half a pixel
+float particleRadius(int count) {
+  float radius = sqrtf(PARTICLE_COVERAGE * SCREEN_WIDTH * SCREEN_HEIGHT /
+                       (3.14159265f * count));
+  return radius < 0.5f ? 0.5f : radius;
+}
+
+void fillParticles(struct PixelBuffer *buffer, struct ParticleSystem *ps,
+                   Uint32 color) {
+  int r = (int)(ps->radius + 0.5f);
+  r = r < 1 ? 1 : r;
+  for (int i = 0; i < ps->count; i++) {
+    rasterCircle(buffer, (int)ps->x[i], (int)ps->y[i], r, color);
+  }
+}
+
+void drawParticles(SDL_Surface *layer, struct ParticleSystem *ps,
+                   SDL_Color color) {
+  struct PixelBuffer buffer;
+  if (beginDraw(layer, &buffer) != 0)
+    return;
+
+  fillParticles(&buffer, ps,
+                SDL_MapRGB(layer->format, color.r, color.g, color.b));
+  endDraw(layer);
+}
+
+// Many balls instead of one, bouncing off each other as well as the walls.
+// Prints the step time and collisions once a second. Balls move in whole
+// steps without interpolation, as the sort reorders them every step. With
+// fade every step is drawn into the fade buffer, so each ball leaves a
+// trail.
+int runParticles(SDL_Surface *screen, SDL_Window *win, int count, int fade,
+                 struct Capture *capture) {
+  struct ParticleSystem ps;
+  if (particlesInit(&ps, count, SCREEN_WIDTH, SCREEN_HEIGHT,
+                    particleRadius(count)) != 0) {
+    fprintf(stderr, "Failed to allocate %d balls.\n", count);
+    return 1;
+  }
+  particlesRandomize(&ps, 1, PARTICLE_SPEED);
+
+  struct PixelBuffer fadeBuffer = {NULL, 0, 0, 0};
+  if (fade && initFade(&fadeBuffer) != 0) {
+    particlesFree(&ps);
+    return 1;
+  }
+
+  SDL_Color ballColor = {255, 255, 255, 255};
+  Uint32 background = SDL_MapRGB(screen->format, 0, 0, 0);
+  Uint32 mappedBall = SDL_MapRGB(screen->format, 255, 255, 255);
+  double frequency = (double)SDL_GetPerformanceFrequency();
+  struct FixedStep fs;
+  fixedStepInit(&fs, 1.0 / STEPS_PER_SECOND, MAX_STEPS_PER_FRAME);
+  struct FrameClock clock;
+  frameClockInit(&clock, win);
+  Uint32 lastReport = SDL_GetTicks();
+  double stepSeconds = 0;
+  long long collisions = 0;
+  int steps = 0;
+
+  SDL_Event e;
+  int running = 1;
+  while (running) {
+    while (SDL_PollEvent(&e)) {
+      if (e.type == SDL_QUIT ||
+          (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE)) {
+        running = 0;
+        break;
+      }
+    }
+
+    double elapsed = captureElapsed(capture, frameClockTick(&clock));
+    int due = fixedStepAdvance(&fs, elapsed);
+    if (fade)
+      fadeFor(&fadeBuffer, elapsed);
+    for (int i = 0; i < due; i++) {
+      Uint64 start = SDL_GetPerformanceCounter();
+      collisions += particlesStep(&ps, 1);
+      stepSeconds += (SDL_GetPerformanceCounter() - start) / frequency;
+      steps++;
+      if (fade)
+        fillParticles(&fadeBuffer, &ps, mappedBall);
+    }
 
-  SDL_UpdateWindowSurface(win);
+    if (fade) {
+      showFade(screen, &fadeBuffer);
+    } else {
+      SDL_FillRect(screen, NULL, background);
+      drawParticles(screen, &ps, ballColor);
+    }
+    SDL_UpdateWindowSurface(win);
+    captureFrame(capture, screen);
+    running = running && !captureDone(capture);
+
+    if (SDL_GetTicks() - lastReport >= 1000 && steps > 0) {
+      printf("%d balls (radius %.1f): %.2f ms/step, %lld collisions/step\n",
+             count, ps.radius, stepSeconds * 1e3 / steps,
+             collisions / steps);
+      lastReport = SDL_GetTicks();
+      stepSeconds = 0;
+      collisions = 0;
+      steps = 0;
+    }
+    frameClockReport(&clock, &fs);
+    if (!capture->offscreen)
+      frameClockWait(&clock);
+  }
+
+  free(fadeBuffer.pixels);
+  particlesFree(&ps);
+  return 0;
 }
 
-int main(void) {
+int main(int argc, char **argv) {
+  int balls = 0;
+  int trailLength = TRAIL_LENGTH;
+  int fade = 0;
+  int fullRedraw = 0;
+  const char *recordPath = NULL;
+  struct Capture capture = {.offscreen = 0, .frameLimit = 0};
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--balls") == 0 && i + 1 < argc) {
+      balls = atoi(argv[++i]);
+      if (balls < 1) {
+        fprintf(stderr, "Invalid ball count: %s\n", argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--trail") == 0 && i + 1 < argc) {
+      trailLength = atoi(argv[++i]);
+      if (trailLength < 1) {
+        fprintf(stderr, "Invalid trail length: %s\n", argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--fade") == 0) {
+      fade = 1;
+    } else if (strcmp(argv[i], "--full-redraw") == 0) {
+      fullRedraw = 1;
+    } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+      recordPath = argv[++i];
+    } else if (strcmp(argv[i], "--offscreen") == 0) {
+      capture.offscreen = 1;
+    } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      capture.frameLimit = atoi(argv[++i]);
+      if (capture.frameLimit < 1) {
+        fprintf(stderr, "Invalid frame count: %s\n", argv[i]);
+        return 1;
+      }
+    } else {
+      fprintf(stderr,
+              "Usage: %s [--balls N] [--trail N | --fade] [--full-redraw]\n"
+              "          [--record FILE.y4m|FILE.ppm] [--offscreen] "
+              "[--frames N]\n"
+              "Benchmarks and checks live in bouncing_ball-headless.out.\n",
+              argv[0]);
+      return 1;
+    }
+  }
+
+  if (capture.offscreen) {
+    SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+    if (capture.frameLimit == 0)
+      capture.frameLimit = OFFSCREEN_FRAMES;
+  }
+
   if (init() != 0)
     return 1;
 
@@ -187,12 +680,41 @@ int main(void) {
     return 1;
   }
 
-  struct Circle circle = {SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, 50, 5, 5};
+  if (startCapture(&capture, screen, recordPath) != 0) {
+    cleanup(win, NULL);
+    return 1;
+  }
+
+  if (balls > 0) {
+    int result = runParticles(screen, win, balls, fade, &capture);
+    result |= finishCapture(&capture) != 0;
+    cleanup(win, NULL);
+    return result;
+  }
+
+  float centreX = SCREEN_WIDTH / 2.0f, centreY = SCREEN_HEIGHT / 2.0f;
+  struct Ball ball = {centreX,       centreY,       centreX, centreY,
+                      BALL_VELOCITY, BALL_VELOCITY, 50};
 
   struct TrailManager manager;
-  manager.length = TRAIL_LENGTH;
-  manager.spacing = TRAIL_SPACING;
-  initializeTrail(&manager, &circle);
+  manager.length = trailLength;
+  manager.spacing = TRAIL_SPACING * TRAIL_LENGTH / trailLength;
+  initializeTrail(&manager, &ball);
+
+  struct PixelBuffer fadeBuffer = {NULL, 0, 0, 0};
+  if (fade && initFade(&fadeBuffer) != 0) {
+    finishCapture(&capture);
+    cleanup(win, &manager);
+    return 1;
+  }
+  Uint32 mappedBall = SDL_MapRGB(screen->format, 255, 255, 255);
+  struct Renderer renderer;
+  initRenderer(&renderer, fullRedraw);
+
+  struct FixedStep fs;
+  fixedStepInit(&fs, 1.0 / STEPS_PER_SECOND, MAX_STEPS_PER_FRAME);
+  struct FrameClock clock;
+  frameClockInit(&clock, win);
 
   SDL_Event e;
   int running = 1;
@@ -207,27 +729,52 @@ int main(void) {
         running = 0;
         break;
       }
+
+      if (e.type == SDL_WINDOWEVENT &&
+          e.window.event == SDL_WINDOWEVENT_EXPOSED)
+        renderer.full = 1;
     }
 
     if (!running)
       break;
 
-    updateCircle(&circle);
-
-    float dx = circle.vx;
-    float dy = circle.vy;
-    float distance_moved = sqrtf(dx * dx + dy * dy);
-    manager.distance_since_last_trail += distance_moved;
-
-    if (manager.distance_since_last_trail >= manager.spacing) {
-      addTrail(&manager, &circle);
-      manager.distance_since_last_trail -= manager.spacing;
+    double elapsed = captureElapsed(&capture, frameClockTick(&clock));
+    int steps = fixedStepAdvance(&fs, elapsed);
+    if (fade)
+      fadeFor(&fadeBuffer, elapsed);
+    for (int i = 0; i < steps; i++) {
+      stepBall(&ball, fs.dt);
+      if (fade)
+        rasterCircle(&fadeBuffer, (int)ball.x, (int)ball.y, ball.r,
+                     mappedBall);
+
+      manager.distance_since_last_trail +=
+          manager.velocity_magnitude * fs.dt;
+      if (manager.distance_since_last_trail >= manager.spacing) {
+        addTrail(&manager, &ball);
+        manager.distance_since_last_trail -= manager.spacing;
+      }
     }
 
-    drawUpdate(screen, win, &circle, &manager);
-    SDL_Delay(1000 / 120);
+    struct Circle circle = interpolateBall(&ball, fixedStepAlpha(&fs));
+    if (fade) {
+      showFade(screen, &fadeBuffer);
+      SDL_Color circleColor = {255, 255, 255, 255};
+      drawCircle(screen, &circle, circleColor);
+      SDL_UpdateWindowSurface(win);
+    } else {
+      drawUpdate(screen, win, &circle, &manager, &renderer);
+      rendererReport(&renderer);
+    }
+    captureFrame(&capture, screen);
+    running = !captureDone(&capture);
+    frameClockReport(&clock, &fs);
+    if (!capture.offscreen)
+      frameClockWait(&clock);
   }
 
-  cleanup(win, manager.trail);
-  return 0;
+  int result = finishCapture(&capture) != 0;
+  free(fadeBuffer.pixels);
+  cleanup(win, &manager);
+  return result;
 }
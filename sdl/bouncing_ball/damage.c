@@ -0,0 +1,77 @@
+#include "damage.h"
+
+void damageInit(struct DamageList *list, int width, int height) {
+  list->count = 0;
+  list->width = width;
+  list->height = height;
+}
+
+void damageClear(struct DamageList *list) { list->count = 0; }
+
+static void unite(struct DamageRect *a, const struct DamageRect *b) {
+  int x1 = a->x + a->w > b->x + b->w ? a->x + a->w : b->x + b->w;
+  int y1 = a->y + a->h > b->y + b->h ? a->y + a->h : b->y + b->h;
+  a->x = a->x < b->x ? a->x : b->x;
+  a->y = a->y < b->y ? a->y : b->y;
+  a->w = x1 - a->x;
+  a->h = y1 - a->y;
+}
+
+void damageAdd(struct DamageList *list, int x, int y, int w, int h) {
+  int x1 = x + w > list->width ? list->width : x + w;
+  int y1 = y + h > list->height ? list->height : y + h;
+  x = x < 0 ? 0 : x;
+  y = y < 0 ? 0 : y;
+  if (x >= x1 || y >= y1)
+    return;
+
+  struct DamageRect rect = {x, y, x1 - x, y1 - y};
+  if (list->count < DAMAGE_MAX) {
+    list->rects[list->count++] = rect;
+    return;
+  }
+
+  for (int i = 1; i < list->count; i++) {
+    unite(&list->rects[0], &list->rects[i]);
+  }
+  unite(&list->rects[0], &rect);
+  list->count = 1;
+}
+
+void damageAddList(struct DamageList *list, const struct DamageList *other) {
+  for (int i = 0; i < other->count; i++) {
+    const struct DamageRect *r = &other->rects[i];
+    damageAdd(list, r->x, r->y, r->w, r->h);
+  }
+}
+
+static int touching(const struct DamageRect *a, const struct DamageRect *b) {
+  return a->x <= b->x + b->w && b->x <= a->x + a->w && a->y <= b->y + b->h &&
+         b->y <= a->y + a->h;
+}
+
+// A merged rectangle can reach others that were apart before, so pairs are
+// looked at again until a whole pass merges none
+void damageMerge(struct DamageList *list) {
+  int merged = 1;
+  while (merged) {
+    merged = 0;
+    for (int i = 0; i < list->count; i++) {
+      for (int j = i + 1; j < list->count; j++) {
+        if (touching(&list->rects[i], &list->rects[j])) {
+          unite(&list->rects[i], &list->rects[j]);
+          list->rects[j--] = list->rects[--list->count];
+          merged = 1;
+        }
+      }
+    }
+  }
+}
+
+long damageArea(const struct DamageList *list) {
+  long area = 0;
+  for (int i = 0; i < list->count; i++) {
+    area += (long)list->rects[i].w * list->rects[i].h;
+  }
+  return area;
+}
@@ -0,0 +1,33 @@
+#ifndef DAMAGE_H
+#define DAMAGE_H
+
+// Up to this many separate rectangles; adding more collapses the list to
+// the one rectangle around them all
+#define DAMAGE_MAX 64
+
+// Same layout as SDL_Rect
+struct DamageRect {
+  int x, y, w, h;
+};
+
+// Parts of a width by height screen that changed and have to be redrawn
+// and presented
+struct DamageList {
+  struct DamageRect rects[DAMAGE_MAX];
+  int count;
+  int width, height;
+};
+
+void damageInit(struct DamageList *list, int width, int height);
+void damageClear(struct DamageList *list);
+// Adds a rectangle, clipped to the screen. Empty ones are dropped.
+void damageAdd(struct DamageList *list, int x, int y, int w, int h);
+// Adds every rectangle of another list
+void damageAddList(struct DamageList *list, const struct DamageList *other);
+// Replaces rectangles that overlap or touch by the one around them, until
+// none do, so no pixel is cleared or presented twice
+void damageMerge(struct DamageList *list);
+// Pixels covered, counting overlaps more than once
+long damageArea(const struct DamageList *list);
+
+#endif
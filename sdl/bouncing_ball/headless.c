@@ -0,0 +1,685 @@
+#define _POSIX_C_SOURCE 200809L
+
+// Headless front end for the particle engine: benchmarks and checks,
+// without SDL
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "damage.h"
+#include "framedump.h"
+#include "pacing.h"
+#include "particles.h"
+#include "raster.h"
+#include "trail.h"
+
+static const float PI = 3.14159265f;
+
+double nowSeconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Square box in which count balls of the radius cover the given fraction
+// of the floor, so every size sees about as many collisions per ball
+int initPacked(struct ParticleSystem *ps, int count, float radius,
+               float coverage, uint64_t seed) {
+  float side = sqrtf(count * PI * radius * radius / coverage);
+  if (particlesInit(ps, count, side, side, radius) != 0) {
+    fprintf(stderr, "Failed to allocate %d particles.\n", count);
+    return -1;
+  }
+
+  particlesRandomize(ps, seed, 2 * radius);
+  return 0;
+}
+
+double kineticEnergy(struct ParticleSystem *ps) {
+  double energy = 0;
+  for (int i = 0; i < ps->count; i++) {
+    energy += 0.5 * ((double)ps->vx[i] * ps->vx[i] +
+                     (double)ps->vy[i] * ps->vy[i]);
+  }
+  return energy;
+}
+
+// Touching pairs by testing every pair, for checking the grid
+int bruteForceContacts(struct ParticleSystem *ps) {
+  float diameter = 2 * ps->radius;
+  int contacts = 0;
+  for (int i = 0; i < ps->count; i++) {
+    for (int j = i + 1; j < ps->count; j++) {
+      float dx = ps->x[j] - ps->x[i];
+      float dy = ps->y[j] - ps->y[i];
+      contacts += dx * dx + dy * dy < diameter * diameter;
+    }
+  }
+  return contacts;
+}
+
+// Balls outside the box, which only collisions can push them into until
+// the next move puts them back
+int ballsOutside(struct ParticleSystem *ps) {
+  float r = ps->radius;
+  int outside = 0;
+  for (int i = 0; i < ps->count; i++) {
+    outside += ps->x[i] < r || ps->x[i] > ps->width - r || ps->y[i] < r ||
+               ps->y[i] > ps->height - r;
+  }
+  return outside;
+}
+
+// The grid finds the same touching pairs as testing all of them, walls and
+// collisions keep the kinetic energy, and every move ends in the box
+int particlesCheck(void) {
+  struct ParticleSystem ps;
+  if (initPacked(&ps, 3000, 2, 0.3f, 1) != 0)
+    return 1;
+
+  int failures = 0;
+  int outside = 0;
+  double energy = kineticEnergy(&ps);
+  for (int step = 0; step < 200; step++) {
+    particlesMove(&ps, 1);
+    outside += ballsOutside(&ps);
+    particlesSort(&ps);
+    if (step % 50 == 0) {
+      int grid = particlesCountContacts(&ps);
+      int all = bruteForceContacts(&ps);
+      if (grid != all) {
+        printf("contacts: step %d, the grid found %d of %d\n", step, grid,
+               all);
+        failures++;
+      }
+    }
+    particlesCollide(&ps);
+  }
+
+  double drift = fabs(kineticEnergy(&ps) - energy) / energy;
+  if (drift > 1e-3) {
+    printf("energy  : drifted by %.2e\n", drift);
+    failures++;
+  }
+
+  if (outside > 0) {
+    printf("walls   : %d balls left the box\n", outside);
+    failures++;
+  }
+
+  if (failures == 0)
+    printf("particles: ok (contacts match all pairs, energy kept to %.1e)\n",
+           drift);
+  particlesFree(&ps);
+  return failures != 0;
+}
+
+// Steps 1K to 1M balls, each for about the same total work, and reports
+// steps/sec and the pairs tested and colliding per step
+int scalingReport(float radius, float coverage) {
+  printf("Radius %.1f, %.0f%% of the floor covered\n", radius,
+         coverage * 100);
+  printf("%9s %8s %7s %11s %11s %13s %9s\n", "balls", "box", "steps",
+         "steps/sec", "ns/ball", "tested/step", "hits/step");
+
+  for (int count = 1000; count <= 1000000; count *= 10) {
+    struct ParticleSystem ps;
+    if (initPacked(&ps, count, radius, coverage, 42) != 0)
+      return 1;
+
+    // A few untimed steps, so the balls are in cell order to begin with
+    for (int step = 0; step < 5; step++) {
+      particlesStep(&ps, 1);
+    }
+
+    int steps = 10000000 / count;
+    steps = steps < 10 ? 10 : steps;
+    uint64_t tested = 0, collisions = 0;
+    double start = nowSeconds();
+    for (int step = 0; step < steps; step++) {
+      collisions += particlesStep(&ps, 1);
+      tested += ps.tested;
+    }
+    double rate = steps / (nowSeconds() - start);
+
+    printf("%9d %8.0f %7d %11.1f %11.2f %13.0f %9.0f\n", count, ps.width,
+           steps, rate, 1e9 / rate / count, (double)tested / steps,
+           (double)collisions / steps);
+    particlesFree(&ps);
+  }
+
+  return 0;
+}
+
+// The drawCircle rasterizer rasterCircle replaced: a distance test for
+// every pixel of the bounding box, column by column
+long perPixelCircle(struct PixelBuffer *buffer, int cx, int cy, int r,
+                    uint32_t color) {
+  if (r <= 0)
+    return 0;
+
+  int xStart = cx - r < 0 ? 0 : cx - r;
+  int xEnd = cx + r + 1 > buffer->width ? buffer->width : cx + r + 1;
+  int yStart = cy - r < 0 ? 0 : cy - r;
+  int yEnd = cy + r + 1 > buffer->height ? buffer->height : cy + r + 1;
+  long filled = 0;
+  for (int x = xStart; x < xEnd; x++) {
+    for (int y = yStart; y < yEnd; y++) {
+      int xDiff = x - cx;
+      int yDiff = y - cy;
+      if (xDiff * xDiff + yDiff * yDiff <= r * r) {
+        buffer->pixels[(long)y * buffer->pitch + x] = color;
+        filled++;
+      }
+    }
+  }
+  return filled;
+}
+
+// Spans fill exactly the pixels the distance test does, clipped at every
+// edge, and nothing in the padding past the last column
+int rasterCheck(void) {
+  enum { WIDTH = 97, HEIGHT = 61, PITCH = 100 };
+  static uint32_t spans[HEIGHT * PITCH], tested[HEIGHT * PITCH];
+  struct PixelBuffer spanBuffer = {spans, WIDTH, HEIGHT, PITCH};
+  struct PixelBuffer testBuffer = {tested, WIDTH, HEIGHT, PITCH};
+  const int centres[][2] = {{48, 30}, {0, 0},    {-5, 20}, {96, 60},
+                            {100, 30}, {20, -12}, {50, 70}, {13, 47}};
+
+  int failures = 0;
+  for (int r = 0; r <= 40; r++) {
+    for (int c = 0; c < 8; c++) {
+      memset(spans, 0, sizeof(spans));
+      memset(tested, 0, sizeof(tested));
+      int cx = centres[c][0], cy = centres[c][1];
+      long spanPixels = rasterCircle(&spanBuffer, cx, cy, r, 0xffffffffu);
+      long testPixels = perPixelCircle(&testBuffer, cx, cy, r, 0xffffffffu);
+      if (spanPixels != testPixels || memcmp(spans, tested, sizeof(spans))) {
+        printf("raster  : radius %d at (%d, %d) differs\n", r, cx, cy);
+        failures++;
+      }
+    }
+  }
+
+  if (failures == 0)
+    printf("raster  : ok (radii 0 to 40, clipped on every side)\n");
+  return failures != 0;
+}
+
+// The ring gives back the newest places, newest first, once it has wrapped
+// around; fading matches scaling each channel on its own, leaves the
+// padding past the row alone, and ends at black
+int trailCheck(void) {
+  int failures = 0;
+  struct TrailRing ring;
+  if (trailInit(&ring, 7) != 0) {
+    fprintf(stderr, "Failed to allocate the trail.\n");
+    return 1;
+  }
+  for (int i = 0; i < 20; i++) {
+    trailPush(&ring, i, -i);
+  }
+  for (int age = 0; age < ring.count; age++) {
+    float x, y;
+    trailGet(&ring, age, &x, &y);
+    if (x != 19 - age || y != age - 19) {
+      printf("trail   : %d back is (%g, %g)\n", age, x, y);
+      failures++;
+    }
+  }
+  if (ring.count != 7) {
+    printf("trail   : holds %d of 7\n", ring.count);
+    failures++;
+  }
+  trailFree(&ring);
+
+  enum { WIDTH = 37, HEIGHT = 5, PITCH = 40 };
+  static uint32_t pixels[HEIGHT * PITCH], original[HEIGHT * PITCH];
+  struct PixelBuffer buffer = {pixels, WIDTH, HEIGHT, PITCH};
+  const int factors[] = {0, 1, 128, 250, 255, 256};
+  uint64_t state = 11;
+  for (int i = 0; i < HEIGHT * PITCH; i++) {
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    original[i] = (uint32_t)(state >> 32);
+  }
+  for (int f = 0; f < 6; f++) {
+    memcpy(pixels, original, sizeof(pixels));
+    rasterFade(&buffer, factors[f]);
+    int wrong = 0;
+    for (int i = 0; i < HEIGHT * PITCH; i++) {
+      uint32_t expected = original[i];
+      if (i % PITCH < WIDTH) {
+        expected = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+          expected |= (((original[i] >> shift) & 0xff) * factors[f] >> 8)
+                      << shift;
+        }
+      }
+      wrong += pixels[i] != expected;
+    }
+    if (wrong > 0) {
+      printf("fade    : %d pixels wrong at factor %d\n", wrong, factors[f]);
+      failures++;
+    }
+  }
+
+  int passes = 0;
+  memset(pixels, 0xff, sizeof(pixels));
+  for (int left = 1; left > 0 && passes < 1000; passes++) {
+    rasterFade(&buffer, 250);
+    left = 0;
+    for (int y = 0; y < HEIGHT; y++) {
+      for (int x = 0; x < WIDTH; x++) {
+        left += pixels[y * PITCH + x] != 0;
+      }
+    }
+  }
+  if (passes >= 1000) {
+    printf("fade    : still not black after %d passes\n", passes);
+    failures++;
+  }
+
+  if (failures == 0)
+    printf("trail   : ok (ring wraps, fade exact, black after %d passes)\n",
+           passes);
+  return failures != 0;
+}
+
+// Mpixels/sec filled by spans and by the per-pixel test, for circles of
+// growing radius at random places in a window sized buffer
+int rasterBench(void) {
+  enum { WIDTH = 1200, HEIGHT = 900 };
+  uint32_t *pixels = malloc((size_t)WIDTH * HEIGHT * sizeof(uint32_t));
+  if (pixels == NULL) {
+    fprintf(stderr, "Failed to allocate the buffer.\n");
+    return 1;
+  }
+  struct PixelBuffer buffer = {pixels, WIDTH, HEIGHT, WIDTH};
+
+  printf("%6s %10s %14s %14s %8s\n", "radius", "circles", "span Mpx/s",
+         "pixel Mpx/s", "speedup");
+  for (int r = 1; r <= 256; r *= 2) {
+    // About 20M pixels a run
+    int circles = (int)(20e6 / (3.14159 * r * r + 1));
+    double rates[2];
+    for (int method = 0; method < 2; method++) {
+      uint64_t state = 7;
+      long filled = 0;
+      double start = nowSeconds();
+      for (int i = 0; i < circles; i++) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        int cx = (int)((state >> 33) % WIDTH);
+        int cy = (int)((state >> 17) % HEIGHT);
+        uint32_t color = (uint32_t)state;
+        filled += method == 0 ? rasterCircle(&buffer, cx, cy, r, color)
+                              : perPixelCircle(&buffer, cx, cy, r, color);
+      }
+      rates[method] = filled / (nowSeconds() - start) / 1e6;
+    }
+
+    printf("%6d %10d %14.1f %14.1f %7.1fx\n", r, circles, rates[0],
+           rates[1], rates[0] / rates[1]);
+  }
+
+  // The fixed cost of --fade, whatever is on screen
+  uint32_t *copy = malloc((size_t)WIDTH * HEIGHT * sizeof(uint32_t));
+  if (copy == NULL) {
+    fprintf(stderr, "Failed to allocate the buffer.\n");
+    free(pixels);
+    return 1;
+  }
+  struct PixelBuffer screen = {copy, WIDTH, HEIGHT, WIDTH};
+  int frames = 200;
+  double start = nowSeconds();
+  for (int i = 0; i < frames; i++) {
+    rasterFade(&buffer, 245);
+  }
+  double fade = (nowSeconds() - start) / frames;
+  start = nowSeconds();
+  for (int i = 0; i < frames; i++) {
+    rasterCopy(&screen, &buffer);
+  }
+  double shown = (nowSeconds() - start) / frames;
+  printf("%dx%d frame: fade %.3f ms (%.0f Mpx/s), copy %.3f ms\n", WIDTH,
+         HEIGHT, fade * 1e3, WIDTH * HEIGHT / fade / 1e6, shown * 1e3);
+
+  free(copy);
+
+  free(pixels);
+  return 0;
+}
+
+// Marks the pixels of a damage list's rectangles in a mask, and returns how
+// many were marked twice
+static int markDamage(unsigned char *mask, const struct DamageList *list) {
+  int twice = 0;
+  for (int i = 0; i < list->count; i++) {
+    const struct DamageRect *r = &list->rects[i];
+    for (int y = r->y; y < r->y + r->h; y++) {
+      for (int x = r->x; x < r->x + r->w; x++) {
+        twice += mask[y * list->width + x]++ > 0;
+      }
+    }
+  }
+  return twice;
+}
+
+// Merged rectangles stay on screen, cover everything the rectangles added
+// did, and neither overlap nor touch; a list that overflows becomes the
+// rectangle around everything
+int damageCheck(void) {
+  enum { WIDTH = 160, HEIGHT = 120 };
+  static unsigned char added[WIDTH * HEIGHT], merged[WIDTH * HEIGHT];
+  struct DamageList list, raw;
+  uint64_t state = 5;
+  int failures = 0;
+  for (int round = 0; round < 200; round++) {
+    damageInit(&list, WIDTH, HEIGHT);
+    damageInit(&raw, WIDTH, HEIGHT);
+    int count = 1 + round % 40;
+    for (int i = 0; i < count; i++) {
+      state = state * 6364136223846793005ull + 1442695040888963407ull;
+      int x = (int)((state >> 33) % (WIDTH + 40)) - 20;
+      int y = (int)((state >> 45) % (HEIGHT + 40)) - 20;
+      int w = (int)((state >> 20) % 30), h = (int)((state >> 10) % 30);
+      damageAdd(&list, x, y, w, h);
+      damageAdd(&raw, x, y, w, h);
+    }
+    damageMerge(&list);
+
+    memset(added, 0, sizeof(added));
+    memset(merged, 0, sizeof(merged));
+    markDamage(added, &raw);
+    int twice = markDamage(merged, &list);
+    int missed = 0;
+    for (int i = 0; i < WIDTH * HEIGHT; i++) {
+      missed += added[i] && !merged[i];
+    }
+
+    int touching = 0;
+    for (int i = 0; i < list.count; i++) {
+      for (int j = i + 1; j < list.count; j++) {
+        struct DamageRect *a = &list.rects[i], *b = &list.rects[j];
+        touching += a->x <= b->x + b->w && b->x <= a->x + a->w &&
+                    a->y <= b->y + b->h && b->y <= a->y + a->h;
+      }
+    }
+    if (missed > 0 || twice > 0 || touching > 0) {
+      printf("damage  : round %d, %d pixels missed, %d twice, %d touching\n",
+             round, missed, twice, touching);
+      failures++;
+    }
+  }
+
+  damageInit(&list, WIDTH, HEIGHT);
+  for (int i = 0; i <= DAMAGE_MAX; i++) {
+    damageAdd(&list, i * 2, i, 1, 1);
+  }
+  struct DamageRect *all = &list.rects[0];
+  if (list.count != 1 || all->x != 0 || all->y != 0 ||
+      all->w != DAMAGE_MAX * 2 + 1 || all->h != DAMAGE_MAX + 1) {
+    printf("damage  : overflow left %d rectangles\n", list.count);
+    failures++;
+  }
+
+  if (failures == 0)
+    printf("damage  : ok (merged rectangles cover all, none overlap)\n");
+  return failures != 0;
+}
+
+static long fileSize(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL)
+    return -1;
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fclose(file);
+  return size;
+}
+
+// Known colours convert to the right Y4M and PPM bytes, an odd-sized
+// frame's last chroma averages what there is, and streams come out as
+// long as their headers and frames say, with nothing lost when waiting
+// for room and every frame either written or dropped when not
+int dumpCheck(void) {
+  const int shifts[3] = {16, 8, 0};
+  // White, red, blue and black, as one 2x2 block
+  const uint32_t block[4] = {0xffffff, 0xff0000, 0x0000ff, 0x000000};
+  uint8_t encoded[16];
+  int failures = 0;
+
+  frameDumpEncode(DUMP_Y4M, block, 2, 2, shifts, encoded);
+  // Luma of each, then the block's average: r 127, g 63, b 127
+  const uint8_t y4m[6] = {255, 77, 29, 0, 149, 155};
+  if (memcmp(encoded, y4m, 6) != 0) {
+    printf("dump    : Y4M bytes %d %d %d %d %d %d\n", encoded[0], encoded[1],
+           encoded[2], encoded[3], encoded[4], encoded[5]);
+    failures++;
+  }
+
+  const uint32_t red = 0xff0000, blue = 0x0000ff;
+  frameDumpEncode(DUMP_Y4M, &red, 1, 1, shifts, encoded);
+  frameDumpEncode(DUMP_Y4M, &blue, 1, 1, shifts, encoded + 3);
+  if (encoded[2] != 255 || encoded[4] != 255) {
+    printf("dump    : pure red V %d, pure blue U %d\n", encoded[2],
+           encoded[4]);
+    failures++;
+  }
+
+  frameDumpEncode(DUMP_PPM, block, 2, 2, shifts, encoded);
+  const uint8_t ppm[12] = {255, 255, 255, 255, 0, 0, 0, 0, 255, 0, 0, 0};
+  if (memcmp(encoded, ppm, 12) != 0) {
+    printf("dump    : PPM bytes differ\n");
+    failures++;
+  }
+
+  enum { WIDTH = 7, HEIGHT = 5, PITCH = 9, FRAMES = 40 };
+  static uint32_t frame[HEIGHT * PITCH];
+  for (int i = 0; i < HEIGHT * PITCH; i++) {
+    frame[i] = (uint32_t)i * 0x010203u;
+  }
+  const char *paths[2] = {"/tmp/bouncing_ball-check.y4m",
+                          "/tmp/bouncing_ball-check.ppm"};
+  for (int p = 0; p < 2; p++) {
+    for (int wait = 1; wait >= 0; wait--) {
+      struct FrameDump dump;
+      if (frameDumpOpen(&dump, paths[p], WIDTH, HEIGHT, 60, 0xff0000,
+                        0xff00, 0xff) != 0) {
+        printf("dump    : failed to open %s\n", paths[p]);
+        return 1;
+      }
+      for (int i = 0; i < FRAMES; i++) {
+        frameDumpPush(&dump, frame, PITCH, wait);
+      }
+      int format = dump.format;
+      long long dropped = dump.dropped;
+      int closed = frameDumpClose(&dump);
+
+      char header[64];
+      long headerSize =
+          format == DUMP_PPM
+              ? snprintf(header, sizeof(header), "P6\n%d %d\n255\n", WIDTH,
+                         HEIGHT)
+              : snprintf(header, sizeof(header), "FRAME\n");
+      long streamHeader =
+          format == DUMP_PPM
+              ? 0
+              : snprintf(header, sizeof(header),
+                         "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 C420jpeg "
+                         "XCOLORRANGE=FULL\n",
+                         WIDTH, HEIGHT);
+      long frameSize = headerSize + (long)frameDumpSize(format, WIDTH, HEIGHT);
+      long expected = streamHeader + dump.written * frameSize;
+      long size = fileSize(paths[p]);
+      if (closed != 0 || size != expected ||
+          dump.written + dropped != FRAMES || (wait && dropped > 0)) {
+        printf("dump    : %s%s is %ld bytes, expected %ld, %lld written "
+               "and %lld dropped\n",
+               paths[p], wait ? "" : " without waiting", size, expected,
+               dump.written, dropped);
+        failures++;
+      }
+      remove(paths[p]);
+    }
+  }
+
+  if (failures == 0)
+    printf("dump    : ok (colours convert, streams complete)\n");
+  return failures != 0;
+}
+
+static int compareDoubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+// Jittery frames run as many fixed steps as fit in their total time, a
+// stalled frame runs no more than its cap, and the histogram's percentiles
+// are within a bin of the sorted frame times
+int pacingCheck(void) {
+  enum { FRAMES = 5000 };
+  static double frames[FRAMES];
+  struct FixedStep fs;
+  fixedStepInit(&fs, 1.0 / 120, 1000);
+  struct FrameStats stats;
+  frameStatsInit(&stats, 0.025);
+
+  uint64_t state = 3;
+  double total = 0;
+  long steps = 0;
+  int failures = 0, late = 0, badAlpha = 0;
+  for (int i = 0; i < FRAMES; i++) {
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    // 0 to 33 ms, with one frame in 64 stalling for up to 0.1 s
+    double elapsed = (state >> 40) / 16777216.0 * 0.033;
+    if ((state >> 20) % 64 == 0)
+      elapsed *= 3;
+    frames[i] = elapsed;
+    total += elapsed;
+    late += elapsed > 0.025;
+    steps += fixedStepAdvance(&fs, elapsed);
+    frameStatsAdd(&stats, elapsed);
+    float alpha = fixedStepAlpha(&fs);
+    badAlpha += alpha < 0 || alpha >= 1;
+  }
+
+  long expected = (long)(total * 120);
+  if (labs(steps - expected) > 1 || badAlpha > 0) {
+    printf("steps   : %ld steps for %ld steps of time, %d bad alphas\n",
+           steps, expected, badAlpha);
+    failures++;
+  }
+
+  struct FixedStep capped;
+  fixedStepInit(&capped, 1.0 / 120, 4);
+  int stalled = fixedStepAdvance(&capped, 1.0);
+  if (stalled != 4 || capped.dropped != 116 ||
+      capped.accumulator >= capped.dt) {
+    printf("steps   : a stalled second ran %d steps, dropped %lld\n", stalled,
+           capped.dropped);
+    failures++;
+  }
+
+  qsort(frames, FRAMES, sizeof(double), compareDoubles);
+  const double percentiles[] = {0.01, 0.5, 0.9, 0.99, 1};
+  for (int i = 0; i < 5; i++) {
+    double exact = frames[(int)(percentiles[i] * FRAMES + 0.5) - 1];
+    double binned = frameStatsPercentile(&stats, percentiles[i]);
+    if (binned < exact || binned > exact + 1e-4 + 1e-12) {
+      printf("frames  : p%g is %.4f ms, sorted %.4f ms\n",
+             percentiles[i] * 100, binned * 1e3, exact * 1e3);
+      failures++;
+    }
+  }
+
+  if (stats.missed != late || stats.frames != FRAMES) {
+    printf("frames  : %d late of %d, expected %d of %d\n", stats.missed,
+           stats.frames, late, FRAMES);
+    failures++;
+  }
+
+  if (failures == 0)
+    printf("pacing  : ok (%ld fixed steps, p99 %.2f ms, %d late)\n", steps,
+           frameStatsPercentile(&stats, 0.99) * 1e3, late);
+  return failures != 0;
+}
+
+void usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [--count N] [--steps S] [--radius R] [--coverage F] "
+          "[--seed S]\n"
+          "       %s --check | --scaling [--radius R] [--coverage F]\n"
+          "       %s --raster-bench\n",
+          program, program, program);
+}
+
+int main(int argc, char **argv) {
+  int count = 100000;
+  int steps = 100;
+  float radius = 1;
+  float coverage = 0.1f;
+  uint64_t seed = 1;
+  int check = 0;
+  int scaling = 0;
+  int rasterBenchmark = 0;
+
+  for (int i = 1; i < argc; i++) {
+    int hasValue = i + 1 < argc;
+    if (strcmp(argv[i], "--check") == 0) {
+      check = 1;
+    } else if (strcmp(argv[i], "--scaling") == 0) {
+      scaling = 1;
+    } else if (strcmp(argv[i], "--raster-bench") == 0) {
+      rasterBenchmark = 1;
+    } else if (strcmp(argv[i], "--count") == 0 && hasValue) {
+      count = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--steps") == 0 && hasValue) {
+      steps = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--radius") == 0 && hasValue) {
+      radius = strtof(argv[++i], NULL);
+    } else if (strcmp(argv[i], "--coverage") == 0 && hasValue) {
+      coverage = strtof(argv[++i], NULL);
+    } else if (strcmp(argv[i], "--seed") == 0 && hasValue) {
+      seed = strtoull(argv[++i], NULL, 0);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (count < 1 || steps < 1 || radius <= 0 || coverage <= 0 ||
+      coverage > 0.9f) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  if (check)
+    return particlesCheck() | rasterCheck() | trailCheck() |
+           damageCheck() | pacingCheck() | dumpCheck();
+  if (rasterBenchmark)
+    return rasterBench();
+  if (scaling)
+    return scalingReport(radius, coverage);
+
+  struct ParticleSystem ps;
+  if (initPacked(&ps, count, radius, coverage, seed) != 0)
+    return 1;
+
+  uint64_t tested = 0, collisions = 0;
+  double start = nowSeconds();
+  for (int step = 0; step < steps; step++) {
+    collisions += particlesStep(&ps, 1);
+    tested += ps.tested;
+  }
+  double seconds = nowSeconds() - start;
+
+  printf("%d balls in a %.0fx%.0f box, %d steps in %.3f s\n", count,
+         ps.width, ps.height, steps, seconds);
+  printf("%.1f steps/sec, %.0f pairs tested and %.0f collisions per step\n",
+         steps / seconds, (double)tested / steps, (double)collisions / steps);
+  particlesFree(&ps);
+  return 0;
+}
@@ -0,0 +1,66 @@
+#include "pacing.h"
+
+#include <string.h>
+
+void fixedStepInit(struct FixedStep *fs, double dt, int maxSteps) {
+  fs->dt = dt;
+  fs->accumulator = 0;
+  fs->maxSteps = maxSteps;
+  fs->dropped = 0;
+}
+
+int fixedStepAdvance(struct FixedStep *fs, double elapsed) {
+  fs->accumulator += elapsed > 0 ? elapsed : 0;
+  int steps = (int)(fs->accumulator / fs->dt);
+  if (steps > fs->maxSteps) {
+    fs->dropped += steps - fs->maxSteps;
+    fs->accumulator -= (steps - fs->maxSteps) * fs->dt;
+    steps = fs->maxSteps;
+  }
+
+  fs->accumulator -= steps * fs->dt;
+  // Rounding can leave a hair under zero or a hair over one step
+  if (fs->accumulator < 0)
+    fs->accumulator = 0;
+  if (fs->accumulator >= fs->dt && steps < fs->maxSteps) {
+    fs->accumulator -= fs->dt;
+    steps++;
+  }
+  return steps;
+}
+
+float fixedStepAlpha(const struct FixedStep *fs) {
+  float alpha = (float)(fs->accumulator / fs->dt);
+  return alpha < 1 ? alpha : 0.999999f;
+}
+
+void frameStatsInit(struct FrameStats *stats, double budget) {
+  memset(stats, 0, sizeof(struct FrameStats));
+  stats->budget = budget;
+}
+
+void frameStatsAdd(struct FrameStats *stats, double seconds) {
+  int bin = (int)(seconds * 1e4);
+  bin = bin < 0 ? 0 : bin >= FRAME_BINS ? FRAME_BINS - 1 : bin;
+  stats->bins[bin]++;
+  stats->frames++;
+  stats->missed += seconds > stats->budget;
+  stats->total += seconds;
+  stats->worst = seconds > stats->worst ? seconds : stats->worst;
+}
+
+double frameStatsPercentile(const struct FrameStats *stats, double p) {
+  if (stats->frames == 0)
+    return 0;
+
+  // The rank of the frame wanted, counting from one
+  int rank = (int)(p * stats->frames + 0.999999);
+  rank = rank < 1 ? 1 : rank > stats->frames ? stats->frames : rank;
+  int seen = 0;
+  for (int bin = 0; bin < FRAME_BINS - 1; bin++) {
+    seen += stats->bins[bin];
+    if (seen >= rank)
+      return (bin + 1) * 1e-4;
+  }
+  return stats->worst;
+}
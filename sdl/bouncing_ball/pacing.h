@@ -0,0 +1,41 @@
+#ifndef PACING_H
+#define PACING_H
+
+// Fixed-timestep accumulator: real time goes in, whole simulation steps
+// come out, and what is left over says how far to interpolate between the
+// last two states
+struct FixedStep {
+  double dt;
+  double accumulator;
+  // Steps a single frame may run. A frame that is later than this drops the
+  // rest of its time, so a slow frame can't pile up ever more steps.
+  int maxSteps;
+  long long dropped;
+};
+
+void fixedStepInit(struct FixedStep *fs, double dt, int maxSteps);
+// Adds elapsed seconds and returns the steps to run now
+int fixedStepAdvance(struct FixedStep *fs, double elapsed);
+// Share of a step the accumulator holds, in [0, 1)
+float fixedStepAlpha(const struct FixedStep *fs);
+
+// Frame times in 0.1 ms bins up to FRAME_BINS / 10 ms, the rest in the last
+// bin. Frames longer than the budget count as missed deadlines.
+#define FRAME_BINS 1000
+
+struct FrameStats {
+  int bins[FRAME_BINS];
+  int frames;
+  int missed;
+  double budget;
+  double total;
+  double worst;
+};
+
+void frameStatsInit(struct FrameStats *stats, double budget);
+void frameStatsAdd(struct FrameStats *stats, double seconds);
+// The frame time p (0 to 1) of the frames are no longer than, to the upper
+// edge of its bin
+double frameStatsPercentile(const struct FrameStats *stats, double p);
+
+#endif
@@ -0,0 +1,264 @@
+#include "particles.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static const float PI = 3.14159265f;
+
+int particlesInit(struct ParticleSystem *ps, int count, float width,
+                  float height, float radius) {
+  memset(ps, 0, sizeof(struct ParticleSystem));
+  ps->count = count;
+  ps->radius = radius;
+  ps->width = width;
+  ps->height = height;
+  ps->cellSize = 2 * radius;
+  ps->gridCols = (int)ceilf(width / ps->cellSize);
+  ps->gridRows = (int)ceilf(height / ps->cellSize);
+  ps->gridCols = ps->gridCols < 1 ? 1 : ps->gridCols;
+  ps->gridRows = ps->gridRows < 1 ? 1 : ps->gridRows;
+
+  size_t floats = (size_t)count * sizeof(float);
+  float **arrays[8] = {&ps->x,       &ps->y,       &ps->vx,
+                       &ps->vy,      &ps->sortedX, &ps->sortedY,
+                       &ps->sortedVx, &ps->sortedVy};
+  int failed = 0;
+  for (int i = 0; i < 8; i++) {
+    *arrays[i] = malloc(floats);
+    failed |= *arrays[i] == NULL;
+  }
+
+  size_t cells = (size_t)ps->gridCols * ps->gridRows;
+  ps->cellStart = malloc((cells + 1) * sizeof(int));
+  ps->cellOf = malloc((size_t)count * sizeof(int));
+  if (failed || ps->cellStart == NULL || ps->cellOf == NULL) {
+    particlesFree(ps);
+    return -1;
+  }
+
+  return 0;
+}
+
+void particlesFree(struct ParticleSystem *ps) {
+  free(ps->x);
+  free(ps->y);
+  free(ps->vx);
+  free(ps->vy);
+  free(ps->sortedX);
+  free(ps->sortedY);
+  free(ps->sortedVx);
+  free(ps->sortedVy);
+  free(ps->cellStart);
+  free(ps->cellOf);
+  memset(ps, 0, sizeof(struct ParticleSystem));
+}
+
+static uint64_t splitMix64(uint64_t *state) {
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+// Uniform in [0, 1)
+static float randomUnit(uint64_t *state) {
+  return (splitMix64(state) >> 40) * (1.0f / 16777216.0f);
+}
+
+void particlesRandomize(struct ParticleSystem *ps, uint64_t seed,
+                        float maxSpeed) {
+  uint64_t state = seed;
+  float r = ps->radius;
+  for (int i = 0; i < ps->count; i++) {
+    ps->x[i] = r + randomUnit(&state) * (ps->width - 2 * r);
+    ps->y[i] = r + randomUnit(&state) * (ps->height - 2 * r);
+    float angle = randomUnit(&state) * 2 * PI;
+    float speed = randomUnit(&state) * maxSpeed;
+    ps->vx[i] = cosf(angle) * speed;
+    ps->vy[i] = sinf(angle) * speed;
+  }
+}
+
+// One coordinate of every ball: a ball past a wall is mirrored back inside
+// and heads away from it. The clamp keeps one faster than the box is wide
+// inside too.
+static void moveAxis(float *pos, float *vel, int count, float dt, float lo,
+                     float hi) {
+  int i = 0;
+#ifdef __SSE2__
+  const __m128 step = _mm_set1_ps(dt);
+  const __m128 low = _mm_set1_ps(lo);
+  const __m128 high = _mm_set1_ps(hi);
+  const __m128 twiceLow = _mm_set1_ps(2 * lo);
+  const __m128 twiceHigh = _mm_set1_ps(2 * hi);
+  const __m128 sign = _mm_set1_ps(-0.0f);
+  for (; i + 4 <= count; i += 4) {
+    __m128 v = _mm_loadu_ps(vel + i);
+    __m128 p = _mm_add_ps(_mm_loadu_ps(pos + i), _mm_mul_ps(v, step));
+    __m128 below = _mm_cmplt_ps(p, low);
+    __m128 above = _mm_cmpgt_ps(p, high);
+    __m128 speed = _mm_andnot_ps(sign, v);
+
+    p = _mm_or_ps(_mm_and_ps(below, _mm_sub_ps(twiceLow, p)),
+                  _mm_andnot_ps(below, p));
+    p = _mm_or_ps(_mm_and_ps(above, _mm_sub_ps(twiceHigh, p)),
+                  _mm_andnot_ps(above, p));
+    v = _mm_or_ps(_mm_and_ps(below, speed), _mm_andnot_ps(below, v));
+    v = _mm_or_ps(_mm_and_ps(above, _mm_or_ps(speed, sign)),
+                  _mm_andnot_ps(above, v));
+
+    _mm_storeu_ps(pos + i, _mm_min_ps(_mm_max_ps(p, low), high));
+    _mm_storeu_ps(vel + i, v);
+  }
+#endif
+
+  for (; i < count; i++) {
+    float p = pos[i] + vel[i] * dt;
+    if (p < lo) {
+      p = 2 * lo - p;
+      vel[i] = fabsf(vel[i]);
+    } else if (p > hi) {
+      p = 2 * hi - p;
+      vel[i] = -fabsf(vel[i]);
+    }
+    pos[i] = p < lo ? lo : p > hi ? hi : p;
+  }
+}
+
+void particlesMove(struct ParticleSystem *ps, float dt) {
+  float r = ps->radius;
+  moveAxis(ps->x, ps->vx, ps->count, dt, r, ps->width - r);
+  moveAxis(ps->y, ps->vy, ps->count, dt, r, ps->height - r);
+}
+
+static int cellIndex(struct ParticleSystem *ps, float x, float y) {
+  int cx = (int)(x / ps->cellSize);
+  int cy = (int)(y / ps->cellSize);
+  cx = cx < 0 ? 0 : cx >= ps->gridCols ? ps->gridCols - 1 : cx;
+  cy = cy < 0 ? 0 : cy >= ps->gridRows ? ps->gridRows - 1 : cy;
+  return cy * ps->gridCols + cx;
+}
+
+static void swapArrays(float **a, float **b) {
+  float *tmp = *a;
+  *a = *b;
+  *b = tmp;
+}
+
+// Counts the balls of every cell, turns the counts into where each cell
+// ends, then places the balls from the last one back, which leaves
+// cellStart at where each cell starts and keeps balls of a cell in order
+void particlesSort(struct ParticleSystem *ps) {
+  int cells = ps->gridCols * ps->gridRows;
+  memset(ps->cellStart, 0, (size_t)(cells + 1) * sizeof(int));
+  for (int i = 0; i < ps->count; i++) {
+    int cell = cellIndex(ps, ps->x[i], ps->y[i]);
+    ps->cellOf[i] = cell;
+    ps->cellStart[cell]++;
+  }
+
+  for (int cell = 1; cell <= cells; cell++) {
+    ps->cellStart[cell] += ps->cellStart[cell - 1];
+  }
+
+  for (int i = ps->count - 1; i >= 0; i--) {
+    int slot = --ps->cellStart[ps->cellOf[i]];
+    ps->sortedX[slot] = ps->x[i];
+    ps->sortedY[slot] = ps->y[i];
+    ps->sortedVx[slot] = ps->vx[i];
+    ps->sortedVy[slot] = ps->vy[i];
+  }
+  ps->cellStart[cells] = ps->count;
+
+  swapArrays(&ps->x, &ps->sortedX);
+  swapArrays(&ps->y, &ps->sortedY);
+  swapArrays(&ps->vx, &ps->sortedVx);
+  swapArrays(&ps->vy, &ps->sortedVy);
+}
+
+static int collidePair(struct ParticleSystem *ps, int i, int j, int resolve) {
+  float dx = ps->x[j] - ps->x[i];
+  float dy = ps->y[j] - ps->y[i];
+  float distSq = dx * dx + dy * dy;
+  float diameter = 2 * ps->radius;
+  ps->tested++;
+  if (distSq >= diameter * diameter)
+    return 0;
+  if (!resolve || distSq == 0)
+    return 1;
+
+  float dist = sqrtf(distSq);
+  float nx = dx / dist;
+  float ny = dy / dist;
+  float push = (diameter - dist) * 0.5f;
+  ps->x[i] -= nx * push;
+  ps->y[i] -= ny * push;
+  ps->x[j] += nx * push;
+  ps->y[j] += ny * push;
+
+  // Only when closing in, or balls still overlapping after the push would
+  // stick together
+  float closing = (ps->vx[j] - ps->vx[i]) * nx + (ps->vy[j] - ps->vy[i]) * ny;
+  if (closing < 0) {
+    ps->vx[i] += closing * nx;
+    ps->vy[i] += closing * ny;
+    ps->vx[j] -= closing * nx;
+    ps->vy[j] -= closing * ny;
+  }
+  return 1;
+}
+
+// Each ball against the later balls of its cell and every ball of the
+// cells to the right and below, so each pair comes up once
+static int findContacts(struct ParticleSystem *ps, int resolve) {
+  static const int neighbours[4][2] = {{1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+  int contacts = 0;
+  ps->tested = 0;
+
+  for (int cy = 0; cy < ps->gridRows; cy++) {
+    for (int cx = 0; cx < ps->gridCols; cx++) {
+      int cell = cy * ps->gridCols + cx;
+      int end = ps->cellStart[cell + 1];
+      for (int i = ps->cellStart[cell]; i < end; i++) {
+        for (int j = i + 1; j < end; j++) {
+          contacts += collidePair(ps, i, j, resolve);
+        }
+
+        for (int k = 0; k < 4; k++) {
+          int nx = cx + neighbours[k][0];
+          int ny = cy + neighbours[k][1];
+          if (nx < 0 || nx >= ps->gridCols || ny >= ps->gridRows)
+            continue;
+
+          int other = ny * ps->gridCols + nx;
+          for (int j = ps->cellStart[other]; j < ps->cellStart[other + 1];
+               j++) {
+            contacts += collidePair(ps, i, j, resolve);
+          }
+        }
+      }
+    }
+  }
+
+  return contacts;
+}
+
+int particlesCollide(struct ParticleSystem *ps) {
+  ps->collisions = findContacts(ps, 1);
+  return ps->collisions;
+}
+
+int particlesCountContacts(struct ParticleSystem *ps) {
+  return findContacts(ps, 0);
+}
+
+int particlesStep(struct ParticleSystem *ps, float dt) {
+  particlesMove(ps, dt);
+  particlesSort(ps);
+  return particlesCollide(ps);
+}
@@ -0,0 +1,55 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <stdint.h>
+
+// Balls of one radius bouncing off the walls of a box and off each other.
+// Positions and velocities are kept as structure of arrays, so moving the
+// balls runs over four floats at a time.
+struct ParticleSystem {
+  int count;
+  float *x, *y, *vx, *vy;
+  float radius;
+  float width, height;
+
+  // Uniform grid of cells one ball across, so touching balls are always in
+  // the same or neighbouring cells. Rebuilt every step with a counting sort
+  // that also moves the balls into cell order: cell c holds balls
+  // cellStart[c] to cellStart[c + 1] - 1.
+  float cellSize;
+  int gridCols, gridRows;
+  int *cellStart;
+  int *cellOf;
+  // The sort writes into these, then swaps them with the arrays above
+  float *sortedX, *sortedY, *sortedVx, *sortedVy;
+
+  // Pairs of the last step that were close enough to check, and those that
+  // touched
+  uint64_t tested;
+  int collisions;
+};
+
+int particlesInit(struct ParticleSystem *ps, int count, float width,
+                  float height, float radius);
+void particlesFree(struct ParticleSystem *ps);
+// Spreads the balls over the box with random directions and speeds up to
+// maxSpeed. Uses its own generator, so a seed gives the same balls
+// everywhere.
+void particlesRandomize(struct ParticleSystem *ps, uint64_t seed,
+                        float maxSpeed);
+
+// The phases of particlesStep. Balls only keep their index until the next
+// sort.
+void particlesMove(struct ParticleSystem *ps, float dt);
+void particlesSort(struct ParticleSystem *ps);
+// Pushes touching balls apart and swaps their velocities along the line
+// between them, an elastic collision of equal masses. Returns the number of
+// touching pairs.
+int particlesCollide(struct ParticleSystem *ps);
+// Same search, but only counts, for checking the grid against all pairs
+int particlesCountContacts(struct ParticleSystem *ps);
+
+// Moves, sorts and collides, and returns the collisions
+int particlesStep(struct ParticleSystem *ps, float dt);
+
+#endif
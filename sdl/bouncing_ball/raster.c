@@ -0,0 +1,109 @@
+#include "raster.h"
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Four pixels per store, then whatever is left one at a time
+void rasterSpan(uint32_t *row, int x0, int x1, uint32_t color) {
+  int x = x0;
+#ifdef __SSE2__
+  const __m128i wide = _mm_set1_epi32((int)color);
+  for (; x + 8 <= x1; x += 8) {
+    _mm_storeu_si128((__m128i *)(row + x), wide);
+    _mm_storeu_si128((__m128i *)(row + x + 4), wide);
+  }
+  for (; x + 4 <= x1; x += 4) {
+    _mm_storeu_si128((__m128i *)(row + x), wide);
+  }
+#endif
+  for (; x < x1; x++) {
+    row[x] = color;
+  }
+}
+
+static long fillRow(struct PixelBuffer *buffer, int y, int x0, int x1,
+                    uint32_t color) {
+  if (y < 0 || y >= buffer->height)
+    return 0;
+
+  x0 = x0 < 0 ? 0 : x0;
+  x1 = x1 > buffer->width ? buffer->width : x1;
+  if (x0 >= x1)
+    return 0;
+
+  rasterSpan(buffer->pixels + (long)y * buffer->pitch, x0, x1, color);
+  return x1 - x0;
+}
+
+long rasterCircle(struct PixelBuffer *buffer, int cx, int cy, int r,
+                  uint32_t color) {
+  if (r <= 0 || cx + r < 0 || cx - r >= buffer->width || cy + r < 0 ||
+      cy - r >= buffer->height)
+    return 0;
+
+  // Half width w of the row dy from the centre is the largest with
+  // w * w + dy * dy <= r * r. error is r * r - w * w - dy * dy, which a
+  // step down takes 2 * dy - 1 from and a narrower span gives 2 * w - 1
+  // back to; w only ever shrinks, r steps in all.
+  int w = r;
+  int64_t error = 0;
+  long filled = 0;
+  for (int dy = 0; dy <= r; dy++) {
+    if (dy > 0) {
+      error -= 2 * dy - 1;
+      while (error < 0) {
+        error += 2 * w - 1;
+        w--;
+      }
+    }
+
+    filled += fillRow(buffer, cy - dy, cx - w, cx + w + 1, color);
+    if (dy > 0)
+      filled += fillRow(buffer, cy + dy, cx - w, cx + w + 1, color);
+  }
+
+  return filled;
+}
+
+// Four pixels at a time: the bytes are widened to 16 bits, multiplied and
+// narrowed again, which keeps 255 * 256 in range
+static void fadeRow(uint32_t *row, int width, int factor) {
+  int x = 0;
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i scale = _mm_set1_epi16((short)factor);
+  for (; x + 4 <= width; x += 4) {
+    __m128i pixels = _mm_loadu_si128((__m128i *)(row + x));
+    __m128i low = _mm_unpacklo_epi8(pixels, zero);
+    __m128i high = _mm_unpackhi_epi8(pixels, zero);
+    low = _mm_srli_epi16(_mm_mullo_epi16(low, scale), 8);
+    high = _mm_srli_epi16(_mm_mullo_epi16(high, scale), 8);
+    _mm_storeu_si128((__m128i *)(row + x), _mm_packus_epi16(low, high));
+  }
+#endif
+  for (; x < width; x++) {
+    uint32_t p = row[x];
+    row[x] = (((p & 0xff) * factor) >> 8) |
+             ((((p >> 8) & 0xff) * factor) >> 8) << 8 |
+             ((((p >> 16) & 0xff) * factor) >> 8) << 16 |
+             (((p >> 24) * factor) >> 8) << 24;
+  }
+}
+
+void rasterFade(struct PixelBuffer *buffer, int factor) {
+  factor = factor < 0 ? 0 : factor > 256 ? 256 : factor;
+  for (int y = 0; y < buffer->height; y++) {
+    fadeRow(buffer->pixels + (long)y * buffer->pitch, buffer->width, factor);
+  }
+}
+
+void rasterCopy(struct PixelBuffer *dst, const struct PixelBuffer *src) {
+  for (int y = 0; y < dst->height; y++) {
+    memcpy(dst->pixels + (long)y * dst->pitch,
+           src->pixels + (long)y * src->pitch,
+           (size_t)dst->width * sizeof(uint32_t));
+  }
+}
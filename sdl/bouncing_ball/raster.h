@@ -0,0 +1,31 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <stdint.h>
+
+// 32-bit pixels, row after row, pitch pixels apart
+struct PixelBuffer {
+  uint32_t *pixels;
+  int width, height;
+  int pitch;
+};
+
+// Fills pixels [x0, x1) of a row
+void rasterSpan(uint32_t *row, int x0, int x1, uint32_t color);
+
+// Fills every pixel within r of (cx, cy), clipped to the buffer, as one
+// span per row. The spans' half widths come from an integer error term
+// updated from row to row, so there is no per-pixel test and no square
+// root. Nothing is drawn for r <= 0. Returns the pixels filled.
+long rasterCircle(struct PixelBuffer *buffer, int cx, int cy, int r,
+                  uint32_t color);
+
+// Scales every channel of every pixel by factor / 256, factor 0 to 256, so
+// what was drawn before fades a little each call. Channels round down, so
+// anything faded often enough ends at black.
+void rasterFade(struct PixelBuffer *buffer, int factor);
+
+// Copies src into dst, both the same size
+void rasterCopy(struct PixelBuffer *dst, const struct PixelBuffer *src);
+
+#endif
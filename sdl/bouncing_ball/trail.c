@@ -0,0 +1,39 @@
+#include "trail.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int trailInit(struct TrailRing *ring, int capacity) {
+  memset(ring, 0, sizeof(struct TrailRing));
+  ring->x = malloc((size_t)capacity * sizeof(float));
+  ring->y = malloc((size_t)capacity * sizeof(float));
+  if (ring->x == NULL || ring->y == NULL) {
+    trailFree(ring);
+    return -1;
+  }
+
+  ring->capacity = capacity;
+  ring->head = capacity - 1;
+  return 0;
+}
+
+void trailFree(struct TrailRing *ring) {
+  free(ring->x);
+  free(ring->y);
+  memset(ring, 0, sizeof(struct TrailRing));
+}
+
+void trailPush(struct TrailRing *ring, float x, float y) {
+  ring->head = ring->head + 1 == ring->capacity ? 0 : ring->head + 1;
+  ring->x[ring->head] = x;
+  ring->y[ring->head] = y;
+  if (ring->count < ring->capacity)
+    ring->count++;
+}
+
+void trailGet(const struct TrailRing *ring, int age, float *x, float *y) {
+  int slot = ring->head - age;
+  slot += slot < 0 ? ring->capacity : 0;
+  *x = ring->x[slot];
+  *y = ring->y[slot];
+}
@@ -0,0 +1,20 @@
+#ifndef TRAIL_H
+#define TRAIL_H
+
+// The last capacity places a ball left its trail at, newest first. Adding
+// one overwrites the oldest in place, so nothing is shifted along.
+struct TrailRing {
+  float *x, *y;
+  int capacity;
+  int count;
+  // Where the newest is
+  int head;
+};
+
+int trailInit(struct TrailRing *ring, int capacity);
+void trailFree(struct TrailRing *ring);
+void trailPush(struct TrailRing *ring, float x, float y);
+// The place age entries back, 0 being the newest; age below count
+void trailGet(const struct TrailRing *ring, int age, float *x, float *y);
+
+#endif
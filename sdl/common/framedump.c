@@ -0,0 +1,227 @@
+#include "framedump.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static int maskShift(uint32_t mask) {
+  int shift = 0;
+  while (mask != 0 && (mask & 1) == 0) {
+    mask >>= 1;
+    shift++;
+  }
+  return shift;
+}
+
+size_t frameDumpSize(int format, int width, int height) {
+  if (format == DUMP_PPM)
+    return (size_t)width * height * 3;
+
+  size_t chroma = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+  return (size_t)width * height + 2 * chroma;
+}
+
+// Full-range BT.601 in 8-bit fixed point
+static void toLuma(const uint32_t *row, int width, const int shifts[3],
+                   uint8_t *out) {
+  for (int x = 0; x < width; x++) {
+    int r = (row[x] >> shifts[0]) & 0xff;
+    int g = (row[x] >> shifts[1]) & 0xff;
+    int b = (row[x] >> shifts[2]) & 0xff;
+    out[x] = (uint8_t)((77 * r + 150 * g + 29 * b + 128) >> 8);
+  }
+}
+
+// Chroma of each 2x2 block from its average colour. The last column or row
+// of an odd-sized frame stands in for the one missing, which averages what
+// there is.
+static void toChroma(const uint32_t *pixels, int width, int height,
+                     const int shifts[3], uint8_t *u, uint8_t *v) {
+  int chromaWidth = (width + 1) / 2;
+  for (int y = 0; y < height; y += 2) {
+    const uint32_t *top = pixels + (size_t)y * width;
+    const uint32_t *bottom = y + 1 < height ? top + width : top;
+    uint8_t *uRow = u + (size_t)(y / 2) * chromaWidth;
+    uint8_t *vRow = v + (size_t)(y / 2) * chromaWidth;
+    for (int x = 0; x < width; x += 2) {
+      int right = x + 1 < width ? x + 1 : x;
+      uint32_t block[4] = {top[x], top[right], bottom[x], bottom[right]};
+      int rgb[3];
+      for (int c = 0; c < 3; c++) {
+        int sum = 0;
+        for (int i = 0; i < 4; i++) {
+          sum += (block[i] >> shifts[c]) & 0xff;
+        }
+        rgb[c] = sum >> 2;
+      }
+
+      // The 128 offset goes in before the shift, which keeps it positive;
+      // pure blue or red come out a rounding over 255
+      int r = rgb[0], g = rgb[1], b = rgb[2];
+      int cb = (-43 * r - 85 * g + 128 * b + 32896) >> 8;
+      int cr = (128 * r - 107 * g - 21 * b + 32896) >> 8;
+      uRow[x / 2] = (uint8_t)(cb > 255 ? 255 : cb);
+      vRow[x / 2] = (uint8_t)(cr > 255 ? 255 : cr);
+    }
+  }
+}
+
+void frameDumpEncode(int format, const uint32_t *pixels, int width,
+                     int height, const int shifts[3], uint8_t *out) {
+  if (format == DUMP_PPM) {
+    for (size_t i = 0; i < (size_t)width * height; i++) {
+      *out++ = (pixels[i] >> shifts[0]) & 0xff;
+      *out++ = (pixels[i] >> shifts[1]) & 0xff;
+      *out++ = (pixels[i] >> shifts[2]) & 0xff;
+    }
+    return;
+  }
+
+  for (int y = 0; y < height; y++) {
+    toLuma(pixels + (size_t)y * width, width, shifts, out + (size_t)y * width);
+  }
+  size_t chroma = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+  uint8_t *u = out + (size_t)width * height;
+  toChroma(pixels, width, height, shifts, u, u + chroma);
+}
+
+static int writeFrame(struct FrameDump *dump, const uint32_t *pixels) {
+  frameDumpEncode(dump->format, pixels, dump->width, dump->height,
+                  dump->shifts, dump->encoded);
+  if (dump->format == DUMP_PPM)
+    fprintf(dump->out, "P6\n%d %d\n255\n", dump->width, dump->height);
+  else
+    fputs("FRAME\n", dump->out);
+  return fwrite(dump->encoded, 1, dump->encodedSize, dump->out) ==
+                 dump->encodedSize
+             ? 0
+             : -1;
+}
+
+// Takes the oldest frame, converts and writes it outside the lock, and
+// only then gives its slot back
+static void *writerMain(void *arg) {
+  struct FrameDump *dump = arg;
+  pthread_mutex_lock(&dump->lock);
+  for (;;) {
+    while (dump->count == 0 && !dump->closing) {
+      pthread_cond_wait(&dump->filled, &dump->lock);
+    }
+    if (dump->count == 0)
+      break;
+
+    uint32_t *frame = dump->slots[dump->head];
+    pthread_mutex_unlock(&dump->lock);
+
+    if (!dump->failed && writeFrame(dump, frame) != 0)
+      dump->failed = 1;
+
+    pthread_mutex_lock(&dump->lock);
+    dump->head = (dump->head + 1) % DUMP_QUEUE;
+    dump->count--;
+    dump->written += !dump->failed;
+    pthread_cond_signal(&dump->emptied);
+  }
+  pthread_mutex_unlock(&dump->lock);
+  return NULL;
+}
+
+static void freeSlots(struct FrameDump *dump) {
+  for (int i = 0; i < DUMP_QUEUE; i++) {
+    free(dump->slots[i]);
+  }
+  free(dump->encoded);
+}
+
+int frameDumpOpen(struct FrameDump *dump, const char *path, int width,
+                  int height, int fps, uint32_t rMask, uint32_t gMask,
+                  uint32_t bMask) {
+  memset(dump, 0, sizeof(struct FrameDump));
+  size_t length = strlen(path);
+  dump->format = length >= 4 && strcmp(path + length - 4, ".ppm") == 0
+                     ? DUMP_PPM
+                     : DUMP_Y4M;
+  dump->width = width;
+  dump->height = height;
+  dump->fps = fps;
+  dump->shifts[0] = maskShift(rMask);
+  dump->shifts[1] = maskShift(gMask);
+  dump->shifts[2] = maskShift(bMask);
+
+  int failed = 0;
+  for (int i = 0; i < DUMP_QUEUE; i++) {
+    dump->slots[i] = malloc((size_t)width * height * sizeof(uint32_t));
+    failed |= dump->slots[i] == NULL;
+  }
+  dump->encodedSize = frameDumpSize(dump->format, width, height);
+  dump->encoded = malloc(dump->encodedSize);
+  if (failed || dump->encoded == NULL) {
+    freeSlots(dump);
+    return -1;
+  }
+
+  dump->out = fopen(path, "wb");
+  if (dump->out == NULL) {
+    freeSlots(dump);
+    return -1;
+  }
+
+  if (dump->format == DUMP_Y4M)
+    fprintf(dump->out, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg "
+                       "XCOLORRANGE=FULL\n",
+            width, height, fps);
+
+  pthread_mutex_init(&dump->lock, NULL);
+  pthread_cond_init(&dump->filled, NULL);
+  pthread_cond_init(&dump->emptied, NULL);
+  if (pthread_create(&dump->thread, NULL, writerMain, dump) != 0) {
+    fclose(dump->out);
+    freeSlots(dump);
+    return -1;
+  }
+
+  return 0;
+}
+
+// Only the one pushing thread adds frames, so the free slot it copies into
+// can't change under it while the lock is let go
+int frameDumpPush(struct FrameDump *dump, const uint32_t *pixels, int pitch,
+                  int wait) {
+  pthread_mutex_lock(&dump->lock);
+  while (dump->count == DUMP_QUEUE && wait) {
+    pthread_cond_wait(&dump->emptied, &dump->lock);
+  }
+  if (dump->count == DUMP_QUEUE) {
+    dump->dropped++;
+    pthread_mutex_unlock(&dump->lock);
+    return 1;
+  }
+  uint32_t *slot = dump->slots[(dump->head + dump->count) % DUMP_QUEUE];
+  pthread_mutex_unlock(&dump->lock);
+
+  for (int y = 0; y < dump->height; y++) {
+    memcpy(slot + (size_t)y * dump->width, pixels + (size_t)y * pitch,
+           (size_t)dump->width * sizeof(uint32_t));
+  }
+
+  pthread_mutex_lock(&dump->lock);
+  dump->count++;
+  pthread_cond_signal(&dump->filled);
+  pthread_mutex_unlock(&dump->lock);
+  return 0;
+}
+
+int frameDumpClose(struct FrameDump *dump) {
+  pthread_mutex_lock(&dump->lock);
+  dump->closing = 1;
+  pthread_cond_signal(&dump->filled);
+  pthread_mutex_unlock(&dump->lock);
+  pthread_join(dump->thread, NULL);
+
+  int failed = dump->failed;
+  failed |= fclose(dump->out) != 0;
+  pthread_cond_destroy(&dump->filled);
+  pthread_cond_destroy(&dump->emptied);
+  pthread_mutex_destroy(&dump->lock);
+  freeSlots(dump);
+  return failed ? -1 : 0;
+}
@@ -0,0 +1,65 @@
+#ifndef FRAMEDUMP_H
+#define FRAMEDUMP_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Frames waiting for the writer at most
+#define DUMP_QUEUE 8
+
+enum { DUMP_Y4M, DUMP_PPM };
+
+// Streams frames of 32-bit pixels to a file or named pipe from a writer
+// thread, so converting and writing them never holds up the program
+// drawing them. Frames go through a bounded queue of copies: one thread
+// pushes, the writer takes them in order.
+//
+// A path ending in .ppm gets one binary PPM after another, anything else
+// a Y4M video in 4:2:0 with full-range BT.601 colours.
+struct FrameDump {
+  FILE *out;
+  int format;
+  int width, height;
+  int fps;
+  // Bit offsets of red, green and blue in a pixel
+  int shifts[3];
+
+  uint32_t *slots[DUMP_QUEUE];
+  int head;
+  int count;
+  int closing;
+  pthread_mutex_t lock;
+  pthread_cond_t filled;
+  pthread_cond_t emptied;
+  pthread_t thread;
+
+  // Only the writer touches these
+  uint8_t *encoded;
+  size_t encodedSize;
+  int failed;
+
+  long long written;
+  long long dropped;
+};
+
+// The masks say where red, green and blue are in a pixel
+int frameDumpOpen(struct FrameDump *dump, const char *path, int width,
+                  int height, int fps, uint32_t rMask, uint32_t gMask,
+                  uint32_t bMask);
+// Queues a copy of a frame, pitch pixels from row to row. When the queue
+// is full the frame is dropped, or with wait set, waited for room for.
+// Returns 0 when queued and 1 when dropped.
+int frameDumpPush(struct FrameDump *dump, const uint32_t *pixels, int pitch,
+                  int wait);
+// Writes out every queued frame and closes the file. Returns -1 if any
+// write failed.
+int frameDumpClose(struct FrameDump *dump);
+
+// Converts one frame as the writer does, into the frame's bytes after the
+// FRAME line of Y4M or the header of PPM, which take out bytes
+size_t frameDumpSize(int format, int width, int height);
+void frameDumpEncode(int format, const uint32_t *pixels, int width,
+                     int height, const int shifts[3], uint8_t *out);
+
+#endif
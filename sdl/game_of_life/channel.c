@@ -0,0 +1,82 @@
+#include "channel.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define TRIPLE_FRESH 4
+
+int tripleInit(struct TripleBuffer *buffer, int rows, int cols) {
+  memset(buffer, 0, sizeof(struct TripleBuffer));
+  for (int i = 0; i < 3; i++) {
+    buffer->frames[i].looks = malloc((size_t)rows * cols);
+    if (buffer->frames[i].looks == NULL) {
+      tripleFree(buffer);
+      return -1;
+    }
+  }
+
+  buffer->back = 0;
+  atomic_init(&buffer->middle, 1);
+  buffer->front = 2;
+  return 0;
+}
+
+void tripleFree(struct TripleBuffer *buffer) {
+  for (int i = 0; i < 3; i++) {
+    free(buffer->frames[i].looks);
+    buffer->frames[i].looks = NULL;
+  }
+}
+
+struct LifeFrame *tripleBack(struct TripleBuffer *buffer) {
+  return &buffer->frames[buffer->back];
+}
+
+// Release, so the reader sees the frame contents along with the index
+void triplePublish(struct TripleBuffer *buffer) {
+  int old = atomic_exchange_explicit(
+      &buffer->middle, buffer->back | TRIPLE_FRESH, memory_order_acq_rel);
+  buffer->back = old & ~TRIPLE_FRESH;
+}
+
+int tripleUnread(struct TripleBuffer *buffer) {
+  return (atomic_load_explicit(&buffer->middle, memory_order_relaxed) &
+          TRIPLE_FRESH) != 0;
+}
+
+struct LifeFrame *tripleAcquire(struct TripleBuffer *buffer) {
+  if (tripleUnread(buffer)) {
+    int old = atomic_exchange_explicit(&buffer->middle, buffer->front,
+                                       memory_order_acq_rel);
+    buffer->front = old & ~TRIPLE_FRESH;
+  }
+
+  return &buffer->frames[buffer->front];
+}
+
+void commandQueueInit(struct CommandQueue *queue) {
+  atomic_init(&queue->head, 0);
+  atomic_init(&queue->tail, 0);
+}
+
+int commandPush(struct CommandQueue *queue, struct Command command) {
+  unsigned tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+  unsigned head = atomic_load_explicit(&queue->head, memory_order_acquire);
+  if (tail - head == COMMAND_QUEUE_SIZE)
+    return -1;
+
+  queue->commands[tail % COMMAND_QUEUE_SIZE] = command;
+  atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+  return 0;
+}
+
+int commandPop(struct CommandQueue *queue, struct Command *command) {
+  unsigned head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+  unsigned tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+  if (head == tail)
+    return 0;
+
+  *command = queue->commands[head % COMMAND_QUEUE_SIZE];
+  atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+  return 1;
+}
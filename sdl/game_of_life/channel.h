@@ -0,0 +1,74 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "view.h"
+
+// A finished generation, as published by the simulation thread
+struct LifeFrame {
+  // The part of the world the frame shows, and how it looks: one byte per
+  // cell or pixel as viewFill makes them
+  struct Viewport view;
+  uint8_t *looks;
+  uint64_t generation;
+  // Total time spent stepping up to this generation
+  double stepSeconds;
+  int activeTiles;
+  int chunkCount;
+  // Period being replayed instead of stepped, 0 while still stepping
+  int period;
+};
+
+// Lock-free triple buffer between one writer and one reader. The writer
+// fills the back frame and swaps it with the middle one, the reader swaps
+// the middle one with its front frame when a newer one is there. Neither
+// side ever waits, and the reader always gets the newest finished frame.
+struct TripleBuffer {
+  struct LifeFrame frames[3];
+  // Index of the middle frame, with TRIPLE_FRESH set until it is read
+  atomic_int middle;
+  int back;
+  int front;
+};
+
+// Frames hold up to rows by cols looks
+int tripleInit(struct TripleBuffer *buffer, int rows, int cols);
+void tripleFree(struct TripleBuffer *buffer);
+
+// Writer side
+struct LifeFrame *tripleBack(struct TripleBuffer *buffer);
+void triplePublish(struct TripleBuffer *buffer);
+// Whether the last published frame hasn't been picked up yet
+int tripleUnread(struct TripleBuffer *buffer);
+
+// Reader side: the newest published frame, which stays valid until the
+// next call
+struct LifeFrame *tripleAcquire(struct TripleBuffer *buffer);
+
+#define COMMAND_QUEUE_SIZE 256
+
+struct Command {
+  int type;
+  int x, y;
+  // Only used by viewport changes
+  int zoom;
+};
+
+// Lock-free ring of commands from one producer to one consumer. The two
+// indices sit on their own cache lines so the threads don't share one.
+struct CommandQueue {
+  struct Command commands[COMMAND_QUEUE_SIZE];
+  alignas(64) atomic_uint head;
+  alignas(64) atomic_uint tail;
+};
+
+void commandQueueInit(struct CommandQueue *queue);
+// Returns -1 when the queue is full
+int commandPush(struct CommandQueue *queue, struct Command command);
+// Returns 0 when the queue is empty
+int commandPop(struct CommandQueue *queue, struct Command *command);
+
+#endif
@@ -0,0 +1,245 @@
+#include "cycle.h"
+#include "tiles.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static uint64_t rotate(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+// splitmix64's finalizer
+static uint64_t mix(uint64_t value) {
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+  return value ^ (value >> 31);
+}
+
+static void tileBounds(struct CycleDetector *cycles, int tile, int *y0,
+                       int *y1, int *x0, int *x1) {
+  *y0 = (tile / cycles->tileCols) * TILE_SIZE;
+  *x0 = (tile % cycles->tileCols) * TILE_SIZE;
+  *y1 = *y0 + TILE_SIZE < cycles->rows ? *y0 + TILE_SIZE : cycles->rows;
+  *x1 = *x0 + TILE_SIZE < cycles->cols ? *x0 + TILE_SIZE : cycles->cols;
+}
+
+// Four independent multiply chains over the tile's words, so they overlap
+// in the pipeline. The tile index goes in last: the same cells elsewhere
+// hash differently, and the XOR of all tiles doesn't cancel them out.
+static uint64_t hashTile(struct CycleDetector *cycles, struct LifeGrid *grid,
+                         int tile) {
+  int y0, y1, x0, x1;
+  tileBounds(cycles, tile, &y0, &y1, &x0, &x1);
+  const uint64_t prime = 0x9e3779b97f4a7c15ull;
+  uint64_t lanes[4] = {1, 2, 3, 4};
+
+  for (int y = y0; y < y1; y++) {
+    const uint8_t *row = lifeCell(grid, y, x0);
+    int width = x1 - x0;
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+      for (int k = 0; k < 4; k++) {
+        uint64_t word;
+        memcpy(&word, row + x + 8 * k, 8);
+        lanes[k] = rotate((lanes[k] ^ word) * prime, 29);
+      }
+    }
+    for (; x < width; x += 8) {
+      uint64_t word = 0;
+      memcpy(&word, row + x, width - x < 8 ? width - x : 8);
+      lanes[0] = rotate((lanes[0] ^ word) * prime, 29);
+    }
+  }
+
+  uint64_t hash = lanes[0] ^ rotate(lanes[1], 16) ^ rotate(lanes[2], 32) ^
+                  rotate(lanes[3], 48);
+  return mix(hash + (uint64_t)tile * prime);
+}
+
+static void hashTiles(struct CycleDetector *cycles, struct LifeGrid *grid,
+                      const uint8_t *changedTiles) {
+  int count = cycles->tileRows * cycles->tileCols;
+  for (int tile = 0; tile < count; tile++) {
+    if (changedTiles != NULL && !changedTiles[tile])
+      continue;
+
+    uint64_t hash = hashTile(cycles, grid, tile);
+    cycles->hash ^= cycles->tileHashes[tile] ^ hash;
+    cycles->tileHashes[tile] = hash;
+  }
+}
+
+static uint8_t *frameAt(struct CycleDetector *cycles, int phase) {
+  return cycles->frames + (size_t)phase * cycles->rows * cycles->cols;
+}
+
+static void saveFrame(struct CycleDetector *cycles, struct LifeGrid *grid,
+                      int phase) {
+  uint8_t *frame = frameAt(cycles, phase);
+  for (int y = 0; y < cycles->rows; y++) {
+    memcpy(frame + (size_t)y * cycles->cols, lifeCell(grid, y, 0),
+           cycles->cols);
+  }
+}
+
+static void dropFrames(struct CycleDetector *cycles) {
+  free(cycles->frames);
+  free(cycles->diffRows);
+  cycles->frames = NULL;
+  cycles->diffRows = NULL;
+  cycles->period = 0;
+  cycles->state = CYCLE_SEARCHING;
+}
+
+int cycleInit(struct CycleDetector *cycles, struct LifeGrid *grid) {
+  memset(cycles, 0, sizeof(struct CycleDetector));
+  cycles->rows = grid->rows;
+  cycles->cols = grid->cols;
+  cycles->tileRows = (grid->rows + TILE_SIZE - 1) / TILE_SIZE;
+  cycles->tileCols = (grid->cols + TILE_SIZE - 1) / TILE_SIZE;
+  cycles->tileHashes =
+      calloc(cycles->tileRows * cycles->tileCols, sizeof(uint64_t));
+  if (cycles->tileHashes == NULL)
+    return -1;
+
+  cycleReset(cycles, grid);
+  return 0;
+}
+
+void cycleFree(struct CycleDetector *cycles) {
+  dropFrames(cycles);
+  free(cycles->tileHashes);
+  cycles->tileHashes = NULL;
+}
+
+// Generations count from 1, so an empty slot never matches
+static void remember(struct CycleDetector *cycles) {
+  struct CycleSlot *slot =
+      &cycles->table[cycles->hash & (CYCLE_TABLE_SIZE - 1)];
+  slot->hash = cycles->hash;
+  slot->generation = cycles->generation;
+}
+
+void cycleReset(struct CycleDetector *cycles, struct LifeGrid *grid) {
+  dropFrames(cycles);
+  memset(cycles->table, 0, sizeof(cycles->table));
+  memset(cycles->tileHashes, 0,
+         cycles->tileRows * cycles->tileCols * sizeof(uint64_t));
+  cycles->hash = 0;
+  cycles->generation = 1;
+  hashTiles(cycles, grid, NULL);
+  remember(cycles);
+}
+
+// Replaying a phase only copies the rows of tiles that differ from the
+// phase before, so a settled soup of still lifes and blinkers costs a few
+// short copies per generation
+static int buildDiffs(struct CycleDetector *cycles) {
+  size_t rowCount = (size_t)cycles->rows * cycles->tileCols;
+  cycles->diffRows = malloc(cycles->period * rowCount * sizeof(int));
+  if (cycles->diffRows == NULL)
+    return -1;
+
+  int count = 0;
+  for (int phase = 0; phase < cycles->period; phase++) {
+    cycles->diffStart[phase] = count;
+    const uint8_t *from = frameAt(cycles, phase);
+    const uint8_t *to = frameAt(cycles, (phase + 1) % cycles->period);
+    for (int y = 0; y < cycles->rows; y++) {
+      for (int tx = 0; tx < cycles->tileCols; tx++) {
+        int x0 = tx * TILE_SIZE;
+        int width = x0 + TILE_SIZE < cycles->cols ? TILE_SIZE
+                                                  : cycles->cols - x0;
+        size_t offset = (size_t)y * cycles->cols + x0;
+        if (memcmp(from + offset, to + offset, width))
+          cycles->diffRows[count++] = y * cycles->tileCols + tx;
+      }
+    }
+  }
+  cycles->diffStart[cycles->period] = count;
+  return 0;
+}
+
+static int gridMatchesFrame(struct CycleDetector *cycles,
+                            struct LifeGrid *grid, int phase) {
+  const uint8_t *frame = frameAt(cycles, phase);
+  for (int y = 0; y < cycles->rows; y++) {
+    if (memcmp(frame + (size_t)y * cycles->cols, lifeCell(grid, y, 0),
+               cycles->cols))
+      return 0;
+  }
+  return 1;
+}
+
+// A repeated hash is only a candidate: the grids of one period are kept,
+// and the cycle holds if the grid after them matches the first in full
+static void confirm(struct CycleDetector *cycles, struct LifeGrid *grid) {
+  uint64_t phase = cycles->generation - cycles->start;
+  if (phase < (uint64_t)cycles->period) {
+    saveFrame(cycles, grid, phase);
+    return;
+  }
+
+  if (gridMatchesFrame(cycles, grid, 0) && buildDiffs(cycles) == 0) {
+    cycles->state = CYCLE_REPLAYING;
+    cycles->phase = 0;
+    return;
+  }
+
+  dropFrames(cycles);
+  remember(cycles);
+}
+
+void cycleObserve(struct CycleDetector *cycles, struct LifeGrid *grid,
+                  const uint8_t *changedTiles) {
+  cycles->generation++;
+  if (cycles->state == CYCLE_CONFIRMING) {
+    confirm(cycles, grid);
+    return;
+  }
+
+  // Tile hashes go stale between bursts, so a burst starts from scratch
+  uint64_t sample = cycles->generation % CYCLE_SAMPLE_INTERVAL;
+  if (sample > CYCLE_MAX_PERIOD)
+    return;
+  hashTiles(cycles, grid, sample == 0 ? NULL : changedTiles);
+
+  struct CycleSlot *slot =
+      &cycles->table[cycles->hash & (CYCLE_TABLE_SIZE - 1)];
+  uint64_t period = cycles->generation - slot->generation;
+  if (slot->hash == cycles->hash && slot->generation != 0 &&
+      period <= CYCLE_MAX_PERIOD) {
+    cycles->frames = malloc(period * cycles->rows * cycles->cols);
+    if (cycles->frames != NULL) {
+      cycles->state = CYCLE_CONFIRMING;
+      cycles->period = period;
+      cycles->start = cycles->generation;
+      saveFrame(cycles, grid, 0);
+      return;
+    }
+  }
+
+  remember(cycles);
+}
+
+void cycleReplay(struct CycleDetector *cycles, struct LifeGrid *grid) {
+  int next = (cycles->phase + 1) % cycles->period;
+  const uint8_t *frame = frameAt(cycles, next);
+
+  for (int i = cycles->diffStart[cycles->phase];
+       i < cycles->diffStart[cycles->phase + 1]; i++) {
+    int y = cycles->diffRows[i] / cycles->tileCols;
+    int x0 = (cycles->diffRows[i] % cycles->tileCols) * TILE_SIZE;
+    int width =
+        x0 + TILE_SIZE < cycles->cols ? TILE_SIZE : cycles->cols - x0;
+    memcpy(lifeCell(grid, y, x0), frame + (size_t)y * cycles->cols + x0,
+           width);
+  }
+
+  cycles->phase = next;
+  cycles->generation++;
+}
+
+int cyclePeriod(struct CycleDetector *cycles) {
+  return cycles->state == CYCLE_REPLAYING ? cycles->period : 0;
+}
@@ -0,0 +1,76 @@
+#ifndef CYCLE_H
+#define CYCLE_H
+
+#include <stdint.h>
+
+#include "life.h"
+
+// Longest period looked for. Replaying keeps one grid per phase.
+#define CYCLE_MAX_PERIOD 32
+// Hashing costs about as much as a step, so it is done in bursts of
+// CYCLE_MAX_PERIOD + 1 generations, which catch any period up to the
+// maximum, once every this many generations
+#define CYCLE_SAMPLE_INTERVAL 512
+// Hash to generation slots, a power of two
+#define CYCLE_TABLE_SIZE 256
+
+enum CycleState {
+  // Hashing generations, looking for one seen before
+  CYCLE_SEARCHING,
+  // A hash repeated: keeping the grids of one period to compare in full
+  CYCLE_CONFIRMING,
+  // The grid repeats, generations are copied from the kept ones
+  CYCLE_REPLAYING,
+};
+
+struct CycleSlot {
+  uint64_t hash;
+  uint64_t generation;
+};
+
+// Finds when a bounded grid starts repeating and then replays the period
+// instead of stepping it. The grid hash is the XOR of one hash per tile (the
+// tile engine's tiles), so only tiles that changed need hashing again.
+struct CycleDetector {
+  int rows, cols;
+  int tileRows, tileCols;
+  uint64_t *tileHashes;
+  uint64_t hash;
+
+  struct CycleSlot table[CYCLE_TABLE_SIZE];
+  // Generations observed since the last reset
+  uint64_t generation;
+
+  enum CycleState state;
+  int period;
+  int phase;
+  // First generation of the cycle, counted like generation
+  uint64_t start;
+
+  // One grid per phase without the halo, and for each phase the tile rows
+  // (y * tileCols + tile column) that differ from the next phase:
+  // diffRows[diffStart[i]] up to diffStart[i + 1]
+  uint8_t *frames;
+  int *diffRows;
+  int diffStart[CYCLE_MAX_PERIOD + 1];
+};
+
+int cycleInit(struct CycleDetector *cycles, struct LifeGrid *grid);
+void cycleFree(struct CycleDetector *cycles);
+
+// The grid was changed from outside, whatever was found no longer holds
+void cycleReset(struct CycleDetector *cycles, struct LifeGrid *grid);
+
+// Called after each stepped generation. changedTiles flags the tiles that
+// changed in it, or is NULL when any of them might have.
+void cycleObserve(struct CycleDetector *cycles, struct LifeGrid *grid,
+                  const uint8_t *changedTiles);
+
+// Advances the grid one generation from the kept period. Only valid while
+// replaying, and only the tile rows that differ between phases are copied.
+void cycleReplay(struct CycleDetector *cycles, struct LifeGrid *grid);
+
+// Period of the cycle being replayed, 0 if there is none yet
+int cyclePeriod(struct CycleDetector *cycles);
+
+#endif
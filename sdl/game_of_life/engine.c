@@ -0,0 +1,276 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "engine.h"
+
+#include <string.h>
+
+static const char *engineNames[ENGINE_COUNT] = {
+    "cells", "bytes", "threads", "tiles", "sparse", "hashlife", "procs",
+};
+
+const char *engineName(enum EngineKind kind) { return engineNames[kind]; }
+
+int engineFromName(const char *name) {
+  for (int i = 0; i < ENGINE_COUNT; i++) {
+    if (strcmp(name, engineNames[i]) == 0)
+      return i;
+  }
+
+  return -1;
+}
+
+int engineIsBounded(enum EngineKind kind) {
+  return kind != ENGINE_SPARSE && kind != ENGINE_HASHLIFE;
+}
+
+int engineStepsGrid(enum EngineKind kind) {
+  return engineIsBounded(kind) && kind != ENGINE_PROCS;
+}
+
+int engineSupportsRule(enum EngineKind kind, const struct LifeRule *rule) {
+  // Slabs have a single halo row
+  if (kind == ENGINE_PROCS)
+    return rule->family != RULE_LARGER;
+  if (engineIsBounded(kind))
+    return 1;
+
+  return rule->family == RULE_LIFE && !ruleBirthOnZero(rule);
+}
+
+int engineSupportsBoundary(enum EngineKind kind, const struct LifeRule *rule,
+                           enum LifeBoundary boundary) {
+  if (boundary == LIFE_BOUNDARY_DEAD)
+    return 1;
+
+  return engineIsBounded(kind) && rule->family != RULE_LARGER;
+}
+
+int stepperInit(struct Stepper *stepper, enum EngineKind kind,
+                struct LifeGrid *grid, int threads) {
+  memset(stepper, 0, sizeof(struct Stepper));
+  stepper->kind = kind;
+  stepper->grid = grid;
+
+  int result = 0;
+  switch (kind) {
+  case ENGINE_THREADS:
+    result = lifePoolInit(&stepper->pool, threads);
+    break;
+  case ENGINE_TILES:
+    result = tilesInit(&stepper->tiles, grid);
+    break;
+  case ENGINE_SPARSE:
+    result = sparseInit(&stepper->sparse);
+    break;
+  case ENGINE_HASHLIFE:
+    result = hashLifeInit(&stepper->hashLife, (size_t)256 << 20);
+    break;
+  case ENGINE_PROCS:
+    result = lifeProcsInit(&stepper->procs, grid, threads);
+    break;
+  default:
+    break;
+  }
+
+  if (result == 0)
+    stepperLoad(stepper);
+  return result;
+}
+
+void stepperFree(struct Stepper *stepper) {
+  if (stepper->detectCycles)
+    cycleFree(&stepper->cycles);
+
+  switch (stepper->kind) {
+  case ENGINE_THREADS:
+    lifePoolFree(&stepper->pool);
+    break;
+  case ENGINE_TILES:
+    tilesFree(&stepper->tiles);
+    break;
+  case ENGINE_SPARSE:
+    sparseFree(&stepper->sparse);
+    break;
+  case ENGINE_HASHLIFE:
+    hashLifeFree(&stepper->hashLife);
+    break;
+  case ENGINE_PROCS:
+    lifeProcsFree(&stepper->procs);
+    break;
+  default:
+    break;
+  }
+}
+
+int stepperDetectCycles(struct Stepper *stepper) {
+  if (!engineStepsGrid(stepper->kind) ||
+      cycleInit(&stepper->cycles, stepper->grid) != 0)
+    return -1;
+
+  stepper->detectCycles = 1;
+  return 0;
+}
+
+// Replaying only writes the current buffer, so the tile engine can't trust
+// its other one to hold the unchanged tiles afterwards
+static void stopReplay(struct Stepper *stepper) {
+  if (!stepper->detectCycles)
+    return;
+
+  if (stepper->cycles.state == CYCLE_REPLAYING &&
+      stepper->kind == ENGINE_TILES)
+    tilesMarkAll(&stepper->tiles);
+  cycleReset(&stepper->cycles, stepper->grid);
+}
+
+void stepperLoad(struct Stepper *stepper) {
+  stopReplay(stepper);
+  stepper->gridStale = 0;
+
+  switch (stepper->kind) {
+  case ENGINE_TILES:
+    tilesMarkAll(&stepper->tiles);
+    break;
+  case ENGINE_SPARSE:
+    sparseFromGrid(&stepper->sparse, stepper->grid, 0, 0);
+    break;
+  case ENGINE_HASHLIFE:
+    hashLifeFromGrid(&stepper->hashLife, stepper->grid);
+    break;
+  case ENGINE_PROCS:
+    lifeProcsLoad(&stepper->procs, stepper->grid);
+    break;
+  default:
+    break;
+  }
+}
+
+void stepperSetCell(struct Stepper *stepper, int y, int x, int alive) {
+  stepperSync(stepper);
+  *lifeCell(stepper->grid, y, x) = alive != 0;
+  stopReplay(stepper);
+
+  switch (stepper->kind) {
+  case ENGINE_TILES:
+    tilesMarkCell(&stepper->tiles, y, x);
+    break;
+  case ENGINE_SPARSE:
+    sparseSetCell(&stepper->sparse, y, x, alive);
+    break;
+  case ENGINE_HASHLIFE:
+    hashLifeSetCell(&stepper->hashLife, y, x, alive);
+    break;
+  case ENGINE_PROCS:
+    lifeProcsSetCell(&stepper->procs, y, x, alive != 0);
+    break;
+  default:
+    break;
+  }
+}
+
+static int stepEngine(struct Stepper *stepper, uint64_t generations) {
+  struct LifeGrid *grid = stepper->grid;
+
+  switch (stepper->kind) {
+  case ENGINE_CELLS:
+    for (uint64_t gen = 0; gen < generations; gen++) {
+      nextGeneration(grid);
+    }
+    break;
+  case ENGINE_BYTES:
+    for (uint64_t gen = 0; gen < generations; gen++) {
+      lifeStep(grid);
+    }
+    break;
+  case ENGINE_THREADS:
+    for (uint64_t gen = 0; gen < generations; gen++) {
+      lifePoolStep(&stepper->pool, grid);
+    }
+    break;
+  case ENGINE_TILES:
+    for (uint64_t gen = 0; gen < generations; gen++) {
+      stepper->activeTiles = tilesStep(&stepper->tiles, grid);
+    }
+    break;
+  case ENGINE_SPARSE:
+    for (uint64_t gen = 0; gen < generations; gen++) {
+      sparseStep(&stepper->sparse);
+    }
+    stepper->gridStale = 1;
+    break;
+  case ENGINE_HASHLIFE:
+    // One call, HashLife splits it into power of two jumps itself
+    stepper->gridStale = 1;
+    return hashLifeStep(&stepper->hashLife, generations);
+  case ENGINE_PROCS:
+    // The workers run on without the coordinator waiting for them
+    lifeProcsStep(&stepper->procs, grid, generations);
+    stepper->gridStale = 1;
+    break;
+  default:
+    break;
+  }
+
+  return 0;
+}
+
+int stepperStep(struct Stepper *stepper, uint64_t generations) {
+  if (!stepper->detectCycles)
+    return stepEngine(stepper, generations);
+
+  struct CycleDetector *cycles = &stepper->cycles;
+  for (uint64_t gen = 0; gen < generations; gen++) {
+    if (cycles->state == CYCLE_REPLAYING) {
+      cycleReplay(cycles, stepper->grid);
+      stepper->activeTiles = 0;
+      continue;
+    }
+
+    stepEngine(stepper, 1);
+    cycleObserve(cycles, stepper->grid,
+                 stepper->kind == ENGINE_TILES ? stepper->tiles.changed
+                                               : NULL);
+  }
+  return 0;
+}
+
+void stepperSync(struct Stepper *stepper) {
+  if (!stepper->gridStale)
+    return;
+
+  switch (stepper->kind) {
+  case ENGINE_SPARSE:
+    sparseToGrid(&stepper->sparse, stepper->grid, 0, 0);
+    break;
+  case ENGINE_HASHLIFE:
+    hashLifeToGrid(&stepper->hashLife, stepper->grid, 0, 0);
+    break;
+  case ENGINE_PROCS:
+    lifeProcsGather(&stepper->procs, stepper->grid);
+    break;
+  default:
+    break;
+  }
+  stepper->gridStale = 0;
+}
+
+uint32_t stepperActiveArea(struct Stepper *stepper) {
+  if (stepper->detectCycles && stepper->cycles.state == CYCLE_REPLAYING)
+    return 0;
+
+  uint64_t area = (uint64_t)stepper->grid->rows * stepper->grid->cols;
+  if (stepper->kind == ENGINE_TILES) {
+    uint64_t tiles = (uint64_t)stepper->activeTiles * TILE_SIZE * TILE_SIZE;
+    area = tiles < area ? tiles : area;
+  } else if (stepper->kind == ENGINE_SPARSE) {
+    area = (uint64_t)stepper->sparse.chunkCount * CHUNK_SIZE * CHUNK_SIZE;
+  }
+  return area > UINT32_MAX ? UINT32_MAX : (uint32_t)area;
+}
+
+const struct TileTracker *stepperSteppedTiles(struct Stepper *stepper) {
+  if (stepper->kind != ENGINE_TILES ||
+      (stepper->detectCycles && stepper->cycles.state == CYCLE_REPLAYING))
+    return NULL;
+  return &stepper->tiles;
+}
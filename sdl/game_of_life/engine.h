@@ -0,0 +1,90 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdint.h>
+
+#include "cycle.h"
+#include "hashlife.h"
+#include "life.h"
+#include "pool.h"
+#include "procs.h"
+#include "rule.h"
+#include "sparse.h"
+#include "tiles.h"
+
+enum EngineKind {
+  ENGINE_CELLS,
+  ENGINE_BYTES,
+  ENGINE_THREADS,
+  ENGINE_TILES,
+  ENGINE_SPARSE,
+  ENGINE_HASHLIFE,
+  ENGINE_PROCS,
+  ENGINE_COUNT
+};
+
+// Common front for every stepping engine. The grid is the world as far as
+// the caller is concerned; the unbounded engines (sparse, hashlife) keep
+// their own copy and write the window at the origin back into it, and the
+// worker processes gather their slabs back into it, on stepperSync.
+struct Stepper {
+  enum EngineKind kind;
+  struct LifeGrid *grid;
+
+  struct LifePool pool;
+  struct TileTracker tiles;
+  struct SparseWorld sparse;
+  struct HashLife hashLife;
+  struct LifeProcs procs;
+
+  // Tiles stepped in the last generation, tile engine only
+  int activeTiles;
+  // The engine has stepped past the grid, until stepperSync
+  int gridStale;
+
+  // Once the grid repeats, generations are replayed rather than stepped
+  int detectCycles;
+  struct CycleDetector cycles;
+};
+
+const char *engineName(enum EngineKind kind);
+int engineFromName(const char *name);
+// Cells past the grid's edge are dead, rather than part of a larger world
+int engineIsBounded(enum EngineKind kind);
+// The engine steps the grid itself, so it is current after every generation
+int engineStepsGrid(enum EngineKind kind);
+
+// The unbounded engines only run two-state range 1 rules without B0, the
+// worker processes any range 1 rule, every other engine runs any rule
+int engineSupportsRule(enum EngineKind kind, const struct LifeRule *rule);
+// Torus and mirror boundaries need a bounded engine and a range 1 rule
+int engineSupportsBoundary(enum EngineKind kind, const struct LifeRule *rule,
+                           enum LifeBoundary boundary);
+
+// threads is the thread count of ENGINE_THREADS and the process count of
+// ENGINE_PROCS, 0 picks the core count
+int stepperInit(struct Stepper *stepper, enum EngineKind kind,
+                struct LifeGrid *grid, int threads);
+void stepperFree(struct Stepper *stepper);
+// Turns on cycle detection, which hashes the grid every generation and so
+// needs an engine that steps it. Returns -1 for the others.
+int stepperDetectCycles(struct Stepper *stepper);
+
+// The grid was changed behind the stepper's back
+void stepperLoad(struct Stepper *stepper);
+void stepperSetCell(struct Stepper *stepper, int y, int x, int alive);
+// Returns -1 if the engine couldn't step that far, HashLife once the
+// pattern outgrows its largest root, with the world wherever it got to
+int stepperStep(struct Stepper *stepper, uint64_t generations);
+// Brings the grid up to the engine's generation. Anything reading the grid
+// after a step calls it first; it costs nothing when the grid is current.
+void stepperSync(struct Stepper *stepper);
+// Cells stepped in the last generation: the whole grid, less what the tile
+// and sparse engines skipped, and none while replaying a cycle
+uint32_t stepperActiveArea(struct Stepper *stepper);
+// The tile engine's tracker if it stepped the last generation itself: only
+// its active tiles may have changed, and the grid's next buffer holds the
+// generation before. NULL for the other engines and while replaying.
+const struct TileTracker *stepperSteppedTiles(struct Stepper *stepper);
+
+#endif
@@ -1,23 +1,47 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_events.h>
 #include <SDL2/SDL_keycode.h>
 #include <SDL2/SDL_pixels.h>
 #include <SDL2/SDL_surface.h>
+#include <math.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
+#include "channel.h"
+#include "engine.h"
+#include "framedump.h"
+#include "history.h"
+#include "metrics.h"
+#include "pattern.h"
+#include "soup.h"
+#include "view.h"
+
 // I don't like it being odd, but it's easier to contain
 const int SCREEN_WIDTH = 1601;
 const int SCREEN_HEIGHT = 1301;
-// Should be at least 2, we -1 to make borders possible
+// Should be at least 2, we -1 to make borders possible. Only sets the
+// default world size now, the viewport zooms from there.
 const int CELL_SIZE = 2;
-
-struct Cell {
-  int x;
-  int y;
-  int state;
-  SDL_Color color;
+// Frame rate written into --record videos. --offscreen stops after
+// OFFSCREEN_FRAMES unless --frames says otherwise.
+const int RECORD_FPS = 60;
+const int OFFSCREEN_FRAMES = 600;
+
+// The step loop only touches the state bytes in the grid. Colours follow
+// from a cell's position and highlights are a short list, so nothing but the
+// grid grows with the world.
+struct World {
+  struct LifeGrid grid;
+  // Neighbours highlighted until the next generation is shown, {y, x}
+  int highlight[8][2];
+  int highlighted;
+
+  struct Stepper stepper;
 };
 
 int init(void) {
@@ -29,9 +53,32 @@ int init(void) {
   return sdlInit;
 }
 
-void cleanup(SDL_Window *win, struct Cell *cells) {
-  if (cells != NULL) {
-    free(cells);
+int initializeWorld(struct World *world, int rows, int cols,
+                    enum EngineKind engine, int threads) {
+  if (lifeGridInit(&world->grid, rows, cols) != 0)
+    return -1;
+
+  world->highlighted = 0;
+  if (stepperInit(&world->stepper, engine, &world->grid, threads) != 0) {
+    lifeGridFree(&world->grid);
+    return -1;
+  }
+
+  return 0;
+}
+
+void freeWorld(struct World *world) {
+  stepperFree(&world->stepper);
+  lifeGridFree(&world->grid);
+}
+
+// The grid was changed outside of stepWorld, so the engine has to pick the
+// new cells up (the unbounded engines replace their world with the grid)
+void touchWorld(struct World *world) { stepperLoad(&world->stepper); }
+
+void cleanup(SDL_Window *win, struct World *world) {
+  if (world != NULL) {
+    freeWorld(world);
   }
 
   if (win != NULL) {
@@ -41,230 +88,770 @@ void cleanup(SDL_Window *win, struct Cell *cells) {
   SDL_Quit();
 }
 
-void drawCells(SDL_Surface *screen, struct Cell *cells, int toggleColor) {
-  SDL_Rect rect;
-  rect.w = CELL_SIZE - 1;
-  rect.h = CELL_SIZE - 1;
+#define LOOK_HIGHLIGHT 0xfe
+
+// Mapped colours and what every cell or pixel of the viewport currently
+// looks like on screen, so a frame writes the pixels of the looks that
+// changed since the last one and nothing else
+struct Renderer {
+  SDL_Surface *screen;
+  // 32-bit surfaces are written directly, anything else goes through
+  // SDL_FillRect
+  int direct;
+
+  Uint32 background, highlight;
+  // Colour of every cell state: dead, alive, then the dying states of
+  // Generations rules fading out
+  Uint32 states[RULE_MAX_STATES];
+  // Zoomed out pixels, from no live cells to all of them alive
+  Uint32 shades[VIEW_SHADES];
+  // Colours of the colour mode, each cell gets one from its position
+  Uint32 palette[8];
+  // Look of everything as last drawn, for shownView: a cell state, a shade,
+  // VIEW_OUTSIDE or LOOK_HIGHLIGHT
+  uint8_t *shown;
+  struct Viewport shownView;
+  // Pixel size and window position of the first look of shownView
+  int lookPixels;
+  int top, left;
+  int toggleColor;
+  int redrawAll;
+  int cellsDrawn;
+};
 
-  int rows = SCREEN_HEIGHT / CELL_SIZE;
-  int cols = SCREEN_WIDTH / CELL_SIZE;
+// Every look is drawn on the first frame
+int initRenderer(struct Renderer *renderer, SDL_Surface *screen) {
+  renderer->screen = screen;
+  renderer->direct = screen->format->BytesPerPixel == 4;
+  // Never more looks than pixels
+  renderer->shown = malloc((size_t)screen->w * screen->h);
+  if (renderer->shown == NULL)
+    return -1;
+
+  SDL_PixelFormat *format = screen->format;
+  renderer->background = SDL_MapRGB(format, 128, 128, 128);
+  renderer->highlight = SDL_MapRGB(format, 0, 0, 255);
+  renderer->states[0] = SDL_MapRGB(format, 0, 0, 0);
+  renderer->states[1] = SDL_MapRGB(format, 255, 255, 255);
+
+  int states = lifeGetRule()->states;
+  for (int state = 2; state < states; state++) {
+    int level = 255 * (states - state) / (states - 1);
+    renderer->states[state] = SDL_MapRGB(format, level, level / 2, 0);
+  }
 
-  SDL_FillRect(screen, NULL, SDL_MapRGB(screen->format, 128, 128, 128));
+  // Square root ramp, so a few live cells in a pixel still show
+  renderer->shades[0] = renderer->states[0];
+  for (int shade = 1; shade < VIEW_SHADES; shade++) {
+    double fraction = (double)shade / (VIEW_SHADES - 1);
+    int level = 48 + (int)(207 * sqrt(fraction));
+    renderer->shades[shade] = SDL_MapRGB(format, level, level, level);
+  }
+  for (int i = 0; i < 8; i++) {
+    renderer->palette[i] = SDL_MapRGB(format, i & 1 ? 255 : 0,
+                                      i & 2 ? 255 : 0, i & 4 ? 255 : 0);
+  }
 
-  for (int i = 0; i < rows; i++) {
-    for (int j = 0; j < cols; j++) {
-      rect.x = j * CELL_SIZE + 1;
-      rect.y = i * CELL_SIZE + 1;
+  memset(&renderer->shownView, 0, sizeof(struct Viewport));
+  renderer->lookPixels = 1;
+  renderer->top = 0;
+  renderer->left = 0;
+  renderer->toggleColor = 0;
+  renderer->redrawAll = 1;
+  renderer->cellsDrawn = 0;
+  return 0;
+}
 
-      int index = i * cols + j;
-      if (cells[index].state == 1) {
-        int red = 255;
-        int green = 255;
-        int blue = 255;
+void freeRenderer(struct Renderer *renderer) { free(renderer->shown); }
 
-        if (toggleColor) {
-          red = cells[index].color.r;
-          green = cells[index].color.g;
-          blue = cells[index].color.b;
-        }
+// Fixed colour of the colour mode for a cell, one of the eight corners of
+// the RGB cube
+static int cellColor(int y, int x) {
+  uint32_t hash = (uint32_t)y * 0x9e3779b1u ^ (uint32_t)x * 0x85ebca77u;
+  hash ^= hash >> 15;
+  hash *= 0x2c1b3c6du;
+  return hash >> 29;
+}
 
-        SDL_FillRect(screen, &rect,
-                     SDL_MapRGB(screen->format, red, green, blue));
-      } else if (cells[index].state == 0) {
-        SDL_FillRect(screen, &rect, SDL_MapRGB(screen->format, 0, 0, 0));
-      } else {
-        SDL_FillRect(screen, &rect, SDL_MapRGB(screen->format, 0, 0, 255));
-      }
+// Cells two or more pixels wide keep a one pixel border of background
+static void paintLook(struct Renderer *renderer, int row, int col,
+                      Uint32 color) {
+  SDL_Surface *screen = renderer->screen;
+  int size = renderer->lookPixels;
+  int border = size > 1;
+  int left = renderer->left + col * size + border;
+  int top = renderer->top + row * size + border;
+  int right = left + size - border;
+  int bottom = top + size - border;
+  left = left < 0 ? 0 : left;
+  top = top < 0 ? 0 : top;
+  right = right > screen->w ? screen->w : right;
+  bottom = bottom > screen->h ? screen->h : bottom;
+  if (left >= right || top >= bottom)
+    return;
+
+  if (!renderer->direct) {
+    SDL_Rect rect = {left, top, right - left, bottom - top};
+    SDL_FillRect(screen, &rect, color);
+    return;
+  }
+
+  for (int y = top; y < bottom; y++) {
+    Uint32 *row = (Uint32 *)((uint8_t *)screen->pixels + y * screen->pitch);
+    for (int x = left; x < right; x++) {
+      row[x] = color;
     }
   }
 }
 
-struct Cell *getNeighbors(struct Cell *cells, int y, int x, int rows,
-                          int cols) {
-  int neighbors[8][2] = {
-      {y - 1, x - 1}, {y - 1, x},     {y - 1, x + 1}, {y, x - 1},
-      {y, x + 1},     {y + 1, x - 1}, {y + 1, x},     {y + 1, x + 1},
-  };
+static Uint32 lookColor(struct Renderer *renderer, int look, int y, int x) {
+  if (look == VIEW_OUTSIDE)
+    return renderer->background;
+  if (renderer->shownView.zoom < 0)
+    return renderer->shades[look];
+  if (look == 1 && renderer->toggleColor)
+    return renderer->palette[cellColor(y, x)];
+  return renderer->states[look];
+}
 
-  struct Cell *nCells = malloc(8 * sizeof(struct Cell));
-  for (int i = 0; i < 8; i++) {
-    nCells[i].state = -1;
+// Redraws the looks of row r whose look changed, from cStart to cEnd
+static void drawRowFrom(struct Renderer *renderer, const uint8_t *looks,
+                        uint8_t *shown, int row0, int col0, int r,
+                        int cStart, int cEnd) {
+  for (int c = cStart; c < cEnd; c++) {
+    if (looks[c] == shown[c])
+      continue;
+
+    shown[c] = looks[c];
+    paintLook(renderer, r, c,
+              lookColor(renderer, looks[c], row0 + r, col0 + c));
+    renderer->cellsDrawn++;
   }
+}
 
-  for (int i = 0; i < 8; i++) {
-    int neighborY = neighbors[i][0];
-    int neighborX = neighbors[i][1];
+// Draws a published frame, which holds the looks of its viewport, with the
+// colours and highlights of the world. Costs the pixels in the window
+// whatever the size of the world.
+void drawCells(struct Renderer *renderer, struct World *world,
+               struct LifeFrame *frame, int toggleColor) {
+  SDL_Surface *screen = renderer->screen;
+  struct Viewport *view = &frame->view;
+  int row0, col0, rows, cols;
+  viewportSpan(view, &row0, &col0, &rows, &cols);
+
+  // Switching colours changes every live cell, and moving the view every
+  // pixel
+  if (toggleColor != renderer->toggleColor ||
+      memcmp(view, &renderer->shownView, sizeof(struct Viewport)) != 0) {
+    renderer->toggleColor = toggleColor;
+    renderer->shownView = *view;
+    renderer->lookPixels = view->zoom > 0 ? 1 << view->zoom : 1;
+    viewportLookPixel(view, 0, 0, &renderer->top, &renderer->left);
+    renderer->redrawAll = 1;
+  }
 
-    if (neighborY < 0 || neighborY >= rows || neighborX < 0 ||
-        neighborX >= cols)
-      continue;
+  if (renderer->redrawAll) {
+    SDL_FillRect(screen, NULL, renderer->background);
+    memset(renderer->shown, 0xff, (size_t)rows * cols);
+    renderer->redrawAll = 0;
+  }
+
+  int locked = renderer->direct && SDL_MUSTLOCK(screen);
+  if (locked && SDL_LockSurface(screen) != 0)
+    return;
+
+  renderer->cellsDrawn = 0;
+  for (int r = 0; r < rows; r++) {
+    // Unchanged runs of 8 looks are skipped with one comparison
+    const uint8_t *looks = frame->looks + (size_t)r * cols;
+    uint8_t *shown = renderer->shown + (size_t)r * cols;
+    for (int c = 0; c < cols; c += 8) {
+      int end = c + 8 < cols ? c + 8 : cols;
+      if (end - c == 8) {
+        uint64_t now, before;
+        memcpy(&now, looks + c, 8);
+        memcpy(&before, shown + c, 8);
+        if (now == before)
+          continue;
+      }
+      drawRowFrom(renderer, looks, shown, row0, col0, r, c, end);
+    }
+  }
 
-    int neighbor = neighborY * cols + neighborX;
-    nCells[i] = cells[neighbor];
+  // Highlights aren't in the looks, they go on top and are marked so the
+  // cell comes back once they are cleared
+  int level = view->zoom < 0 ? -view->zoom : 0;
+  for (int i = 0; i < world->highlighted; i++) {
+    int r = (world->highlight[i][0] >> level) - row0;
+    int c = (world->highlight[i][1] >> level) - col0;
+    if (r < 0 || r >= rows || c < 0 || c >= cols)
+      continue;
+    renderer->shown[(size_t)r * cols + c] = LOOK_HIGHLIGHT;
+    paintLook(renderer, r, c, renderer->highlight);
   }
 
-  return nCells;
+  if (locked)
+    SDL_UnlockSurface(screen);
 }
 
-void toggleCellState(struct Cell *cells, int x, int y) {
-  int cols = SCREEN_WIDTH / CELL_SIZE;
+// Pixel coordinates go through the viewport the click was made in, which
+// the simulation has by then since commands arrive in order
+void toggleCellState(struct World *world, struct Viewport *view, int x,
+                     int y) {
+  int cellX, cellY;
+  if (!viewportCellAt(view, x, y, &cellY, &cellX) || cellY < 0 ||
+      cellY >= world->grid.rows || cellX < 0 || cellX >= world->grid.cols)
+    return;
+
+  stepperSync(&world->stepper);
+  int alive = *lifeCell(&world->grid, cellY, cellX);
+  stepperSetCell(&world->stepper, cellY, cellX, !alive);
+}
 
-  int cellX = x / CELL_SIZE;
-  int cellY = y / CELL_SIZE;
+void showNeighbors(struct World *world, struct Viewport *view, int x,
+                   int y) {
+  int cellX, cellY;
+  if (!viewportCellAt(view, x, y, &cellY, &cellX) || cellY < 0 ||
+      cellY >= world->grid.rows || cellX < 0 || cellX >= world->grid.cols)
+    return;
 
-  int index = cellY * cols + cellX;
-  cells[index].state = !cells[index].state;
+  world->highlighted = getNeighbors(cellY, cellX, world->grid.rows,
+                                    world->grid.cols, world->highlight);
 }
 
-void showNeighbors(struct Cell *cells, int x, int y, int rows, int cols) {
-  int cellX = x / CELL_SIZE;
-  int cellY = y / CELL_SIZE;
-
-  int index = cellY * cols + cellX;
-  struct Cell *cell = &cells[index];
+void clearCells(struct World *world) {
+  lifeGridClear(&world->grid);
+  touchWorld(world);
+}
 
-  struct Cell *neighbors = getNeighbors(cells, cell->y, cell->x, rows, cols);
+// Advances the world one generation. The grid engines swap their state
+// buffers rather than copying them and nothing is allocated here. Returns
+// -1 once HashLife can't hold the world any more.
+int stepWorld(struct World *world) {
+  return stepperStep(&world->stepper, 1);
+}
 
-  for (int i = 0; i < 8; i++) {
-    if (neighbors[i].state == -1) {
-      continue;
-    }
+// Highlights only last until the next generation is shown
+void clearHighlights(struct World *world) { world->highlighted = 0; }
 
-    index = neighbors[i].y * cols + neighbors[i].x;
-    cells[index].state = 3;
-  }
+// 75% chance of being dead. Two xoshiro draws decide 64 cells, on every
+// core, so even the largest world fills in well under a second.
+void randomizeCells(struct LifeGrid *grid, uint64_t seed) {
+  soupFillGrid(grid, seed, 25, 0);
+}
 
-  free(neighbors);
+// Where the save key writes the world to
+#define SAVE_PATH "gol-save.rle"
+// Where the metrics go on exit and with the m key, in a METRICS=1 build
+#define METRICS_PATH "gol-metrics.csv"
+
+// Generations skipped at once by the jump key (2^JUMP_LOG)
+#define JUMP_LOG 10
+
+// Advances the world 2^JUMP_LOG generations. The unbounded engines step
+// their whole world themselves. A bounded grid goes through HashLife, where
+// the world is unbounded, so anything that leaves the grid is dropped.
+// Rules HashLife can't run (more states, a larger range, B0) and the torus
+// and mirror boundaries, which HashLife has no edge for, are stepped by the
+// world's own engine instead. Returns -1 like stepWorld.
+int jumpWorld(struct World *world, struct HashLife *hl) {
+  if (!engineIsBounded(world->stepper.kind) ||
+      !engineSupportsRule(ENGINE_HASHLIFE, lifeGetRule()) ||
+      world->grid.boundary != LIFE_BOUNDARY_DEAD)
+    return stepperStep(&world->stepper, (uint64_t)1 << JUMP_LOG);
+
+  stepperSync(&world->stepper);
+  hashLifeFromGrid(hl, &world->grid);
+  int result = hashLifeStep(hl, (uint64_t)1 << JUMP_LOG);
+  hashLifeToGrid(hl, &world->grid, 0, 0);
+  touchWorld(world);
+  return result;
 }
 
-void clearCells(struct Cell *cells) {
-  int rows = SCREEN_HEIGHT / CELL_SIZE;
-  int cols = SCREEN_WIDTH / CELL_SIZE;
+// Generations between history keyframes, so a seek decodes at most this
+// many entries
+#define HISTORY_KEY_INTERVAL 64
+// Default history budget in MiB, --history changes it and 0 turns it off
+#define HISTORY_BUDGET 64
+
+// Generations scrubbed at once by page up and page down
+#define SCRUB_GENERATIONS 100
+
+// Input that changes the world, sent from the render thread to the
+// simulation thread
+enum CommandType {
+  COMMAND_TOGGLE,
+  COMMAND_CLEAR,
+  COMMAND_RANDOMIZE,
+  COMMAND_STEP,
+  COMMAND_JUMP,
+  COMMAND_PAUSE,
+  COMMAND_RESUME,
+  COMMAND_SAVE,
+  COMMAND_SEEK,
+  COMMAND_VIEW,
+};
 
-  for (int i = 0; i < rows; i++) {
-    for (int j = 0; j < cols; j++) {
-      int index = i * cols + j;
-      cells[index].state = 0;
-    }
-  }
+// The simulation thread owns the world grid, its engine and the HashLife
+// used for jumps. The render thread only sees the published frames.
+struct Simulation {
+  struct World *world;
+  struct HashLife hl;
+  // Past generations, for going back. Empty when turned off.
+  struct LifeHistory history;
+  int recording;
+  struct Metrics *metrics;
+  // What the render thread shows, frames only hold that part of the world
+  struct Viewport view;
+  struct LifePyramid pyramid;
+  // Seeds of the soups the randomize key fills the world with, so --seed
+  // replays the same ones
+  struct SoupRandom random;
+  struct TripleBuffer frames;
+  struct CommandQueue commands;
+  pthread_t thread;
+  atomic_int quit;
+
+  int paused;
+  int stepsPending;
+  uint64_t generation;
+  double stepSeconds;
+};
+
+static double nowSeconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
 }
 
-int nextCellState(struct Cell *cell, struct Cell *cells) {
-  int aliveNeighbors = 0;
-  struct Cell *neighbors =
-      getNeighbors(cells, cell->y, cell->x, SCREEN_HEIGHT / CELL_SIZE,
-                   SCREEN_WIDTH / CELL_SIZE);
-  for (int i = 0; i < 8; i++) {
-    if (neighbors[i].state == -1) {
-      continue;
-    }
+// HashLife ran out of levels for the pattern, the world stays where it got
+static void stopStepping(struct Simulation *sim) {
+  fprintf(stderr, "The world outgrew HashLife, pausing.\n");
+  sim->paused = 1;
+  sim->stepsPending = 0;
+}
 
-    if (neighbors[i].state)
-      aliveNeighbors++;
-  }
+// Recording a generation that is already there replaces it and drops the
+// ones after it, so an edit starts a new history from that point. A
+// generation that doesn't fit turns history off for good.
+static void recordHistory(struct Simulation *sim) {
+  if (!sim->recording ||
+      historyRecord(&sim->history, sim->generation, &sim->world->grid) == 0)
+    return;
+
+  fprintf(stderr, "Failed to record generation %llu, history is off.\n",
+          (unsigned long long)sim->generation);
+  historyFree(&sim->history);
+  sim->recording = 0;
+}
 
-  free(neighbors);
+// Moves the world back, or forward up to the newest generation recorded
+static void seekHistory(struct Simulation *sim, int generations) {
+  uint64_t first, last, found;
+  if (!sim->recording || !historyRange(&sim->history, &first, &last))
+    return;
+
+  uint64_t target = sim->generation + generations;
+  if (generations < 0 && (uint64_t)-generations > sim->generation - first)
+    target = first;
+  if (historySeek(&sim->history, target, &sim->world->grid, &found) != 0)
+    return;
+
+  sim->generation = found;
+  touchWorld(sim->world);
+  pyramidMarkAll(&sim->pyramid);
+}
 
-  if (cell->state) {
-    if (aliveNeighbors < 2 || aliveNeighbors > 3)
-      return 0;
-  } else {
-    if (aliveNeighbors == 3)
-      return 1;
+static void runCommand(struct Simulation *sim, struct Command *command) {
+  struct World *world = sim->world;
+  switch (command->type) {
+  case COMMAND_TOGGLE:
+    toggleCellState(world, &sim->view, command->x, command->y);
+    pyramidMarkAll(&sim->pyramid);
+    recordHistory(sim);
+    break;
+  case COMMAND_CLEAR:
+    clearCells(world);
+    pyramidMarkAll(&sim->pyramid);
+    recordHistory(sim);
+    break;
+  case COMMAND_RANDOMIZE:
+    randomizeCells(&world->grid, soupRandomNext(&sim->random));
+    touchWorld(world);
+    pyramidMarkAll(&sim->pyramid);
+    recordHistory(sim);
+    break;
+  case COMMAND_STEP:
+    sim->stepsPending++;
+    break;
+  case COMMAND_JUMP:
+    if (jumpWorld(world, &sim->hl) != 0)
+      stopStepping(sim);
+    pyramidMarkAll(&sim->pyramid);
+    sim->generation += 1 << JUMP_LOG;
+    recordHistory(sim);
+    break;
+  case COMMAND_SEEK:
+    seekHistory(sim, command->x);
+    break;
+  case COMMAND_VIEW:
+    sim->view.x = command->x;
+    sim->view.y = command->y;
+    sim->view.zoom = command->zoom;
+    break;
+  case COMMAND_PAUSE:
+    sim->paused = 1;
+    break;
+  case COMMAND_RESUME:
+    sim->paused = 0;
+    break;
+  case COMMAND_SAVE:
+    stepperSync(&world->stepper);
+    if (patternSaveRle(SAVE_PATH, &world->grid) == 0)
+      printf("Saved %s\n", SAVE_PATH);
+    break;
   }
-
-  return cell->state;
 }
 
-struct Cell *nextGeneration(struct Cell *cells, int rows, int cols) {
-  // Make a copy of the cells, so we can update them all at once -> otherwise
-  // invalidates the neighbors
-  struct Cell *nextGen = malloc(rows * cols * sizeof(struct Cell));
-  struct Cell *cellsToCheck = malloc(rows * cols * sizeof(struct Cell));
+static void publishFrame(struct Simulation *sim) {
+  struct World *world = sim->world;
+  struct LifeFrame *frame = tripleBack(&sim->frames);
+
+  frame->view = sim->view;
+  stepperSync(&world->stepper);
+  viewFill(&sim->view, &world->grid, &sim->pyramid, frame->looks);
+  frame->generation = sim->generation;
+  frame->stepSeconds = sim->stepSeconds;
+  frame->activeTiles = world->stepper.activeTiles;
+  frame->chunkCount = world->stepper.sparse.chunkCount;
+  frame->period = world->stepper.detectCycles
+                      ? cyclePeriod(&world->stepper.cycles)
+                      : 0;
+  triplePublish(&sim->frames);
+}
 
-  // Initialize cells to check to have state -1
-  for (int i = 0; i < rows * cols; i++) {
-    cellsToCheck[i].state = -1;
-  }
+static void *simulationMain(void *arg) {
+  struct Simulation *sim = arg;
+  int dirty = 1;
 
-  for (int i = 0; i < rows; i++) {
-    for (int j = 0; j < cols; j++) {
-      int index = i * cols + j;
-      nextGen[index] = cells[index];
+  while (!atomic_load(&sim->quit)) {
+    struct Command command;
+    while (commandPop(&sim->commands, &command)) {
+      runCommand(sim, &command);
+      dirty = 1;
+    }
 
-      if (cells[index].state <= 0) {
+    int stepping = !sim->paused || sim->stepsPending > 0;
+    if (stepping) {
+      double start = nowSeconds();
+      if (stepWorld(sim->world) != 0) {
+        stopStepping(sim);
         continue;
       }
+      double elapsed = nowSeconds() - start;
+      pyramidMarkStep(&sim->pyramid, stepperSteppedTiles(&sim->world->stepper));
+      sim->stepSeconds += elapsed;
+      sim->generation++;
+      recordHistory(sim);
+      if (metricsWantsGrid(sim->metrics, sim->generation))
+        stepperSync(&sim->world->stepper);
+      metricsGeneration(sim->metrics, sim->generation, elapsed * 1e9,
+                        &sim->world->grid,
+                        stepperActiveArea(&sim->world->stepper),
+                        stepperSteppedTiles(&sim->world->stepper));
+      if (sim->stepsPending > 0)
+        sim->stepsPending--;
+      dirty = 1;
+    }
 
-      if (cells[index].state == 1) {
-        cellsToCheck[index] = cells[index];
-      }
+    // Filling the looks costs the visible cells, as much as stepping them
+    // when zoomed out over the whole world, and the worker processes have to
+    // be gathered for it, so while running a generation is only published
+    // once the last one was picked up. The render thread shows the newest
+    // one either way.
+    if (dirty && (sim->paused || !tripleUnread(&sim->frames))) {
+      publishFrame(sim);
+      dirty = 0;
+    }
 
-      struct Cell *neighbors =
-          getNeighbors(cells, cells[index].y, cells[index].x, rows, cols);
+    if (sim->paused && !dirty) {
+      struct timespec idle = {0, 1000000};
+      nanosleep(&idle, NULL);
+    }
+  }
 
-      for (int j = 0; j < 8; j++) {
-        // Skip NULL neighbors
-        if (neighbors[j].state == -1) {
-          continue;
-        }
+  return NULL;
+}
 
-        int neighborIndex = neighbors[j].y * cols + neighbors[j].x;
+int startSimulation(struct Simulation *sim, struct World *world,
+                    struct Viewport *view, size_t historyBudget,
+                    uint64_t seed, struct Metrics *metrics) {
+  sim->world = world;
+  soupRandomInit(&sim->random, seed);
+  sim->metrics = metrics;
+  sim->view = *view;
+  sim->paused = 1;
+  sim->stepsPending = 0;
+  sim->generation = 0;
+  sim->stepSeconds = 0;
+  atomic_init(&sim->quit, 0);
+  commandQueueInit(&sim->commands);
+
+  // Kept between jumps, so its memoized results can be reused
+  if (hashLifeInit(&sim->hl, (size_t)256 << 20) != 0)
+    return -1;
+
+  if (pyramidInit(&sim->pyramid, world->grid.rows, world->grid.cols) != 0) {
+    hashLifeFree(&sim->hl);
+    return -1;
+  }
 
-        // Check if neighbor is already in the list
-        if (cellsToCheck[neighborIndex].state != -1) {
-          continue;
-        }
+  // Never more looks than pixels
+  if (tripleInit(&sim->frames, view->height, view->width) != 0) {
+    pyramidFree(&sim->pyramid);
+    hashLifeFree(&sim->hl);
+    return -1;
+  }
 
-        cellsToCheck[neighborIndex] = neighbors[j];
-      }
-    }
+  // Recording would bring the grid up to date every generation, and only
+  // holds the unbounded engines' window on the world
+  if (historyBudget > 0 && !engineStepsGrid(world->stepper.kind)) {
+    printf("History is off with the %s engine.\n",
+           engineName(world->stepper.kind));
+    historyBudget = 0;
   }
 
-  for (int i = 0; i < (cols * rows) - 1; i++) {
-    if (cellsToCheck[i].state == -1) {
-      continue;
-    }
+  // Before anything is allocated, history's buffers add up to several
+  // frames
+  if (historyBudget > 0 &&
+      !historyKeyframeFits(world->grid.rows, world->grid.cols,
+                           historyBudget)) {
+    printf("History is off, a keyframe of the world needs more than %zu "
+           "MiB.\n",
+           historyBudget >> 20);
+    historyBudget = 0;
+  }
 
-    int nextState = nextCellState(&cellsToCheck[i], cells);
-    int index = cellsToCheck[i].y * cols + cellsToCheck[i].x;
-    nextGen[index].state = nextState;
+  memset(&sim->history, 0, sizeof(struct LifeHistory));
+  sim->recording = historyBudget > 0;
+  if (sim->recording &&
+      historyInit(&sim->history, world->grid.rows, world->grid.cols,
+                  HISTORY_KEY_INTERVAL, historyBudget) != 0) {
+    fprintf(stderr, "Failed to allocate history, it is off.\n");
+    sim->recording = 0;
+  }
+  recordHistory(sim);
+
+  if (pthread_create(&sim->thread, NULL, simulationMain, sim) != 0) {
+    historyFree(&sim->history);
+    tripleFree(&sim->frames);
+    pyramidFree(&sim->pyramid);
+    hashLifeFree(&sim->hl);
+    return -1;
   }
 
-  free(cellsToCheck);
-  return nextGen;
+  return 0;
+}
+
+void stopSimulation(struct Simulation *sim) {
+  atomic_store(&sim->quit, 1);
+  pthread_join(sim->thread, NULL);
+  historyFree(&sim->history);
+  tripleFree(&sim->frames);
+  pyramidFree(&sim->pyramid);
+  hashLifeFree(&sim->hl);
+}
+
+// Commands are dropped if the simulation falls that far behind
+void sendCommand(struct Simulation *sim, int type, int x, int y) {
+  struct Command command = {type, x, y, 0};
+  if (commandPush(&sim->commands, command) != 0)
+    fprintf(stderr, "Command queue full, input dropped.\n");
+}
+
+void sendView(struct Simulation *sim, struct Viewport *view) {
+  struct Command command = {COMMAND_VIEW, view->x, view->y, view->zoom};
+  if (commandPush(&sim->commands, command) != 0)
+    fprintf(stderr, "Command queue full, input dropped.\n");
+}
+
+// Hands the frame on the screen to the writer thread. Waiting for room only
+// makes sense offscreen, with no display to keep up with.
+void captureFrame(struct FrameDump *dump, SDL_Surface *screen, int wait) {
+  if (SDL_MUSTLOCK(screen) && SDL_LockSurface(screen) < 0) {
+    fprintf(stderr, "SDL_LockSurface Error: %s\n", SDL_GetError());
+    return;
+  }
+  frameDumpPush(dump, screen->pixels, screen->pitch / 4, wait);
+  if (SDL_MUSTLOCK(screen))
+    SDL_UnlockSurface(screen);
 }
 
-void randomizeCells(struct Cell *cells, int rows, int cols) {
-  for (int i = 0; i < rows * cols; i++) {
-    // 75% chance of being dead
-    int chance = rand() % 100;
-    if (chance < 75) {
-      cells[i].state = 0;
+int main(int argc, char **argv) {
+  int engine = ENGINE_CELLS;
+  int threads = 0;
+  const char *patternPath = NULL;
+  int boundary = LIFE_BOUNDARY_DEAD;
+  int historyMegabytes = HISTORY_BUDGET;
+  const char *metricsPath = METRICS_PATH;
+  uint64_t seed = 1;
+  // --record streams the frames to a file, --offscreen draws them with no
+  // window on screen, unpaced, until frameLimit
+  const char *recordPath = NULL;
+  int offscreen = 0;
+  int frameLimit = 0;
+  // Fills the window at the default cell size unless --size says otherwise
+  int rows = SCREEN_HEIGHT / CELL_SIZE;
+  int cols = SCREEN_WIDTH / CELL_SIZE;
+  struct LifeRule rule;
+  ruleParse(&rule, "life");
+  int ruleGiven = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      threads = atoi(argv[++i]);
+      if (threads < 1) {
+        fprintf(stderr, "Invalid thread count: %s\n", argv[i]);
+        return 1;
+      }
+      engine = ENGINE_THREADS;
+    } else if (strcmp(argv[i], "--procs") == 0 && i + 1 < argc) {
+      threads = atoi(argv[++i]);
+      if (threads < 1) {
+        fprintf(stderr, "Invalid process count: %s\n", argv[i]);
+        return 1;
+      }
+      engine = ENGINE_PROCS;
+    } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+      engine = engineFromName(argv[++i]);
+      if (engine < 0) {
+        fprintf(stderr, "Unknown engine: %s\n", argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+      int kernel = lifeKernelFromName(argv[++i]);
+      if (kernel < 0 || lifeSetKernel(kernel) != 0) {
+        fprintf(stderr, "Kernel not available: %s\n", argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--pattern") == 0 && i + 1 < argc) {
+      patternPath = argv[++i];
+    } else if (strcmp(argv[i], "--boundary") == 0 && i + 1 < argc) {
+      boundary = lifeBoundaryFromName(argv[++i]);
+      if (boundary < 0) {
+        fprintf(stderr, "Unknown boundary: %s\n", argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+      if (sscanf(argv[++i], "%dx%d", &cols, &rows) != 2 || cols < 1 ||
+          rows < 1 || cols > VIEW_MAX_SIDE || rows > VIEW_MAX_SIDE) {
+        fprintf(stderr, "Invalid size: %s (up to %dx%d)\n", argv[i],
+                VIEW_MAX_SIDE, VIEW_MAX_SIDE);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--history") == 0 && i + 1 < argc) {
+      historyMegabytes = atoi(argv[++i]);
+      if (historyMegabytes < 0) {
+        fprintf(stderr, "Invalid history size: %s\n", argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+      metricsPath = argv[++i];
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = strtoull(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "--rule") == 0 && i + 1 < argc) {
+      if (ruleParse(&rule, argv[++i]) != 0) {
+        fprintf(stderr, "Invalid rule: %s\n", argv[i]);
+        return 1;
+      }
+      ruleGiven = 1;
+    } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+      recordPath = argv[++i];
+    } else if (strcmp(argv[i], "--offscreen") == 0) {
+      offscreen = 1;
+    } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      frameLimit = atoi(argv[++i]);
+      if (frameLimit < 1) {
+        fprintf(stderr, "Invalid frame count: %s\n", argv[i]);
+        return 1;
+      }
     } else {
-      cells[i].state = 1;
+      fprintf(stderr,
+              "Usage: %s [--engine NAME] [--kernel scalar|sse2|avx2] "
+              "[--threads N | --procs N]\n"
+              "          [--pattern FILE] [--rule RULE] "
+              "[--boundary dead|torus|mirror]\n"
+              "          [--history MIB] [--metrics FILE.csv|FILE.json] "
+              "[--size WxH] [--seed S]\n"
+              "          [--record FILE.y4m|FILE.ppm] [--offscreen] "
+              "[--frames N]\n"
+              "Engines: cells, bytes, threads, tiles, sparse, hashlife, "
+              "procs\n"
+              "Benchmarks and checks live in gol-headless.out.\n",
+              argv[0]);
+      return 1;
     }
   }
-}
 
-void initializeCells(struct Cell *cells, int rows, int cols) {
-  for (int y = 0; y < rows; y++) {
-    for (int x = 0; x < cols; x++) {
-      cells[y * cols + x].x = x;
-      cells[y * cols + x].y = y;
+  // A pattern runs under the rule its file names, unless --rule overrides
+  // it
+  struct LifeRule fileRule;
+  if (patternPath != NULL && !ruleGiven) {
+    if (patternRule(patternPath, &rule) != 0)
+      return 1;
+  } else if (patternPath != NULL && patternRule(patternPath, &fileRule) == 0 &&
+             strcmp(fileRule.name, rule.name) != 0) {
+    fprintf(stderr, "%s is for %s, running it as %s as --rule says\n",
+            patternPath, fileRule.name, rule.name);
+  }
+  if (!engineSupportsRule(engine, &rule)) {
+    fprintf(stderr, "The %s engine can't run %s\n", engineName(engine),
+            rule.name);
+    return 1;
+  }
+  if (!engineSupportsBoundary(engine, &rule, boundary)) {
+    fprintf(stderr, "The %s engine can't run %s with a %s boundary\n",
+            engineName(engine), rule.name, lifeBoundaryName(boundary));
+    return 1;
+  }
+  lifeSetRule(&rule);
 
-      int r = rand() % 2 == 0 ? 0 : 255;
-      int g = rand() % 2 == 0 ? 0 : 255;
-      int b = rand() % 2 == 0 ? 0 : 255;
+  struct World world;
+  if (initializeWorld(&world, rows, cols, engine, threads) != 0) {
+    fprintf(stderr, "Failed to set up the world.\n");
+    return 1;
+  }
+  lifeGridSetBoundary(&world.grid, boundary);
 
-      cells[y * cols + x].color = (SDL_Color){r, g, b, 1};
+  // RLE or plaintext, centered in the world
+  if (patternPath != NULL) {
+    if (patternLoadGrid(patternPath, &world.grid) != 0) {
+      freeWorld(&world);
+      return 1;
     }
+    touchWorld(&world);
+  }
+
+  // Settled soups are replayed from their period instead of stepped. The
+  // unbounded engines skip it, their grid is only a window on the world,
+  // and so do the worker processes, which would gather every generation.
+  if (engineStepsGrid(engine) && stepperDetectCycles(&world.stepper) != 0) {
+    fprintf(stderr, "Failed to set up cycle detection.\n");
+    freeWorld(&world);
+    return 1;
   }
-}
 
-int main(void) {
-  if (init() != 0)
+  // SDL's dummy driver gives a window surface in memory and nothing on
+  // screen
+  if (offscreen) {
+    SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+    if (frameLimit == 0)
+      frameLimit = OFFSCREEN_FRAMES;
+  }
+
+  if (init() != 0) {
+    freeWorld(&world);
     return 1;
+  }
 
   SDL_Window *win = SDL_CreateWindow("Game of Life", SDL_WINDOWPOS_CENTERED,
                                      SDL_WINDOWPOS_CENTERED, SCREEN_WIDTH,
@@ -272,23 +859,76 @@ int main(void) {
 
   if (win == NULL) {
     fprintf(stderr, "SDL_CreateWindow Error: %s\n", SDL_GetError());
-    cleanup(win, NULL);
+    cleanup(win, &world);
     return 1;
   }
 
   SDL_Surface *screen = SDL_GetWindowSurface(win);
   if (screen == NULL) {
     fprintf(stderr, "SDL_GetWindowSurface Error: %s\n", SDL_GetError());
-    cleanup(win, NULL);
+    cleanup(win, &world);
     return 1;
   }
 
-  int rows = SCREEN_HEIGHT / CELL_SIZE;
-  int cols = SCREEN_WIDTH / CELL_SIZE;
-  printf("Rows: %d, Cols: %d\n", rows, cols);
-  struct Cell *cells = malloc(rows * cols * sizeof(struct Cell));
-  struct Cell *nextCells = malloc(rows * cols * sizeof(struct Cell));
-  initializeCells(cells, rows, cols);
+  // Closest zoom that shows the whole world, the default one comes out at
+  // CELL_SIZE
+  struct Viewport view = {0, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT};
+  viewportFit(&view, rows, cols);
+  int viewChanged = 0;
+
+  printf("Rows: %d, Cols: %d, zoom %d\n", rows, cols, view.zoom);
+  printf("Engine: %s (%s kernel), rule %s, %s boundary\n",
+         engineName(engine), lifeKernelName(lifeGetKernel()), rule.name,
+         lifeBoundaryName(boundary));
+
+  struct FrameDump dump;
+  if (recordPath != NULL &&
+      (screen->format->BytesPerPixel != 4 ||
+       frameDumpOpen(&dump, recordPath, screen->w, screen->h, RECORD_FPS,
+                     screen->format->Rmask, screen->format->Gmask,
+                     screen->format->Bmask) != 0)) {
+    fprintf(stderr, "Failed to start recording to %s\n", recordPath);
+    cleanup(win, &world);
+    return 1;
+  }
+
+  struct Renderer renderer;
+  if (initRenderer(&renderer, screen) != 0) {
+    fprintf(stderr, "Failed to set up the renderer.\n");
+    if (recordPath != NULL)
+      frameDumpClose(&dump);
+    cleanup(win, &world);
+    return 1;
+  }
+
+  struct Metrics metrics;
+  if (metricsInit(&metrics, rows, cols) != 0) {
+    fprintf(stderr, "Failed to set up the metrics.\n");
+    if (recordPath != NULL)
+      frameDumpClose(&dump);
+    freeRenderer(&renderer);
+    cleanup(win, &world);
+    return 1;
+  }
+
+  struct Simulation sim;
+  if (startSimulation(&sim, &world, &view, (size_t)historyMegabytes << 20,
+                      seed, &metrics) != 0) {
+    fprintf(stderr, "Failed to start the simulation thread.\n");
+    if (recordPath != NULL)
+      frameDumpClose(&dump);
+    metricsFree(&metrics);
+    freeRenderer(&renderer);
+    cleanup(win, &world);
+    return 1;
+  }
+
+  // Frames are drawn at the display rate, whatever the simulation does
+  SDL_DisplayMode mode;
+  int refreshRate = 60;
+  if (SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(win), &mode) == 0 &&
+      mode.refresh_rate > 0)
+    refreshRate = mode.refresh_rate;
 
   SDL_Event e;
   int exitTrigger = 0;
@@ -296,12 +936,27 @@ int main(void) {
   int speedDef = 1000;
   int speedDivisor = 100;
   int toggleColor = 0;
+  // Something recorded or run offscreen should move from the start
+  if (recordPath != NULL || offscreen) {
+    pause = 0;
+    sendCommand(&sim, COMMAND_RESUME, 0, 0);
+  }
 
-  int generationCounter = 0;
-  int lastGeneration = 0;
+  uint64_t shownGeneration = 0;
+  int shownPeriod = 0;
+  uint64_t lastGeneration = 0;
+  double lastStepSeconds = 0;
 
   time_t startTime = time(NULL);
 
+  // Draw and present times since the last report
+  double frequency = SDL_GetPerformanceFrequency();
+  Uint64 drawTicks = 0;
+  Uint64 presentTicks = 0;
+  int frames = 0;
+  int totalFrames = 0;
+  Uint64 firstFrame = SDL_GetPerformanceCounter();
+
   while (!exitTrigger) {
     while (SDL_PollEvent(&e)) {
       if (e.type == SDL_QUIT) {
@@ -317,19 +972,31 @@ int main(void) {
         // Toggle pause
         case SDLK_SPACE:
           pause = !pause;
+          sendCommand(&sim, pause ? COMMAND_PAUSE : COMMAND_RESUME, 0, 0);
           break;
 
         // Next generation
         case SDLK_RIGHT:
-          nextCells = nextGeneration(cells, rows, cols);
-          for (int i = 0; i < rows * cols; i++) {
-            cells[i] = nextCells[i];
+          sendCommand(&sim, COMMAND_STEP, 0, 0);
+          break;
+
+        // Back through the history, pausing first so it stays there
+        case SDLK_LEFT:
+        case SDLK_PAGEUP:
+        case SDLK_PAGEDOWN:
+          if (!pause) {
+            pause = 1;
+            sendCommand(&sim, COMMAND_PAUSE, 0, 0);
           }
-          free(nextCells);
+          sendCommand(&sim, COMMAND_SEEK,
+                      e.key.keysym.sym == SDLK_LEFT     ? -1
+                      : e.key.keysym.sym == SDLK_PAGEUP ? -SCRUB_GENERATIONS
+                                                        : SCRUB_GENERATIONS,
+                      0);
           break;
 
         case SDLK_r:
-          randomizeCells(cells, rows, cols);
+          sendCommand(&sim, COMMAND_RANDOMIZE, 0, 0);
           break;
 
         case SDLK_UP:
@@ -351,16 +1018,68 @@ int main(void) {
           break;
 
         case SDLK_c:
-          clearCells(cells);
+          sendCommand(&sim, COMMAND_CLEAR, 0, 0);
+          break;
+
+        case SDLK_s:
+          sendCommand(&sim, COMMAND_SAVE, 0, 0);
+          break;
+
+        // Dump what was measured so far, the simulation keeps going
+        case SDLK_m:
+          if (METRICS_ENABLED)
+            metricsWrite(&metrics, metricsPath);
+          else
+            printf("Metrics are off, build with make METRICS=1\n");
+          break;
+
+        // Jump ahead 2^JUMP_LOG generations
+        case SDLK_j:
+          sendCommand(&sim, COMMAND_JUMP, 0, 0);
+          break;
+
+        // Zoom around the middle of the window, home fits the world back
+        case SDLK_EQUALS:
+        case SDLK_PLUS:
+        case SDLK_MINUS:
+          viewportZoom(&view, e.key.keysym.sym == SDLK_MINUS ? -1 : 1,
+                       SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2);
+          viewChanged = 1;
+          break;
+
+        case SDLK_HOME:
+          viewportFit(&view, rows, cols);
+          viewChanged = 1;
           break;
         }
       }
 
+      // The wheel zooms around the pointer, dragging with the middle button
+      // pans
+      if (e.type == SDL_MOUSEWHEEL && e.wheel.y != 0) {
+        int mouseX, mouseY;
+        SDL_GetMouseState(&mouseX, &mouseY);
+        viewportZoom(&view, e.wheel.y > 0 ? 1 : -1, mouseX, mouseY);
+        viewChanged = 1;
+      }
+
+      if (e.type == SDL_MOUSEMOTION && (e.motion.state & SDL_BUTTON_MMASK)) {
+        viewportPan(&view, -e.motion.xrel, -e.motion.yrel);
+        viewChanged = 1;
+      }
+
+      // Motion comes in far more often than frames, so the viewport is sent
+      // once per frame, and before a click that has to map through it
+      if (viewChanged && e.type == SDL_MOUSEBUTTONDOWN) {
+        sendView(&sim, &view);
+        viewChanged = 0;
+      }
+
       if (e.type == SDL_MOUSEBUTTONDOWN) {
         if (e.button.button == SDL_BUTTON_LEFT) {
-          toggleCellState(cells, e.button.x, e.button.y);
+          sendCommand(&sim, COMMAND_TOGGLE, e.button.x, e.button.y);
         } else if (e.button.button == SDL_BUTTON_RIGHT) {
-          showNeighbors(cells, e.button.x, e.button.y, rows, cols);
+          showNeighbors(&world, &view, e.button.x, e.button.y);
         }
       }
     }
@@ -368,32 +1087,99 @@ int main(void) {
     if (exitTrigger)
       break;
 
-    if (!pause) {
-      // Print generations per second
-      if (time(NULL) - startTime >= 1) {
-        printf("Generation: %d, Generations per second: %d\n",
-               generationCounter, generationCounter - lastGeneration);
-        lastGeneration = generationCounter;
-        startTime = time(NULL);
-      }
-      nextCells = nextGeneration(cells, rows, cols);
-      generationCounter++;
-      for (int i = 0; i < rows * cols; i++) {
-        cells[i] = nextCells[i];
+    if (viewChanged) {
+      sendView(&sim, &view);
+      viewChanged = 0;
+    }
+
+    struct LifeFrame *frame = tripleAcquire(&sim.frames);
+    if (frame->generation != shownGeneration) {
+      clearHighlights(&world);
+      shownGeneration = frame->generation;
+    }
+
+    // The title says when the world has settled into a cycle
+    if (frame->period != shownPeriod) {
+      char title[64];
+      if (frame->period > 0)
+        snprintf(title, sizeof(title), "Game of Life (settled, period %d)",
+                 frame->period);
+      else
+        snprintf(title, sizeof(title), "Game of Life");
+      SDL_SetWindowTitle(win, title);
+      shownPeriod = frame->period;
+    }
+
+    // Print generations per second
+    if (time(NULL) - startTime >= 1) {
+      uint64_t generations = frame->generation - lastGeneration;
+      if (!pause) {
+        printf("Generation: %llu, Generations per second: %llu",
+               (unsigned long long)frame->generation,
+               (unsigned long long)generations);
+        if (engine == ENGINE_TILES)
+          printf(", Active tiles: %d", frame->activeTiles);
+        if (engine == ENGINE_SPARSE)
+          printf(", Chunks: %d", frame->chunkCount);
+        if (frame->period > 0)
+          printf(", Replaying period %d", frame->period);
+        printf("\nStep: %.3f ms/gen, Draw: %.3f ms/frame "
+               "(%d cells last frame), Present: %.3f ms/frame\n",
+               generations > 0 ? (frame->stepSeconds - lastStepSeconds) *
+                                     1000 / generations
+                               : 0,
+               frames > 0 ? drawTicks * 1000 / frequency / frames : 0,
+               renderer.cellsDrawn,
+               frames > 0 ? presentTicks * 1000 / frequency / frames : 0);
       }
-      free(nextCells);
+      lastGeneration = frame->generation;
+      lastStepSeconds = frame->stepSeconds;
+      startTime = time(NULL);
+      drawTicks = 0;
+      presentTicks = 0;
+      frames = 0;
     }
 
-    drawCells(screen, cells, toggleColor);
+    Uint64 start = SDL_GetPerformanceCounter();
+    drawCells(&renderer, &world, frame, toggleColor);
+    Uint64 drawn = SDL_GetPerformanceCounter();
     SDL_UpdateWindowSurface(win);
+    Uint64 presented = SDL_GetPerformanceCounter();
+    drawTicks += drawn - start;
+    presentTicks += presented - drawn;
+    frames++;
+    metricsFrame(&metrics, frame->generation,
+                 (drawn - start) * 1e9 / frequency,
+                 (presented - drawn) * 1e9 / frequency, renderer.cellsDrawn);
+
+    if (recordPath != NULL)
+      captureFrame(&dump, screen, offscreen);
+    totalFrames++;
+    if (frameLimit > 0 && totalFrames >= frameLimit)
+      exitTrigger = 1;
+
+    if (!offscreen)
+      SDL_Delay(1000 / refreshRate);
+  }
 
-    if (pause) {
-      SDL_Delay(1000 / 120);
-    } else {
-      SDL_Delay(0);
-    }
+  double seconds = (SDL_GetPerformanceCounter() - firstFrame) / frequency;
+  printf("%d frames in %.2f s: %.1f fps\n", totalFrames, seconds,
+         totalFrames / seconds);
+  int result = 0;
+  if (recordPath != NULL) {
+    long long dropped = dump.dropped;
+    result = frameDumpClose(&dump) != 0;
+    if (result)
+      fprintf(stderr, "Failed to write the recording.\n");
+    else
+      printf("Recorded %lld frames, %lld dropped\n", dump.written, dropped);
   }
 
-  cleanup(win, cells);
-  return 0;
+  stopSimulation(&sim);
+  if (METRICS_ENABLED)
+    metricsWrite(&metrics, metricsPath);
+  metricsFree(&metrics);
+  freeRenderer(&renderer);
+  cleanup(win, &world);
+  return result;
 }
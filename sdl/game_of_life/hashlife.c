@@ -0,0 +1,559 @@
+#include "hashlife.h"
+#include "rule.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HL_BLOCK_NODES 4096
+#define HL_MIN_LEVEL 3
+
+// The two level 0 nodes are shared by every universe and never collected
+static struct HLNode deadCell = {.population = 0};
+static struct HLNode aliveCell = {.population = 1};
+
+static size_t hashChildren(struct HLNode *nw, struct HLNode *ne,
+                           struct HLNode *sw, struct HLNode *se) {
+  uint64_t h = (uintptr_t)nw;
+  h = h * 0x100000001b3ull ^ (uintptr_t)ne;
+  h = h * 0x100000001b3ull ^ (uintptr_t)sw;
+  h = h * 0x100000001b3ull ^ (uintptr_t)se;
+  h ^= h >> 31;
+  h *= 0xbf58476d1ce4e5b9ull;
+  h ^= h >> 29;
+  return (size_t)h;
+}
+
+int hashLifeInit(struct HashLife *hl, size_t memoryBudget) {
+  memset(hl, 0, sizeof(struct HashLife));
+  hl->tableSize = 1 << 16;
+  hl->table = calloc(hl->tableSize, sizeof(struct HLNode *));
+  if (hl->table == NULL)
+    return -1;
+
+  hl->memoryBudget = memoryBudget;
+  hl->collectAt = memoryBudget;
+  hl->blockUsed = HL_BLOCK_NODES;
+  memcpy(hl->rule, lifeGetRule()->table, sizeof(hl->rule));
+  return 0;
+}
+
+void hashLifeFree(struct HashLife *hl) {
+  for (int i = 0; i < hl->blockCount; i++) {
+    free(hl->blocks[i]);
+  }
+
+  free(hl->blocks);
+  free(hl->table);
+  memset(hl, 0, sizeof(struct HashLife));
+}
+
+static struct HLNode *allocNode(struct HashLife *hl) {
+  if (hl->freeList != NULL) {
+    struct HLNode *node = hl->freeList;
+    hl->freeList = node->next;
+    return node;
+  }
+
+  if (hl->blockUsed == HL_BLOCK_NODES) {
+    struct HLNode **blocks =
+        realloc(hl->blocks, (hl->blockCount + 1) * sizeof(struct HLNode *));
+    struct HLNode *block = malloc(HL_BLOCK_NODES * sizeof(struct HLNode));
+    if (blocks == NULL || block == NULL) {
+      fprintf(stderr, "Out of memory for HashLife nodes.\n");
+      exit(1);
+    }
+
+    hl->blocks = blocks;
+    hl->blocks[hl->blockCount++] = block;
+    hl->blockUsed = 0;
+  }
+
+  return &hl->blocks[hl->blockCount - 1][hl->blockUsed++];
+}
+
+static void growTable(struct HashLife *hl) {
+  size_t newSize = hl->tableSize * 2;
+  struct HLNode **newTable = calloc(newSize, sizeof(struct HLNode *));
+  if (newTable == NULL)
+    return;
+
+  for (size_t i = 0; i < hl->tableSize; i++) {
+    struct HLNode *node = hl->table[i];
+    while (node != NULL) {
+      struct HLNode *next = node->next;
+      size_t index =
+          hashChildren(node->nw, node->ne, node->sw, node->se) & (newSize - 1);
+      node->next = newTable[index];
+      newTable[index] = node;
+      node = next;
+    }
+  }
+
+  free(hl->table);
+  hl->table = newTable;
+  hl->tableSize = newSize;
+}
+
+// Keeps a node through collections until the caller resets keptCount
+static struct HLNode *keep(struct HashLife *hl, struct HLNode *node) {
+  hl->kept[hl->keptCount++] = node;
+  return node;
+}
+
+// Returns the canonical node with these four children
+static struct HLNode *findNode(struct HashLife *hl, struct HLNode *nw,
+                               struct HLNode *ne, struct HLNode *sw,
+                               struct HLNode *se) {
+  size_t index = hashChildren(nw, ne, sw, se) & (hl->tableSize - 1);
+  for (struct HLNode *node = hl->table[index]; node != NULL;
+       node = node->next) {
+    if (node->nw == nw && node->ne == ne && node->sw == sw && node->se == se)
+      return node;
+  }
+
+  // A large jump can make more nodes than the budget on its own. The caller
+  // still needs the four children, which aren't in the tree yet.
+  if (hl->stepping && hashLifeMemory(hl) > hl->collectAt) {
+    int kept = hl->keptCount;
+    keep(hl, nw);
+    keep(hl, ne);
+    keep(hl, sw);
+    keep(hl, se);
+    hashLifeCollect(hl);
+    hl->keptCount = kept;
+  }
+
+  struct HLNode *node = allocNode(hl);
+  node->nw = nw;
+  node->ne = ne;
+  node->sw = sw;
+  node->se = se;
+  node->result = NULL;
+  node->stepResult = NULL;
+  node->stepLog = -1;
+  node->marked = 0;
+  node->level = nw->level + 1;
+  node->population =
+      nw->population + ne->population + sw->population + se->population;
+
+  node->next = hl->table[index];
+  hl->table[index] = node;
+  hl->nodeCount++;
+
+  if (hl->nodeCount > hl->tableSize)
+    growTable(hl);
+
+  return node;
+}
+
+static struct HLNode *emptyNode(struct HashLife *hl, int level) {
+  if (level == 0)
+    return &deadCell;
+
+  if (hl->empty[level] == NULL) {
+    struct HLNode *child = emptyNode(hl, level - 1);
+    hl->empty[level] = findNode(hl, child, child, child, child);
+  }
+
+  return hl->empty[level];
+}
+
+// Center half of a node, at the same generation
+static struct HLNode *centered(struct HashLife *hl, struct HLNode *node) {
+  return findNode(hl, node->nw->se, node->ne->sw, node->sw->ne, node->se->nw);
+}
+
+static struct HLNode *centeredHorizontal(struct HashLife *hl,
+                                         struct HLNode *w, struct HLNode *e) {
+  return findNode(hl, w->ne, e->nw, w->se, e->sw);
+}
+
+static struct HLNode *centeredVertical(struct HashLife *hl, struct HLNode *n,
+                                       struct HLNode *s) {
+  return findNode(hl, n->sw, n->se, s->nw, s->ne);
+}
+
+// 4x4 node: brute force one generation of the center 2x2
+static struct HLNode *baseResult(struct HashLife *hl, struct HLNode *node) {
+  int cells[4][4];
+  struct HLNode *quads[2][2] = {{node->nw, node->ne}, {node->sw, node->se}};
+
+  for (int qy = 0; qy < 2; qy++) {
+    for (int qx = 0; qx < 2; qx++) {
+      struct HLNode *q = quads[qy][qx];
+      cells[qy * 2][qx * 2] = q->nw->population != 0;
+      cells[qy * 2][qx * 2 + 1] = q->ne->population != 0;
+      cells[qy * 2 + 1][qx * 2] = q->sw->population != 0;
+      cells[qy * 2 + 1][qx * 2 + 1] = q->se->population != 0;
+    }
+  }
+
+  struct HLNode *out[2][2];
+  for (int y = 1; y <= 2; y++) {
+    for (int x = 1; x <= 2; x++) {
+      int n = 0;
+      for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+          if (dy != 0 || dx != 0)
+            n += cells[y + dy][x + dx];
+        }
+      }
+
+      int alive = hl->rule[cells[y][x] * 9 + n];
+      out[y - 1][x - 1] = alive ? &aliveCell : &deadCell;
+    }
+  }
+
+  return findNode(hl, out[0][0], out[0][1], out[1][0], out[1][1]);
+}
+
+static struct HLNode *advance(struct HashLife *hl, struct HLNode *node,
+                              int stepLog);
+
+// RESULT: center half of the node, 2^(level-2) generations later. Every
+// node held across a call that can make nodes is kept, as a collection may
+// run in the middle.
+static struct HLNode *fullResult(struct HashLife *hl, struct HLNode *node) {
+  if (node->result != NULL)
+    return node->result;
+
+  int kept = hl->keptCount;
+  keep(hl, node);
+  if (node->population == 0) {
+    node->result = emptyNode(hl, node->level - 1);
+  } else if (node->level == 2) {
+    node->result = baseResult(hl, node);
+  } else {
+    // Nine overlapping sub-squares, each advanced by half the step
+    struct HLNode *n00 = keep(hl, fullResult(hl, node->nw));
+    struct HLNode *n01 = keep(
+        hl, fullResult(hl, centeredHorizontal(hl, node->nw, node->ne)));
+    struct HLNode *n02 = keep(hl, fullResult(hl, node->ne));
+    struct HLNode *n10 =
+        keep(hl, fullResult(hl, centeredVertical(hl, node->nw, node->sw)));
+    struct HLNode *n11 = keep(hl, fullResult(hl, centered(hl, node)));
+    struct HLNode *n12 =
+        keep(hl, fullResult(hl, centeredVertical(hl, node->ne, node->se)));
+    struct HLNode *n20 = keep(hl, fullResult(hl, node->sw));
+    struct HLNode *n21 = keep(
+        hl, fullResult(hl, centeredHorizontal(hl, node->sw, node->se)));
+    struct HLNode *n22 = keep(hl, fullResult(hl, node->se));
+
+    // ... and the second half of the step on the four combined squares
+    struct HLNode *nw =
+        keep(hl, fullResult(hl, findNode(hl, n00, n01, n10, n11)));
+    struct HLNode *ne =
+        keep(hl, fullResult(hl, findNode(hl, n01, n02, n11, n12)));
+    struct HLNode *sw =
+        keep(hl, fullResult(hl, findNode(hl, n10, n11, n20, n21)));
+    struct HLNode *se = fullResult(hl, findNode(hl, n11, n12, n21, n22));
+    node->result = findNode(hl, nw, ne, sw, se);
+  }
+
+  hl->keptCount = kept;
+  return node->result;
+}
+
+// Center half of the node, 2^stepLog generations later (stepLog <= level-2)
+static struct HLNode *advance(struct HashLife *hl, struct HLNode *node,
+                              int stepLog) {
+  if (stepLog == node->level - 2)
+    return fullResult(hl, node);
+
+  if (node->stepLog == stepLog && node->stepResult != NULL)
+    return node->stepResult;
+
+  if (node->population == 0)
+    return emptyNode(hl, node->level - 1);
+
+  // Same nine sub-squares, but only moved to the center without stepping
+  int kept = hl->keptCount;
+  keep(hl, node);
+  struct HLNode *n00 = keep(hl, centered(hl, node->nw));
+  struct HLNode *n01 =
+      keep(hl, centered(hl, centeredHorizontal(hl, node->nw, node->ne)));
+  struct HLNode *n02 = keep(hl, centered(hl, node->ne));
+  struct HLNode *n10 =
+      keep(hl, centered(hl, centeredVertical(hl, node->nw, node->sw)));
+  struct HLNode *n11 = keep(hl, centered(hl, centered(hl, node)));
+  struct HLNode *n12 =
+      keep(hl, centered(hl, centeredVertical(hl, node->ne, node->se)));
+  struct HLNode *n20 = keep(hl, centered(hl, node->sw));
+  struct HLNode *n21 =
+      keep(hl, centered(hl, centeredHorizontal(hl, node->sw, node->se)));
+  struct HLNode *n22 = keep(hl, centered(hl, node->se));
+
+  struct HLNode *nw =
+      keep(hl, advance(hl, findNode(hl, n00, n01, n10, n11), stepLog));
+  struct HLNode *ne =
+      keep(hl, advance(hl, findNode(hl, n01, n02, n11, n12), stepLog));
+  struct HLNode *sw =
+      keep(hl, advance(hl, findNode(hl, n10, n11, n20, n21), stepLog));
+  struct HLNode *se = advance(hl, findNode(hl, n11, n12, n21, n22), stepLog);
+  node->stepResult = findNode(hl, nw, ne, sw, se);
+  node->stepLog = stepLog;
+
+  hl->keptCount = kept;
+  return node->stepResult;
+}
+
+static struct HLNode *buildFromGrid(struct HashLife *hl, struct LifeGrid *grid,
+                                    int level, int y, int x) {
+  if (y >= grid->rows || x >= grid->cols)
+    return emptyNode(hl, level);
+
+  if (level == 0)
+    return *lifeCell(grid, y, x) ? &aliveCell : &deadCell;
+
+  int half = 1 << (level - 1);
+  return findNode(hl, buildFromGrid(hl, grid, level - 1, y, x),
+                  buildFromGrid(hl, grid, level - 1, y, x + half),
+                  buildFromGrid(hl, grid, level - 1, y + half, x),
+                  buildFromGrid(hl, grid, level - 1, y + half, x + half));
+}
+
+void hashLifeFromGrid(struct HashLife *hl, struct LifeGrid *grid) {
+  int level = HL_MIN_LEVEL;
+  while ((1 << level) < grid->rows || (1 << level) < grid->cols) {
+    level++;
+  }
+
+  hl->root = buildFromGrid(hl, grid, level, 0, 0);
+  hl->originX = 0;
+  hl->originY = 0;
+  hl->generation = 0;
+}
+
+static void writeToGrid(struct HLNode *node, struct LifeGrid *grid,
+                        int64_t y, int64_t x) {
+  int64_t size = (int64_t)1 << node->level;
+  if (node->population == 0 || y >= grid->rows || x >= grid->cols ||
+      y + size <= 0 || x + size <= 0)
+    return;
+
+  if (node->level == 0) {
+    *lifeCell(grid, (int)y, (int)x) = 1;
+    return;
+  }
+
+  int64_t half = size / 2;
+  writeToGrid(node->nw, grid, y, x);
+  writeToGrid(node->ne, grid, y, x + half);
+  writeToGrid(node->sw, grid, y + half, x);
+  writeToGrid(node->se, grid, y + half, x + half);
+}
+
+void hashLifeToGrid(struct HashLife *hl, struct LifeGrid *grid, int64_t y,
+                    int64_t x) {
+  lifeGridClear(grid);
+  if (hl->root != NULL)
+    writeToGrid(hl->root, grid, hl->originY - y, hl->originX - x);
+}
+
+// Grows the root one level, keeping the old root in the middle. Returns -1
+// once the root is as large as it gets.
+static int expand(struct HashLife *hl) {
+  struct HLNode *root = hl->root;
+  if (root->level >= HASHLIFE_MAX_LEVEL)
+    return -1;
+
+  struct HLNode *empty = emptyNode(hl, root->level - 1);
+
+  hl->root = findNode(hl, findNode(hl, empty, empty, empty, root->nw),
+                      findNode(hl, empty, empty, root->ne, empty),
+                      findNode(hl, empty, root->sw, empty, empty),
+                      findNode(hl, root->se, empty, empty, empty));
+
+  int64_t quarter = (int64_t)1 << (root->level - 1);
+  hl->originX -= quarter;
+  hl->originY -= quarter;
+  return 0;
+}
+
+static int contains(struct HashLife *hl, int64_t y, int64_t x) {
+  int64_t size = (int64_t)1 << hl->root->level;
+  return y >= hl->originY && y < hl->originY + size && x >= hl->originX &&
+         x < hl->originX + size;
+}
+
+static void ensureRoot(struct HashLife *hl) {
+  if (hl->root == NULL)
+    hl->root = emptyNode(hl, HL_MIN_LEVEL);
+}
+
+int hashLifeGetCell(struct HashLife *hl, int64_t y, int64_t x) {
+  if (hl->root == NULL || !contains(hl, y, x))
+    return 0;
+
+  struct HLNode *node = hl->root;
+  y -= hl->originY;
+  x -= hl->originX;
+  while (node->level > 0) {
+    int64_t half = (int64_t)1 << (node->level - 1);
+    int south = y >= half;
+    int east = x >= half;
+    if (south) {
+      node = east ? node->se : node->sw;
+      y -= half;
+    } else {
+      node = east ? node->ne : node->nw;
+    }
+    if (east)
+      x -= half;
+  }
+
+  return node->population != 0;
+}
+
+static struct HLNode *setCell(struct HashLife *hl, struct HLNode *node,
+                              int64_t y, int64_t x, int alive) {
+  if (node->level == 0)
+    return alive ? &aliveCell : &deadCell;
+
+  int64_t half = (int64_t)1 << (node->level - 1);
+  struct HLNode *nw = node->nw, *ne = node->ne, *sw = node->sw,
+                *se = node->se;
+  if (y < half && x < half) {
+    nw = setCell(hl, nw, y, x, alive);
+  } else if (y < half) {
+    ne = setCell(hl, ne, y, x - half, alive);
+  } else if (x < half) {
+    sw = setCell(hl, sw, y - half, x, alive);
+  } else {
+    se = setCell(hl, se, y - half, x - half, alive);
+  }
+
+  return findNode(hl, nw, ne, sw, se);
+}
+
+void hashLifeSetCell(struct HashLife *hl, int64_t y, int64_t x, int alive) {
+  ensureRoot(hl);
+  while (!contains(hl, y, x)) {
+    if (expand(hl) != 0)
+      return;
+  }
+
+  hl->root = setCell(hl, hl->root, y - hl->originY, x - hl->originX, alive);
+}
+
+// True when every live cell is in the middle quarter of the root, so a step
+// of up to 2^(level-3) generations cannot reach past the root's result
+static int isPadded(struct HashLife *hl) {
+  return centered(hl, centered(hl, hl->root))->population ==
+         hl->root->population;
+}
+
+static int stepPowerOfTwo(struct HashLife *hl, int stepLog) {
+  while (hl->root->level < stepLog + 3 || !isPadded(hl)) {
+    if (expand(hl) != 0)
+      return -1;
+  }
+
+  int64_t quarter = (int64_t)1 << (hl->root->level - 2);
+  hl->stepping = 1;
+  hl->root = advance(hl, hl->root, stepLog);
+  hl->stepping = 0;
+  hl->originX += quarter;
+  hl->originY += quarter;
+  hl->generation += (uint64_t)1 << stepLog;
+  return 0;
+}
+
+static int collectAndStep(struct HashLife *hl, int stepLog) {
+  if (hashLifeMemory(hl) > hl->memoryBudget)
+    hashLifeCollect(hl);
+
+  return stepPowerOfTwo(hl, stepLog);
+}
+
+int hashLifeStep(struct HashLife *hl, uint64_t generations) {
+  ensureRoot(hl);
+
+  const int maxStepLog = HASHLIFE_MAX_LEVEL - 3;
+  int stepLog = 0;
+  for (; stepLog < maxStepLog && generations != 0;
+       stepLog++, generations >>= 1) {
+    if ((generations & 1) && collectAndStep(hl, stepLog) != 0)
+      return -1;
+  }
+
+  // What is left counts the largest jumps
+  for (; generations != 0; generations--) {
+    if (collectAndStep(hl, maxStepLog) != 0)
+      return -1;
+  }
+  return 0;
+}
+
+uint64_t hashLifePopulation(struct HashLife *hl) {
+  return hl->root == NULL ? 0 : hl->root->population;
+}
+
+size_t hashLifeMemory(struct HashLife *hl) {
+  return hl->nodeCount * sizeof(struct HLNode) +
+         hl->tableSize * sizeof(struct HLNode *);
+}
+
+static void mark(struct HLNode *node) {
+  while (node != NULL && node->level > 0 && !node->marked) {
+    node->marked = 1;
+    mark(node->nw);
+    mark(node->ne);
+    mark(node->sw);
+    node = node->se;
+  }
+}
+
+static int isLive(struct HLNode *node) {
+  return node == NULL || node->level == 0 || node->marked;
+}
+
+// Mark and sweep. Only the root, the empty nodes and the nodes a step in
+// progress keeps are kept alive; cached results of survivors are kept when
+// the result survived as well.
+void hashLifeCollect(struct HashLife *hl) {
+  mark(hl->root);
+  for (int i = 0; i < hl->keptCount; i++) {
+    mark(hl->kept[i]);
+  }
+  for (int level = 1; level <= HASHLIFE_MAX_LEVEL; level++) {
+    mark(hl->empty[level]);
+  }
+
+  for (size_t i = 0; i < hl->tableSize; i++) {
+    for (struct HLNode *node = hl->table[i]; node != NULL; node = node->next) {
+      if (!node->marked)
+        continue;
+
+      if (!isLive(node->result))
+        node->result = NULL;
+      if (!isLive(node->stepResult))
+        node->stepResult = NULL;
+    }
+  }
+
+  for (size_t i = 0; i < hl->tableSize; i++) {
+    struct HLNode **link = &hl->table[i];
+    while (*link != NULL) {
+      struct HLNode *node = *link;
+      if (node->marked) {
+        node->marked = 0;
+        link = &node->next;
+        continue;
+      }
+
+      *link = node->next;
+      node->next = hl->freeList;
+      hl->freeList = node;
+      hl->nodeCount--;
+    }
+  }
+
+  // A live set near the budget would otherwise collect on every new node
+  size_t live = hashLifeMemory(hl);
+  hl->collectAt = live + hl->memoryBudget / 2 > hl->memoryBudget
+                      ? live + hl->memoryBudget / 2
+                      : hl->memoryBudget;
+  hl->collections++;
+}
@@ -0,0 +1,89 @@
+#ifndef HASHLIFE_H
+#define HASHLIFE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "life.h"
+
+// Quadtree node. Level 0 nodes are single cells, a level n node covers
+// 2^n x 2^n cells. Nodes are hash-consed, so equal subtrees are shared and
+// a node can be compared by pointer.
+struct HLNode {
+  struct HLNode *nw, *ne, *sw, *se;
+  // Center 2^(level-1) square, 2^(level-2) generations later
+  struct HLNode *result;
+  // Same, but only 2^stepLog generations later
+  struct HLNode *stepResult;
+  struct HLNode *next;
+  uint64_t population;
+  int level;
+  int stepLog;
+  int marked;
+};
+
+// Largest root. World coordinates stay in int64_t with room to spare, and a
+// single jump is at most 2^(HASHLIFE_MAX_LEVEL - 3) generations.
+#define HASHLIFE_MAX_LEVEL 60
+// Nodes a step in progress holds on to: each level of the recursion holds
+// at most 13, and a node being made its four children
+#define HASHLIFE_KEPT (16 * (HASHLIFE_MAX_LEVEL + 1))
+
+struct HashLife {
+  struct HLNode **table;
+  size_t tableSize;
+  size_t nodeCount;
+
+  // Nodes are handed out from blocks and recycled through a free list
+  struct HLNode **blocks;
+  int blockCount;
+  int blockUsed;
+  struct HLNode *freeList;
+
+  // Canonical empty node of every level, built on demand
+  struct HLNode *empty[HASHLIFE_MAX_LEVEL + 1];
+
+  // Garbage collection kicks in once the nodes take up more than this many
+  // bytes: between steps, and inside a step at collectAt, which stays at
+  // least half a budget above what the last collection kept
+  size_t memoryBudget;
+  size_t collectAt;
+  int collections;
+
+  // Nodes a collection inside a step must keep besides the root
+  struct HLNode *kept[HASHLIFE_KEPT];
+  int keptCount;
+  int stepping;
+
+  // Lookup table of the two-state rule that was active at init, see
+  // rule.h. Memoized results are only valid for this rule.
+  uint8_t rule[18];
+
+  struct HLNode *root;
+  // World coordinates of the root's top left cell
+  int64_t originX, originY;
+  uint64_t generation;
+};
+
+int hashLifeInit(struct HashLife *hl, size_t memoryBudget);
+void hashLifeFree(struct HashLife *hl);
+
+// Replaces the world with the grid, its top left cell at world (0, 0)
+void hashLifeFromGrid(struct HashLife *hl, struct LifeGrid *grid);
+// Copies the world window starting at world (y, x) into the grid
+void hashLifeToGrid(struct HashLife *hl, struct LifeGrid *grid, int64_t y,
+                    int64_t x);
+
+int hashLifeGetCell(struct HashLife *hl, int64_t y, int64_t x);
+// Cells more than 2^(HASHLIFE_MAX_LEVEL - 1) from the origin are ignored
+void hashLifeSetCell(struct HashLife *hl, int64_t y, int64_t x, int alive);
+
+// Advances the world by any number of generations, in power of two jumps.
+// Returns -1, with hl->generation saying how far it got, once the pattern
+// needs a root past HASHLIFE_MAX_LEVEL.
+int hashLifeStep(struct HashLife *hl, uint64_t generations);
+uint64_t hashLifePopulation(struct HashLife *hl);
+size_t hashLifeMemory(struct HashLife *hl);
+void hashLifeCollect(struct HashLife *hl);
+
+#endif
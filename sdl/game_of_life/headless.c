@@ -0,0 +1,1547 @@
+#define _POSIX_C_SOURCE 200809L
+
+// Headless front end for the Game of Life engines: benchmarks and the
+// regression suite, without SDL
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "engine.h"
+#include "history.h"
+#include "metrics.h"
+#include "pattern.h"
+#include "soup.h"
+#include "view.h"
+
+// Runs every supported kernel, and the other bounded engines, next to
+// nextGeneration on a random soup and reports the first generation where
+// they disagree
+int crossCheck(int rows, int cols, int generations,
+               enum LifeBoundary boundary) {
+  struct LifeGrid reference;
+  struct LifeGrid grid;
+  if (lifeGridInit(&reference, rows, cols) != 0) {
+    fprintf(stderr, "Failed to allocate grid.\n");
+    return 1;
+  }
+  if (lifeGridInit(&grid, rows, cols) != 0) {
+    fprintf(stderr, "Failed to allocate grid.\n");
+    lifeGridFree(&reference);
+    return 1;
+  }
+
+  // One pass per kernel through the bytes engine, then one pass each for
+  // the threaded, tile and process engines on the best kernel
+  enum EngineKind others[] = {ENGINE_THREADS, ENGINE_TILES, ENGINE_PROCS};
+  int passes = LIFE_KERNEL_COUNT + 3;
+
+  int failures = 0;
+  for (int pass = 0; pass < passes; pass++) {
+    enum EngineKind kind = ENGINE_BYTES;
+    const char *name;
+    if (pass < LIFE_KERNEL_COUNT) {
+      name = lifeKernelName(pass);
+      if (!lifeKernelSupported(pass)) {
+        printf("%-8s: not supported, skipped\n", name);
+        continue;
+      }
+      lifeSetKernel(pass);
+    } else {
+      kind = others[pass - LIFE_KERNEL_COUNT];
+      name = engineName(kind);
+      if (!engineSupportsRule(kind, lifeGetRule())) {
+        printf("%-8s: can't run the rule, skipped\n", name);
+        continue;
+      }
+      lifeSetKernel(lifeDetectKernel());
+    }
+
+    lifeGridRandomize(&reference, 42, 25);
+    lifeGridRandomize(&grid, 42, 25);
+    lifeGridSetBoundary(&reference, boundary);
+    lifeGridSetBoundary(&grid, boundary);
+
+    struct Stepper stepper;
+    if (stepperInit(&stepper, kind, &grid, 4) != 0) {
+      fprintf(stderr, "Failed to start the %s engine.\n", name);
+      failures++;
+      continue;
+    }
+
+    int mismatch = -1;
+    for (int gen = 0; gen < generations && mismatch < 0; gen++) {
+      nextGeneration(&reference);
+      stepperStep(&stepper, 1);
+      stepperSync(&stepper);
+
+      for (int y = 0; y < rows && mismatch < 0; y++) {
+        if (memcmp(lifeCell(&reference, y, 0), lifeCell(&grid, y, 0), cols))
+          mismatch = gen + 1;
+      }
+    }
+    stepperFree(&stepper);
+
+    if (mismatch < 0) {
+      printf("%-8s: ok (%d generations, %dx%d)\n", name, generations, cols,
+             rows);
+    } else {
+      printf("%-8s: MISMATCH at generation %d\n", name, mismatch);
+      failures++;
+    }
+  }
+
+  lifeGridFree(&grid);
+  lifeGridFree(&reference);
+  return failures != 0;
+}
+
+// Checks the halo modes against what they stand for, without using the
+// halo of the same grid: a glider comes back to where it started on a
+// torus, and a mirrored grid runs the same as a torus twice its size that
+// holds the grid reflected four times
+int boundaryCheck(void) {
+  const char *glider[3] = {".O.", "..O", "OOO"};
+  struct LifeGrid torus;
+  if (lifeGridInit(&torus, 32, 40) != 0) {
+    fprintf(stderr, "Failed to allocate grid.\n");
+    return 1;
+  }
+
+  lifeGridSetBoundary(&torus, LIFE_BOUNDARY_TORUS);
+  for (int y = 0; y < 3; y++) {
+    for (int x = 0; x < 3; x++) {
+      *lifeCell(&torus, y, x) = glider[y][x] == 'O';
+    }
+  }
+
+  // One cell diagonally every 4 generations, lcm(32, 40) cells to go round
+  uint64_t start = lifeGridHash(&torus);
+  for (int gen = 0; gen < 4 * 160; gen++) {
+    lifeStep(&torus);
+  }
+  int torusOk = lifeGridHash(&torus) == start;
+  printf("torus   : %s (glider after 640 generations)\n",
+         torusOk ? "ok" : "FAILED");
+  lifeGridFree(&torus);
+
+  int rows = 97, cols = 120;
+  struct LifeGrid mirror, doubled;
+  if (lifeGridInit(&mirror, rows, cols) != 0 ||
+      lifeGridInit(&doubled, 2 * rows, 2 * cols) != 0) {
+    fprintf(stderr, "Failed to allocate grid.\n");
+    return 1;
+  }
+
+  lifeGridRandomize(&mirror, 11, 30);
+  lifeGridSetBoundary(&mirror, LIFE_BOUNDARY_MIRROR);
+  lifeGridSetBoundary(&doubled, LIFE_BOUNDARY_TORUS);
+  for (int y = 0; y < rows; y++) {
+    for (int x = 0; x < cols; x++) {
+      uint8_t cell = *lifeCell(&mirror, y, x);
+      *lifeCell(&doubled, y, x) = cell;
+      *lifeCell(&doubled, y, 2 * cols - 1 - x) = cell;
+      *lifeCell(&doubled, 2 * rows - 1 - y, x) = cell;
+      *lifeCell(&doubled, 2 * rows - 1 - y, 2 * cols - 1 - x) = cell;
+    }
+  }
+
+  int mismatch = -1;
+  for (int gen = 0; gen < 100 && mismatch < 0; gen++) {
+    lifeStep(&mirror);
+    lifeStep(&doubled);
+    for (int y = 0; y < rows && mismatch < 0; y++) {
+      if (memcmp(lifeCell(&mirror, y, 0), lifeCell(&doubled, y, 0), cols))
+        mismatch = gen + 1;
+    }
+  }
+  if (mismatch < 0)
+    printf("mirror  : ok (100 generations against a doubled torus)\n");
+  else
+    printf("mirror  : MISMATCH at generation %d\n", mismatch);
+
+  lifeGridFree(&mirror);
+  lifeGridFree(&doubled);
+  return !torusOk || mismatch >= 0;
+}
+
+// Cross-checks every rule family on every boundary it runs with, with a
+// smaller grid for Larger than Life, whose reference is slow
+int crossCheckRules(void) {
+  const char *rules[] = {"life", "highlife", "daynight", "seeds",
+                         "brain", "bosco"};
+  int count = sizeof(rules) / sizeof(rules[0]);
+
+  int failures = 0;
+  for (int i = 0; i < count; i++) {
+    struct LifeRule rule;
+    ruleParse(&rule, rules[i]);
+    lifeSetRule(&rule);
+
+    if (rule.family == RULE_LARGER) {
+      printf("Rule %s:\n", rule.name);
+      failures += crossCheck(97, 160, 20, LIFE_BOUNDARY_DEAD);
+      continue;
+    }
+
+    for (int boundary = 0; boundary < LIFE_BOUNDARY_COUNT; boundary++) {
+      printf("Rule %s, %s boundary:\n", rule.name,
+             lifeBoundaryName(boundary));
+      failures += crossCheck(300, 333, 100, boundary);
+    }
+  }
+
+  struct LifeRule life;
+  ruleParse(&life, "life");
+  lifeSetRule(&life);
+  return failures != 0;
+}
+
+double nowSeconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+double measureGensPerSecond(struct LifeGrid *grid, struct LifePool *pool,
+                            int generations) {
+  double start = nowSeconds();
+  for (int gen = 0; gen < generations; gen++) {
+    if (pool != NULL) {
+      lifePoolStep(pool, grid);
+    } else {
+      lifeStep(grid);
+    }
+  }
+
+  return generations / (nowSeconds() - start);
+}
+
+// Steps the same soup with 1, 2, 4... up to maxThreads worker threads and
+// prints gens/sec and the speedup over the single threaded kernel
+int scalingReport(int rows, int cols, int maxThreads, int generations) {
+  struct LifeGrid grid;
+  if (lifeGridInit(&grid, rows, cols) != 0) {
+    fprintf(stderr, "Failed to allocate grid.\n");
+    return 1;
+  }
+
+  printf("Grid %dx%d, %s kernel, %d generations per run\n", cols, rows,
+         lifeKernelName(lifeGetKernel()), generations);
+  printf("%8s %8s %12s %8s\n", "threads", "bands", "gens/sec", "speedup");
+
+  double base = 0;
+  for (int threads = 1; threads <= maxThreads; threads *= 2) {
+    // Always finish on the requested count, even if it isn't a power of two
+    if (threads * 2 > maxThreads)
+      threads = maxThreads;
+
+    lifeGridRandomize(&grid, 42, 25);
+
+    struct LifePool pool;
+    if (lifePoolInit(&pool, threads) != 0) {
+      fprintf(stderr, "Failed to start %d threads.\n", threads);
+      lifeGridFree(&grid);
+      return 1;
+    }
+
+    // One untimed generation so the bands are planned and caches are warm
+    lifePoolStep(&pool, &grid);
+    double rate = measureGensPerSecond(&grid, &pool, generations);
+    if (threads == 1)
+      base = rate;
+
+    printf("%8d %8d %12.1f %7.2fx\n", threads, pool.bandCount, rate,
+           rate / base);
+    lifePoolFree(&pool);
+  }
+
+  lifeGridFree(&grid);
+  return 0;
+}
+
+// Same soup through 1 to maxProcs worker processes, every count, with the
+// gather for display at the end of each run included in the time
+int procsScalingReport(int rows, int cols, int maxProcs, int generations) {
+  struct LifeGrid grid;
+  if (lifeGridInit(&grid, rows, cols) != 0) {
+    fprintf(stderr, "Failed to allocate grid.\n");
+    return 1;
+  }
+
+  printf("Grid %dx%d, %s kernel, %d NUMA nodes, %d generations per run\n",
+         cols, rows, lifeKernelName(lifeGetKernel()), procsNodeCount(),
+         generations);
+  printf("%8s %8s %12s %8s\n", "procs", "slabs", "gens/sec", "speedup");
+
+  double base = 0;
+  for (int procs = 1; procs <= maxProcs; procs++) {
+    lifeGridRandomize(&grid, 42, 25);
+
+    struct Stepper stepper;
+    if (stepperInit(&stepper, ENGINE_PROCS, &grid, procs) != 0) {
+      fprintf(stderr, "Failed to start %d processes.\n", procs);
+      lifeGridFree(&grid);
+      return 1;
+    }
+
+    // One untimed generation, so every slab has been through the cache
+    stepperStep(&stepper, 1);
+    double start = nowSeconds();
+    stepperStep(&stepper, generations);
+    stepperSync(&stepper);
+    double rate = generations / (nowSeconds() - start);
+    if (procs == 1)
+      base = rate;
+
+    printf("%8d %8d %12.1f %7.2fx\n", procs, stepper.procs.count, rate,
+           rate / base);
+    stepperFree(&stepper);
+  }
+
+  lifeGridFree(&grid);
+  return 0;
+}
+
+struct Pattern {
+  const char *name;
+  const char *rows[10];
+  uint64_t generations;
+  // Known population at that generation, or -1 if it isn't checked
+  int64_t population;
+};
+
+static const struct Pattern hashLifePatterns[] = {
+    {"r-pentomino", {".OO", "OO.", ".O."}, 1103, 116},
+    {"acorn", {".O.....", "...O...", "OO..OOO"}, 5206, 633},
+    {"diehard", {"......O.", "OO......", ".O...OOO"}, 130, 0},
+    {"gosper-gun",
+     {"........................O...........",
+      "......................O.O...........",
+      "............OO......OO............OO",
+      "...........O...O....OO............OO",
+      "OO........O.....O...OO..............",
+      "OO........O...O.OO....O.O...........",
+      "..........O.....O.......O...........",
+      "...........O...O....................",
+      "............OO......................"},
+     1 << 20,
+     -1},
+};
+
+static void hashLifeRun(void *context, int64_t y, int64_t x,
+                        int64_t length, int state) {
+  (void)state;
+  for (int64_t i = 0; i < length; i++) {
+    hashLifeSetCell(context, y, x + i, 1);
+  }
+}
+
+// Times a 2^30 generation jump on a pattern file, e.g. a breeder
+int hashLifeBenchFile(const char *path) {
+  struct PatternFile file;
+  if (patternOpen(&file, path) != 0)
+    return 1;
+
+  struct HashLife hl;
+  if (hashLifeInit(&hl, (size_t)1 << 30) != 0) {
+    fprintf(stderr, "Failed to allocate HashLife table.\n");
+    patternClose(&file);
+    return 1;
+  }
+
+  int result = patternDecode(&file, hashLifeRun, &hl);
+  if (result != 0)
+    patternPrintError(&file, path);
+  patternClose(&file);
+
+  if (result == 0) {
+    uint64_t initial = hashLifePopulation(&hl);
+    double start = nowSeconds();
+    hashLifeStep(&hl, (uint64_t)1 << 30);
+    double elapsed = nowSeconds() - start;
+
+    printf("%s: %llu cells, %llu after %llu generations in %.2f ms, "
+           "%zu nodes, %.1f MiB\n",
+           path, (unsigned long long)initial,
+           (unsigned long long)hashLifePopulation(&hl),
+           (unsigned long long)hl.generation, elapsed * 1000, hl.nodeCount,
+           hashLifeMemory(&hl) / (1024.0 * 1024.0));
+  }
+
+  hashLifeFree(&hl);
+  return result != 0;
+}
+
+// Runs the methuselahs to the generation they settle at and checks their
+// known final population, then times a 2^30 generation jump on each, and
+// on every pattern file given
+int hashLifeBench(char **files, int fileCount) {
+  int failures = 0;
+  printf("%-12s %12s %12s %10s %10s %10s\n", "pattern", "generations",
+         "population", "ms", "nodes", "MiB");
+
+  int count = sizeof(hashLifePatterns) / sizeof(hashLifePatterns[0]);
+  for (int i = 0; i < count; i++) {
+    const struct Pattern *pattern = &hashLifePatterns[i];
+    struct HashLife hl;
+    if (hashLifeInit(&hl, (size_t)256 << 20) != 0) {
+      fprintf(stderr, "Failed to allocate HashLife table.\n");
+      return 1;
+    }
+
+    for (int y = 0; y < 10 && pattern->rows[y] != NULL; y++) {
+      for (int x = 0; pattern->rows[y][x] != '\0'; x++) {
+        if (pattern->rows[y][x] == 'O')
+          hashLifeSetCell(&hl, y, x, 1);
+      }
+    }
+
+    uint64_t targets[2] = {pattern->generations, (uint64_t)1 << 30};
+    for (int t = 0; t < 2; t++) {
+      double start = nowSeconds();
+      hashLifeStep(&hl, targets[t]);
+      double elapsed = nowSeconds() - start;
+
+      uint64_t population = hashLifePopulation(&hl);
+      printf("%-12s %12llu %12llu %10.2f %10zu %10.1f", pattern->name,
+             (unsigned long long)hl.generation,
+             (unsigned long long)population, elapsed * 1000, hl.nodeCount,
+             hashLifeMemory(&hl) / (1024.0 * 1024.0));
+
+      if (t == 0 && pattern->population >= 0) {
+        int ok = population == (uint64_t)pattern->population;
+        printf("  %s (expected %lld)", ok ? "ok" : "WRONG",
+               (long long)pattern->population);
+        failures += !ok;
+      }
+      printf("\n");
+    }
+
+    hashLifeFree(&hl);
+  }
+
+  for (int i = 0; i < fileCount; i++) {
+    failures += hashLifeBenchFile(files[i]);
+  }
+
+  return failures != 0;
+}
+
+// Jumps as far as a uint64_t goes: a block lasts through all of it, a
+// glider runs out of world, and neither takes the root past its cap. Then
+// a jump on a small memory budget.
+int hashLifeCheck(void) {
+  struct LifeRule life;
+  ruleParse(&life, "life");
+  lifeSetRule(&life);
+
+  const char *names[2] = {"block", "glider"};
+  const char *rows[2][3] = {{"OO", "OO", ""}, {".O.", "..O", "OOO"}};
+  int failures = 0;
+  for (int i = 0; i < 2; i++) {
+    struct HashLife hl;
+    if (hashLifeInit(&hl, (size_t)64 << 20) != 0) {
+      fprintf(stderr, "Failed to allocate HashLife table.\n");
+      return 1;
+    }
+    for (int y = 0; y < 3; y++) {
+      for (int x = 0; rows[i][y][x] != '\0'; x++) {
+        if (rows[i][y][x] == 'O')
+          hashLifeSetCell(&hl, y, x, 1);
+      }
+    }
+
+    int result = hashLifeStep(&hl, UINT64_MAX);
+    int ok = hl.root->level <= HASHLIFE_MAX_LEVEL &&
+             (i == 0 ? result == 0 && hl.generation == UINT64_MAX &&
+                           hashLifePopulation(&hl) == 4
+                     : result != 0 && hashLifePopulation(&hl) == 5);
+    printf("hashlife %-6s: %s (%" PRIu64 " generations, level %d)\n",
+           names[i], ok ? "ok" : "FAILED", hl.generation, hl.root->level);
+    failures += !ok;
+    hashLifeFree(&hl);
+  }
+
+  // A soup jumped on a budget far below what the jump makes has to collect
+  // inside the jump, and must still end where a roomy run does
+  struct LifeGrid grids[2];
+  uint64_t hashes[2] = {0, 0}, populations[2] = {0, 0};
+  int collections = 0;
+  for (int i = 0; i < 2; i++) {
+    struct HashLife hl;
+    if (lifeGridInit(&grids[i], 128, 128) != 0 ||
+        hashLifeInit(&hl, i == 0 ? (size_t)256 << 20 : (size_t)4 << 20)) {
+      fprintf(stderr, "Failed to allocate HashLife table.\n");
+      return 1;
+    }
+    lifeGridRandomize(&grids[i], 7, 30);
+    hashLifeFromGrid(&hl, &grids[i]);
+    hashLifeStep(&hl, 4096);
+    hashLifeToGrid(&hl, &grids[i], -64, -64);
+    hashes[i] = lifeGridHash(&grids[i]);
+    populations[i] = hashLifePopulation(&hl);
+    collections = hl.collections;
+    hashLifeFree(&hl);
+    lifeGridFree(&grids[i]);
+  }
+  int ok = hashes[0] == hashes[1] && populations[0] == populations[1] &&
+           collections > 1;
+  printf("hashlife budget: %s (%d collections in one jump)\n",
+         ok ? "ok" : "FAILED", collections);
+  failures += !ok;
+
+  return failures != 0;
+}
+
+static void countRun(void *context, int64_t y, int64_t x, int64_t length,
+                     int state) {
+  (void)y;
+  (void)x;
+  (void)state;
+  *(uint64_t *)context += length;
+}
+
+// Saves a soup as RLE, loads it back and compares the hashes, for both
+// formats
+int patternCheck(int rows, int cols) {
+  struct LifeGrid grid, loaded;
+  if (lifeGridInit(&grid, rows, cols) != 0 ||
+      lifeGridInit(&loaded, rows, cols) != 0) {
+    fprintf(stderr, "Failed to allocate grids.\n");
+    return 1;
+  }
+
+  lifeGridRandomize(&grid, 7, 30);
+  char path[] = "/tmp/gol-pattern-XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    perror("mkstemp");
+    return 1;
+  }
+  close(fd);
+
+  int failures = 0;
+  const char *names[2] = {"rle", "plaintext"};
+  for (int format = 0; format < 2; format++) {
+    int saved = format == 0 ? patternSaveRle(path, &grid)
+                            : patternSavePlaintext(path, &grid);
+    int ok = saved == 0 && patternLoadGrid(path, &loaded) == 0 &&
+             lifeGridHash(&loaded) == lifeGridHash(&grid);
+    // RLE keeps the rule in its header, plaintext stands for B3/S23
+    struct LifeRule rule;
+    ok &= patternRule(path, &rule) == 0 &&
+          strcmp(rule.name, format == 0 ? lifeGetRule()->name : "B3/S23") == 0;
+    printf("%-10s round trip %s\n", names[format], ok ? "ok" : "FAILED");
+    failures += !ok;
+  }
+
+  // Runs that would overflow the count, or add up past any world, are
+  // errors rather than wrapped around
+  const char *huge[2] = {"x = 1, y = 1\n99999999999999999999o!\n",
+                         "x = 1, y = 1\n999999999999999b999999999999999bo!\n"};
+  const char *errors[2] = {"run too long", "pattern too large"};
+  for (int i = 0; i < 2; i++) {
+    FILE *out = fopen(path, "w");
+    struct PatternFile file;
+    uint64_t cells = 0;
+    int rejected = out != NULL && fputs(huge[i], out) >= 0 &&
+                   fclose(out) == 0 && patternOpen(&file, path) == 0;
+    if (rejected) {
+      rejected = patternDecode(&file, countRun, &cells) != 0 &&
+                 strcmp(file.error, errors[i]) == 0;
+      patternClose(&file);
+    }
+    printf("rle        huge run %d %s\n", i, rejected ? "ok" : "FAILED");
+    failures += !rejected;
+  }
+
+  unlink(path);
+  lifeGridFree(&grid);
+  lifeGridFree(&loaded);
+  return failures != 0;
+}
+
+// Live cells and a hash of a soup from soupFillGrid, which must not have
+// written past the last column into the halo
+static uint64_t fillSoup(struct LifeGrid *grid, uint64_t seed, double percent,
+                         int threads, uint64_t *population, int *spilled) {
+  soupFillGrid(grid, seed, percent, threads);
+  for (int y = 0; y < grid->rows; y++) {
+    *spilled |= *lifeCell(grid, y, grid->cols) != 0;
+  }
+
+  *population = lifeGridPopulation(grid);
+  return lifeGridHash(grid);
+}
+
+// A seed gives the same soup on any thread count and another seed another
+// soup, and every density comes out within 5 standard deviations
+int soupCheck(void) {
+  const int rows = 333, cols = 517;
+  struct LifeGrid grid;
+  if (lifeGridInit(&grid, rows, cols) != 0) {
+    fprintf(stderr, "Failed to allocate grid.\n");
+    return 1;
+  }
+
+  int failures = 0;
+  int spilled = 0;
+  uint64_t population;
+  uint64_t hash = fillSoup(&grid, 5, 30, 1, &population, &spilled);
+  for (int threads = 2; threads <= 8; threads++) {
+    if (fillSoup(&grid, 5, 30, threads, &population, &spilled) != hash) {
+      printf("soup    : %d threads fill another soup\n", threads);
+      failures++;
+    }
+  }
+  if (fillSoup(&grid, 6, 30, 0, &population, &spilled) == hash) {
+    printf("soup    : seeds 5 and 6 fill the same soup\n");
+    failures++;
+  }
+
+  const double percents[] = {0, 0.5, 25, 30, 50, 99.9, 100};
+  for (int i = 0; i < 7; i++) {
+    struct SoupDensity density;
+    soupDensityInit(&density, percents[i]);
+    double chance = density.fraction / 65536.0;
+    double cells = (double)rows * cols;
+    double expected = cells * chance;
+    double tolerance = 5 * sqrt(cells * chance * (1 - chance));
+
+    fillSoup(&grid, 7 + i, percents[i], 0, &population, &spilled);
+    if (fabs((double)population - expected) > tolerance) {
+      printf("soup    : %.1f%% gave %" PRIu64 " live cells, expected %.0f\n",
+             percents[i], population, expected);
+      failures++;
+    }
+  }
+  if (spilled) {
+    printf("soup    : cells written into the halo\n");
+    failures++;
+  }
+
+  if (failures == 0)
+    printf("soup    : ok (same soup on 1 to 8 threads, 7 densities)\n");
+  lifeGridFree(&grid);
+  return failures != 0;
+}
+
+// Times lifeGridRandomize, one splitmix draw per cell, against
+// soupFillGrid on one thread and on threads of them
+int soupBench(int rows, int cols, int density, int threads) {
+  struct LifeGrid grid;
+  if (lifeGridInit(&grid, rows, cols) != 0) {
+    fprintf(stderr, "Failed to allocate grid.\n");
+    return 1;
+  }
+  if (threads < 1)
+    threads = poolDefaultThreads();
+
+  printf("Grid %dx%d, %d%% density\n", cols, rows, density);
+  printf("%-10s %8s %10s %12s %9s\n", "fill", "threads", "ms",
+         "Mcells/sec", "density");
+  const int repeats = 3;
+  for (int pass = 0; pass < 3; pass++) {
+    int passThreads = pass < 2 ? 1 : threads;
+    double best = 0;
+    for (int i = 0; i < repeats; i++) {
+      double start = nowSeconds();
+      if (pass == 0)
+        lifeGridRandomize(&grid, i + 1, density);
+      else
+        soupFillGrid(&grid, i + 1, density, passThreads);
+      double elapsed = nowSeconds() - start;
+      if (i == 0 || elapsed < best)
+        best = elapsed;
+    }
+
+    double cells = (double)rows * cols;
+    printf("%-10s %8d %10.1f %12.1f %8.2f%%\n",
+           pass == 0 ? "splitmix" : "xoshiro", passThreads, best * 1e3,
+           cells / best / 1e6, 100.0 * lifeGridPopulation(&grid) / cells);
+  }
+
+  lifeGridFree(&grid);
+  return 0;
+}
+
+// Decodes a pattern file a few times without storing the cells, so only the
+// parser is measured, then once more into a grid. Without a file, a large
+// soup is written out first.
+int parseBench(const char *path, int rows, int cols) {
+  char tempPath[] = "/tmp/gol-parse-XXXXXX";
+  if (path == NULL) {
+    int fd = mkstemp(tempPath);
+    if (fd < 0) {
+      perror("mkstemp");
+      return 1;
+    }
+    close(fd);
+
+    struct LifeGrid grid;
+    if (lifeGridInit(&grid, rows, cols) != 0) {
+      fprintf(stderr, "Failed to allocate grid.\n");
+      return 1;
+    }
+    lifeGridRandomize(&grid, 1, 25);
+    int saved = patternSaveRle(tempPath, &grid);
+    lifeGridFree(&grid);
+    if (saved != 0)
+      return 1;
+    path = tempPath;
+  }
+
+  struct PatternFile file;
+  if (patternOpen(&file, path) != 0)
+    return 1;
+
+  const int repeats = 5;
+  uint64_t cells = 0;
+  double best = 0;
+  int result = 0;
+  for (int i = 0; i < repeats && result == 0; i++) {
+    cells = 0;
+    double start = nowSeconds();
+    result = patternDecode(&file, countRun, &cells);
+    double elapsed = nowSeconds() - start;
+    if (result != 0)
+      patternPrintError(&file, path);
+    if (i == 0 || elapsed < best)
+      best = elapsed;
+  }
+
+  double megabytes = file.size / (1024.0 * 1024.0);
+  printf("%s: %s, %lldx%lld, %.1f MiB, %llu live cells\n", path,
+         file.format == PATTERN_RLE ? "rle" : "plaintext",
+         (long long)file.width, (long long)file.height, megabytes,
+         (unsigned long long)cells);
+  printf("Parse: %.2f ms, %.0f MB/s\n", best * 1000, megabytes / best);
+  patternClose(&file);
+
+  // Loading into a grid as big as the pattern, when that is reasonable
+  if (result == 0 && file.width * file.height <= ((int64_t)1 << 30)) {
+    struct LifeGrid grid;
+    if (lifeGridInit(&grid, file.height, file.width) == 0) {
+      double start = nowSeconds();
+      result = patternLoadGrid(path, &grid);
+      double elapsed = nowSeconds() - start;
+      printf("Load into grid: %.2f ms, %.0f MB/s\n", elapsed * 1000,
+             megabytes / elapsed);
+      lifeGridFree(&grid);
+    }
+  }
+
+  if (path == tempPath)
+    unlink(tempPath);
+  return result != 0;
+}
+
+// Records a soup's generations, then checks that seeks give back the same
+// grids: with everything kept, with a budget small enough to evict, and
+// after going back and editing a generation. Brian's Brain has three
+// states, so its frames aren't bit packed.
+int historyCheck(const char *ruleText) {
+  const int rows = 200, cols = 250, generations = 300;
+  struct LifeRule rule;
+  ruleParse(&rule, ruleText);
+  lifeSetRule(&rule);
+
+  struct LifeGrid grid;
+  if (lifeGridInit(&grid, rows, cols) != 0) {
+    fprintf(stderr, "Failed to allocate grid.\n");
+    return 1;
+  }
+
+  uint64_t *hashes = malloc((generations + 1) * sizeof(uint64_t));
+  struct LifeHistory full, small;
+  if (hashes == NULL || historyInit(&full, rows, cols, 16, 64 << 20) != 0 ||
+      historyInit(&small, rows, cols, 16, 64 << 10) != 0) {
+    fprintf(stderr, "Failed to allocate history.\n");
+    return 1;
+  }
+
+  lifeGridRandomize(&grid, 21, 30);
+  int failures = 0;
+  for (int gen = 0; gen <= generations; gen++) {
+    if (gen > 0)
+      lifeStep(&grid);
+    hashes[gen] = lifeGridHash(&grid);
+    failures += historyRecord(&full, gen, &grid) != 0;
+    failures += historyRecord(&small, gen, &grid) != 0;
+  }
+
+  const char *names[2] = {"full", "evicting"};
+  struct LifeHistory *histories[2] = {&full, &small};
+  for (int i = 0; i < 2; i++) {
+    uint64_t first, last, found;
+    int ok = historyRange(histories[i], &first, &last) &&
+             last == (uint64_t)generations && (i == 0) == (first == 0);
+    for (uint64_t gen = first; ok && gen <= last; gen++) {
+      ok = historySeek(histories[i], gen, &grid, &found) == 0 &&
+           found == gen && lifeGridHash(&grid) == hashes[gen];
+    }
+    printf("history %-8s %-6s: %s (generations %llu to %llu)\n", names[i],
+           ruleText, ok ? "ok" : "FAILED", (unsigned long long)first,
+           (unsigned long long)last);
+    failures += !ok;
+  }
+
+  // Editing generation 100 replaces it and drops everything after it
+  uint64_t found, first, last;
+  historySeek(&full, 100, &grid, &found);
+  *lifeCell(&grid, rows / 2, cols / 2) ^= 1;
+  uint64_t edited = lifeGridHash(&grid);
+  historyRecord(&full, 100, &grid);
+  lifeStep(&grid);
+  uint64_t next = lifeGridHash(&grid);
+  historyRecord(&full, 101, &grid);
+  int ok = historyRange(&full, &first, &last) && last == 101 &&
+           historySeek(&full, 100, &grid, &found) == 0 &&
+           lifeGridHash(&grid) == edited &&
+           historySeek(&full, 500, &grid, &found) == 0 && found == 101 &&
+           lifeGridHash(&grid) == next &&
+           historySeek(&full, 99, &grid, &found) == 0 &&
+           lifeGridHash(&grid) == hashes[99];
+  printf("history branch   %-6s: %s\n", ruleText, ok ? "ok" : "FAILED");
+  failures += !ok;
+
+  // A budget short of a frame is turned down before allocating anything
+  struct LifeHistory tiny;
+  size_t frame = (size_t)rows * cols / (rule.states > 2 ? 1 : 8);
+  ok = historyKeyframeFits(rows, cols, frame) &&
+       !historyKeyframeFits(rows, cols, frame - 1) &&
+       historyInit(&tiny, rows, cols, 16, frame - 1) != 0 &&
+       tiny.arena == NULL;
+  printf("history budget   %-6s: %s\n", ruleText, ok ? "ok" : "FAILED");
+  failures += !ok;
+
+  historyFree(&full);
+  historyFree(&small);
+  free(hashes);
+  lifeGridFree(&grid);
+  ruleParse(&rule, "life");
+  lifeSetRule(&rule);
+  return failures != 0;
+}
+
+// Records soups with a few keyframe intervals and reports how well they
+// compress and how long recording and seeking take
+int historyBench(int rows, int cols, uint64_t seed, int density,
+                 int generations) {
+  struct LifeGrid grid;
+  if (lifeGridInit(&grid, rows, cols) != 0) {
+    fprintf(stderr, "Failed to allocate grid.\n");
+    return 1;
+  }
+
+  printf("%dx%d soup at %d%%, %d generations\n", cols, rows, density,
+         generations);
+  printf("interval  ratio   bytes/gen  record us  seek avg us  seek max us\n");
+
+  const int intervals[3] = {16, 64, 256};
+  for (int i = 0; i < 3; i++) {
+    struct LifeHistory history;
+    if (historyInit(&history, rows, cols, intervals[i], (size_t)1 << 30) !=
+        0) {
+      fprintf(stderr, "Failed to allocate history.\n");
+      lifeGridFree(&grid);
+      return 1;
+    }
+
+    lifeGridRandomize(&grid, seed, density);
+    double recordSeconds = 0;
+    for (int gen = 0; gen <= generations; gen++) {
+      if (gen > 0)
+        lifeStep(&grid);
+      double start = nowSeconds();
+      historyRecord(&history, gen, &grid);
+      recordSeconds += nowSeconds() - start;
+    }
+
+    const int seeks = 200;
+    double seekTotal = 0, seekMax = 0;
+    srand(seed);
+    for (int s = 0; s < seeks; s++) {
+      uint64_t found;
+      double start = nowSeconds();
+      historySeek(&history, rand() % (generations + 1), &grid, &found);
+      double elapsed = nowSeconds() - start;
+      seekTotal += elapsed;
+      if (elapsed > seekMax)
+        seekMax = elapsed;
+    }
+
+    double raw = (double)history.count * rows * cols;
+    printf("%8d  %5.1fx  %10.0f  %9.1f  %11.1f  %11.1f\n", intervals[i],
+           raw / history.storedBytes,
+           (double)history.storedBytes / history.count,
+           recordSeconds * 1e6 / history.count, seekTotal * 1e6 / seeks,
+           seekMax * 1e6);
+    historyFree(&history);
+  }
+
+  lifeGridFree(&grid);
+  return 0;
+}
+
+struct RunResult {
+  double seconds;
+  // Period being replayed at the end, with cycle detection
+  int period;
+  uint64_t population;
+  uint64_t hash;
+  double activeTiles;
+};
+
+// Seeds a soup (or loads the pattern file, if there is one), steps it with
+// the engine and reports how long that took and where it ended up. With
+// metrics, every generation is timed on its own.
+int runEngine(enum EngineKind kind, int threads, int rows, int cols,
+              uint64_t seed, int density, int generations,
+              enum LifeBoundary boundary, const char *pattern,
+              int detectCycles, struct Metrics *metrics,
+              struct RunResult *result) {
+  struct LifeGrid grid;
+  if (lifeGridInit(&grid, rows, cols) != 0) {
+    fprintf(stderr, "Failed to allocate grid.\n");
+    return -1;
+  }
+
+  if (pattern == NULL) {
+    lifeGridRandomize(&grid, seed, density);
+  } else if (patternLoadGrid(pattern, &grid) != 0) {
+    lifeGridFree(&grid);
+    return -1;
+  }
+  lifeGridSetBoundary(&grid, boundary);
+
+  struct Stepper stepper;
+  if (stepperInit(&stepper, kind, &grid, threads) != 0) {
+    fprintf(stderr, "Failed to start the %s engine.\n", engineName(kind));
+    lifeGridFree(&grid);
+    return -1;
+  }
+  if (detectCycles && stepperDetectCycles(&stepper) != 0) {
+    fprintf(stderr, "The %s engine can't detect cycles.\n",
+            engineName(kind));
+    stepperFree(&stepper);
+    lifeGridFree(&grid);
+    return -1;
+  }
+
+  long activeTiles = 0;
+  int failed = 0;
+  double start = nowSeconds();
+  if (metrics != NULL) {
+    metricsGeneration(metrics, 0, 0, &grid, stepperActiveArea(&stepper),
+                      stepperSteppedTiles(&stepper));
+    for (int gen = 0; gen < generations && !failed; gen++) {
+      double stepStart = nowSeconds();
+      failed = stepperStep(&stepper, 1) != 0;
+      if (metricsWantsGrid(metrics, gen + 1))
+        stepperSync(&stepper);
+      double elapsed = nowSeconds() - stepStart;
+      activeTiles += stepper.activeTiles;
+      metricsGeneration(metrics, gen + 1, elapsed * 1e9, &grid,
+                        stepperActiveArea(&stepper),
+                        stepperSteppedTiles(&stepper));
+    }
+  } else if (kind == ENGINE_TILES) {
+    for (int gen = 0; gen < generations; gen++) {
+      stepperStep(&stepper, 1);
+      activeTiles += stepper.activeTiles;
+    }
+  } else {
+    failed = stepperStep(&stepper, generations) != 0;
+  }
+  // Part of the run: the grid is only written, and the worker processes
+  // only done, once synced
+  stepperSync(&stepper);
+  result->seconds = nowSeconds() - start;
+
+  if (failed) {
+    fprintf(stderr, "The world outgrew the %s engine.\n", engineName(kind));
+    stepperFree(&stepper);
+    lifeGridFree(&grid);
+    return -1;
+  }
+
+  result->period =
+      detectCycles ? cyclePeriod(&stepper.cycles) : 0;
+  result->population = lifeGridPopulation(&grid);
+  result->hash = lifeGridHash(&grid);
+  result->activeTiles =
+      generations > 0 ? (double)activeTiles / generations : 0;
+
+  stepperFree(&stepper);
+  lifeGridFree(&grid);
+  return 0;
+}
+
+void printRun(const char *label, enum EngineKind kind, int rows, int cols,
+              int generations, struct RunResult *result) {
+  printf("%-14s %-9s %10.1f %14.3e %10" PRIu64 "  %016" PRIx64, label,
+         engineName(kind), generations / result->seconds,
+         (double)rows * cols * generations / result->seconds,
+         result->population, result->hash);
+}
+
+void printRunHeader(void) {
+  printf("%-14s %-9s %10s %14s %10s  %-16s\n", "scenario", "engine",
+         "gens/sec", "cell-upd/sec", "population", "hash");
+}
+
+// A soup that settles within the run on every boundary: replaying its cycle
+// must end on the grid stepping it all the way does
+int cycleCheck(void) {
+  const enum EngineKind kinds[3] = {ENGINE_BYTES, ENGINE_THREADS,
+                                    ENGINE_TILES};
+  int failures = 0;
+  for (int boundary = 0; boundary < LIFE_BOUNDARY_COUNT; boundary++) {
+    for (int i = 0; i < 3; i++) {
+      struct RunResult plain, cycled;
+      if (runEngine(kinds[i], 2, 96, 128, 1, 30, 3000, boundary, NULL, 0,
+                    NULL, &plain) != 0 ||
+          runEngine(kinds[i], 2, 96, 128, 1, 30, 3000, boundary, NULL, 1,
+                    NULL, &cycled) != 0)
+        return 1;
+
+      int ok = plain.hash == cycled.hash && cycled.period > 0;
+      printf("cycles %-8s %-6s: %s (period %d)\n", engineName(kinds[i]),
+             lifeBoundaryName(boundary), ok ? "ok" : "FAILED",
+             cycled.period);
+      failures += !ok;
+    }
+  }
+
+  return failures != 0;
+}
+
+// Live cells of the 2^level block at (by, bx), for checking the pyramid
+static int blockPopulation(struct LifeGrid *grid, int level, int by, int bx) {
+  int population = 0;
+  for (int y = by << level; y < (by + 1) << level && y < grid->rows; y++) {
+    for (int x = bx << level; x < (bx + 1) << level && x < grid->cols; x++) {
+      population += *lifeCell(grid, y, x) == 1;
+    }
+  }
+  return population;
+}
+
+// The pyramid against counted blocks, a rebuild of part of it against a
+// full one, zoomed in looks against the cells, and zooming in and back out
+int viewCheck(void) {
+  const int rows = 97, cols = 333;
+  struct LifeRule rule;
+  ruleParse(&rule, "life");
+  lifeSetRule(&rule);
+
+  struct LifeGrid grid;
+  struct LifePyramid pyramid, fresh;
+  uint8_t *looks = malloc((size_t)rows * cols);
+  if (looks == NULL || lifeGridInit(&grid, rows, cols) != 0 ||
+      pyramidInit(&pyramid, rows, cols) != 0 ||
+      pyramidInit(&fresh, rows, cols) != 0) {
+    fprintf(stderr, "Failed to allocate the view.\n");
+    return 1;
+  }
+
+  // Blocks are rounded up once per level, and only empty ones are 0
+  lifeGridRandomize(&grid, 31, 10);
+  int ok = 1;
+  for (int level = 1; level <= 9; level++) {
+    struct Viewport view = {-level, 0, 0, cols, rows};
+    viewFill(&view, &grid, &pyramid, looks);
+    for (int by = 0; by < pyramid.rows[level]; by++) {
+      for (int bx = 0; bx < pyramid.cols[level]; bx++) {
+        int population = blockPopulation(&grid, level, by, bx);
+        double exact = 255.0 * population / (1 << 2 * level);
+        int density = pyramid.levels[level][by * pyramid.cols[level] + bx];
+        ok &= (density == 0) == (population == 0) && density >= exact &&
+              density <= exact + level;
+        ok &= (looks[by * cols + bx] == 0) == (population == 0);
+      }
+    }
+  }
+
+  // A window at level 3 only rebuilds what it shows, and that has to match
+  lifeGridRandomize(&grid, 32, 40);
+  pyramidMarkAll(&pyramid);
+  struct Viewport part = {-3, 5, 3, 20, 7};
+  viewFill(&part, &grid, &pyramid, looks);
+  pyramidBuild(&fresh, &grid, 3, 0, rows, 0, cols);
+  for (int r = 0; r < part.height; r++) {
+    for (int c = 0; c < part.width; c++) {
+      int by = part.y + r, bx = part.x + c;
+      if (by >= fresh.rows[3] || bx >= fresh.cols[3]) {
+        ok &= looks[r * part.width + c] == VIEW_OUTSIDE;
+        continue;
+      }
+      ok &= pyramid.levels[3][by * fresh.cols[3] + bx] ==
+            fresh.levels[3][by * fresh.cols[3] + bx];
+    }
+  }
+
+  // Stepped by the tile engine, only the tiles it changed are rebuilt: a
+  // glider under the window every fill, a blinker outside it once the
+  // whole world is shown, and then every level matches a full build
+  lifeGridClear(&grid);
+  const int shape[8][2] = {{20, 41}, {21, 42}, {22, 40}, {22, 41},
+                           {22, 42}, {80, 300}, {80, 301}, {80, 302}};
+  for (int i = 0; i < 8; i++)
+    *lifeCell(&grid, shape[i][0], shape[i][1]) = 1;
+  pyramidMarkAll(&pyramid);
+  struct Stepper stepper;
+  if (stepperInit(&stepper, ENGINE_TILES, &grid, 1) != 0) {
+    fprintf(stderr, "Failed to start the tiles engine.\n");
+    return 1;
+  }
+  for (int gen = 0; gen < 30; gen++) {
+    stepperStep(&stepper, 1);
+    pyramidMarkStep(&pyramid, stepperSteppedTiles(&stepper));
+    viewFill(&part, &grid, &pyramid, looks);
+  }
+  struct Viewport whole = {-9, 0, 0, cols, rows};
+  viewFill(&whole, &grid, &pyramid, looks);
+  pyramidBuild(&fresh, &grid, 9, 0, rows, 0, cols);
+  for (int k = 1; k <= 9; k++) {
+    ok &= memcmp(pyramid.levels[k], fresh.levels[k],
+                 (size_t)fresh.rows[k] * fresh.cols[k]) == 0;
+  }
+  stepperFree(&stepper);
+
+  // Zoomed in, each look is the cell under its top left pixel
+  struct Viewport view = {2, -5, 7, 101, 60};
+  int row0, col0, lookRows, lookCols;
+  viewportSpan(&view, &row0, &col0, &lookRows, &lookCols);
+  viewFill(&view, &grid, &pyramid, looks);
+  for (int r = 0; r < lookRows; r++) {
+    for (int c = 0; c < lookCols; c++) {
+      int py, px, y, x;
+      viewportLookPixel(&view, r, c, &py, &px);
+      viewportCellAt(&view, px, py, &y, &x);
+      int inside = y >= 0 && y < rows && x >= 0 && x < cols;
+      ok &= looks[r * lookCols + c] ==
+            (inside ? *lifeCell(&grid, y, x) : VIEW_OUTSIDE);
+    }
+  }
+
+  struct Viewport zoomed = view;
+  viewportZoom(&zoomed, 3, 37, 11);
+  viewportZoom(&zoomed, -3, 37, 11);
+  ok &= memcmp(&zoomed, &view, sizeof(struct Viewport)) == 0;
+
+  printf("view       : %s (pyramid levels 1 to 9, %dx%d)\n",
+         ok ? "ok" : "FAILED", cols, rows);
+  pyramidFree(&pyramid);
+  pyramidFree(&fresh);
+  lifeGridFree(&grid);
+  free(looks);
+  return !ok;
+}
+
+// Every count metrics takes against the grid counted by hand: the tile
+// engine's through the tiles it stepped, across an edit and skipped
+// generations, and the bytes engine's through its copy
+int metricsCheck(void) {
+  if (!METRICS_ENABLED)
+    return 0;
+
+  const int rows = 150, cols = 230, generations = 1100;
+  const enum EngineKind kinds[2] = {ENGINE_TILES, ENGINE_BYTES};
+  struct LifeRule rule;
+  ruleParse(&rule, "life");
+  lifeSetRule(&rule);
+  uint8_t *before = malloc((size_t)rows * cols);
+  if (before == NULL) {
+    fprintf(stderr, "Failed to allocate the metrics check.\n");
+    return 1;
+  }
+
+  int failures = 0;
+  for (int i = 0; i < 2; i++) {
+    struct LifeGrid grid;
+    struct Stepper stepper;
+    struct Metrics metrics;
+    if (lifeGridInit(&grid, rows, cols) != 0) {
+      free(before);
+      return 1;
+    }
+    lifeGridRandomize(&grid, 3, 30);
+    if (stepperInit(&stepper, kinds[i], &grid, 1) != 0 ||
+        metricsInit(&metrics, rows, cols) != 0) {
+      lifeGridFree(&grid);
+      free(before);
+      return 1;
+    }
+
+    int wrong = 0;
+    for (int gen = 0; gen <= generations; gen++) {
+      if (gen > 0) {
+        if (gen == 400) {
+          for (int y = 70; y < 73; y++) {
+            for (int x = 100; x < 103; x++)
+              stepperSetCell(&stepper, y, x, 1);
+          }
+        } else if (gen == 760) {
+          stepperStep(&stepper, 5);
+          gen += 5;
+        }
+        for (int y = 0; y < rows; y++)
+          memcpy(before + (size_t)y * cols, lifeCell(&grid, y, 0), cols);
+        stepperStep(&stepper, 1);
+      }
+      metricsGeneration(&metrics, gen, 0, &grid, stepperActiveArea(&stepper),
+                        stepperSteppedTiles(&stepper));
+      if (gen % METRICS_COUNT_INTERVAL != 0)
+        continue;
+
+      uint32_t population = 0, births = 0, deaths = 0;
+      for (int y = 0; y < rows; y++) {
+        for (int x = 0; x < cols; x++) {
+          int alive = *lifeCell(&grid, y, x) == 1;
+          int wasAlive = before[(size_t)y * cols + x] == 1;
+          population += alive;
+          births += alive && !wasAlive;
+          deaths += wasAlive && !alive;
+        }
+      }
+      struct MetricsRing *ring = &metrics.generations;
+      struct GenerationSample sample;
+      memcpy(&sample,
+             ring->samples + (atomic_load(&ring->head) - 1) %
+                                 METRICS_RING_SIZE * ring->sampleSize,
+             sizeof(sample));
+      uint32_t changes = gen > 0 ? METRICS_COUNTED_CHANGES : 0;
+      if (sample.counted != (METRICS_COUNTED_POPULATION | changes) ||
+          sample.population != population ||
+          (changes && (sample.births != births || sample.deaths != deaths))) {
+        printf("metrics %s gen %d: %u/%u/%u counted, %u/%u/%u by hand\n",
+               engineName(kinds[i]), gen, sample.population, sample.births,
+               sample.deaths, population, births, deaths);
+        wrong = 1;
+      }
+    }
+
+    printf("metrics %-8s: %s\n", engineName(kinds[i]),
+           wrong ? "FAILED" : "ok");
+    failures += wrong;
+    metricsFree(&metrics);
+    stepperFree(&stepper);
+    lifeGridFree(&grid);
+  }
+
+  free(before);
+  return failures != 0;
+}
+
+struct Scenario {
+  const char *name;
+  int rows, cols;
+  uint64_t seed;
+  int density;
+  int generations;
+  const char *rule;
+  enum LifeBoundary boundary;
+  // Final grid hash with dead cells past the edge, and with the unbounded
+  // engines, which let patterns leave the window and come back
+  uint64_t boundedHash;
+  uint64_t unboundedHash;
+};
+
+static const struct Scenario scenarios[] = {
+    {"soup-64", 64, 64, 1, 25, 100, "life", LIFE_BOUNDARY_DEAD,
+     0xbd3f1743f7926df2ull, 0xd0ad3858a1064328ull},
+    {"soup-256", 256, 256, 2, 30, 500, "life", LIFE_BOUNDARY_DEAD,
+     0x1131fe66f1eb45b7ull, 0x1571c60524a2d749ull},
+    {"odd-333x97", 97, 333, 3, 40, 300, "life", LIFE_BOUNDARY_DEAD,
+     0xff1e1960d9ab19e9ull, 0x3ce0969982d48643ull},
+    {"sparse-384", 384, 384, 4, 3, 800, "life", LIFE_BOUNDARY_DEAD,
+     0xa34afb7cbb712355ull, 0xa34afb7cbb712355ull},
+    {"window", 650, 800, 5, 25, 200, "life", LIFE_BOUNDARY_DEAD,
+     0x12a1df68d3b1d180ull, 0x499d8b8f6adfa044ull},
+    {"highlife-256", 256, 256, 6, 30, 300, "highlife", LIFE_BOUNDARY_DEAD,
+     0x942aa3c64f882b69ull, 0x9fe5d4a450979038ull},
+    {"daynight-256", 256, 256, 7, 50, 300, "daynight", LIFE_BOUNDARY_DEAD,
+     0x7707e922a93acf65ull, 0xdb1ff73fd0acc3e6ull},
+    {"seeds-128", 128, 128, 8, 5, 100, "seeds", LIFE_BOUNDARY_DEAD,
+     0xa6e3dc3594239c9dull, 0xc4136a990d14a99cull},
+    // The unbounded engines can't run these, see engineSupportsRule and
+    // engineSupportsBoundary
+    {"brain-200", 200, 200, 9, 30, 200, "brain", LIFE_BOUNDARY_DEAD,
+     0x68ed314013d409afull, 0},
+    {"bosco-128", 128, 128, 10, 50, 60, "bosco", LIFE_BOUNDARY_DEAD,
+     0x3fdcd90078b15ea2ull, 0},
+    {"torus-256", 256, 256, 12, 30, 500, "life", LIFE_BOUNDARY_TORUS,
+     0xe53238280718f822ull, 0},
+    {"mirror-333x97", 97, 333, 13, 40, 300, "highlife", LIFE_BOUNDARY_MIRROR,
+     0x19c191520d4e6e90ull, 0},
+};
+
+// Runs every scenario on every engine (or only the given one), checks the
+// final hashes and prints the rates
+int runSuite(int onlyEngine, int threads) {
+  int failures = 0;
+  int count = sizeof(scenarios) / sizeof(scenarios[0]);
+
+  printRunHeader();
+  for (int i = 0; i < count; i++) {
+    const struct Scenario *scenario = &scenarios[i];
+    struct LifeRule rule;
+    ruleParse(&rule, scenario->rule);
+    lifeSetRule(&rule);
+
+    for (int kind = 0; kind < ENGINE_COUNT; kind++) {
+      if (onlyEngine >= 0 && kind != onlyEngine)
+        continue;
+      if (!engineSupportsRule(kind, &rule) ||
+          !engineSupportsBoundary(kind, &rule, scenario->boundary))
+        continue;
+
+      struct RunResult result;
+      if (runEngine(kind, threads, scenario->rows, scenario->cols,
+                    scenario->seed, scenario->density, scenario->generations,
+                    scenario->boundary, NULL, 0, NULL, &result) != 0)
+        return 1;
+
+      uint64_t expected = engineIsBounded(kind) ? scenario->boundedHash
+                                                : scenario->unboundedHash;
+      int ok = result.hash == expected;
+      failures += !ok;
+
+      printRun(scenario->name, kind, scenario->rows, scenario->cols,
+               scenario->generations, &result);
+      printf("  %s\n", ok ? "ok" : "FAIL");
+      if (!ok)
+        printf("%-14s expected %016" PRIx64 "\n", "", expected);
+    }
+  }
+
+  printf("%s\n", failures == 0 ? "All scenarios passed."
+                                : "Some scenarios FAILED.");
+  return failures != 0;
+}
+
+void usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [--engine NAME] [--kernel scalar|sse2|avx2] "
+          "[--threads N]\n"
+          "          [--seed S] [--size WxH] [--density PERCENT] "
+          "[--generations G]\n"
+          "          [--pattern FILE] [--rule RULE] "
+          "[--boundary dead|torus|mirror]\n"
+          "          [--metrics FILE.csv|FILE.json] [--cycles]\n"
+          "       %s --suite [--engine NAME]\n"
+          "       %s --check | --scaling [--engine procs] [--threads N]\n"
+          "       %s --hashlife-bench [FILE...] | --parse-bench [FILE]\n"
+          "       %s --soup-bench [--density PERCENT] [--threads N]\n"
+          "       %s --history-bench [--size WxH] [--density PERCENT] "
+          "[--rule RULE]\n"
+          "Engines: cells, bytes, threads, tiles, sparse, hashlife, procs\n"
+          "Rules: B/S notation (B36/S23), Generations (B2/S/C3), HROT\n"
+          "       (R5,C0,M1,S34..58,B34..45,NM) or life, highlife, daynight,\n"
+          "       seeds, brain, bosco\n",
+          program, program, program, program, program, program);
+}
+
+int main(int argc, char **argv) {
+  int engine = -1;
+  int threads = 0;
+  uint64_t seed = 1;
+  int rows = 650;
+  int cols = 800;
+  int density = 25;
+  int generations = 1000;
+  int suite = 0;
+  int check = 0;
+  const char *ruleText = NULL;
+  int boundary = LIFE_BOUNDARY_DEAD;
+  int scaling = 0;
+  int hashLifeBenchmark = 0;
+  char **hashLifeFiles = NULL;
+  int hashLifeFileCount = 0;
+  int parseBenchmark = 0;
+  int soupBenchmark = 0;
+  int historyBenchmark = 0;
+  const char *metricsPath = NULL;
+  int detectCycles = 0;
+  const char *patternPath = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    int hasValue = i + 1 < argc;
+    if (strcmp(argv[i], "--suite") == 0) {
+      suite = 1;
+    } else if (strcmp(argv[i], "--check") == 0) {
+      check = 1;
+    } else if (strcmp(argv[i], "--scaling") == 0) {
+      scaling = 1;
+    } else if (strcmp(argv[i], "--hashlife-bench") == 0) {
+      hashLifeBenchmark = 1;
+      hashLifeFiles = &argv[i + 1];
+      while (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+        hashLifeFileCount++;
+        i++;
+      }
+    } else if (strcmp(argv[i], "--cycles") == 0) {
+      detectCycles = 1;
+    } else if (strcmp(argv[i], "--history-bench") == 0) {
+      historyBenchmark = 1;
+    } else if (strcmp(argv[i], "--soup-bench") == 0) {
+      soupBenchmark = 1;
+    } else if (strcmp(argv[i], "--parse-bench") == 0) {
+      parseBenchmark = 1;
+      if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0)
+        patternPath = argv[++i];
+    } else if (strcmp(argv[i], "--boundary") == 0 && hasValue) {
+      boundary = lifeBoundaryFromName(argv[++i]);
+      if (boundary < 0) {
+        fprintf(stderr, "Unknown boundary: %s\n", argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--metrics") == 0 && hasValue) {
+      metricsPath = argv[++i];
+      if (!METRICS_ENABLED) {
+        fprintf(stderr, "Built without metrics, use make METRICS=1\n");
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--rule") == 0 && hasValue) {
+      ruleText = argv[++i];
+    } else if (strcmp(argv[i], "--pattern") == 0 && hasValue) {
+      patternPath = argv[++i];
+    } else if (strcmp(argv[i], "--engine") == 0 && hasValue) {
+      engine = engineFromName(argv[++i]);
+      if (engine < 0) {
+        fprintf(stderr, "Unknown engine: %s\n", argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--kernel") == 0 && hasValue) {
+      int kernel = lifeKernelFromName(argv[++i]);
+      if (kernel < 0 || lifeSetKernel(kernel) != 0) {
+        fprintf(stderr, "Kernel not available: %s\n", argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--threads") == 0 && hasValue) {
+      threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--seed") == 0 && hasValue) {
+      seed = strtoull(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "--size") == 0 && hasValue) {
+      if (sscanf(argv[++i], "%dx%d", &cols, &rows) != 2 || cols < 1 ||
+          rows < 1) {
+        fprintf(stderr, "Invalid size: %s\n", argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--density") == 0 && hasValue) {
+      density = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--generations") == 0 && hasValue) {
+      generations = atoi(argv[++i]);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (check)
+    return crossCheckRules() | boundaryCheck() | patternCheck(97, 333) |
+           historyCheck("life") | historyCheck("brain") | cycleCheck() |
+           viewCheck() | metricsCheck() | soupCheck() | hashLifeCheck();
+
+  if (scaling && engine == ENGINE_PROCS)
+    return procsScalingReport(4096, 4096, threads > 0 ? threads : 8, 50);
+  if (scaling)
+    return scalingReport(4096, 4096,
+                         threads > 0 ? threads : poolDefaultThreads(), 50);
+
+  if (hashLifeBenchmark)
+    return hashLifeBench(hashLifeFiles, hashLifeFileCount);
+
+  if (soupBenchmark)
+    return soupBench(8192, 8192, density, threads);
+
+  if (parseBenchmark)
+    return parseBench(patternPath, 8192, 8192);
+
+  if (suite)
+    return runSuite(engine, threads);
+
+  if (engine < 0)
+    engine = ENGINE_BYTES;
+
+  struct LifeRule rule;
+  if (ruleParse(&rule, ruleText != NULL ? ruleText : "life") != 0) {
+    fprintf(stderr, "Invalid rule: %s\n", ruleText);
+    return 1;
+  }
+  // A pattern runs under the rule its file names, unless --rule overrides
+  // it
+  struct LifeRule fileRule;
+  if (patternPath != NULL && ruleText == NULL) {
+    if (patternRule(patternPath, &rule) != 0)
+      return 1;
+  } else if (patternPath != NULL && patternRule(patternPath, &fileRule) == 0 &&
+             strcmp(fileRule.name, rule.name) != 0) {
+    fprintf(stderr, "%s is for %s, running it as %s as --rule says\n",
+            patternPath, fileRule.name, rule.name);
+  }
+  if (!engineSupportsRule(engine, &rule)) {
+    fprintf(stderr, "The %s engine can't run %s\n", engineName(engine),
+            rule.name);
+    return 1;
+  }
+  if (!engineSupportsBoundary(engine, &rule, boundary)) {
+    fprintf(stderr, "The %s engine can't run %s with a %s boundary\n",
+            engineName(engine), rule.name, lifeBoundaryName(boundary));
+    return 1;
+  }
+  lifeSetRule(&rule);
+
+  if (historyBenchmark)
+    return historyBench(rows, cols, seed, density, generations);
+
+  struct Metrics metrics;
+  if (metricsPath != NULL && metricsInit(&metrics, rows, cols) != 0) {
+    fprintf(stderr, "Failed to allocate metrics.\n");
+    return 1;
+  }
+
+  struct RunResult result;
+  if (runEngine(engine, threads, rows, cols, seed, density, generations,
+                boundary, patternPath, detectCycles,
+                metricsPath ? &metrics : NULL, &result) != 0)
+    return 1;
+
+  char label[32];
+  snprintf(label, sizeof(label), "%dx%d", cols, rows);
+  if (patternPath != NULL) {
+    const char *name = strrchr(patternPath, '/');
+    snprintf(label, sizeof(label), "%s", name ? name + 1 : patternPath);
+  }
+  printRunHeader();
+  printRun(label, engine, rows, cols, generations, &result);
+  printf("\n");
+
+  if (engine == ENGINE_TILES)
+    printf("Average active tiles: %.1f\n", result.activeTiles);
+  if (detectCycles && result.period > 0)
+    printf("Replaying a cycle of period %d\n", result.period);
+  else if (detectCycles)
+    printf("No cycle found\n");
+
+  if (metricsPath != NULL) {
+    int written = metricsWrite(&metrics, metricsPath);
+    metricsFree(&metrics);
+    if (written != 0)
+      return 1;
+  }
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  printf("Kernel: %s, max RSS %ld KiB\n", lifeKernelName(lifeGetKernel()),
+         usage.ru_maxrss);
+  return 0;
+}
@@ -0,0 +1,354 @@
+#include "history.h"
+#include "rule.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Rounded up to whole words for packing, the padding stays zero
+static size_t paddedCells(int rows, int cols) {
+  return ((size_t)rows * cols + 7) & ~(size_t)7;
+}
+
+static size_t frameBytes(int rows, int cols) {
+  size_t cells = paddedCells(rows, cols);
+  return lifeGetRule()->states <= 2 ? cells / 8 : cells;
+}
+
+int historyKeyframeFits(int rows, int cols, size_t budget) {
+  return frameBytes(rows, cols) <= budget;
+}
+
+int historyInit(struct LifeHistory *history, int rows, int cols,
+                int keyInterval, size_t budget) {
+  memset(history, 0, sizeof(struct LifeHistory));
+  if (!historyKeyframeFits(rows, cols, budget))
+    return -1;
+
+  history->rows = rows;
+  history->cols = cols;
+  history->keyInterval = keyInterval > 0 ? keyInterval : 1;
+  history->budget = budget;
+  history->capacity = 64;
+
+  size_t cells = paddedCells(rows, cols);
+  history->bitPacked = lifeGetRule()->states <= 2;
+  history->frameSize = frameBytes(rows, cols);
+
+  history->arena = malloc(budget);
+  history->entries = malloc(history->capacity * sizeof(struct HistoryEntry));
+  history->cells = calloc(cells, 1);
+  history->last = malloc(history->frameSize);
+  history->current = malloc(history->frameSize);
+  history->zeros = calloc(history->frameSize, 1);
+  // Worst case of the encoding, see encodeDelta
+  history->scratch = malloc(2 * history->frameSize + 16);
+  if (history->arena == NULL || history->entries == NULL ||
+      history->cells == NULL || history->last == NULL ||
+      history->current == NULL || history->zeros == NULL ||
+      history->scratch == NULL) {
+    historyFree(history);
+    return -1;
+  }
+
+  return 0;
+}
+
+void historyFree(struct LifeHistory *history) {
+  free(history->arena);
+  free(history->entries);
+  free(history->cells);
+  free(history->last);
+  free(history->current);
+  free(history->zeros);
+  free(history->scratch);
+  history->arena = NULL;
+  history->entries = NULL;
+  history->cells = NULL;
+  history->last = NULL;
+  history->current = NULL;
+  history->zeros = NULL;
+  history->scratch = NULL;
+}
+
+void historyClear(struct LifeHistory *history) {
+  history->head = 0;
+  history->start = 0;
+  history->count = 0;
+  history->sinceKeyframe = 0;
+  history->storedBytes = 0;
+}
+
+static struct HistoryEntry *entryAt(struct LifeHistory *history, int i) {
+  return &history->entries[(history->start + i) % history->capacity];
+}
+
+// Eight 0/1 bytes to one bit each, the first cell in the lowest bit
+static void packBits(const uint8_t *cells, size_t count, uint8_t *bits) {
+  for (size_t i = 0; i < count; i += 8) {
+    uint64_t word;
+    memcpy(&word, cells + i, 8);
+    bits[i / 8] = (word * 0x0102040810204080ull) >> 56;
+  }
+}
+
+static void unpackBits(const uint8_t *bits, size_t count, uint8_t *cells) {
+  for (size_t i = 0; i < count; i += 8) {
+    uint64_t word = (bits[i / 8] * 0x0101010101010101ull) &
+                    0x8040201008040201ull;
+    word = ((word + 0x7f7f7f7f7f7f7f7full) >> 7) & 0x0101010101010101ull;
+    memcpy(cells + i, &word, 8);
+  }
+}
+
+// Frames are what gets encoded: the cells, or their bits
+static void gridToFrame(struct LifeHistory *history, struct LifeGrid *grid,
+                        uint8_t *frame) {
+  uint8_t *cells = history->bitPacked ? history->cells : frame;
+  for (int y = 0; y < history->rows; y++) {
+    memcpy(cells + (size_t)y * history->cols, lifeCell(grid, y, 0),
+           history->cols);
+  }
+  if (history->bitPacked)
+    packBits(cells, history->frameSize * 8, frame);
+}
+
+static void frameToGrid(struct LifeHistory *history, const uint8_t *frame,
+                        struct LifeGrid *grid) {
+  const uint8_t *cells = frame;
+  if (history->bitPacked) {
+    unpackBits(frame, history->frameSize * 8, history->cells);
+    cells = history->cells;
+  }
+  for (int y = 0; y < history->rows; y++) {
+    memcpy(lifeCell(grid, y, 0), cells + (size_t)y * history->cols,
+           history->cols);
+  }
+}
+
+static uint8_t *putVarint(uint8_t *out, size_t value) {
+  while (value >= 0x80) {
+    *out++ = (uint8_t)value | 0x80;
+    value >>= 7;
+  }
+  *out++ = (uint8_t)value;
+  return out;
+}
+
+static size_t getVarint(const uint8_t **in) {
+  size_t value = 0;
+  int shift = 0;
+  uint8_t byte;
+  do {
+    byte = *(*in)++;
+    value |= (size_t)(byte & 0x7f) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  return value;
+}
+
+// Runs of unchanged bytes alternate with literal runs of XORed bytes, as
+// varint lengths. A literal run only ends at two unchanged bytes in a row,
+// a single one costs more to skip than to copy. Trailing unchanged bytes are
+// implied. No varint is longer than the run it describes, so the output is
+// at most 2 * count + 1 bytes.
+static size_t encodeDelta(const uint8_t *frame, const uint8_t *base,
+                          size_t count, uint8_t *out) {
+  uint8_t *start = out;
+  size_t i = 0;
+  while (i < count) {
+    size_t same = i;
+    while (i + 8 <= count) {
+      uint64_t now, before;
+      memcpy(&now, frame + i, 8);
+      memcpy(&before, base + i, 8);
+      if (now != before)
+        break;
+      i += 8;
+    }
+    while (i < count && frame[i] == base[i]) {
+      i++;
+    }
+    if (i == count)
+      break;
+
+    size_t changed = i;
+    while (i < count && (frame[i] != base[i] ||
+                         (i + 1 < count && frame[i + 1] != base[i + 1]))) {
+      i++;
+    }
+
+    out = putVarint(out, changed - same);
+    out = putVarint(out, i - changed);
+    for (size_t k = changed; k < i; k++) {
+      *out++ = frame[k] ^ base[k];
+    }
+  }
+
+  return out - start;
+}
+
+static void applyDelta(const uint8_t *data, size_t size, uint8_t *frame) {
+  const uint8_t *end = data + size;
+  size_t i = 0;
+  while (data < end) {
+    i += getVarint(&data);
+    size_t length = getVarint(&data);
+    for (size_t k = 0; k < length; k++) {
+      frame[i + k] ^= data[k];
+    }
+    data += length;
+    i += length;
+  }
+}
+
+static void dropOldest(struct LifeHistory *history) {
+  history->storedBytes -= entryAt(history, 0)->size;
+  history->start = (history->start + 1) % history->capacity;
+  history->count--;
+}
+
+// Deltas can't be decoded without their keyframe, so they go with it
+static void dropGroup(struct LifeHistory *history) {
+  dropOldest(history);
+  while (history->count > 0 && !entryAt(history, 0)->keyframe) {
+    dropOldest(history);
+  }
+}
+
+// Finds room for size bytes after the newest entry, wrapping to the start
+// of the arena when the end is too short. The entries in the way are always
+// the oldest ones.
+static size_t reserve(struct LifeHistory *history, size_t size) {
+  size_t offset = history->head;
+  if (offset + size > history->budget)
+    offset = 0;
+
+  while (history->count > 0) {
+    struct HistoryEntry *oldest = entryAt(history, 0);
+    if (oldest->offset >= offset + size ||
+        oldest->offset + oldest->size <= offset)
+      break;
+    dropGroup(history);
+  }
+
+  return offset;
+}
+
+static int growEntries(struct LifeHistory *history) {
+  int capacity = history->capacity * 2;
+  struct HistoryEntry *entries =
+      malloc(capacity * sizeof(struct HistoryEntry));
+  if (entries == NULL)
+    return -1;
+
+  for (int i = 0; i < history->count; i++) {
+    entries[i] = *entryAt(history, i);
+  }
+  free(history->entries);
+  history->entries = entries;
+  history->capacity = capacity;
+  history->start = 0;
+  return 0;
+}
+
+int historyRecord(struct LifeHistory *history, uint64_t generation,
+                  struct LifeGrid *grid) {
+  // A generation that was already recorded means the world went back or
+  // was edited, and the newer entries no longer follow from it
+  int branched = 0;
+  while (history->count > 0 &&
+         entryAt(history, history->count - 1)->generation >= generation) {
+    history->storedBytes -= entryAt(history, history->count - 1)->size;
+    history->count--;
+    branched = 1;
+  }
+  if (history->count == 0) {
+    history->head = 0;
+  } else if (branched) {
+    struct HistoryEntry *newest = entryAt(history, history->count - 1);
+    history->head = newest->offset + newest->size;
+  }
+
+  gridToFrame(history, grid, history->current);
+
+  // The last buffer only matches the newest entry if nothing was dropped
+  int keyframe = history->count == 0 || branched ||
+                 history->sinceKeyframe + 1 >= history->keyInterval;
+  size_t size =
+      encodeDelta(history->current, keyframe ? history->zeros : history->last,
+                  history->frameSize, history->scratch);
+  size_t offset = size <= history->budget ? reserve(history, size) : 0;
+
+  // Making room dropped the keyframe this delta was based on
+  if (!keyframe && (history->count == 0 || size > history->budget)) {
+    historyClear(history);
+    keyframe = 1;
+    size = encodeDelta(history->current, history->zeros, history->frameSize,
+                       history->scratch);
+    offset = 0;
+  }
+  if (size > history->budget) {
+    historyClear(history);
+    return -1;
+  }
+
+  if (history->count == history->capacity && growEntries(history) != 0)
+    return -1;
+
+  memcpy(history->arena + offset, history->scratch, size);
+  history->head = offset + size;
+  *entryAt(history, history->count) =
+      (struct HistoryEntry){generation, offset, size, keyframe};
+  history->count++;
+  history->storedBytes += size;
+  history->sinceKeyframe = keyframe ? 0 : history->sinceKeyframe + 1;
+
+  uint8_t *last = history->last;
+  history->last = history->current;
+  history->current = last;
+  return 0;
+}
+
+int historyRange(struct LifeHistory *history, uint64_t *first,
+                 uint64_t *last) {
+  if (history->count == 0)
+    return 0;
+
+  *first = entryAt(history, 0)->generation;
+  *last = entryAt(history, history->count - 1)->generation;
+  return 1;
+}
+
+int historySeek(struct LifeHistory *history, uint64_t generation,
+                struct LifeGrid *grid, uint64_t *found) {
+  if (history->count == 0 || entryAt(history, 0)->generation > generation)
+    return -1;
+
+  // Newest entry at or before the generation
+  int low = 0, high = history->count - 1;
+  while (low < high) {
+    int middle = (low + high + 1) / 2;
+    if (entryAt(history, middle)->generation <= generation) {
+      low = middle;
+    } else {
+      high = middle - 1;
+    }
+  }
+
+  int key = low;
+  while (!entryAt(history, key)->keyframe) {
+    key--;
+  }
+
+  // current is only used while recording, so it can hold the decoded frame
+  uint8_t *frame = history->current;
+  memset(frame, 0, history->frameSize);
+  for (int i = key; i <= low; i++) {
+    struct HistoryEntry *entry = entryAt(history, i);
+    applyDelta(history->arena + entry->offset, entry->size, frame);
+  }
+
+  frameToGrid(history, frame, grid);
+  *found = entryAt(history, low)->generation;
+  return 0;
+}
@@ -0,0 +1,82 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "life.h"
+
+// One recorded generation. Keyframes hold the whole grid, the others only
+// what changed since the entry before them; both as runs of unchanged
+// bytes and literal XOR bytes.
+struct HistoryEntry {
+  uint64_t generation;
+  size_t offset;
+  size_t size;
+  int keyframe;
+};
+
+// Past generations of a grid, kept in a fixed arena of budget bytes. The
+// oldest keyframe and the deltas after it are dropped to make room, so
+// whatever is left always starts at a keyframe, and a seek decodes one
+// keyframe and at most keyInterval - 1 deltas. With a two-state rule active
+// at init, frames are packed to a bit per cell before encoding.
+struct LifeHistory {
+  int rows, cols;
+  int keyInterval;
+
+  uint8_t *arena;
+  size_t budget;
+  // Where the next entry goes
+  size_t head;
+
+  // Ring of entries, oldest first, in increasing generation order
+  struct HistoryEntry *entries;
+  int capacity;
+  int start;
+  int count;
+  int sinceKeyframe;
+
+  int bitPacked;
+  size_t frameSize;
+  // Cells without the halo, a byte each
+  uint8_t *cells;
+
+  // Frames of the newest entry and of the one being recorded; zeros is the
+  // base of keyframes
+  uint8_t *last;
+  uint8_t *current;
+  uint8_t *zeros;
+  uint8_t *scratch;
+
+  // Encoded bytes of the entries kept
+  size_t storedBytes;
+};
+
+// A keyframe of a busy grid takes about a frame: a bit per cell with a
+// two-state rule active, a byte otherwise. Returns 0 if that is more than
+// the budget, and history would turn off at the first busy generation.
+int historyKeyframeFits(int rows, int cols, size_t budget);
+
+// Returns -1 if a keyframe doesn't fit the budget, or out of memory
+int historyInit(struct LifeHistory *history, int rows, int cols,
+                int keyInterval, size_t budget);
+void historyFree(struct LifeHistory *history);
+void historyClear(struct LifeHistory *history);
+
+// Records the grid as the given generation. Anything at or after it is
+// dropped first, so recording an edited grid starts a new branch. Returns -1
+// if a single keyframe doesn't fit the budget.
+int historyRecord(struct LifeHistory *history, uint64_t generation,
+                  struct LifeGrid *grid);
+
+// Oldest and newest generations kept, 0 if there are none
+int historyRange(struct LifeHistory *history, uint64_t *first,
+                 uint64_t *last);
+
+// Restores the newest kept generation at or before the given one into the
+// grid and stores it in found. Returns -1 if there is none.
+int historySeek(struct LifeHistory *history, uint64_t generation,
+                struct LifeGrid *grid, uint64_t *found);
+
+#endif
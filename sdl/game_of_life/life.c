@@ -0,0 +1,424 @@
+#include "life.h"
+#include "rule.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LIFE_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+typedef void (*StepRowsFn)(const uint8_t *cur, uint8_t *next, int stride,
+                           int cols, int yStart, int yEnd);
+
+static const char *kernelNames[LIFE_KERNEL_COUNT] = {"scalar", "sse2",
+                                                     "avx2"};
+static const char *boundaryNames[LIFE_BOUNDARY_COUNT] = {"dead", "torus",
+                                                         "mirror"};
+
+int lifeGridInit(struct LifeGrid *grid, int rows, int cols) {
+  grid->rows = rows;
+  grid->cols = cols;
+  // Round up to whole AVX2 vectors, plus one spare vector so the loads of
+  // the last chunk (which reach two cells to the right) stay in the row
+  grid->stride = ((cols + 31) / 32) * 32 + 32;
+
+  size_t size = (size_t)(rows + 2) * grid->stride;
+  grid->cells = aligned_alloc(32, size);
+  grid->next = aligned_alloc(32, size);
+  if (grid->cells == NULL || grid->next == NULL) {
+    lifeGridFree(grid);
+    return -1;
+  }
+
+  memset(grid->cells, 0, size);
+  memset(grid->next, 0, size);
+  grid->boundary = LIFE_BOUNDARY_DEAD;
+  return 0;
+}
+
+void lifeGridFree(struct LifeGrid *grid) {
+  free(grid->cells);
+  free(grid->next);
+  grid->cells = NULL;
+  grid->next = NULL;
+}
+
+void lifeGridClear(struct LifeGrid *grid) {
+  memset(grid->cells, 0, (size_t)(grid->rows + 2) * grid->stride);
+}
+
+void lifeGridSetBoundary(struct LifeGrid *grid, enum LifeBoundary boundary) {
+  grid->boundary = boundary;
+  if (boundary != LIFE_BOUNDARY_DEAD)
+    return;
+
+  // Clear what an earlier mode left in the halo
+  size_t last = (size_t)(grid->rows + 1) * grid->stride;
+  memset(grid->cells, 0, grid->stride);
+  memset(grid->cells + last, 0, grid->stride);
+  for (int y = 0; y < grid->rows; y++) {
+    *lifeCell(grid, y, -1) = 0;
+    *lifeCell(grid, y, grid->cols) = 0;
+  }
+}
+
+const char *lifeBoundaryName(enum LifeBoundary boundary) {
+  return boundaryNames[boundary];
+}
+
+int lifeBoundaryFromName(const char *name) {
+  for (int i = 0; i < LIFE_BOUNDARY_COUNT; i++) {
+    if (strcmp(name, boundaryNames[i]) == 0)
+      return i;
+  }
+
+  return -1;
+}
+
+void lifeRefreshHalo(struct LifeGrid *grid) {
+  if (grid->boundary == LIFE_BOUNDARY_DEAD)
+    return;
+
+  int rows = grid->rows;
+  int cols = grid->cols;
+  int torus = grid->boundary == LIFE_BOUNDARY_TORUS;
+
+  for (int y = 0; y < rows; y++) {
+    uint8_t *row = lifeCell(grid, y, 0);
+    row[-1] = torus ? row[cols - 1] : row[0];
+    row[cols] = torus ? row[0] : row[cols - 1];
+  }
+
+  // Whole rows, so the corners come along with the side columns
+  memcpy(lifeCell(grid, -1, -1), lifeCell(grid, torus ? rows - 1 : 0, -1),
+         cols + 2);
+  memcpy(lifeCell(grid, rows, -1), lifeCell(grid, torus ? 0 : rows - 1, -1),
+         cols + 2);
+}
+
+static uint64_t splitMix64(uint64_t *state) {
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+void lifeGridRandomize(struct LifeGrid *grid, uint64_t seed, int density) {
+  uint64_t state = seed;
+  for (int y = 0; y < grid->rows; y++) {
+    uint8_t *row = lifeCell(grid, y, 0);
+    for (int x = 0; x < grid->cols; x++) {
+      row[x] = splitMix64(&state) % 100 < (uint64_t)density;
+    }
+  }
+}
+
+uint64_t lifeGridPopulation(struct LifeGrid *grid) {
+  uint64_t population = 0;
+  for (int y = 0; y < grid->rows; y++) {
+    const uint8_t *row = lifeCell(grid, y, 0);
+    for (int x = 0; x < grid->cols; x++) {
+      population += row[x] == 1;
+    }
+  }
+
+  return population;
+}
+
+uint64_t lifeGridHash(struct LifeGrid *grid) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (int y = 0; y < grid->rows; y++) {
+    const uint8_t *row = lifeCell(grid, y, 0);
+    for (int x = 0; x < grid->cols; x++) {
+      hash = (hash ^ row[x]) * 0x100000001b3ull;
+    }
+  }
+
+  return hash;
+}
+
+int getNeighbors(int y, int x, int rows, int cols, int neighbors[8][2]) {
+  int offsets[8][2] = {
+      {-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1},
+  };
+
+  int count = 0;
+  for (int i = 0; i < 8; i++) {
+    int neighborY = y + offsets[i][0];
+    int neighborX = x + offsets[i][1];
+
+    if (neighborY < 0 || neighborY >= rows || neighborX < 0 ||
+        neighborX >= cols)
+      continue;
+
+    neighbors[count][0] = neighborY;
+    neighbors[count][1] = neighborX;
+    count++;
+  }
+
+  return count;
+}
+
+// Active rule, B3/S23 until lifeSetRule is called
+static struct LifeRule activeRule = {
+    .family = RULE_LIFE,
+    .name = "B3/S23",
+    .birth = 1 << 3,
+    .survive = (1 << 2) | (1 << 3),
+    .table = {0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0},
+    .states = 2,
+    .range = 1,
+};
+static int activeConway = 1;
+
+void lifeSetRule(const struct LifeRule *rule) {
+  activeRule = *rule;
+  activeConway = ruleIsConway(rule);
+}
+
+const struct LifeRule *lifeGetRule(void) { return &activeRule; }
+
+int nextCellState(struct LifeGrid *grid, int y, int x) {
+  int state = *lifeCell(grid, y, x);
+  int aliveNeighbors = 0;
+
+  if (activeRule.family == RULE_LARGER) {
+    int range = activeRule.range;
+    for (int ny = y - range; ny <= y + range; ny++) {
+      for (int nx = x - range; nx <= x + range; nx++) {
+        if (ny < 0 || ny >= grid->rows || nx < 0 || nx >= grid->cols)
+          continue;
+        if (ny == y && nx == x && !activeRule.middle)
+          continue;
+        aliveNeighbors += *lifeCell(grid, ny, nx) == 1;
+      }
+    }
+
+    return ruleNextState(&activeRule, state, aliveNeighbors);
+  }
+
+  // The halo stands in for whatever is past the edge
+  for (int dy = -1; dy <= 1; dy++) {
+    const uint8_t *row = lifeCell(grid, y + dy, x);
+    aliveNeighbors += (row[-1] == 1) + (row[0] == 1) + (row[1] == 1);
+  }
+  aliveNeighbors -= state == 1;
+
+  return ruleNextState(&activeRule, state, aliveNeighbors);
+}
+
+void nextGeneration(struct LifeGrid *grid) {
+  lifeRefreshHalo(grid);
+  for (int y = 0; y < grid->rows; y++) {
+    uint8_t *out = grid->next + (size_t)(y + 1) * grid->stride + 1;
+    for (int x = 0; x < grid->cols; x++) {
+      out[x] = nextCellState(grid, y, x);
+    }
+  }
+
+  lifeSwap(grid);
+}
+
+static void stepRowsScalar(const uint8_t *cur, uint8_t *next, int stride,
+                           int cols, int yStart, int yEnd) {
+  for (int y = yStart; y < yEnd; y++) {
+    // Padded row y is the row above grid row y
+    const uint8_t *up = cur + (size_t)y * stride;
+    const uint8_t *mid = up + stride;
+    const uint8_t *down = mid + stride;
+    uint8_t *out = next + (size_t)(y + 1) * stride + 1;
+
+    for (int x = 0; x < cols; x++) {
+      int n = up[x] + up[x + 1] + up[x + 2] + mid[x] + mid[x + 2] + down[x] +
+              down[x + 1] + down[x + 2];
+      out[x] = (n == 3) | ((n == 2) & mid[x + 1]);
+    }
+  }
+}
+
+#ifdef LIFE_X86
+__attribute__((target("sse2"))) static void
+stepRowsSse2(const uint8_t *cur, uint8_t *next, int stride, int cols,
+             int yStart, int yEnd) {
+  const __m128i one = _mm_set1_epi8(1);
+  const __m128i two = _mm_set1_epi8(2);
+  const __m128i three = _mm_set1_epi8(3);
+
+  for (int y = yStart; y < yEnd; y++) {
+    const uint8_t *up = cur + (size_t)y * stride;
+    const uint8_t *mid = up + stride;
+    const uint8_t *down = mid + stride;
+    uint8_t *out = next + (size_t)(y + 1) * stride + 1;
+
+    int x = 0;
+    for (; x < cols; x += 16) {
+      __m128i n = _mm_loadu_si128((const __m128i *)(up + x));
+      n = _mm_add_epi8(n, _mm_loadu_si128((const __m128i *)(up + x + 1)));
+      n = _mm_add_epi8(n, _mm_loadu_si128((const __m128i *)(up + x + 2)));
+      n = _mm_add_epi8(n, _mm_loadu_si128((const __m128i *)(mid + x)));
+      n = _mm_add_epi8(n, _mm_loadu_si128((const __m128i *)(mid + x + 2)));
+      n = _mm_add_epi8(n, _mm_loadu_si128((const __m128i *)(down + x)));
+      n = _mm_add_epi8(n, _mm_loadu_si128((const __m128i *)(down + x + 1)));
+      n = _mm_add_epi8(n, _mm_loadu_si128((const __m128i *)(down + x + 2)));
+
+      // alive = (n == 3) | (n == 2 & self), self is already 0 or 1
+      __m128i self = _mm_loadu_si128((const __m128i *)(mid + x + 1));
+      __m128i born = _mm_and_si128(_mm_cmpeq_epi8(n, three), one);
+      __m128i stay = _mm_and_si128(_mm_cmpeq_epi8(n, two), self);
+      _mm_storeu_si128((__m128i *)(out + x), _mm_or_si128(born, stay));
+    }
+
+    // The last vector spills into the right border, which has to stay dead
+    memset(out + cols, 0, x - cols);
+  }
+}
+
+__attribute__((target("avx2"))) static void
+stepRowsAvx2(const uint8_t *cur, uint8_t *next, int stride, int cols,
+             int yStart, int yEnd) {
+  const __m256i one = _mm256_set1_epi8(1);
+  const __m256i two = _mm256_set1_epi8(2);
+  const __m256i three = _mm256_set1_epi8(3);
+
+  for (int y = yStart; y < yEnd; y++) {
+    const uint8_t *up = cur + (size_t)y * stride;
+    const uint8_t *mid = up + stride;
+    const uint8_t *down = mid + stride;
+    uint8_t *out = next + (size_t)(y + 1) * stride + 1;
+
+    int x = 0;
+    for (; x < cols; x += 32) {
+      __m256i n = _mm256_loadu_si256((const __m256i *)(up + x));
+      n = _mm256_add_epi8(n, _mm256_loadu_si256((const __m256i *)(up + x + 1)));
+      n = _mm256_add_epi8(n, _mm256_loadu_si256((const __m256i *)(up + x + 2)));
+      n = _mm256_add_epi8(n, _mm256_loadu_si256((const __m256i *)(mid + x)));
+      n = _mm256_add_epi8(n,
+                          _mm256_loadu_si256((const __m256i *)(mid + x + 2)));
+      n = _mm256_add_epi8(n, _mm256_loadu_si256((const __m256i *)(down + x)));
+      n = _mm256_add_epi8(n,
+                          _mm256_loadu_si256((const __m256i *)(down + x + 1)));
+      n = _mm256_add_epi8(n,
+                          _mm256_loadu_si256((const __m256i *)(down + x + 2)));
+
+      __m256i self = _mm256_loadu_si256((const __m256i *)(mid + x + 1));
+      __m256i born = _mm256_and_si256(_mm256_cmpeq_epi8(n, three), one);
+      __m256i stay = _mm256_and_si256(_mm256_cmpeq_epi8(n, two), self);
+      _mm256_storeu_si256((__m256i *)(out + x), _mm256_or_si256(born, stay));
+    }
+
+    memset(out + cols, 0, x - cols);
+  }
+}
+#endif
+
+static const StepRowsFn kernels[LIFE_KERNEL_COUNT] = {
+    stepRowsScalar,
+#ifdef LIFE_X86
+    stepRowsSse2,
+    stepRowsAvx2,
+#else
+    NULL,
+    NULL,
+#endif
+};
+
+int lifeKernelSupported(enum LifeKernel kernel) {
+  if (kernel == LIFE_KERNEL_SCALAR)
+    return 1;
+
+#ifdef LIFE_X86
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return 0;
+
+  if (kernel == LIFE_KERNEL_SSE2)
+    return (edx & bit_SSE2) != 0;
+
+  if (kernel == LIFE_KERNEL_AVX2) {
+    // The OS has to save the YMM registers too (OSXSAVE + XCR0 bits 1 and 2)
+    if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX))
+      return 0;
+
+    unsigned int xcr0Lo, xcr0Hi;
+    __asm__("xgetbv" : "=a"(xcr0Lo), "=d"(xcr0Hi) : "c"(0));
+    if ((xcr0Lo & 0x6) != 0x6)
+      return 0;
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+      return 0;
+    return (ebx & bit_AVX2) != 0;
+  }
+#endif
+
+  return 0;
+}
+
+enum LifeKernel lifeDetectKernel(void) {
+  if (lifeKernelSupported(LIFE_KERNEL_AVX2))
+    return LIFE_KERNEL_AVX2;
+  if (lifeKernelSupported(LIFE_KERNEL_SSE2))
+    return LIFE_KERNEL_SSE2;
+  return LIFE_KERNEL_SCALAR;
+}
+
+const char *lifeKernelName(enum LifeKernel kernel) {
+  return kernelNames[kernel];
+}
+
+int lifeKernelFromName(const char *name) {
+  for (int i = 0; i < LIFE_KERNEL_COUNT; i++) {
+    if (strcmp(name, kernelNames[i]) == 0)
+      return i;
+  }
+
+  return -1;
+}
+
+static int activeKernel = -1;
+
+int lifeSetKernel(enum LifeKernel kernel) {
+  if (!lifeKernelSupported(kernel))
+    return -1;
+
+  activeKernel = kernel;
+  return 0;
+}
+
+enum LifeKernel lifeGetKernel(void) {
+  if (activeKernel < 0)
+    activeKernel = lifeDetectKernel();
+
+  return activeKernel;
+}
+
+void lifeStepRows(struct LifeGrid *grid, int yStart, int yEnd) {
+  lifeStepRect(grid, yStart, yEnd, 0, grid->cols);
+}
+
+// B3/S23 keeps its hardcoded kernels, other rules go through rule.c
+void lifeStepRect(struct LifeGrid *grid, int yStart, int yEnd, int xStart,
+                  int xEnd) {
+  if (!activeConway) {
+    ruleStepRect(&activeRule, lifeGetKernel(), grid, yStart, yEnd, xStart,
+                 xEnd);
+    return;
+  }
+
+  kernels[lifeGetKernel()](grid->cells + xStart, grid->next + xStart,
+                           grid->stride, xEnd - xStart, yStart, yEnd);
+}
+
+void lifeSwap(struct LifeGrid *grid) {
+  uint8_t *tmp = grid->cells;
+  grid->cells = grid->next;
+  grid->next = tmp;
+}
+
+void lifeStep(struct LifeGrid *grid) {
+  lifeRefreshHalo(grid);
+  lifeStepRows(grid, 0, grid->rows);
+  lifeSwap(grid);
+}
@@ -0,0 +1,99 @@
+#ifndef LIFE_H
+#define LIFE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// What lies past the edge of a bounded grid
+enum LifeBoundary {
+  LIFE_BOUNDARY_DEAD,
+  // The edges wrap around
+  LIFE_BOUNDARY_TORUS,
+  // Every edge cell sees itself reflected past the edge
+  LIFE_BOUNDARY_MIRROR,
+  LIFE_BOUNDARY_COUNT
+};
+
+// Byte-per-cell grid: every cell is a single 0/1 byte, so a cell can still be
+// read and written directly. Each row is padded with a halo cell on both
+// sides (and a halo row above and below the grid), and the stride is
+// rounded up so the SIMD kernels can always load full vectors. The halo
+// holds what the boundary mode puts past the edge, so no kernel ever checks
+// a neighbour against the grid size.
+struct LifeGrid {
+  int rows, cols;
+  int stride;
+  uint8_t *cells;
+  uint8_t *next;
+  enum LifeBoundary boundary;
+};
+
+enum LifeKernel {
+  LIFE_KERNEL_SCALAR,
+  LIFE_KERNEL_SSE2,
+  LIFE_KERNEL_AVX2,
+  LIFE_KERNEL_COUNT
+};
+
+// New grids have a dead boundary
+int lifeGridInit(struct LifeGrid *grid, int rows, int cols);
+void lifeGridFree(struct LifeGrid *grid);
+void lifeGridClear(struct LifeGrid *grid);
+
+void lifeGridSetBoundary(struct LifeGrid *grid, enum LifeBoundary boundary);
+const char *lifeBoundaryName(enum LifeBoundary boundary);
+int lifeBoundaryFromName(const char *name);
+// Copies the edge cells into the halo for the torus and mirror modes. The
+// steppers call it once per generation before any row is stepped; a dead
+// halo is never written, so callers that fill the halo themselves (the
+// sparse chunks) keep what they put there.
+void lifeRefreshHalo(struct LifeGrid *grid);
+
+// Fills the grid with a soup in which each cell is alive with the given
+// percent chance. Uses its own generator, so a seed gives the same soup on
+// every platform. One draw per cell: the regression suite's soups come from
+// here, soupFillGrid (soup.h) seeds large worlds.
+void lifeGridRandomize(struct LifeGrid *grid, uint64_t seed, int density);
+// Live cells only, the dying states of Generations rules don't count
+uint64_t lifeGridPopulation(struct LifeGrid *grid);
+// FNV-1a over the cells, row by row, without the border
+uint64_t lifeGridHash(struct LifeGrid *grid);
+
+static inline uint8_t *lifeCell(struct LifeGrid *grid, int y, int x) {
+  return &grid->cells[(size_t)(y + 1) * grid->stride + x + 1];
+}
+
+// Rule every kernel steps with, see rule.h. Defaults to B3/S23.
+struct LifeRule;
+void lifeSetRule(const struct LifeRule *rule);
+const struct LifeRule *lifeGetRule(void);
+
+// Reference implementation, which visits the neighbours of every cell one
+// at a time through the halo. Slow, but simple enough to check the kernels
+// against. getNeighbors fills the {y, x} pairs of the in-bounds neighbours
+// and returns how many there are.
+int getNeighbors(int y, int x, int rows, int cols, int neighbors[8][2]);
+int nextCellState(struct LifeGrid *grid, int y, int x);
+void nextGeneration(struct LifeGrid *grid);
+
+// Best kernel the CPU (and OS) supports, as reported by CPUID
+enum LifeKernel lifeDetectKernel(void);
+int lifeKernelSupported(enum LifeKernel kernel);
+const char *lifeKernelName(enum LifeKernel kernel);
+int lifeKernelFromName(const char *name);
+
+// Returns -1 if the kernel is not supported on this machine
+int lifeSetKernel(enum LifeKernel kernel);
+enum LifeKernel lifeGetKernel(void);
+
+// Computes rows [yStart, yEnd) of the next generation into grid->next
+void lifeStepRows(struct LifeGrid *grid, int yStart, int yEnd);
+// Same for the columns [xStart, xEnd) of those rows only. The vector kernels
+// write whole vectors, so xEnd - xStart has to be a multiple of 32 unless
+// xEnd is the last column.
+void lifeStepRect(struct LifeGrid *grid, int yStart, int yEnd, int xStart,
+                  int xEnd);
+void lifeSwap(struct LifeGrid *grid);
+void lifeStep(struct LifeGrid *grid);
+
+#endif
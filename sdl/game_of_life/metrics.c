@@ -0,0 +1,365 @@
+#include "metrics.h"
+#include "tiles.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define METRICS_X86 1
+#include <immintrin.h>
+#endif
+
+static int ringInit(struct MetricsRing *ring, size_t sampleSize) {
+  ring->samples = calloc(METRICS_RING_SIZE, sampleSize);
+  ring->sampleSize = sampleSize;
+  atomic_init(&ring->head, 0);
+  return ring->samples == NULL ? -1 : 0;
+}
+
+// Release, so a reader that sees the new head sees the sample too
+static void ringPush(struct MetricsRing *ring, const void *sample) {
+  unsigned long long head =
+      atomic_load_explicit(&ring->head, memory_order_relaxed);
+  memcpy(ring->samples + (head % METRICS_RING_SIZE) * ring->sampleSize,
+         sample, ring->sampleSize);
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+// Copies the samples kept into out, oldest first, and returns how many
+// survived the copy. The writer may be reusing the oldest slots meanwhile,
+// so those are dropped once the copy is done.
+static size_t ringSnapshot(struct MetricsRing *ring, unsigned char *out) {
+  unsigned long long head =
+      atomic_load_explicit(&ring->head, memory_order_acquire);
+  unsigned long long first =
+      head > METRICS_RING_SIZE ? head - METRICS_RING_SIZE : 0;
+  for (unsigned long long i = first; i < head; i++) {
+    memcpy(out + (i - first) * ring->sampleSize,
+           ring->samples + (i % METRICS_RING_SIZE) * ring->sampleSize,
+           ring->sampleSize);
+  }
+
+  atomic_thread_fence(memory_order_acquire);
+  unsigned long long now =
+      atomic_load_explicit(&ring->head, memory_order_relaxed);
+  // The slot of sample now is being written, and it was sample
+  // now - METRICS_RING_SIZE
+  unsigned long long valid =
+      now >= METRICS_RING_SIZE ? now - METRICS_RING_SIZE + 1 : 0;
+  if (valid <= first)
+    return head - first;
+  if (valid >= head)
+    return 0;
+
+  size_t dropped = valid - first;
+  memmove(out, out + dropped * ring->sampleSize,
+          (head - valid) * ring->sampleSize);
+  return head - valid;
+}
+
+// Population, births and deaths of a row, alive being state 1 as in
+// lifeGridPopulation
+static void countRowScalar(const uint8_t *cells, const uint8_t *previous,
+                           int cols, uint32_t counts[3]) {
+  for (int x = 0; x < cols; x++) {
+    uint32_t alive = cells[x] == 1;
+    uint32_t wasAlive = previous[x] == 1;
+    counts[0] += alive;
+    counts[1] += alive & !wasAlive;
+    counts[2] += wasAlive & !alive;
+  }
+}
+
+#ifdef METRICS_X86
+// A count reads the whole grid, or all the tiles stepped since the last one,
+// so it gets the same vector treatment as the step
+__attribute__((target("avx2"))) static void
+countRowAvx2(const uint8_t *cells, const uint8_t *previous, int cols,
+             uint32_t counts[3]) {
+  const __m256i one = _mm256_set1_epi8(1);
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i population = zero, births = zero, deaths = zero;
+
+  int x = 0;
+  for (; x + 32 <= cols; x += 32) {
+    __m256i now = _mm256_loadu_si256((const __m256i *)(cells + x));
+    __m256i before = _mm256_loadu_si256((const __m256i *)(previous + x));
+    __m256i alive = _mm256_and_si256(_mm256_cmpeq_epi8(now, one), one);
+    __m256i wasAlive = _mm256_and_si256(_mm256_cmpeq_epi8(before, one), one);
+
+    // Byte sums into four 64-bit lanes
+    population = _mm256_add_epi64(population, _mm256_sad_epu8(alive, zero));
+    births = _mm256_add_epi64(
+        births, _mm256_sad_epu8(_mm256_andnot_si256(wasAlive, alive), zero));
+    deaths = _mm256_add_epi64(
+        deaths, _mm256_sad_epu8(_mm256_andnot_si256(alive, wasAlive), zero));
+  }
+
+  uint64_t lanes[4];
+  __m256i *sums[3] = {&population, &births, &deaths};
+  for (int i = 0; i < 3; i++) {
+    _mm256_storeu_si256((__m256i *)lanes, *sums[i]);
+    counts[i] += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  }
+
+  countRowScalar(cells + x, previous + x, cols - x, counts);
+}
+#endif
+
+int metricsInit(struct Metrics *metrics, int rows, int cols) {
+  memset(metrics, 0, sizeof(struct Metrics));
+  metrics->rows = rows;
+  metrics->cols = cols;
+  metrics->previous = malloc((size_t)rows * cols);
+  metrics->tileRows = (rows + TILE_SIZE - 1) / TILE_SIZE;
+  metrics->tileCols = (cols + TILE_SIZE - 1) / TILE_SIZE;
+  size_t tileCount = (size_t)metrics->tileRows * metrics->tileCols;
+  metrics->tilePopulation = calloc(tileCount, sizeof(uint32_t));
+  metrics->tileDirty = calloc(tileCount, 1);
+  metrics->allTilesDirty = 1;
+  metrics->countRow = countRowScalar;
+#ifdef METRICS_X86
+  if (lifeKernelSupported(LIFE_KERNEL_AVX2))
+    metrics->countRow = countRowAvx2;
+#endif
+  if (metrics->previous == NULL || metrics->tilePopulation == NULL ||
+      metrics->tileDirty == NULL ||
+      ringInit(&metrics->generations, sizeof(struct GenerationSample)) != 0 ||
+      ringInit(&metrics->frames, sizeof(struct FrameSample)) != 0) {
+    metricsFree(metrics);
+    return -1;
+  }
+
+  return 0;
+}
+
+void metricsFree(struct Metrics *metrics) {
+  free(metrics->generations.samples);
+  free(metrics->frames.samples);
+  free(metrics->previous);
+  free(metrics->tilePopulation);
+  free(metrics->tileDirty);
+  metrics->generations.samples = NULL;
+  metrics->frames.samples = NULL;
+  metrics->previous = NULL;
+  metrics->tilePopulation = NULL;
+  metrics->tileDirty = NULL;
+}
+
+// Counts the whole grid, against the copy of the generation before if there
+// is one
+static void countGrid(struct Metrics *metrics, uint64_t generation,
+                      struct LifeGrid *grid, struct GenerationSample *sample) {
+  int changes =
+      metrics->previousValid && metrics->previousGeneration + 1 == generation;
+  uint32_t counts[3] = {0, 0, 0};
+  for (int y = 0; y < metrics->rows; y++) {
+    const uint8_t *cells = lifeCell(grid, y, 0);
+    metrics->countRow(cells,
+                      changes ? metrics->previous + (size_t)y * metrics->cols
+                              : cells,
+                      metrics->cols, counts);
+  }
+
+  sample->population = counts[0];
+  sample->births = counts[1];
+  sample->deaths = counts[2];
+  sample->counted = METRICS_COUNTED_POPULATION |
+                    (changes ? METRICS_COUNTED_CHANGES : 0);
+}
+
+// Counts the tiles stepped since the last count against the grid's next
+// buffer, the generation before. The others kept their population, and
+// hold the same cells in both buffers.
+static void countTiles(struct Metrics *metrics, struct LifeGrid *grid,
+                       struct GenerationSample *sample) {
+  if (metrics->allTilesDirty) {
+    size_t tileCount = (size_t)metrics->tileRows * metrics->tileCols;
+    memset(metrics->tileDirty, 1, tileCount);
+    memset(metrics->tilePopulation, 0, tileCount * sizeof(uint32_t));
+    metrics->population = 0;
+    metrics->allTilesDirty = 0;
+  }
+
+  for (int tile = 0; tile < metrics->tileRows * metrics->tileCols; tile++) {
+    if (!metrics->tileDirty[tile])
+      continue;
+    metrics->tileDirty[tile] = 0;
+
+    int yStart = (tile / metrics->tileCols) * TILE_SIZE;
+    int xStart = (tile % metrics->tileCols) * TILE_SIZE;
+    int yEnd = yStart + TILE_SIZE < metrics->rows ? yStart + TILE_SIZE
+                                                  : metrics->rows;
+    int xEnd = xStart + TILE_SIZE < metrics->cols ? xStart + TILE_SIZE
+                                                  : metrics->cols;
+    uint32_t counts[3] = {0, 0, 0};
+    for (int y = yStart; y < yEnd; y++) {
+      size_t offset = (size_t)(y + 1) * grid->stride + xStart + 1;
+      metrics->countRow(grid->cells + offset, grid->next + offset,
+                        xEnd - xStart, counts);
+    }
+
+    metrics->population += counts[0] - metrics->tilePopulation[tile];
+    metrics->tilePopulation[tile] = counts[0];
+    sample->births += counts[1];
+    sample->deaths += counts[2];
+  }
+
+  sample->population = metrics->population;
+  sample->counted = METRICS_COUNTED_POPULATION | METRICS_COUNTED_CHANGES;
+}
+
+// Between counts a generation only costs marking the tiles the tile engine
+// stepped, or one copy of the grid the generation before a count
+void metricsGeneration(struct Metrics *metrics, uint64_t generation,
+                       uint64_t stepNanos, struct LifeGrid *grid,
+                       uint32_t activeArea, const struct TileTracker *tiles) {
+  struct GenerationSample sample = {generation, stepNanos, 0, 0, 0,
+                                    activeArea, 0};
+
+  // A jump or a seek skips generations the tiles weren't marked for
+  if (tiles != NULL && generation == metrics->lastGeneration + 1) {
+    for (int i = 0; i < tiles->activeCount; i++)
+      metrics->tileDirty[tiles->activeList[i]] = 1;
+  } else {
+    tiles = NULL;
+    metrics->allTilesDirty = 1;
+  }
+  metrics->lastGeneration = generation;
+
+  if (generation % METRICS_COUNT_INTERVAL == 0) {
+    if (tiles != NULL)
+      countTiles(metrics, grid, &sample);
+    else
+      countGrid(metrics, generation, grid, &sample);
+  } else if (generation % METRICS_COUNT_INTERVAL ==
+                 METRICS_COUNT_INTERVAL - 1 &&
+             tiles == NULL) {
+    for (int y = 0; y < metrics->rows; y++) {
+      memcpy(metrics->previous + (size_t)y * metrics->cols,
+             lifeCell(grid, y, 0), metrics->cols);
+    }
+    metrics->previousGeneration = generation;
+    metrics->previousValid = 1;
+  }
+
+  ringPush(&metrics->generations, &sample);
+}
+
+// A count, or the copy of the generation before one
+int metricsWantsGrid(struct Metrics *metrics, uint64_t generation) {
+  (void)metrics;
+  return generation % METRICS_COUNT_INTERVAL == 0 ||
+         generation % METRICS_COUNT_INTERVAL == METRICS_COUNT_INTERVAL - 1;
+}
+
+void metricsFrame(struct Metrics *metrics, uint64_t generation,
+                  uint64_t drawNanos, uint64_t presentNanos,
+                  uint32_t cellsDrawn) {
+  struct FrameSample sample = {generation, drawNanos, presentNanos,
+                               cellsDrawn};
+  ringPush(&metrics->frames, &sample);
+}
+
+static void writeCsv(FILE *out, struct GenerationSample *generations,
+                     size_t generationCount, struct FrameSample *frames,
+                     size_t frameCount) {
+  fprintf(out, "type,generation,step_ns,population,births,deaths,"
+               "active_area,draw_ns,present_ns,cells_drawn\n");
+  for (size_t i = 0; i < generationCount; i++) {
+    struct GenerationSample *s = &generations[i];
+    // Counts that weren't taken are left empty
+    char population[16] = "", births[16] = "", deaths[16] = "";
+    if (s->counted & METRICS_COUNTED_POPULATION)
+      snprintf(population, sizeof(population), "%u", s->population);
+    if (s->counted & METRICS_COUNTED_CHANGES) {
+      snprintf(births, sizeof(births), "%u", s->births);
+      snprintf(deaths, sizeof(deaths), "%u", s->deaths);
+    }
+    fprintf(out, "generation,%llu,%llu,%s,%s,%s,%u,,,\n",
+            (unsigned long long)s->generation,
+            (unsigned long long)s->stepNanos, population, births, deaths,
+            s->activeArea);
+  }
+  for (size_t i = 0; i < frameCount; i++) {
+    struct FrameSample *s = &frames[i];
+    fprintf(out, "frame,%llu,,,,,,%llu,%llu,%u\n",
+            (unsigned long long)s->generation,
+            (unsigned long long)s->drawNanos,
+            (unsigned long long)s->presentNanos, s->cellsDrawn);
+  }
+}
+
+static void writeJson(FILE *out, struct GenerationSample *generations,
+                      size_t generationCount, struct FrameSample *frames,
+                      size_t frameCount) {
+  fprintf(out, "{\n  \"generations\": [");
+  for (size_t i = 0; i < generationCount; i++) {
+    struct GenerationSample *s = &generations[i];
+    // Counts that weren't taken are null
+    char population[16] = "null", births[16] = "null", deaths[16] = "null";
+    if (s->counted & METRICS_COUNTED_POPULATION)
+      snprintf(population, sizeof(population), "%u", s->population);
+    if (s->counted & METRICS_COUNTED_CHANGES) {
+      snprintf(births, sizeof(births), "%u", s->births);
+      snprintf(deaths, sizeof(deaths), "%u", s->deaths);
+    }
+    fprintf(out,
+            "%s\n    {\"generation\": %llu, \"stepNs\": %llu, "
+            "\"population\": %s, \"births\": %s, \"deaths\": %s, "
+            "\"activeArea\": %u}",
+            i > 0 ? "," : "", (unsigned long long)s->generation,
+            (unsigned long long)s->stepNanos, population, births, deaths,
+            s->activeArea);
+  }
+  fprintf(out, "\n  ],\n  \"frames\": [");
+  for (size_t i = 0; i < frameCount; i++) {
+    struct FrameSample *s = &frames[i];
+    fprintf(out,
+            "%s\n    {\"generation\": %llu, \"drawNs\": %llu, "
+            "\"presentNs\": %llu, \"cellsDrawn\": %u}",
+            i > 0 ? "," : "", (unsigned long long)s->generation,
+            (unsigned long long)s->drawNanos,
+            (unsigned long long)s->presentNanos, s->cellsDrawn);
+  }
+  fprintf(out, "\n  ]\n}\n");
+}
+
+int metricsWrite(struct Metrics *metrics, const char *path) {
+  struct GenerationSample *generations =
+      malloc(METRICS_RING_SIZE * sizeof(struct GenerationSample));
+  struct FrameSample *frames =
+      malloc(METRICS_RING_SIZE * sizeof(struct FrameSample));
+  FILE *out = fopen(path, "w");
+  if (generations == NULL || frames == NULL || out == NULL) {
+    if (out == NULL)
+      perror(path);
+    else
+      fclose(out);
+    free(generations);
+    free(frames);
+    return -1;
+  }
+
+  size_t generationCount = ringSnapshot(
+      &metrics->generations, (unsigned char *)generations);
+  size_t frameCount =
+      ringSnapshot(&metrics->frames, (unsigned char *)frames);
+
+  size_t length = strlen(path);
+  if (length >= 5 && strcmp(path + length - 5, ".json") == 0) {
+    writeJson(out, generations, generationCount, frames, frameCount);
+  } else {
+    writeCsv(out, generations, generationCount, frames, frameCount);
+  }
+
+  free(generations);
+  free(frames);
+  if (fclose(out) != 0)
+    return -1;
+
+  printf("Wrote %zu generations and %zu frames to %s\n", generationCount,
+         frameCount, path);
+  return 0;
+}
@@ -0,0 +1,152 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "life.h"
+
+// Samples kept per ring, older ones are overwritten. A power of two.
+#define METRICS_RING_SIZE 8192
+// Counting the cells costs about as much as stepping them, so only every
+// this many generations are population, births and deaths counted
+#define METRICS_COUNT_INTERVAL 256
+
+// Which counts of a generation sample were taken
+enum {
+  METRICS_COUNTED_POPULATION = 1,
+  // Births and deaths, which need the generation before
+  METRICS_COUNTED_CHANGES = 2
+};
+
+struct GenerationSample {
+  uint64_t generation;
+  uint64_t stepNanos;
+  uint32_t population;
+  uint32_t births;
+  uint32_t deaths;
+  // Cells the engine actually stepped
+  uint32_t activeArea;
+  uint32_t counted;
+};
+
+struct FrameSample {
+  uint64_t generation;
+  uint64_t drawNanos;
+  uint64_t presentNanos;
+  uint32_t cellsDrawn;
+};
+
+// Overwriting ring with a single writer that never waits. Readers copy it
+// while it is written and drop whatever may have been overwritten meanwhile.
+struct MetricsRing {
+  unsigned char *samples;
+  size_t sampleSize;
+  alignas(64) atomic_ullong head;
+};
+
+typedef void (*CountRowFn)(const uint8_t *cells, const uint8_t *previous,
+                           int cols, uint32_t counts[3]);
+
+struct TileTracker;
+
+// Generations are written by the thread that steps, frames by the one that
+// draws; either may be dumped from anywhere
+struct Metrics {
+  struct MetricsRing generations;
+  struct MetricsRing frames;
+  int rows, cols;
+  CountRowFn countRow;
+  uint64_t lastGeneration;
+  // The cells of the generation before a count, copied unless the tile
+  // engine stepped it and left it in the grid's next buffer
+  uint8_t *previous;
+  uint64_t previousGeneration;
+  int previousValid;
+  // Live cells per tile at the last count, so the tile engine's counts only
+  // read the tiles it stepped since
+  int tileRows, tileCols;
+  uint32_t *tilePopulation;
+  uint8_t *tileDirty;
+  int allTilesDirty;
+  uint32_t population;
+};
+
+// Instrumentation is compiled in with -DGOL_METRICS (make METRICS=1).
+// Otherwise every call below is empty and costs nothing.
+#ifdef GOL_METRICS
+
+#define METRICS_ENABLED 1
+
+int metricsInit(struct Metrics *metrics, int rows, int cols);
+void metricsFree(struct Metrics *metrics);
+
+// Records the step, and every METRICS_COUNT_INTERVAL generations counts the
+// grid. tiles is stepperSteppedTiles, or NULL.
+void metricsGeneration(struct Metrics *metrics, uint64_t generation,
+                       uint64_t stepNanos, struct LifeGrid *grid,
+                       uint32_t activeArea, const struct TileTracker *tiles);
+// metricsGeneration reads the grid of this generation, which the engines
+// that step elsewhere then have to bring up to date
+int metricsWantsGrid(struct Metrics *metrics, uint64_t generation);
+void metricsFrame(struct Metrics *metrics, uint64_t generation,
+                  uint64_t drawNanos, uint64_t presentNanos,
+                  uint32_t cellsDrawn);
+
+// JSON if the path ends in .json, CSV otherwise
+int metricsWrite(struct Metrics *metrics, const char *path);
+
+#else
+
+#define METRICS_ENABLED 0
+
+static inline int metricsInit(struct Metrics *metrics, int rows, int cols) {
+  (void)metrics;
+  (void)rows;
+  (void)cols;
+  return 0;
+}
+
+static inline void metricsFree(struct Metrics *metrics) { (void)metrics; }
+
+static inline void metricsGeneration(struct Metrics *metrics,
+                                     uint64_t generation, uint64_t stepNanos,
+                                     struct LifeGrid *grid,
+                                     uint32_t activeArea,
+                                     const struct TileTracker *tiles) {
+  (void)metrics;
+  (void)generation;
+  (void)stepNanos;
+  (void)grid;
+  (void)activeArea;
+  (void)tiles;
+}
+
+static inline int metricsWantsGrid(struct Metrics *metrics,
+                                   uint64_t generation) {
+  (void)metrics;
+  (void)generation;
+  return 0;
+}
+
+static inline void metricsFrame(struct Metrics *metrics, uint64_t generation,
+                                uint64_t drawNanos, uint64_t presentNanos,
+                                uint32_t cellsDrawn) {
+  (void)metrics;
+  (void)generation;
+  (void)drawNanos;
+  (void)presentNanos;
+  (void)cellsDrawn;
+}
+
+static inline int metricsWrite(struct Metrics *metrics, const char *path) {
+  (void)metrics;
+  (void)path;
+  return -1;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,369 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "pattern.h"
+#include "rule.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Longest line written to RLE files, as recommended by the format
+#define RLE_LINE_LENGTH 70
+// Longest run and farthest cell an RLE file may give, far past what even
+// HashLife holds but nowhere near overflowing an int64_t
+#define RLE_MAX_COUNT ((int64_t)1 << 50)
+
+static size_t skipLine(const char *data, size_t size, size_t pos) {
+  const char *end = memchr(data + pos, '\n', size - pos);
+  return end == NULL ? size : (size_t)(end - data) + 1;
+}
+
+// "x = 3, y = 2, rule = B3/S23"
+static int parseRleHeader(struct PatternFile *file, size_t pos,
+                          size_t lineEnd) {
+  char line[256];
+  size_t length = lineEnd - pos;
+  if (length >= sizeof(line))
+    length = sizeof(line) - 1;
+  memcpy(line, file->data + pos, length);
+  line[length] = '\0';
+
+  long long width, height;
+  if (sscanf(line, " x = %lld , y = %lld", &width, &height) != 2)
+    return -1;
+
+  file->width = width;
+  file->height = height;
+
+  const char *rule = strstr(line, "rule");
+  if (rule != NULL && sscanf(rule, "rule = %63[^ \r\n]", file->rule) != 1)
+    file->rule[0] = '\0';
+  return 0;
+}
+
+// Plaintext has no header, so measure it while skipping the '!' comments
+static void measurePlaintext(struct PatternFile *file) {
+  size_t pos = file->body;
+  while (pos < file->size) {
+    size_t next = skipLine(file->data, file->size, pos);
+    int64_t width = next - pos;
+    while (width > 0 && (file->data[pos + width - 1] == '\n' ||
+                         file->data[pos + width - 1] == '\r')) {
+      width--;
+    }
+
+    if (width > file->width)
+      file->width = width;
+    file->height++;
+    pos = next;
+  }
+}
+
+int patternOpen(struct PatternFile *file, const char *path) {
+  memset(file, 0, sizeof(struct PatternFile));
+  strcpy(file->rule, "B3/S23");
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    perror(path);
+    return -1;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    fprintf(stderr, "%s: empty or unreadable pattern file\n", path);
+    close(fd);
+    return -1;
+  }
+
+  void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    perror(path);
+    return -1;
+  }
+
+  posix_madvise(data, st.st_size, POSIX_MADV_SEQUENTIAL);
+  file->data = data;
+  file->size = st.st_size;
+
+  // Skip comments: '#' lines in RLE, '!' lines in plaintext
+  size_t pos = 0;
+  while (pos < file->size &&
+         (file->data[pos] == '#' || file->data[pos] == '!')) {
+    if (file->data[pos] == '!')
+      file->format = PATTERN_PLAINTEXT;
+    pos = skipLine(file->data, file->size, pos);
+  }
+
+  size_t lineEnd = skipLine(file->data, file->size, pos);
+  if (file->format != PATTERN_PLAINTEXT &&
+      parseRleHeader(file, pos, lineEnd) == 0) {
+    file->format = PATTERN_RLE;
+    file->body = lineEnd;
+  } else {
+    file->format = PATTERN_PLAINTEXT;
+    file->body = pos;
+    measurePlaintext(file);
+  }
+
+  return 0;
+}
+
+void patternClose(struct PatternFile *file) {
+  if (file->data != NULL)
+    munmap((void *)file->data, file->size);
+  file->data = NULL;
+}
+
+static int decodeError(struct PatternFile *file, const char *error,
+                       size_t pos) {
+  file->error = error;
+  file->errorAt = pos;
+  return -1;
+}
+
+static int decodeRle(struct PatternFile *file, PatternRunFn run,
+                     void *context) {
+  const char *data = file->data;
+  int64_t y = 0, x = 0;
+  int64_t count = 0;
+
+  for (size_t pos = file->body; pos < file->size; pos++) {
+    char c = data[pos];
+    if (c >= '0' && c <= '9') {
+      count = count * 10 + (c - '0');
+      if (count > RLE_MAX_COUNT)
+        return decodeError(file, "run too long", pos);
+      continue;
+    }
+
+    int64_t n = count == 0 ? 1 : count;
+    count = 0;
+
+    switch (c) {
+    case 'b':
+    case '.':
+      x += n;
+      break;
+    case '$':
+      y += n;
+      x = 0;
+      break;
+    case '!':
+      return 0;
+    case ' ':
+    case '\t':
+    case '\r':
+    case '\n':
+      break;
+    default: {
+      // Multi-state RLE: 'A'..'X' are states 1 to 24, a 'p'..'y' prefix
+      // adds 24 per letter. Any other letter is simply alive.
+      int state = 1;
+      if (c >= 'p' && c <= 'y' && pos + 1 < file->size &&
+          data[pos + 1] >= 'A' && data[pos + 1] <= 'X') {
+        state = 24 * (c - 'p' + 1) + data[++pos] - 'A' + 1;
+      } else if (c >= 'A' && c <= 'X') {
+        state = c - 'A' + 1;
+      } else if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))) {
+        return decodeError(file, "unexpected character", pos);
+      }
+
+      run(context, y, x, n, state);
+      x += n;
+    }
+    }
+
+    if (x > RLE_MAX_COUNT || y > RLE_MAX_COUNT)
+      return decodeError(file, "pattern too large", pos);
+  }
+
+  return 0;
+}
+
+static int decodePlaintext(struct PatternFile *file, PatternRunFn run,
+                           void *context) {
+  const char *data = file->data;
+  int64_t y = 0, x = 0;
+  int64_t runStart = -1;
+
+  for (size_t pos = file->body; pos <= file->size; pos++) {
+    char c = pos < file->size ? data[pos] : '\n';
+    int alive = c == 'O' || c == '*';
+
+    if (alive && runStart < 0)
+      runStart = x;
+    if (!alive && runStart >= 0) {
+      run(context, y, runStart, x - runStart, 1);
+      runStart = -1;
+    }
+
+    if (c == '\n') {
+      y++;
+      x = 0;
+    } else if (c != '\r') {
+      x++;
+    }
+  }
+
+  return 0;
+}
+
+int patternDecode(struct PatternFile *file, PatternRunFn run, void *context) {
+  if (file->format == PATTERN_RLE)
+    return decodeRle(file, run, context);
+
+  return decodePlaintext(file, run, context);
+}
+
+void patternPrintError(const struct PatternFile *file, const char *path) {
+  fprintf(stderr, "%s: %s in RLE at byte %zu\n", path, file->error,
+          file->errorAt);
+}
+
+struct GridSink {
+  struct LifeGrid *grid;
+  int64_t top, left;
+};
+
+static void gridRun(void *context, int64_t y, int64_t x, int64_t length,
+                    int state) {
+  struct GridSink *sink = context;
+  struct LifeGrid *grid = sink->grid;
+
+  y += sink->top;
+  x += sink->left;
+  if (y < 0 || y >= grid->rows)
+    return;
+
+  int64_t end = x + length;
+  if (x < 0)
+    x = 0;
+  if (end > grid->cols)
+    end = grid->cols;
+  if (x < end)
+    memset(lifeCell(grid, (int)y, (int)x), state, end - x);
+}
+
+int patternRule(const char *path, struct LifeRule *rule) {
+  struct PatternFile file;
+  if (patternOpen(&file, path) != 0)
+    return -1;
+
+  int result = ruleParse(rule, file.rule);
+  if (result != 0)
+    fprintf(stderr, "%s: unknown rule %s\n", path, file.rule);
+  patternClose(&file);
+  return result;
+}
+
+int patternLoadGrid(const char *path, struct LifeGrid *grid) {
+  struct PatternFile file;
+  if (patternOpen(&file, path) != 0)
+    return -1;
+
+  lifeGridClear(grid);
+  struct GridSink sink = {grid, (grid->rows - file.height) / 2,
+                          (grid->cols - file.width) / 2};
+  int result = patternDecode(&file, gridRun, &sink);
+  if (result != 0)
+    patternPrintError(&file, path);
+  patternClose(&file);
+  return result;
+}
+
+static void writeRleRun(FILE *out, int *lineLength, int64_t count,
+                        const char *tag) {
+  char token[32];
+  int length = count > 1 ? snprintf(token, sizeof(token), "%lld%s",
+                                    (long long)count, tag)
+                         : snprintf(token, sizeof(token), "%s", tag);
+
+  if (*lineLength + length > RLE_LINE_LENGTH) {
+    fputc('\n', out);
+    *lineLength = 0;
+  }
+
+  fputs(token, out);
+  *lineLength += length;
+}
+
+// Multi-state RLE: '.' for dead, 'A'..'X', then 'pA'..'pX' and so on
+static void stateTag(char *tag, int state) {
+  if (state == 0) {
+    tag[0] = '.';
+  } else if (state <= 24) {
+    tag[0] = 'A' + state - 1;
+  } else {
+    tag[0] = 'p' + (state - 25) / 24;
+    tag[1] = 'A' + (state - 25) % 24;
+  }
+}
+
+int patternSaveRle(const char *path, struct LifeGrid *grid) {
+  FILE *out = fopen(path, "w");
+  if (out == NULL) {
+    perror(path);
+    return -1;
+  }
+
+  const struct LifeRule *rule = lifeGetRule();
+  fprintf(out, "x = %d, y = %d, rule = %s\n", grid->cols, grid->rows,
+          rule->name);
+
+  int lineLength = 0;
+  int lastRow = 0;
+  for (int y = 0; y < grid->rows; y++) {
+    const uint8_t *row = lifeCell(grid, y, 0);
+
+    // Trailing dead cells of a row are implied
+    int end = grid->cols;
+    while (end > 0 && !row[end - 1]) {
+      end--;
+    }
+
+    if (end == 0)
+      continue;
+
+    if (y > lastRow)
+      writeRleRun(out, &lineLength, y - lastRow, "$");
+    lastRow = y;
+
+    for (int x = 0; x < end;) {
+      int start = x;
+      while (x < end && row[x] == row[start]) {
+        x++;
+      }
+      char tag[3] = {row[start] ? 'o' : 'b', '\0', '\0'};
+      if (rule->states > 2)
+        stateTag(tag, row[start]);
+      writeRleRun(out, &lineLength, x - start, tag);
+    }
+  }
+
+  fputs("!\n", out);
+  return fclose(out) == 0 ? 0 : -1;
+}
+
+int patternSavePlaintext(const char *path, struct LifeGrid *grid) {
+  FILE *out = fopen(path, "w");
+  if (out == NULL) {
+    perror(path);
+    return -1;
+  }
+
+  fprintf(out, "!Name: gol\n");
+  for (int y = 0; y < grid->rows; y++) {
+    const uint8_t *row = lifeCell(grid, y, 0);
+    for (int x = 0; x < grid->cols; x++) {
+      fputc(row[x] ? 'O' : '.', out);
+    }
+    fputc('\n', out);
+  }
+
+  return fclose(out) == 0 ? 0 : -1;
+}
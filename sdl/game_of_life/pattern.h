@@ -0,0 +1,50 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "life.h"
+
+enum PatternFormat { PATTERN_RLE, PATTERN_PLAINTEXT };
+
+// A pattern file mapped into memory. Opening reads the header (and for
+// plaintext, the size); the cells are only decoded by patternDecode.
+struct PatternFile {
+  const char *data;
+  size_t size;
+  size_t body;
+  enum PatternFormat format;
+
+  int64_t width, height;
+  char rule[64];
+
+  // Why patternDecode failed and at which byte, for the caller to report
+  const char *error;
+  size_t errorAt;
+};
+
+// Called for every run of live cells (state 1, or the state of a
+// multi-state pattern), in row order, relative to the pattern's top left
+// corner
+typedef void (*PatternRunFn)(void *context, int64_t y, int64_t x,
+                             int64_t length, int state);
+
+int patternOpen(struct PatternFile *file, const char *path);
+void patternClose(struct PatternFile *file);
+// Single pass over the mapped file, nothing is allocated per cell. Returns
+// -1 with the error set, without printing anything.
+int patternDecode(struct PatternFile *file, PatternRunFn run, void *context);
+void patternPrintError(const struct PatternFile *file, const char *path);
+
+// Parses the rule named in the header of a pattern file, B3/S23 if there
+// is none. Returns -1 after saying why if the file can't be read or the
+// rule is unknown.
+int patternRule(const char *path, struct LifeRule *rule);
+// Loads a pattern centered in the grid, clipping what doesn't fit
+int patternLoadGrid(const char *path, struct LifeGrid *grid);
+
+int patternSaveRle(const char *path, struct LifeGrid *grid);
+int patternSavePlaintext(const char *path, struct LifeGrid *grid);
+
+#endif
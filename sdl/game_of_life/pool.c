@@ -0,0 +1,137 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "pool.h"
+#include "rule.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+struct Worker {
+  struct LifePool *pool;
+  int id;
+};
+
+int poolDefaultThreads(void) {
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  return cores < 1 ? 1 : (int)cores;
+}
+
+static void stepBand(struct LifePool *pool, int id) {
+  if (id >= pool->bandCount)
+    return;
+
+  lifeStepRows(pool->grid, pool->bandStart[id], pool->bandStart[id + 1]);
+}
+
+static void *workerMain(void *arg) {
+  struct Worker *worker = arg;
+  struct LifePool *pool = worker->pool;
+  int id = worker->id;
+  free(worker);
+
+  for (;;) {
+    // Start of generation
+    pthread_barrier_wait(&pool->barrier);
+    if (pool->quit)
+      break;
+
+    stepBand(pool, id);
+
+    // End of generation
+    pthread_barrier_wait(&pool->barrier);
+  }
+
+  ruleFreeScratch();
+  return NULL;
+}
+
+// Splits the grid into at most one band per thread, but never into bands
+// thinner than POOL_MIN_BAND_ROWS, so small grids use fewer threads
+static void planBands(struct LifePool *pool, struct LifeGrid *grid) {
+  int bands = grid->rows / POOL_MIN_BAND_ROWS;
+  if (bands > pool->threadCount)
+    bands = pool->threadCount;
+  if (bands < 1)
+    bands = 1;
+
+  int base = grid->rows / bands;
+  int extra = grid->rows % bands;
+
+  pool->bandStart[0] = 0;
+  for (int i = 0; i < bands; i++) {
+    pool->bandStart[i + 1] = pool->bandStart[i] + base + (i < extra);
+  }
+
+  pool->bandCount = bands;
+  pool->grid = grid;
+}
+
+int lifePoolInit(struct LifePool *pool, int threadCount) {
+  if (threadCount < 1)
+    threadCount = poolDefaultThreads();
+
+  pool->threadCount = threadCount;
+  pool->quit = 0;
+  pool->grid = NULL;
+  pool->bandCount = 0;
+  pool->bandStart = malloc((threadCount + 1) * sizeof(int));
+  pool->threads = malloc(threadCount * sizeof(pthread_t));
+  if (pool->bandStart == NULL || pool->threads == NULL) {
+    free(pool->bandStart);
+    free(pool->threads);
+    return -1;
+  }
+
+  if (pthread_barrier_init(&pool->barrier, NULL, threadCount) != 0) {
+    free(pool->bandStart);
+    free(pool->threads);
+    return -1;
+  }
+
+  // Make sure the kernel is picked before any worker can race on it
+  lifeGetKernel();
+
+  // Thread 0 is the caller
+  for (int i = 1; i < threadCount; i++) {
+    struct Worker *worker = malloc(sizeof(struct Worker));
+    if (worker == NULL) {
+      fprintf(stderr, "Failed to allocate worker %d.\n", i);
+      exit(1);
+    }
+
+    worker->pool = pool;
+    worker->id = i;
+    if (pthread_create(&pool->threads[i], NULL, workerMain, worker) != 0) {
+      fprintf(stderr, "Failed to start worker thread %d.\n", i);
+      exit(1);
+    }
+  }
+
+  return 0;
+}
+
+void lifePoolStep(struct LifePool *pool, struct LifeGrid *grid) {
+  if (pool->grid != grid || pool->bandStart[pool->bandCount] != grid->rows)
+    planBands(pool, grid);
+
+  lifeRefreshHalo(grid);
+  pthread_barrier_wait(&pool->barrier);
+  stepBand(pool, 0);
+  pthread_barrier_wait(&pool->barrier);
+
+  lifeSwap(grid);
+}
+
+void lifePoolFree(struct LifePool *pool) {
+  pool->quit = 1;
+  pthread_barrier_wait(&pool->barrier);
+
+  for (int i = 1; i < pool->threadCount; i++) {
+    pthread_join(pool->threads[i], NULL);
+  }
+
+  pthread_barrier_destroy(&pool->barrier);
+  free(pool->threads);
+  free(pool->bandStart);
+}
@@ -0,0 +1,32 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+
+#include "life.h"
+
+// Bands thinner than this cost more in synchronisation than they save
+#define POOL_MIN_BAND_ROWS 16
+
+// Persistent workers that step a LifeGrid in horizontal row bands. The
+// calling thread works on the first band itself, the helper threads are
+// created once and wait on a barrier between generations.
+struct LifePool {
+  int threadCount;
+  pthread_t *threads;
+  pthread_barrier_t barrier;
+  int quit;
+
+  struct LifeGrid *grid;
+  int bandCount;
+  int *bandStart;
+};
+
+// Number of online cores, used when no thread count is given
+int poolDefaultThreads(void);
+
+int lifePoolInit(struct LifePool *pool, int threadCount);
+void lifePoolStep(struct LifePool *pool, struct LifeGrid *grid);
+void lifePoolFree(struct LifePool *pool);
+
+#endif
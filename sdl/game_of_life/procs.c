@@ -0,0 +1,491 @@
+#define _GNU_SOURCE
+
+#include "procs.h"
+#include "pool.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#endif
+
+// Polls before sleeping in the kernel, a neighbour is usually only a few
+// microseconds behind
+#define PROCS_SPINS 200
+// How often the coordinator checks that no worker died while it waits
+#define PROCS_POLL_MS 100
+#define PROCS_MAX_NODES 64
+// Generations per round, so the 32-bit counters never lap a worker
+#define PROCS_MAX_ROUND (1u << 30)
+
+static size_t alignUp(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+// Not the private futexes: the words are shared between processes. Without
+// futexes the waits spin on sched_yield instead.
+static void futexWait(_Atomic uint32_t *word, uint32_t value, int timeoutMs) {
+#ifdef __linux__
+  struct timespec timeout = {timeoutMs / 1000,
+                             (long)(timeoutMs % 1000) * 1000000};
+  syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT, value,
+          timeoutMs > 0 ? &timeout : NULL, NULL, 0);
+#else
+  (void)word;
+  (void)value;
+  (void)timeoutMs;
+  sched_yield();
+#endif
+}
+
+static void futexWake(_Atomic uint32_t *word) {
+#ifdef __linux__
+  syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#else
+  (void)word;
+#endif
+}
+
+static void waitWhile(_Atomic uint32_t *word, uint32_t value) {
+  for (int spin = 0; spin < PROCS_SPINS; spin++) {
+    if (atomic_load_explicit(word, memory_order_acquire) != value)
+      return;
+  }
+
+  while (atomic_load_explicit(word, memory_order_acquire) == value) {
+    futexWait(word, value, 0);
+  }
+}
+
+static size_t slotSize(struct LifeProcs *procs) {
+  return alignUp(procs->cols + 2, 64);
+}
+
+static void ringPush(struct LifeProcs *procs, struct ProcsRing *ring,
+                     const uint8_t *row) {
+  uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  for (;;) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail < PROCS_RING_SLOTS)
+      break;
+    waitWhile(&ring->tail, tail);
+  }
+
+  memcpy(ring->slots + (head % PROCS_RING_SLOTS) * slotSize(procs), row,
+         procs->cols + 2);
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+  futexWake(&ring->head);
+}
+
+static void ringPop(struct LifeProcs *procs, struct ProcsRing *ring,
+                    uint8_t *row) {
+  uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  waitWhile(&ring->head, tail);
+
+  memcpy(row, ring->slots + (tail % PROCS_RING_SLOTS) * slotSize(procs),
+         procs->cols + 2);
+  atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+  futexWake(&ring->tail);
+}
+
+// Both buffers, the other one is current after the next step
+static void setBoundary(struct LifeGrid *grid, enum LifeBoundary boundary) {
+  lifeGridSetBoundary(grid, boundary);
+  lifeSwap(grid);
+  lifeGridSetBoundary(grid, boundary);
+  lifeSwap(grid);
+}
+
+// Runs in the forked child, so no stdio and no malloc: another thread of
+// the parent may have held their locks when it forked
+static void workerMain(struct LifeProcs *procs, int id) {
+  struct ProcsControl *control = procs->control;
+  struct ProcsSlab *slab = &procs->slabs[id];
+  struct ProcsRing *fromAbove = &procs->rings[2 * id];
+  struct ProcsRing *fromBelow = &procs->rings[2 * id + 1];
+
+  // First touch, which puts the pages on this worker's node
+  size_t bufferSize = (size_t)(slab->rows + 2) * procs->stride;
+  memset(slab->buffers[0], 0, bufferSize);
+  memset(slab->buffers[1], 0, bufferSize);
+  memset(fromAbove->slots, 0, PROCS_RING_SLOTS * slotSize(procs));
+  memset(fromBelow->slots, 0, PROCS_RING_SLOTS * slotSize(procs));
+  atomic_store_explicit(&slab->ready, 1, memory_order_release);
+  futexWake(&slab->ready);
+
+  struct LifeGrid grid = {slab->rows,         procs->cols,
+                          procs->stride,      slab->buffers[0],
+                          slab->buffers[1],   LIFE_BOUNDARY_DEAD};
+  int last = procs->count - 1;
+  uint32_t generation = 0;
+  for (;;) {
+    waitWhile(&control->target, generation);
+    if (atomic_load_explicit(&control->quit, memory_order_acquire))
+      _exit(0);
+
+    uint32_t target =
+        atomic_load_explicit(&control->target, memory_order_acquire);
+    int boundary = atomic_load_explicit(&control->boundary,
+                                        memory_order_relaxed);
+    if (boundary != (int)grid.boundary)
+      setBoundary(&grid, boundary);
+
+    // A lone worker wraps onto itself through lifeRefreshHalo
+    int torus = boundary == LIFE_BOUNDARY_TORUS && last > 0;
+    int above = id > 0 ? id - 1 : torus ? last : -1;
+    int below = id < last ? id + 1 : torus ? 0 : -1;
+
+    while (generation != target) {
+      // Fills the side halo cells, and the top and bottom halo rows as
+      // the world's edges; rows from the neighbours then replace those
+      lifeRefreshHalo(&grid);
+      if (above >= 0)
+        ringPush(procs, &procs->rings[2 * above + 1], lifeCell(&grid, 0, -1));
+      if (below >= 0)
+        ringPush(procs, &procs->rings[2 * below],
+                 lifeCell(&grid, grid.rows - 1, -1));
+      if (above >= 0)
+        ringPop(procs, fromAbove, lifeCell(&grid, -1, -1));
+      if (below >= 0)
+        ringPop(procs, fromBelow, lifeCell(&grid, grid.rows, -1));
+
+      lifeStepRows(&grid, 0, grid.rows);
+      lifeSwap(&grid);
+      generation++;
+      // Sequentially consistent, against the coordinator setting waiting
+      // and then reading done
+      atomic_store(&slab->done, generation);
+      if (atomic_load(&slab->waiting))
+        futexWake(&slab->done);
+    }
+  }
+}
+
+static void checkWorker(struct LifeProcs *procs, int id) {
+  int status;
+  if (waitpid(procs->pids[id], &status, WNOHANG) != procs->pids[id])
+    return;
+
+  fprintf(stderr, "Worker process %ld (slab %d) died.\n",
+          (long)procs->pids[id], id);
+  exit(1);
+}
+
+// The counters wrap, but never lap: a worker is at most PROCS_MAX_LEAD plus
+// PROCS_MAX_ROUND generations behind
+static int reached(uint32_t seen, uint32_t value) {
+  return (int32_t)(seen - value) >= 0;
+}
+
+// Waits until the worker's word is at value or past it
+static void awaitWorker(struct LifeProcs *procs, int id,
+                        _Atomic uint32_t *word, uint32_t value) {
+  for (int spin = 0; spin < PROCS_SPINS; spin++) {
+    if (reached(atomic_load_explicit(word, memory_order_acquire), value))
+      return;
+  }
+
+  struct ProcsSlab *slab = &procs->slabs[id];
+  atomic_store(&slab->waiting, 1);
+  for (;;) {
+    uint32_t seen = atomic_load(word);
+    if (reached(seen, value))
+      break;
+    futexWait(word, seen, PROCS_POLL_MS);
+    checkWorker(procs, id);
+  }
+  atomic_store(&slab->waiting, 0);
+}
+
+#ifdef __linux__
+// CPUs of every NUMA node that has some, from sysfs. Node numbers can have
+// gaps, and memory-only nodes have nothing to pin to.
+static int readNodes(cpu_set_t *nodes) {
+  int count = 0;
+  for (int node = 0; node < PROCS_MAX_NODES; node++) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+             node);
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+      continue;
+
+    // Ranges and single CPUs, such as 0-7,16-23
+    char list[4096];
+    CPU_ZERO(&nodes[count]);
+    if (fgets(list, sizeof(list), file) != NULL) {
+      char *cursor = list;
+      while (*cursor >= '0' && *cursor <= '9') {
+        long first = strtol(cursor, &cursor, 10);
+        long last = first;
+        if (*cursor == '-')
+          last = strtol(cursor + 1, &cursor, 10);
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+          CPU_SET(cpu, &nodes[count]);
+        }
+        if (*cursor == ',')
+          cursor++;
+      }
+    }
+    fclose(file);
+
+    if (CPU_COUNT(&nodes[count]) > 0)
+      count++;
+  }
+
+  return count;
+}
+#endif
+
+int procsNodeCount(void) {
+#ifdef __linux__
+  cpu_set_t nodes[PROCS_MAX_NODES];
+  int count = readNodes(nodes);
+  return count > 0 ? count : 1;
+#else
+  return 1;
+#endif
+}
+
+// The name is gone as soon as the segment is mapped, so a crash leaves
+// nothing behind in /dev/shm; the children inherit the mapping
+static uint8_t *mapShared(size_t size) {
+  static int segments = 0;
+  char name[64];
+  snprintf(name, sizeof(name), "/gol-procs-%ld-%d", (long)getpid(),
+           segments++);
+
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0)
+    return NULL;
+  shm_unlink(name);
+
+  void *base = MAP_FAILED;
+  if (ftruncate(fd, (off_t)size) == 0)
+    base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  return base == MAP_FAILED ? NULL : base;
+}
+
+// Control block, slab and ring headers, then each worker's buffers and the
+// slots of the rings it reads, starting on a page of their own so first
+// touch can place them
+static size_t workerBytes(struct LifeProcs *procs, int rows) {
+  size_t buffers = 2 * (size_t)(rows + 2) * procs->stride;
+  size_t slots = 2 * PROCS_RING_SLOTS * slotSize(procs);
+  return alignUp(buffers + slots, (size_t)sysconf(_SC_PAGESIZE));
+}
+
+static size_t layout(struct LifeProcs *procs, int assign) {
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t offset = alignUp(sizeof(struct ProcsControl), 64);
+  size_t slabsOffset = offset;
+  offset += procs->count * sizeof(struct ProcsSlab);
+  size_t ringsOffset = offset;
+  offset = alignUp(offset + 2 * procs->count * sizeof(struct ProcsRing), page);
+
+  if (assign) {
+    procs->control = (struct ProcsControl *)procs->base;
+    procs->slabs = (struct ProcsSlab *)(procs->base + slabsOffset);
+    procs->rings = (struct ProcsRing *)(procs->base + ringsOffset);
+  }
+
+  int base = procs->rows / procs->count;
+  int extra = procs->rows % procs->count;
+  int start = 0;
+  for (int i = 0; i < procs->count; i++) {
+    int rows = base + (i < extra);
+    if (assign) {
+      size_t bufferSize = (size_t)(rows + 2) * procs->stride;
+      uint8_t *data = procs->base + offset;
+      struct ProcsSlab *slab = &procs->slabs[i];
+      slab->start = start;
+      slab->rows = rows;
+      slab->buffers[0] = data;
+      slab->buffers[1] = data + bufferSize;
+      data += 2 * bufferSize;
+      procs->rings[2 * i].slots = data;
+      procs->rings[2 * i + 1].slots =
+          data + PROCS_RING_SLOTS * slotSize(procs);
+    }
+    start += rows;
+    offset += workerBytes(procs, rows);
+  }
+
+  return offset;
+}
+
+// Asks the first started workers to quit and reaps them
+static void stopWorkers(struct LifeProcs *procs, int started) {
+  atomic_store_explicit(&procs->control->quit, 1, memory_order_release);
+  atomic_fetch_add_explicit(&procs->control->target, 1, memory_order_release);
+  futexWake(&procs->control->target);
+
+  for (int i = 0; i < started; i++) {
+    waitpid(procs->pids[i], NULL, 0);
+  }
+}
+
+int lifeProcsInit(struct LifeProcs *procs, struct LifeGrid *grid,
+                  int processCount) {
+  if (processCount < 1)
+    processCount = poolDefaultThreads();
+
+  // Same split as the thread pool's bands
+  int count = grid->rows / POOL_MIN_BAND_ROWS;
+  if (count > processCount)
+    count = processCount;
+  if (count < 1)
+    count = 1;
+
+  memset(procs, 0, sizeof(struct LifeProcs));
+  procs->count = count;
+  procs->rows = grid->rows;
+  procs->cols = grid->cols;
+  procs->stride = grid->stride;
+  procs->size = layout(procs, 0);
+  procs->base = mapShared(procs->size);
+  procs->pids = malloc(count * sizeof(pid_t));
+  if (procs->base == NULL || procs->pids == NULL) {
+    if (procs->base != NULL)
+      munmap(procs->base, procs->size);
+    free(procs->pids);
+    return -1;
+  }
+  layout(procs, 1);
+
+  // The workers get a copy of the parent as it is now
+  lifeGetKernel();
+  pid_t parent = getpid();
+#ifdef __linux__
+  cpu_set_t nodes[PROCS_MAX_NODES];
+  procs->nodeCount = readNodes(nodes);
+#endif
+  if (procs->nodeCount < 1)
+    procs->nodeCount = 1;
+
+  for (int i = 0; i < count; i++) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      fprintf(stderr, "Failed to start worker process %d.\n", i);
+      stopWorkers(procs, i);
+      munmap(procs->base, procs->size);
+      free(procs->pids);
+      return -1;
+    }
+
+    if (pid == 0) {
+#ifdef __linux__
+      // Dies with the coordinator, even if that never gets to free us
+      prctl(PR_SET_PDEATHSIG, SIGKILL);
+      if (getppid() != parent)
+        _exit(0);
+      if (procs->nodeCount > 1)
+        sched_setaffinity(0, sizeof(cpu_set_t),
+                          &nodes[i % procs->nodeCount]);
+#else
+      (void)parent;
+#endif
+      workerMain(procs, i);
+    }
+    procs->pids[i] = pid;
+  }
+
+  // Nothing is scattered before every slab sits on its node
+  for (int i = 0; i < count; i++) {
+    awaitWorker(procs, i, &procs->slabs[i].ready, 1);
+  }
+  return 0;
+}
+
+void lifeProcsFree(struct LifeProcs *procs) {
+  stopWorkers(procs, procs->count);
+  munmap(procs->base, procs->size);
+  free(procs->pids);
+}
+
+void lifeProcsSync(struct LifeProcs *procs) {
+  for (int i = 0; i < procs->count; i++) {
+    awaitWorker(procs, i, &procs->slabs[i].done, procs->generation);
+  }
+}
+
+// Cell (y, x) of the world in the slab's current buffer. Workers only
+// touch their slab between a new target and their last done, so the
+// coordinator has it to itself once they are synced.
+static uint8_t *slabCell(struct LifeProcs *procs, struct ProcsSlab *slab,
+                         int y, int x) {
+  return slab->buffers[procs->generation & 1] +
+         (size_t)(y - slab->start + 1) * procs->stride + x + 1;
+}
+
+void lifeProcsLoad(struct LifeProcs *procs, struct LifeGrid *grid) {
+  lifeProcsSync(procs);
+  for (int i = 0; i < procs->count; i++) {
+    struct ProcsSlab *slab = &procs->slabs[i];
+    for (int y = slab->start; y < slab->start + slab->rows; y++) {
+      memcpy(slabCell(procs, slab, y, 0), lifeCell(grid, y, 0), procs->cols);
+    }
+  }
+}
+
+void lifeProcsSetCell(struct LifeProcs *procs, int y, int x, uint8_t state) {
+  lifeProcsSync(procs);
+  for (int i = 0; i < procs->count; i++) {
+    struct ProcsSlab *slab = &procs->slabs[i];
+    if (y >= slab->start && y < slab->start + slab->rows) {
+      *slabCell(procs, slab, y, x) = state;
+      return;
+    }
+  }
+}
+
+void lifeProcsStep(struct LifeProcs *procs, struct LifeGrid *grid,
+                   uint64_t generations) {
+  struct ProcsControl *control = procs->control;
+  // Workers pick the boundary up with a new target, so they all have to
+  // be at the same generation when it changes
+  int boundary = (int)grid->boundary;
+  if (atomic_load_explicit(&control->boundary, memory_order_relaxed) !=
+      boundary) {
+    lifeProcsSync(procs);
+    atomic_store_explicit(&control->boundary, boundary, memory_order_relaxed);
+  }
+
+  while (generations > 0) {
+    uint32_t round =
+        generations < PROCS_MAX_ROUND ? generations : PROCS_MAX_ROUND;
+    generations -= round;
+    for (int i = 0; i < procs->count; i++) {
+      awaitWorker(procs, i, &procs->slabs[i].done,
+                  procs->generation - PROCS_MAX_LEAD);
+    }
+
+    procs->generation += round;
+    atomic_store_explicit(&control->target, procs->generation,
+                          memory_order_release);
+    futexWake(&control->target);
+  }
+}
+
+void lifeProcsGather(struct LifeProcs *procs, struct LifeGrid *grid) {
+  lifeProcsSync(procs);
+  for (int i = 0; i < procs->count; i++) {
+    struct ProcsSlab *slab = &procs->slabs[i];
+    for (int y = slab->start; y < slab->start + slab->rows; y++) {
+      memcpy(lifeCell(grid, y, 0), slabCell(procs, slab, y, 0), procs->cols);
+    }
+  }
+}
@@ -0,0 +1,98 @@
+#ifndef PROCS_H
+#define PROCS_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "life.h"
+
+// Halo rows a worker can send ahead of a neighbour that hasn't taken them
+#define PROCS_RING_SLOTS 4
+// Generations the coordinator can ask for ahead of the slowest worker
+// before lifeProcsStep waits for it
+#define PROCS_MAX_LEAD 16
+
+// One worker's horizontal slab of the world, in the shared segment. The
+// cells ping-pong between the two buffers, the current one being
+// buffers[done & 1], so the coordinator finds it without asking.
+struct ProcsSlab {
+  // Generations stepped, and set once the worker has touched its memory.
+  // Both are futex words the coordinator waits on.
+  _Alignas(64) _Atomic uint32_t done;
+  _Atomic uint32_t ready;
+  // Set while the coordinator sleeps on done, so the worker only wakes it
+  // then rather than after every generation
+  _Atomic uint32_t waiting;
+  int start, rows;
+  uint8_t *buffers[2];
+};
+
+// Single producer, single consumer queue of halo rows, each the row with
+// its two side halo cells. Head and tail are futex words and count rows
+// pushed and taken.
+struct ProcsRing {
+  _Alignas(64) _Atomic uint32_t head;
+  _Alignas(64) _Atomic uint32_t tail;
+  uint8_t *slots;
+};
+
+// Written by the coordinator, read by every worker
+struct ProcsControl {
+  // Generation the workers step to
+  _Alignas(64) _Atomic uint32_t target;
+  _Atomic uint32_t quit;
+  _Atomic int boundary;
+};
+
+// Worker processes that each own a slab of rows and step it with the
+// kernels, swapping edge rows with their neighbours through rings in a POSIX
+// shared-memory segment. Nothing synchronises the workers but those rows, so
+// they only ever wait for the slabs next to theirs. Worker i is pinned to
+// NUMA node i % nodeCount and first touches its own slab, which then lives
+// in that node's memory.
+//
+// The rule and kernel are copied into the workers when they are forked, so
+// both have to be set before lifeProcsInit. Rules beyond range 1 need more
+// halo rows than the slabs have.
+struct LifeProcs {
+  int count;
+  int rows, cols, stride;
+  int nodeCount;
+  // Generations the coordinator has asked for so far
+  uint32_t generation;
+
+  uint8_t *base;
+  size_t size;
+  struct ProcsControl *control;
+  struct ProcsSlab *slabs;
+  // Two per worker: the rows coming from the slab above, then from below
+  struct ProcsRing *rings;
+  pid_t *pids;
+};
+
+// NUMA nodes with CPUs, 1 where the system doesn't say
+int procsNodeCount(void);
+
+// Splits the grid into slabs for up to processCount workers (0 picks the
+// core count), never thinner than POOL_MIN_BAND_ROWS, and starts them
+int lifeProcsInit(struct LifeProcs *procs, struct LifeGrid *grid,
+                  int processCount);
+void lifeProcsFree(struct LifeProcs *procs);
+
+// Copies the whole grid into the slabs, or a single cell, once the workers
+// are done
+void lifeProcsLoad(struct LifeProcs *procs, struct LifeGrid *grid);
+void lifeProcsSetCell(struct LifeProcs *procs, int y, int x, uint8_t state);
+// Asks the workers for more generations with the grid's boundary and
+// returns without waiting for them, unless the slowest one is more than
+// PROCS_MAX_LEAD generations behind. Exits if a worker died.
+void lifeProcsStep(struct LifeProcs *procs, struct LifeGrid *grid,
+                   uint64_t generations);
+// Waits until every worker has stepped all the generations asked for
+void lifeProcsSync(struct LifeProcs *procs);
+// Copies the slabs back into the grid once the workers are done, for
+// display
+void lifeProcsGather(struct LifeProcs *procs, struct LifeGrid *grid);
+
+#endif
@@ -0,0 +1,583 @@
+#include "rule.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RULE_X86 1
+#include <immintrin.h>
+#endif
+
+#define RULE_BIT(n) (1u << (n))
+
+typedef void (*RuleRowsFn)(const struct LifeRule *rule, const uint8_t *cur,
+                           uint8_t *next, int stride, int cols, int yStart,
+                           int yEnd);
+
+static const struct {
+  const char *name;
+  const char *rule;
+} ruleAliases[] = {
+    {"life", "B3/S23"},
+    {"highlife", "B36/S23"},
+    {"daynight", "B3678/S34678"},
+    {"seeds", "B2/S"},
+    {"brain", "B2/S/C3"},
+    {"bosco", "R5,C0,M1,S34..58,B34..45,NM"},
+};
+
+static int parseDigits(const char *text, uint16_t *mask) {
+  *mask = 0;
+  for (; *text != '\0'; text++) {
+    if (*text < '0' || *text > '8')
+      return -1;
+    *mask |= RULE_BIT(*text - '0');
+  }
+
+  return 0;
+}
+
+static void formatDigits(char *out, uint16_t mask) {
+  for (int n = 0; n <= 8; n++) {
+    if (mask & RULE_BIT(n))
+      *out++ = '0' + n;
+  }
+  *out = '\0';
+}
+
+// "s34..58", the part after the letter
+static int parseRange(const char *text, int *low, int *high) {
+  return sscanf(text, "%d..%d", low, high) == 2 && *low <= *high ? 0 : -1;
+}
+
+static int parseLarger(struct LifeRule *rule, char *text) {
+  rule->family = RULE_LARGER;
+  rule->states = 2;
+  rule->middle = 0;
+  rule->range = 0;
+  int hasBirth = 0, hasSurvive = 0;
+
+  for (char *part = strtok(text, ","); part != NULL;
+       part = strtok(NULL, ",")) {
+    switch (part[0]) {
+    case 'r':
+      rule->range = atoi(part + 1);
+      break;
+    case 'c':
+      rule->states = atoi(part + 1);
+      break;
+    case 'm':
+      rule->middle = atoi(part + 1) != 0;
+      break;
+    case 's':
+      if (parseRange(part + 1, &rule->surviveMin, &rule->surviveMax) != 0)
+        return -1;
+      hasSurvive = 1;
+      break;
+    case 'b':
+      if (parseRange(part + 1, &rule->birthMin, &rule->birthMax) != 0)
+        return -1;
+      hasBirth = 1;
+      break;
+    case 'n':
+      // Only the Moore neighbourhood is supported
+      if (strcmp(part, "nm") != 0)
+        return -1;
+      break;
+    default:
+      return -1;
+    }
+  }
+
+  if (rule->range < 1 || rule->range > RULE_MAX_RANGE || !hasBirth ||
+      !hasSurvive || rule->states < 0 || rule->states > RULE_MAX_STATES)
+    return -1;
+
+  // C0 and C2 both mean two states
+  if (rule->states < 2)
+    rule->states = 2;
+
+  snprintf(rule->name, sizeof(rule->name), "R%d,C%d,M%d,S%d..%d,B%d..%d,NM",
+           rule->range, rule->states > 2 ? rule->states : 0, rule->middle,
+           rule->surviveMin, rule->surviveMax, rule->birthMin,
+           rule->birthMax);
+  return 0;
+}
+
+static int parseTotalistic(struct LifeRule *rule, char *text) {
+  char *parts[3] = {NULL, NULL, NULL};
+  int count = 0;
+  for (char *part = text;; part++) {
+    if (count == 3)
+      return -1;
+    parts[count++] = part;
+
+    part = strchr(part, '/');
+    if (part == NULL)
+      break;
+    *part = '\0';
+  }
+
+  rule->states = 2;
+  int hasBirth = 0, hasSurvive = 0;
+  for (int i = 0; i < count; i++) {
+    char *part = parts[i];
+    int ok = 0;
+    if (part[0] == 'b') {
+      ok = parseDigits(part + 1, &rule->birth) == 0;
+      hasBirth = 1;
+    } else if (part[0] == 's') {
+      ok = parseDigits(part + 1, &rule->survive) == 0;
+      hasSurvive = 1;
+    } else if (part[0] == 'c' || part[0] == 'g' || i == 2) {
+      char *end;
+      rule->states = strtol(part + (isdigit((unsigned char)part[0]) ? 0 : 1),
+                            &end, 10);
+      ok = *end == '\0' && rule->states >= 2;
+    } else if (i == 0) {
+      // Plain digits are S/B/C
+      ok = parseDigits(part, &rule->survive) == 0;
+      hasSurvive = 1;
+    } else {
+      ok = parseDigits(part, &rule->birth) == 0;
+      hasBirth = 1;
+    }
+
+    if (!ok)
+      return -1;
+  }
+
+  if (!hasBirth || !hasSurvive || rule->states > RULE_MAX_STATES)
+    return -1;
+
+  rule->family = rule->states > 2 ? RULE_GENERATIONS : RULE_LIFE;
+  rule->range = 1;
+
+  char birth[10], survive[10];
+  formatDigits(birth, rule->birth);
+  formatDigits(survive, rule->survive);
+  if (rule->family == RULE_GENERATIONS) {
+    snprintf(rule->name, sizeof(rule->name), "B%s/S%s/C%d", birth, survive,
+             rule->states);
+  } else {
+    snprintf(rule->name, sizeof(rule->name), "B%s/S%s", birth, survive);
+  }
+
+  for (int n = 0; n <= 8; n++) {
+    rule->table[n] = (rule->birth >> n) & 1;
+    rule->table[9 + n] = (rule->survive >> n) & 1 ? 1
+                         : rule->states > 2       ? 2
+                                                  : 0;
+  }
+  return 0;
+}
+
+int ruleParse(struct LifeRule *rule, const char *text) {
+  char buffer[128];
+  size_t length = strlen(text);
+  if (length >= sizeof(buffer))
+    return -1;
+
+  // Case and spaces don't matter
+  size_t out = 0;
+  for (size_t i = 0; i < length; i++) {
+    if (!isspace((unsigned char)text[i]))
+      buffer[out++] = tolower((unsigned char)text[i]);
+  }
+  buffer[out] = '\0';
+
+  int aliases = sizeof(ruleAliases) / sizeof(ruleAliases[0]);
+  for (int i = 0; i < aliases; i++) {
+    if (strcmp(buffer, ruleAliases[i].name) == 0)
+      return ruleParse(rule, ruleAliases[i].rule);
+  }
+
+  memset(rule, 0, sizeof(struct LifeRule));
+  if (buffer[0] == 'r' && isdigit((unsigned char)buffer[1]))
+    return parseLarger(rule, buffer);
+
+  return parseTotalistic(rule, buffer);
+}
+
+int ruleIsConway(const struct LifeRule *rule) {
+  return rule->family == RULE_LIFE && rule->birth == RULE_BIT(3) &&
+         rule->survive == (RULE_BIT(2) | RULE_BIT(3));
+}
+
+int ruleBirthOnZero(const struct LifeRule *rule) {
+  if (rule->family == RULE_LARGER)
+    return rule->birthMin <= 0;
+
+  return (rule->birth & RULE_BIT(0)) != 0;
+}
+
+int ruleNextState(const struct LifeRule *rule, int state, int count) {
+  if (state >= 2)
+    return state + 1 < rule->states ? state + 1 : 0;
+
+  if (rule->family != RULE_LARGER)
+    return rule->table[state * 9 + count];
+
+  if (state == 0)
+    return count >= rule->birthMin && count <= rule->birthMax;
+
+  if (count >= rule->surviveMin && count <= rule->surviveMax)
+    return 1;
+  return rule->states > 2 ? 2 : 0;
+}
+
+// Two-state kernel with the birth and survival masks given as expressions.
+// Instantiated with constants, the lookup folds into a shift and a mask.
+#define DEFINE_LIFE_KERNEL(name, BIRTH, SURVIVE)                              \
+  static void name(const struct LifeRule *rule, const uint8_t *cur,          \
+                   uint8_t *next, int stride, int cols, int yStart,           \
+                   int yEnd) {                                                \
+    (void)rule;                                                               \
+    for (int y = yStart; y < yEnd; y++) {                                     \
+      const uint8_t *up = cur + (size_t)y * stride;                            \
+      const uint8_t *mid = up + stride;                                       \
+      const uint8_t *down = mid + stride;                                     \
+      uint8_t *out = next + (size_t)(y + 1) * stride + 1;                      \
+                                                                              \
+      for (int x = 0; x < cols; x++) {                                        \
+        unsigned n = up[x] + up[x + 1] + up[x + 2] + mid[x] + mid[x + 2] +    \
+                     down[x] + down[x + 1] + down[x + 2];                     \
+        out[x] = ((mid[x + 1] ? (SURVIVE) : (BIRTH)) >> n) & 1;               \
+      }                                                                       \
+    }                                                                         \
+  }
+
+// Same for Generations. Only state 1 counts as a live neighbour, and dying
+// cells age by one state every generation.
+#define DEFINE_GENERATIONS_KERNEL(name, BIRTH, SURVIVE, STATES)               \
+  static void name(const struct LifeRule *rule, const uint8_t *cur,          \
+                   uint8_t *next, int stride, int cols, int yStart,           \
+                   int yEnd) {                                                \
+    (void)rule;                                                               \
+    for (int y = yStart; y < yEnd; y++) {                                     \
+      const uint8_t *up = cur + (size_t)y * stride;                            \
+      const uint8_t *mid = up + stride;                                       \
+      const uint8_t *down = mid + stride;                                     \
+      uint8_t *out = next + (size_t)(y + 1) * stride + 1;                      \
+                                                                              \
+      for (int x = 0; x < cols; x++) {                                        \
+        unsigned n = (up[x] == 1) + (up[x + 1] == 1) + (up[x + 2] == 1) +     \
+                     (mid[x] == 1) + (mid[x + 2] == 1) + (down[x] == 1) +     \
+                     (down[x + 1] == 1) + (down[x + 2] == 1);                 \
+        unsigned self = mid[x + 1];                                           \
+        if (self == 0) {                                                      \
+          out[x] = ((BIRTH) >> n) & 1;                                        \
+        } else if (self == 1) {                                               \
+          out[x] = ((SURVIVE) >> n) & 1 ? 1 : 2;                              \
+        } else {                                                              \
+          out[x] = self + 1 < (unsigned)(STATES) ? self + 1 : 0;              \
+        }                                                                     \
+      }                                                                       \
+    }                                                                         \
+  }
+
+DEFINE_LIFE_KERNEL(stepRowsHighLife, RULE_BIT(3) | RULE_BIT(6),
+                   RULE_BIT(2) | RULE_BIT(3))
+DEFINE_LIFE_KERNEL(stepRowsDayNight,
+                   RULE_BIT(3) | RULE_BIT(6) | RULE_BIT(7) | RULE_BIT(8),
+                   RULE_BIT(3) | RULE_BIT(4) | RULE_BIT(6) | RULE_BIT(7) |
+                       RULE_BIT(8))
+DEFINE_LIFE_KERNEL(stepRowsSeeds, RULE_BIT(2), 0)
+DEFINE_LIFE_KERNEL(stepRowsLife, rule->birth, rule->survive)
+
+DEFINE_GENERATIONS_KERNEL(stepRowsBrain, RULE_BIT(2), 0, 3)
+DEFINE_GENERATIONS_KERNEL(stepRowsGenerations, rule->birth, rule->survive,
+                          rule->states)
+
+// Rules with a kernel of their own, everything else of the family goes
+// through the runtime masks
+static const struct {
+  enum RuleFamily family;
+  uint16_t birth, survive;
+  int states;
+  RuleRowsFn step;
+} specializedKernels[] = {
+    {RULE_LIFE, RULE_BIT(3) | RULE_BIT(6), RULE_BIT(2) | RULE_BIT(3), 2,
+     stepRowsHighLife},
+    {RULE_LIFE, RULE_BIT(3) | RULE_BIT(6) | RULE_BIT(7) | RULE_BIT(8),
+     RULE_BIT(3) | RULE_BIT(4) | RULE_BIT(6) | RULE_BIT(7) | RULE_BIT(8), 2,
+     stepRowsDayNight},
+    {RULE_LIFE, RULE_BIT(2), 0, 2, stepRowsSeeds},
+    {RULE_GENERATIONS, RULE_BIT(2), 0, 3, stepRowsBrain},
+};
+
+static RuleRowsFn scalarKernel(const struct LifeRule *rule) {
+  int count = sizeof(specializedKernels) / sizeof(specializedKernels[0]);
+  for (int i = 0; i < count; i++) {
+    if (specializedKernels[i].family == rule->family &&
+        specializedKernels[i].birth == rule->birth &&
+        specializedKernels[i].survive == rule->survive &&
+        specializedKernels[i].states == rule->states)
+      return specializedKernels[i].step;
+  }
+
+  return rule->family == RULE_LIFE ? stepRowsLife : stepRowsGenerations;
+}
+
+#ifdef RULE_X86
+// Two-state rules as a table lookup: the neighbour counts index the birth
+// and survival halves of the table with a byte shuffle, so any rule costs
+// the same as the hardcoded B3/S23 kernel
+__attribute__((target("avx2"))) static void
+stepRowsTableAvx2(const struct LifeRule *rule, const uint8_t *cur,
+                  uint8_t *next, int stride, int cols, int yStart, int yEnd) {
+  uint8_t born[16] = {0}, stay[16] = {0};
+  memcpy(born, rule->table, 9);
+  memcpy(stay, rule->table + 9, 9);
+
+  const __m256i bornTable =
+      _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)born));
+  const __m256i stayTable =
+      _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)stay));
+  const __m256i one = _mm256_set1_epi8(1);
+
+  for (int y = yStart; y < yEnd; y++) {
+    const uint8_t *up = cur + (size_t)y * stride;
+    const uint8_t *mid = up + stride;
+    const uint8_t *down = mid + stride;
+    uint8_t *out = next + (size_t)(y + 1) * stride + 1;
+
+    int x = 0;
+    for (; x < cols; x += 32) {
+      __m256i n = _mm256_loadu_si256((const __m256i *)(up + x));
+      n = _mm256_add_epi8(n, _mm256_loadu_si256((const __m256i *)(up + x + 1)));
+      n = _mm256_add_epi8(n, _mm256_loadu_si256((const __m256i *)(up + x + 2)));
+      n = _mm256_add_epi8(n, _mm256_loadu_si256((const __m256i *)(mid + x)));
+      n = _mm256_add_epi8(n,
+                          _mm256_loadu_si256((const __m256i *)(mid + x + 2)));
+      n = _mm256_add_epi8(n, _mm256_loadu_si256((const __m256i *)(down + x)));
+      n = _mm256_add_epi8(n,
+                          _mm256_loadu_si256((const __m256i *)(down + x + 1)));
+      n = _mm256_add_epi8(n,
+                          _mm256_loadu_si256((const __m256i *)(down + x + 2)));
+
+      __m256i self = _mm256_loadu_si256((const __m256i *)(mid + x + 1));
+      __m256i live = _mm256_cmpeq_epi8(self, one);
+      __m256i born = _mm256_shuffle_epi8(bornTable, n);
+      __m256i stay = _mm256_shuffle_epi8(stayTable, n);
+      _mm256_storeu_si256((__m256i *)(out + x),
+                          _mm256_blendv_epi8(born, stay, live));
+    }
+
+    // The last vector spills into the right border, which has to stay dead
+    memset(out + cols, 0, x - cols);
+  }
+}
+
+// Generations rules the same way. Live neighbours are counted from the
+// state == 1 masks, and dying cells age with a saturating compare.
+__attribute__((target("avx2"))) static void
+stepRowsGenerationsAvx2(const struct LifeRule *rule, const uint8_t *cur,
+                        uint8_t *next, int stride, int cols, int yStart,
+                        int yEnd) {
+  uint8_t born[16] = {0}, stay[16] = {0};
+  memcpy(born, rule->table, 9);
+  memcpy(stay, rule->table + 9, 9);
+
+  const __m256i bornTable =
+      _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)born));
+  const __m256i stayTable =
+      _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)stay));
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi8(1);
+  const __m256i lastState = _mm256_set1_epi8((char)(rule->states - 1));
+
+#define LIVE_AT(p)                                                            \
+  _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p)), one)
+
+  for (int y = yStart; y < yEnd; y++) {
+    const uint8_t *up = cur + (size_t)y * stride;
+    const uint8_t *mid = up + stride;
+    const uint8_t *down = mid + stride;
+    uint8_t *out = next + (size_t)(y + 1) * stride + 1;
+
+    int x = 0;
+    for (; x < cols; x += 32) {
+      // Live masks are -1, so the sum is minus the count
+      __m256i sum = LIVE_AT(up + x);
+      sum = _mm256_add_epi8(sum, LIVE_AT(up + x + 1));
+      sum = _mm256_add_epi8(sum, LIVE_AT(up + x + 2));
+      sum = _mm256_add_epi8(sum, LIVE_AT(mid + x));
+      sum = _mm256_add_epi8(sum, LIVE_AT(mid + x + 2));
+      sum = _mm256_add_epi8(sum, LIVE_AT(down + x));
+      sum = _mm256_add_epi8(sum, LIVE_AT(down + x + 1));
+      sum = _mm256_add_epi8(sum, LIVE_AT(down + x + 2));
+      __m256i n = _mm256_sub_epi8(zero, sum);
+
+      __m256i self = _mm256_loadu_si256((const __m256i *)(mid + x + 1));
+      __m256i older = _mm256_add_epi8(self, one);
+      __m256i aging = _mm256_cmpeq_epi8(_mm256_min_epu8(older, lastState),
+                                        older);
+      __m256i result = _mm256_and_si256(older, aging);
+      result = _mm256_blendv_epi8(result, _mm256_shuffle_epi8(stayTable, n),
+                                  _mm256_cmpeq_epi8(self, one));
+      result = _mm256_blendv_epi8(result, _mm256_shuffle_epi8(bornTable, n),
+                                  _mm256_cmpeq_epi8(self, zero));
+      _mm256_storeu_si256((__m256i *)(out + x), result);
+    }
+
+    memset(out + cols, 0, x - cols);
+  }
+
+#undef LIVE_AT
+}
+
+// SSE2 has no byte shuffle, so each count the rule reacts to is compared
+// for instead
+__attribute__((target("sse2"))) static void
+stepRowsTableSse2(const struct LifeRule *rule, const uint8_t *cur,
+                  uint8_t *next, int stride, int cols, int yStart, int yEnd) {
+  __m128i counts[9], born[9], stay[9];
+  int used = 0;
+  for (int n = 0; n <= 8; n++) {
+    if (rule->table[n] || rule->table[9 + n]) {
+      counts[used] = _mm_set1_epi8(n);
+      born[used] = _mm_set1_epi8(rule->table[n]);
+      stay[used] = _mm_set1_epi8(rule->table[9 + n]);
+      used++;
+    }
+  }
+  const __m128i one = _mm_set1_epi8(1);
+
+  for (int y = yStart; y < yEnd; y++) {
+    const uint8_t *up = cur + (size_t)y * stride;
+    const uint8_t *mid = up + stride;
+    const uint8_t *down = mid + stride;
+    uint8_t *out = next + (size_t)(y + 1) * stride + 1;
+
+    int x = 0;
+    for (; x < cols; x += 16) {
+      __m128i n = _mm_loadu_si128((const __m128i *)(up + x));
+      n = _mm_add_epi8(n, _mm_loadu_si128((const __m128i *)(up + x + 1)));
+      n = _mm_add_epi8(n, _mm_loadu_si128((const __m128i *)(up + x + 2)));
+      n = _mm_add_epi8(n, _mm_loadu_si128((const __m128i *)(mid + x)));
+      n = _mm_add_epi8(n, _mm_loadu_si128((const __m128i *)(mid + x + 2)));
+      n = _mm_add_epi8(n, _mm_loadu_si128((const __m128i *)(down + x)));
+      n = _mm_add_epi8(n, _mm_loadu_si128((const __m128i *)(down + x + 1)));
+      n = _mm_add_epi8(n, _mm_loadu_si128((const __m128i *)(down + x + 2)));
+
+      __m128i self = _mm_loadu_si128((const __m128i *)(mid + x + 1));
+      __m128i live = _mm_cmpeq_epi8(self, one);
+      __m128i result = _mm_setzero_si128();
+      for (int i = 0; i < used; i++) {
+        __m128i value = _mm_or_si128(_mm_andnot_si128(live, born[i]),
+                                     _mm_and_si128(live, stay[i]));
+        result = _mm_or_si128(
+            result, _mm_and_si128(_mm_cmpeq_epi8(n, counts[i]), value));
+      }
+      _mm_storeu_si128((__m128i *)(out + x), result);
+    }
+
+    memset(out + cols, 0, x - cols);
+  }
+}
+#endif
+
+// Rows of the summed-area table of the calling thread, kept between steps
+// and only grown: the tile engine wants them per tile and the pool per
+// band, every generation
+static _Thread_local uint32_t *largerSums;
+static _Thread_local size_t largerCapacity;
+
+static uint32_t *reserveSums(size_t count) {
+  if (count > largerCapacity) {
+    free(largerSums);
+    largerSums = malloc(count * sizeof(uint32_t));
+    largerCapacity = largerSums == NULL ? 0 : count;
+  }
+  if (largerSums == NULL) {
+    fprintf(stderr, "Failed to allocate the summed-area table.\n");
+    abort();
+  }
+  return largerSums;
+}
+
+void ruleFreeScratch(void) {
+  free(largerSums);
+  largerSums = NULL;
+  largerCapacity = 0;
+}
+
+// Larger than Life through a summed-area table of the live cells around
+// the rectangle, so every cell costs four lookups whatever the range. Sums
+// wrap past 2^32 cells, which the differences undo.
+static void stepRectLarger(const struct LifeRule *rule, struct LifeGrid *grid,
+                           int yStart, int yEnd, int xStart, int xEnd) {
+  int range = rule->range;
+  int top = yStart - range > 0 ? yStart - range : 0;
+  int bottom = yEnd + range < grid->rows ? yEnd + range : grid->rows;
+  int left = xStart - range > 0 ? xStart - range : 0;
+  int right = xEnd + range < grid->cols ? xEnd + range : grid->cols;
+  size_t width = (size_t)(right - left + 1);
+
+  // Row i, column j holds the live cells above and left of window (i, j).
+  // A cell reads two rows at most 2 * range + 1 apart, so only a strip of
+  // rows is kept, row i in slot i % strip.
+  int strip = 2 * range + 2;
+  uint32_t *sums = reserveSums((size_t)strip * width);
+  memset(sums, 0, width * sizeof(uint32_t));
+  int built = 0;
+
+  for (int y = yStart; y < yEnd; y++) {
+    int y0 = (y - range > top ? y - range : top) - top;
+    int y1 = (y + range + 1 < bottom ? y + range + 1 : bottom) - top;
+    for (; built < y1; built++) {
+      const uint8_t *row = lifeCell(grid, top + built, 0);
+      const uint32_t *above = sums + (size_t)(built % strip) * width;
+      uint32_t *sum = sums + (size_t)((built + 1) % strip) * width;
+
+      uint32_t rowSum = 0;
+      sum[0] = 0;
+      for (int x = left; x < right; x++) {
+        rowSum += row[x] == 1;
+        sum[x - left + 1] = above[x - left + 1] + rowSum;
+      }
+    }
+
+    const uint32_t *upper = sums + (size_t)(y0 % strip) * width;
+    const uint32_t *lower = sums + (size_t)(y1 % strip) * width;
+    const uint8_t *row = lifeCell(grid, y, 0);
+    uint8_t *out = grid->next + (size_t)(y + 1) * grid->stride + 1;
+
+    for (int x = xStart; x < xEnd; x++) {
+      int x0 = (x - range > left ? x - range : left) - left;
+      int x1 = (x + range + 1 < right ? x + range + 1 : right) - left;
+      int count = lower[x1] - lower[x0] - upper[x1] + upper[x0];
+      if (!rule->middle)
+        count -= row[x] == 1;
+
+      out[x] = ruleNextState(rule, row[x], count);
+    }
+  }
+}
+
+void ruleStepRect(const struct LifeRule *rule, enum LifeKernel kernel,
+                  struct LifeGrid *grid, int yStart, int yEnd, int xStart,
+                  int xEnd) {
+  if (rule->family == RULE_LARGER) {
+    stepRectLarger(rule, grid, yStart, yEnd, xStart, xEnd);
+    return;
+  }
+
+  RuleRowsFn step = scalarKernel(rule);
+#ifdef RULE_X86
+  if (rule->family == RULE_LIFE && kernel == LIFE_KERNEL_AVX2)
+    step = stepRowsTableAvx2;
+  else if (rule->family == RULE_LIFE && kernel == LIFE_KERNEL_SSE2)
+    step = stepRowsTableSse2;
+  else if (rule->family == RULE_GENERATIONS && kernel == LIFE_KERNEL_AVX2)
+    step = stepRowsGenerationsAvx2;
+#else
+  (void)kernel;
+#endif
+
+  step(rule, grid->cells + xStart, grid->next + xStart, grid->stride,
+       xEnd - xStart, yStart, yEnd);
+}
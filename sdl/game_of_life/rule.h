@@ -0,0 +1,69 @@
+#ifndef RULE_H
+#define RULE_H
+
+#include <stdint.h>
+
+#include "life.h"
+
+// Outer-totalistic rules: the next state of a cell only depends on its own
+// state and how many live cells there are around it.
+enum RuleFamily {
+  // Two states, Moore neighbourhood of range 1 (Life, HighLife, Seeds...)
+  RULE_LIFE,
+  // Live cells that don't survive go through states - 2 dying states, which
+  // count as dead neighbours, before they are dead (Brian's Brain...)
+  RULE_GENERATIONS,
+  // Larger than Life: Moore neighbourhood of any range, birth and survival
+  // given as count ranges. Reaches past the one cell halo, so only runs
+  // with a dead boundary.
+  RULE_LARGER,
+};
+
+#define RULE_MAX_STATES 200
+#define RULE_MAX_RANGE 64
+
+struct LifeRule {
+  enum RuleFamily family;
+  char name[64];
+
+  // Bit n is set if a dead cell is born / a live cell survives with n live
+  // neighbours. Range 1 families only.
+  uint16_t birth, survive;
+  // Next state of a dead (0..8) or live (9..17) cell with n live neighbours
+  uint8_t table[18];
+  int states;
+
+  // Larger than Life. The counts include the cell itself if middle is set.
+  int range;
+  int middle;
+  int birthMin, birthMax;
+  int surviveMin, surviveMax;
+};
+
+// Accepts B/S notation (B36/S23, or S/B as 23/36), Generations as B2/S/C3
+// or S/B/C (/2/3), HROT style Larger than Life (R5,C0,M1,S34..58,B34..45,NM)
+// and the names life, highlife, daynight, seeds, brain and bosco.
+// Returns -1 if the rule can't be parsed.
+int ruleParse(struct LifeRule *rule, const char *text);
+
+// B3/S23 runs on the hardcoded kernels in life.c
+int ruleIsConway(const struct LifeRule *rule);
+// Whether dead cells with no live neighbours are born, which the
+// unbounded engines can't represent
+int ruleBirthOnZero(const struct LifeRule *rule);
+
+// Next state of a cell with the given state and live count (for Larger
+// than Life, including the cell itself if the rule says so)
+int ruleNextState(const struct LifeRule *rule, int state, int count);
+
+// Steps rows [yStart, yEnd), columns [xStart, xEnd) of the grid into
+// grid->next with the kernel family of the rule. Same column rules as
+// lifeStepRect.
+void ruleStepRect(const struct LifeRule *rule, enum LifeKernel kernel,
+                  struct LifeGrid *grid, int yStart, int yEnd, int xStart,
+                  int xEnd);
+// Frees the scratch ruleStepRect keeps for the calling thread, before it
+// exits
+void ruleFreeScratch(void);
+
+#endif
@@ -0,0 +1,187 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "soup.h"
+#include "pool.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint64_t rotate(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+// The state is expanded from the seed with splitmix64, as xoshiro's
+// authors suggest, so nearby seeds still start far apart
+void soupRandomInit(struct SoupRandom *random, uint64_t seed) {
+  for (int i = 0; i < 4; i++) {
+    uint64_t z = (seed += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    random->state[i] = z ^ (z >> 31);
+  }
+}
+
+uint64_t soupRandomNext(struct SoupRandom *random) {
+  uint64_t *s = random->state;
+  uint64_t result = rotate(s[0] + s[3], 23) + s[0];
+  uint64_t t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotate(s[3], 45);
+  return result;
+}
+
+void soupRandomJump(struct SoupRandom *random) {
+  static const uint64_t jump[4] = {
+      0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull, 0xa9582618e03fc9aaull,
+      0x39abdc4529b1661cull};
+  uint64_t s[4] = {0, 0, 0, 0};
+  for (int i = 0; i < 4; i++) {
+    for (int bit = 0; bit < 64; bit++) {
+      if (jump[i] >> bit & 1) {
+        for (int k = 0; k < 4; k++) {
+          s[k] ^= random->state[k];
+        }
+      }
+      soupRandomNext(random);
+    }
+  }
+
+  memcpy(random->state, s, sizeof(s));
+}
+
+void soupDensityInit(struct SoupDensity *density, double percent) {
+  percent = percent < 0 ? 0 : percent > 100 ? 100 : percent;
+  density->fraction = (uint32_t)(percent / 100 * 65536 + 0.5);
+  density->lowestBit = 0;
+  while (density->lowestBit < 16 &&
+         !(density->fraction >> density->lowestBit & 1)) {
+    density->lowestBit++;
+  }
+}
+
+// Each step halves the chance so far and, for a set bit, adds a half:
+// ANDing with a fair draw halves it, ORing with one halves it and adds a
+// half. After the top bit every cell is alive with fraction / 65536.
+uint64_t soupMask(struct SoupRandom *random,
+                  const struct SoupDensity *density) {
+  if (density->fraction >= 65536)
+    return UINT64_MAX;
+
+  uint64_t mask = 0;
+  for (int bit = density->lowestBit; bit < 16; bit++) {
+    uint64_t draw = soupRandomNext(random);
+    mask = density->fraction >> bit & 1 ? mask | draw : mask & draw;
+  }
+  return mask;
+}
+
+// Bit i of the mask becomes cell i. Seven bits spread with one multiply,
+// their copies 7 bits apart never carry into each other, and the eighth
+// goes in on its own.
+static void spreadMask(uint64_t mask, uint8_t *cells) {
+  for (int i = 0; i < 8; i++) {
+    uint64_t bits = mask >> (8 * i) & 0xff;
+    uint64_t bytes = ((bits & 0x7f) * 0x0002040810204081ull &
+                      0x0101010101010101ull) |
+                     (bits >> 7) << 56;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    bytes = __builtin_bswap64(bytes);
+#endif
+    memcpy(cells + 8 * i, &bytes, 8);
+  }
+}
+
+// The last partial chunk goes through a buffer, past the last column is
+// the halo
+static void fillRow(uint8_t *row, int cols, struct SoupRandom *random,
+                    const struct SoupDensity *density) {
+  int x = 0;
+  for (; x + 64 <= cols; x += 64) {
+    spreadMask(soupMask(random, density), row + x);
+  }
+
+  if (x < cols) {
+    uint8_t tail[64];
+    spreadMask(soupMask(random, density), tail);
+    memcpy(row + x, tail, cols - x);
+  }
+}
+
+struct SoupJob {
+  struct LifeGrid *grid;
+  uint64_t seed;
+  struct SoupDensity density;
+  int firstBand, lastBand;
+  pthread_t thread;
+  int started;
+};
+
+// Band b is filled from the seed's stream jumped b times
+static void *fillBands(void *arg) {
+  struct SoupJob *job = arg;
+  struct LifeGrid *grid = job->grid;
+  struct SoupRandom band;
+  soupRandomInit(&band, job->seed);
+  for (int b = 0; b < job->firstBand; b++) {
+    soupRandomJump(&band);
+  }
+
+  for (int b = job->firstBand; b < job->lastBand; b++) {
+    struct SoupRandom random = band;
+    int yEnd = (b + 1) * SOUP_BAND_ROWS;
+    yEnd = yEnd < grid->rows ? yEnd : grid->rows;
+    for (int y = b * SOUP_BAND_ROWS; y < yEnd; y++) {
+      fillRow(lifeCell(grid, y, 0), grid->cols, &random, &job->density);
+    }
+    soupRandomJump(&band);
+  }
+
+  return NULL;
+}
+
+void soupFillGrid(struct LifeGrid *grid, uint64_t seed, double percent,
+                  int threads) {
+  int bands = (grid->rows + SOUP_BAND_ROWS - 1) / SOUP_BAND_ROWS;
+  if (threads < 1)
+    threads = poolDefaultThreads();
+  if (threads > bands)
+    threads = bands;
+
+  struct SoupJob single;
+  struct SoupJob *jobs = threads > 1 ? malloc(threads * sizeof(*jobs)) : NULL;
+  if (jobs == NULL) {
+    jobs = &single;
+    threads = 1;
+  }
+
+  for (int i = 0; i < threads; i++) {
+    jobs[i].grid = grid;
+    jobs[i].seed = seed;
+    soupDensityInit(&jobs[i].density, percent);
+    jobs[i].firstBand = (int)((int64_t)bands * i / threads);
+    jobs[i].lastBand = (int)((int64_t)bands * (i + 1) / threads);
+  }
+
+  // The caller takes the first bands, and those of any thread that
+  // couldn't be started
+  for (int i = 1; i < threads; i++) {
+    jobs[i].started =
+        pthread_create(&jobs[i].thread, NULL, fillBands, &jobs[i]) == 0;
+    if (!jobs[i].started)
+      fillBands(&jobs[i]);
+  }
+  fillBands(&jobs[0]);
+
+  for (int i = 1; i < threads; i++) {
+    if (jobs[i].started)
+      pthread_join(jobs[i].thread, NULL);
+  }
+
+  if (jobs != &single)
+    free(jobs);
+}
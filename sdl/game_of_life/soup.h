@@ -0,0 +1,41 @@
+#ifndef SOUP_H
+#define SOUP_H
+
+#include <stdint.h>
+
+#include "life.h"
+
+// Rows filled from one stream, so a seed gives the same soup whatever the
+// thread count
+#define SOUP_BAND_ROWS 64
+
+// xoshiro256++: four words of state, a few cycles a draw, and a jump that
+// moves 2^128 draws ahead, so one seed splits into non-overlapping streams
+struct SoupRandom {
+  uint64_t state[4];
+};
+
+void soupRandomInit(struct SoupRandom *random, uint64_t seed);
+uint64_t soupRandomNext(struct SoupRandom *random);
+void soupRandomJump(struct SoupRandom *random);
+
+// Chance of a live cell in 65536ths. soupMask decides 64 cells at a time
+// with one draw per bit of it, from the lowest set one up: 25% takes two
+// draws, any percent at most 16.
+struct SoupDensity {
+  uint32_t fraction;
+  int lowestBit;
+};
+
+// Any percent from 0 to 100, fractions of one too
+void soupDensityInit(struct SoupDensity *density, double percent);
+// Bit i is set with the density's chance, independently of the others
+uint64_t soupMask(struct SoupRandom *random, const struct SoupDensity *density);
+
+// Seeds the grid with a soup, one stream per band of SOUP_BAND_ROWS rows,
+// on up to threads threads (0 picks the core count). Faster than
+// lifeGridRandomize by far, but a different soup for the same seed.
+void soupFillGrid(struct LifeGrid *grid, uint64_t seed, double percent,
+                  int threads);
+
+#endif
@@ -0,0 +1,383 @@
+#include "sparse.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Empty chunks kept around for reuse, beyond this they are freed
+#define CHUNK_FREE_LIMIT 256
+
+static const int directionOffsets[8][2] = {
+    {-1, 0}, {-1, 1}, {0, 1}, {1, 1}, {1, 0}, {1, -1}, {0, -1}, {-1, -1},
+};
+
+static uint64_t chunkKey(int32_t cy, int32_t cx) {
+  return ((uint64_t)(uint32_t)cy << 32) | (uint32_t)cx;
+}
+
+static size_t hashKey(uint64_t key) {
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdull;
+  key ^= key >> 33;
+  return (size_t)key;
+}
+
+// Chunk coordinate of a cell, rounding towards negative infinity
+static int32_t chunkCoord(int64_t v) {
+  return (int32_t)(v >= 0 ? v / CHUNK_SIZE
+                           : (v - CHUNK_SIZE + 1) / CHUNK_SIZE);
+}
+
+int sparseInit(struct SparseWorld *world) {
+  memset(world, 0, sizeof(struct SparseWorld));
+  world->tableSize = 1024;
+  world->table = calloc(world->tableSize, sizeof(struct Chunk *));
+  world->chunkCapacity = 256;
+  world->chunks = malloc(world->chunkCapacity * sizeof(struct Chunk *));
+  if (world->table == NULL || world->chunks == NULL) {
+    free(world->table);
+    free(world->chunks);
+    return -1;
+  }
+
+  return 0;
+}
+
+static void destroyChunk(struct Chunk *chunk) {
+  lifeGridFree(&chunk->grid);
+  free(chunk);
+}
+
+void sparseFree(struct SparseWorld *world) {
+  for (int i = 0; i < world->chunkCount; i++) {
+    destroyChunk(world->chunks[i]);
+  }
+
+  while (world->freeList != NULL) {
+    struct Chunk *next = world->freeList->next;
+    destroyChunk(world->freeList);
+    world->freeList = next;
+  }
+
+  free(world->chunks);
+  free(world->table);
+  memset(world, 0, sizeof(struct SparseWorld));
+}
+
+static struct Chunk *findChunk(struct SparseWorld *world, int32_t cy,
+                               int32_t cx) {
+  uint64_t key = chunkKey(cy, cx);
+  struct Chunk *chunk = world->table[hashKey(key) & (world->tableSize - 1)];
+  while (chunk != NULL && chunk->key != key) {
+    chunk = chunk->next;
+  }
+
+  return chunk;
+}
+
+static void growTable(struct SparseWorld *world) {
+  size_t newSize = world->tableSize * 2;
+  struct Chunk **newTable = calloc(newSize, sizeof(struct Chunk *));
+  if (newTable == NULL)
+    return;
+
+  for (int i = 0; i < world->chunkCount; i++) {
+    struct Chunk *chunk = world->chunks[i];
+    size_t index = hashKey(chunk->key) & (newSize - 1);
+    chunk->next = newTable[index];
+    newTable[index] = chunk;
+  }
+
+  free(world->table);
+  world->table = newTable;
+  world->tableSize = newSize;
+}
+
+static struct Chunk *createChunk(struct SparseWorld *world, int32_t cy,
+                                 int32_t cx) {
+  struct Chunk *chunk = world->freeList;
+  if (chunk != NULL) {
+    world->freeList = chunk->next;
+    world->freeCount--;
+    lifeGridClear(&chunk->grid);
+  } else {
+    chunk = malloc(sizeof(struct Chunk));
+    if (chunk == NULL ||
+        lifeGridInit(&chunk->grid, CHUNK_SIZE, CHUNK_SIZE) != 0) {
+      fprintf(stderr, "Out of memory for chunks.\n");
+      exit(1);
+    }
+  }
+
+  if (world->chunkCount == world->chunkCapacity) {
+    world->chunkCapacity *= 2;
+    world->chunks =
+        realloc(world->chunks, world->chunkCapacity * sizeof(struct Chunk *));
+    if (world->chunks == NULL) {
+      fprintf(stderr, "Out of memory for chunks.\n");
+      exit(1);
+    }
+  }
+
+  chunk->cx = cx;
+  chunk->cy = cy;
+  chunk->key = chunkKey(cy, cx);
+  chunk->population = 0;
+  chunk->index = world->chunkCount;
+  world->chunks[world->chunkCount++] = chunk;
+
+  size_t index = hashKey(chunk->key) & (world->tableSize - 1);
+  chunk->next = world->table[index];
+  world->table[index] = chunk;
+
+  // Link both ways
+  for (int d = 0; d < 8; d++) {
+    struct Chunk *neighbor = findChunk(world, cy + directionOffsets[d][0],
+                                       cx + directionOffsets[d][1]);
+    chunk->neighbors[d] = neighbor;
+    if (neighbor != NULL)
+      neighbor->neighbors[d ^ 4] = chunk;
+  }
+
+  if ((size_t)world->chunkCount > world->tableSize)
+    growTable(world);
+
+  return chunk;
+}
+
+static void removeChunk(struct SparseWorld *world, struct Chunk *chunk) {
+  struct Chunk **link =
+      &world->table[hashKey(chunk->key) & (world->tableSize - 1)];
+  while (*link != chunk) {
+    link = &(*link)->next;
+  }
+  *link = chunk->next;
+
+  for (int d = 0; d < 8; d++) {
+    if (chunk->neighbors[d] != NULL)
+      chunk->neighbors[d]->neighbors[d ^ 4] = NULL;
+  }
+
+  struct Chunk *last = world->chunks[--world->chunkCount];
+  world->chunks[chunk->index] = last;
+  last->index = chunk->index;
+
+  if (world->freeCount < CHUNK_FREE_LIMIT) {
+    chunk->next = world->freeList;
+    world->freeList = chunk;
+    world->freeCount++;
+  } else {
+    destroyChunk(chunk);
+  }
+}
+
+void sparseClear(struct SparseWorld *world) {
+  while (world->chunkCount > 0) {
+    removeChunk(world, world->chunks[world->chunkCount - 1]);
+  }
+}
+
+int sparseGetCell(struct SparseWorld *world, int64_t y, int64_t x) {
+  int32_t cy = chunkCoord(y);
+  int32_t cx = chunkCoord(x);
+  struct Chunk *chunk = findChunk(world, cy, cx);
+  if (chunk == NULL)
+    return 0;
+
+  return *lifeCell(&chunk->grid, (int)(y - (int64_t)cy * CHUNK_SIZE),
+                   (int)(x - (int64_t)cx * CHUNK_SIZE));
+}
+
+void sparseSetCell(struct SparseWorld *world, int64_t y, int64_t x,
+                   int alive) {
+  int32_t cy = chunkCoord(y);
+  int32_t cx = chunkCoord(x);
+  struct Chunk *chunk = findChunk(world, cy, cx);
+  if (chunk == NULL) {
+    if (!alive)
+      return;
+    chunk = createChunk(world, cy, cx);
+  }
+
+  uint8_t *cell = lifeCell(&chunk->grid, (int)(y - (int64_t)cy * CHUNK_SIZE),
+                           (int)(x - (int64_t)cx * CHUNK_SIZE));
+  chunk->population += (alive != 0) - *cell;
+  *cell = alive != 0;
+}
+
+void sparseFromGrid(struct SparseWorld *world, struct LifeGrid *grid,
+                    int64_t y, int64_t x) {
+  sparseClear(world);
+  for (int gy = 0; gy < grid->rows; gy++) {
+    for (int gx = 0; gx < grid->cols; gx++) {
+      if (*lifeCell(grid, gy, gx))
+        sparseSetCell(world, y + gy, x + gx, 1);
+    }
+  }
+}
+
+void sparseToGrid(struct SparseWorld *world, struct LifeGrid *grid, int64_t y,
+                  int64_t x) {
+  lifeGridClear(grid);
+
+  for (int i = 0; i < world->chunkCount; i++) {
+    struct Chunk *chunk = world->chunks[i];
+    if (chunk->population == 0)
+      continue;
+
+    // Chunk position inside the grid, clipped to it
+    int64_t top = (int64_t)chunk->cy * CHUNK_SIZE - y;
+    int64_t left = (int64_t)chunk->cx * CHUNK_SIZE - x;
+    if (top >= grid->rows || left >= grid->cols || top + CHUNK_SIZE <= 0 ||
+        left + CHUNK_SIZE <= 0)
+      continue;
+
+    int xFrom = left < 0 ? (int)-left : 0;
+    int xTo = left + CHUNK_SIZE > grid->cols ? (int)(grid->cols - left)
+                                             : CHUNK_SIZE;
+    for (int cy = 0; cy < CHUNK_SIZE; cy++) {
+      int64_t gy = top + cy;
+      if (gy < 0 || gy >= grid->rows)
+        continue;
+
+      memcpy(lifeCell(grid, (int)gy, (int)(left + xFrom)),
+             lifeCell(&chunk->grid, cy, xFrom), xTo - xFrom);
+    }
+  }
+}
+
+static int rowAlive(const uint8_t *row) {
+  for (int x = 0; x < CHUNK_SIZE; x++) {
+    if (row[x])
+      return 1;
+  }
+
+  return 0;
+}
+
+static int columnAlive(struct LifeGrid *grid, int x) {
+  for (int y = 0; y < CHUNK_SIZE; y++) {
+    if (*lifeCell(grid, y, x))
+      return 1;
+  }
+
+  return 0;
+}
+
+// Live cells on an edge can cause births in the chunk across that edge
+static void allocateNeighbors(struct SparseWorld *world, struct Chunk *chunk) {
+  struct LifeGrid *grid = &chunk->grid;
+  int last = CHUNK_SIZE - 1;
+  int edge[8];
+  edge[DIR_N] = rowAlive(lifeCell(grid, 0, 0));
+  edge[DIR_S] = rowAlive(lifeCell(grid, last, 0));
+  edge[DIR_W] = columnAlive(grid, 0);
+  edge[DIR_E] = columnAlive(grid, last);
+  edge[DIR_NE] = *lifeCell(grid, 0, last);
+  edge[DIR_SE] = *lifeCell(grid, last, last);
+  edge[DIR_SW] = *lifeCell(grid, last, 0);
+  edge[DIR_NW] = *lifeCell(grid, 0, 0);
+
+  for (int d = 0; d < 8; d++) {
+    if (edge[d] && chunk->neighbors[d] == NULL) {
+      createChunk(world, chunk->cy + directionOffsets[d][0],
+                  chunk->cx + directionOffsets[d][1]);
+    }
+  }
+}
+
+static uint8_t neighborCell(struct Chunk *chunk, int d, int y, int x) {
+  struct Chunk *neighbor = chunk->neighbors[d];
+  return neighbor == NULL ? 0 : *lifeCell(&neighbor->grid, y, x);
+}
+
+// Copies the cells just across each edge into the chunk's border
+static void fillHalo(struct Chunk *chunk) {
+  struct LifeGrid *grid = &chunk->grid;
+  int last = CHUNK_SIZE - 1;
+  uint8_t *top = lifeCell(grid, -1, 0);
+  uint8_t *bottom = lifeCell(grid, CHUNK_SIZE, 0);
+
+  if (chunk->neighbors[DIR_N] != NULL) {
+    memcpy(top, lifeCell(&chunk->neighbors[DIR_N]->grid, last, 0),
+           CHUNK_SIZE);
+  } else {
+    memset(top, 0, CHUNK_SIZE);
+  }
+
+  if (chunk->neighbors[DIR_S] != NULL) {
+    memcpy(bottom, lifeCell(&chunk->neighbors[DIR_S]->grid, 0, 0),
+           CHUNK_SIZE);
+  } else {
+    memset(bottom, 0, CHUNK_SIZE);
+  }
+
+  for (int y = 0; y < CHUNK_SIZE; y++) {
+    *lifeCell(grid, y, -1) = neighborCell(chunk, DIR_W, y, last);
+    *lifeCell(grid, y, CHUNK_SIZE) = neighborCell(chunk, DIR_E, y, 0);
+  }
+
+  *lifeCell(grid, -1, -1) = neighborCell(chunk, DIR_NW, last, last);
+  *lifeCell(grid, -1, CHUNK_SIZE) = neighborCell(chunk, DIR_NE, last, 0);
+  *lifeCell(grid, CHUNK_SIZE, -1) = neighborCell(chunk, DIR_SW, 0, last);
+  *lifeCell(grid, CHUNK_SIZE, CHUNK_SIZE) = neighborCell(chunk, DIR_SE, 0, 0);
+}
+
+static int countPopulation(struct LifeGrid *grid) {
+  int population = 0;
+  for (int y = 0; y < CHUNK_SIZE; y++) {
+    const uint8_t *row = lifeCell(grid, y, 0);
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+      population += row[x];
+    }
+  }
+
+  return population;
+}
+
+void sparseStep(struct SparseWorld *world) {
+  // Chunks created here are empty, so they never need neighbours themselves
+  int count = world->chunkCount;
+  for (int i = 0; i < count; i++) {
+    if (world->chunks[i]->population > 0)
+      allocateNeighbors(world, world->chunks[i]);
+  }
+
+  // Every halo has to be filled before any chunk swaps its buffers
+  for (int i = 0; i < world->chunkCount; i++) {
+    fillHalo(world->chunks[i]);
+  }
+
+  for (int i = 0; i < world->chunkCount; i++) {
+    struct Chunk *chunk = world->chunks[i];
+    lifeStep(&chunk->grid);
+    chunk->population = countPopulation(&chunk->grid);
+  }
+
+  // Walk backwards, removing a chunk moves the last one into its slot
+  for (int i = world->chunkCount - 1; i >= 0; i--) {
+    if (world->chunks[i]->population == 0)
+      removeChunk(world, world->chunks[i]);
+  }
+
+  world->generation++;
+}
+
+uint64_t sparsePopulation(struct SparseWorld *world) {
+  uint64_t population = 0;
+  for (int i = 0; i < world->chunkCount; i++) {
+    population += world->chunks[i]->population;
+  }
+
+  return population;
+}
+
+size_t sparseMemory(struct SparseWorld *world) {
+  // Same stride as lifeGridInit gives a CHUNK_SIZE wide grid
+  size_t stride = ((CHUNK_SIZE + 31) / 32) * 32 + 32;
+  size_t chunkBytes =
+      sizeof(struct Chunk) + 2 * (size_t)(CHUNK_SIZE + 2) * stride;
+  return (world->chunkCount + world->freeCount) * chunkBytes +
+         world->tableSize * sizeof(struct Chunk *) +
+         world->chunkCapacity * sizeof(struct Chunk *);
+}
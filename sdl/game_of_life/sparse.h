@@ -0,0 +1,72 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "life.h"
+
+// Chunks are a whole number of AVX2 vectors wide
+#define CHUNK_SIZE 32
+
+// Opposite directions are four apart, so d ^ 4 flips a direction
+enum ChunkDirection {
+  DIR_N,
+  DIR_NE,
+  DIR_E,
+  DIR_SE,
+  DIR_S,
+  DIR_SW,
+  DIR_W,
+  DIR_NW
+};
+
+// A CHUNK_SIZE square of an unbounded world. The grid's dead border is used
+// as a halo here: it is filled from the neighbouring chunks before a step.
+struct Chunk {
+  int32_t cx, cy;
+  uint64_t key;
+  struct LifeGrid grid;
+  int population;
+
+  // Cached so a step never has to go through the hash table
+  struct Chunk *neighbors[8];
+  struct Chunk *next;
+  int index;
+};
+
+// Only chunks with live cells (and the empty ones right next to them) are
+// allocated, so memory follows the population rather than the bounding box
+struct SparseWorld {
+  struct Chunk **table;
+  size_t tableSize;
+
+  struct Chunk **chunks;
+  int chunkCount;
+  int chunkCapacity;
+
+  struct Chunk *freeList;
+  int freeCount;
+
+  uint64_t generation;
+};
+
+int sparseInit(struct SparseWorld *world);
+void sparseFree(struct SparseWorld *world);
+void sparseClear(struct SparseWorld *world);
+
+int sparseGetCell(struct SparseWorld *world, int64_t y, int64_t x);
+void sparseSetCell(struct SparseWorld *world, int64_t y, int64_t x,
+                   int alive);
+
+// Copies a window of the world, starting at world (y, x), from or to a grid
+void sparseFromGrid(struct SparseWorld *world, struct LifeGrid *grid,
+                    int64_t y, int64_t x);
+void sparseToGrid(struct SparseWorld *world, struct LifeGrid *grid, int64_t y,
+                  int64_t x);
+
+void sparseStep(struct SparseWorld *world);
+uint64_t sparsePopulation(struct SparseWorld *world);
+size_t sparseMemory(struct SparseWorld *world);
+
+#endif
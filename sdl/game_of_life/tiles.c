@@ -0,0 +1,109 @@
+#include "tiles.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int tilesInit(struct TileTracker *tiles, struct LifeGrid *grid) {
+  tiles->tileRows = (grid->rows + TILE_SIZE - 1) / TILE_SIZE;
+  tiles->tileCols = (grid->cols + TILE_SIZE - 1) / TILE_SIZE;
+
+  int count = tiles->tileRows * tiles->tileCols;
+  tiles->changed = malloc(count);
+  tiles->nextChanged = malloc(count);
+  tiles->activeList = malloc(count * sizeof(int));
+  tiles->activeCount = 0;
+  if (tiles->changed == NULL || tiles->nextChanged == NULL ||
+      tiles->activeList == NULL) {
+    tilesFree(tiles);
+    return -1;
+  }
+
+  tilesMarkAll(tiles);
+  return 0;
+}
+
+void tilesFree(struct TileTracker *tiles) {
+  free(tiles->changed);
+  free(tiles->nextChanged);
+  free(tiles->activeList);
+  tiles->changed = NULL;
+  tiles->nextChanged = NULL;
+  tiles->activeList = NULL;
+}
+
+void tilesMarkAll(struct TileTracker *tiles) {
+  memset(tiles->changed, 1, tiles->tileRows * tiles->tileCols);
+}
+
+void tilesMarkCell(struct TileTracker *tiles, int y, int x) {
+  tiles->changed[(y / TILE_SIZE) * tiles->tileCols + x / TILE_SIZE] = 1;
+}
+
+// A tile has to be stepped when it or one of its eight neighbours changed.
+// On a torus the neighbours of the edge tiles wrap around.
+static void collectActive(struct TileTracker *tiles, int wrap) {
+  tiles->activeCount = 0;
+
+  for (int ty = 0; ty < tiles->tileRows; ty++) {
+    for (int tx = 0; tx < tiles->tileCols; tx++) {
+      int active = 0;
+      for (int dy = -1; dy <= 1 && !active; dy++) {
+        int ny = ty + dy;
+        if (wrap)
+          ny = (ny + tiles->tileRows) % tiles->tileRows;
+        if (ny < 0 || ny >= tiles->tileRows)
+          continue;
+
+        for (int dx = -1; dx <= 1; dx++) {
+          int nx = tx + dx;
+          if (wrap)
+            nx = (nx + tiles->tileCols) % tiles->tileCols;
+          if (nx >= 0 && nx < tiles->tileCols &&
+              tiles->changed[ny * tiles->tileCols + nx]) {
+            active = 1;
+            break;
+          }
+        }
+      }
+
+      if (active)
+        tiles->activeList[tiles->activeCount++] = ty * tiles->tileCols + tx;
+    }
+  }
+}
+
+// Skipped tiles are left alone in both buffers. That is safe because a
+// skipped tile did not change in the last generation, so the buffer being
+// written to already holds the same cells as the current one.
+int tilesStep(struct TileTracker *tiles, struct LifeGrid *grid) {
+  lifeRefreshHalo(grid);
+  collectActive(tiles, grid->boundary == LIFE_BOUNDARY_TORUS);
+  memset(tiles->nextChanged, 0, tiles->tileRows * tiles->tileCols);
+
+  for (int i = 0; i < tiles->activeCount; i++) {
+    int tile = tiles->activeList[i];
+    int yStart = (tile / tiles->tileCols) * TILE_SIZE;
+    int xStart = (tile % tiles->tileCols) * TILE_SIZE;
+    int yEnd = yStart + TILE_SIZE < grid->rows ? yStart + TILE_SIZE
+                                               : grid->rows;
+    int xEnd = xStart + TILE_SIZE < grid->cols ? xStart + TILE_SIZE
+                                               : grid->cols;
+
+    lifeStepRect(grid, yStart, yEnd, xStart, xEnd);
+
+    for (int y = yStart; y < yEnd; y++) {
+      size_t offset = (size_t)(y + 1) * grid->stride + xStart + 1;
+      if (memcmp(grid->cells + offset, grid->next + offset, xEnd - xStart)) {
+        tiles->nextChanged[tile] = 1;
+        break;
+      }
+    }
+  }
+
+  uint8_t *tmp = tiles->changed;
+  tiles->changed = tiles->nextChanged;
+  tiles->nextChanged = tmp;
+
+  lifeSwap(grid);
+  return tiles->activeCount;
+}
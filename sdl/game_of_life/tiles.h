@@ -0,0 +1,31 @@
+#ifndef TILES_H
+#define TILES_H
+
+#include "life.h"
+
+// Square tiles, a multiple of 32 so the vector kernels never write across
+// into the next tile
+#define TILE_SIZE 64
+
+// Steps only the tiles that changed in the previous generation, or that
+// border on one that did. Stable and empty parts of the grid are skipped.
+struct TileTracker {
+  int tileRows, tileCols;
+  // Tiles that changed in the last generation
+  uint8_t *changed;
+  uint8_t *nextChanged;
+  int *activeList;
+  int activeCount;
+};
+
+int tilesInit(struct TileTracker *tiles, struct LifeGrid *grid);
+void tilesFree(struct TileTracker *tiles);
+
+// The grid was edited outside of tilesStep
+void tilesMarkAll(struct TileTracker *tiles);
+void tilesMarkCell(struct TileTracker *tiles, int y, int x);
+
+// Returns the number of tiles that were stepped
+int tilesStep(struct TileTracker *tiles, struct LifeGrid *grid);
+
+#endif
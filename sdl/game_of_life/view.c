@@ -0,0 +1,387 @@
+#include "view.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Rounds towards minus infinity, unlike >> on a negative int which C leaves
+// to the implementation
+static int shiftDown(int value, int bits) {
+  if (value >= 0)
+    return value >> bits;
+  return -((-value + (1 << bits) - 1) >> bits);
+}
+
+static int clamp(int value, int low, int high) {
+  return value < low ? low : value > high ? high : value;
+}
+
+void viewportSpan(const struct Viewport *view, int *row0, int *col0,
+                  int *rows, int *cols) {
+  if (view->zoom < 0) {
+    *row0 = view->y;
+    *col0 = view->x;
+    *rows = view->height;
+    *cols = view->width;
+    return;
+  }
+
+  *row0 = shiftDown(view->y, view->zoom);
+  *col0 = shiftDown(view->x, view->zoom);
+  *rows = shiftDown(view->y + view->height - 1, view->zoom) + 1 - *row0;
+  *cols = shiftDown(view->x + view->width - 1, view->zoom) + 1 - *col0;
+}
+
+void viewportLookPixel(const struct Viewport *view, int row, int col, int *py,
+                       int *px) {
+  if (view->zoom < 0) {
+    *py = row;
+    *px = col;
+    return;
+  }
+
+  int row0, col0, rows, cols;
+  viewportSpan(view, &row0, &col0, &rows, &cols);
+  *py = (row0 + row) * (1 << view->zoom) - view->y;
+  *px = (col0 + col) * (1 << view->zoom) - view->x;
+}
+
+int viewportCellAt(const struct Viewport *view, int px, int py, int *y,
+                   int *x) {
+  if (view->zoom < 0)
+    return 0;
+
+  *y = shiftDown(view->y + py, view->zoom);
+  *x = shiftDown(view->x + px, view->zoom);
+  return 1;
+}
+
+// World pixel at one zoom to the same spot at another
+static int rescale(int value, int from, int to) {
+  return to >= from ? value * (1 << (to - from)) : shiftDown(value, from - to);
+}
+
+void viewportZoom(struct Viewport *view, int steps, int px, int py) {
+  int zoom = clamp(view->zoom + steps, VIEW_MIN_ZOOM, VIEW_MAX_ZOOM);
+  view->x = rescale(view->x + px, view->zoom, zoom) - px;
+  view->y = rescale(view->y + py, view->zoom, zoom) - py;
+  view->zoom = zoom;
+}
+
+void viewportPan(struct Viewport *view, int dx, int dy) {
+  view->x += dx;
+  view->y += dy;
+}
+
+// World size in pixels at a zoom
+static int scaledSide(int cells, int zoom) {
+  if (zoom >= 0)
+    return cells * (1 << zoom);
+  return (cells + (1 << -zoom) - 1) >> -zoom;
+}
+
+void viewportFit(struct Viewport *view, int rows, int cols) {
+  int zoom = VIEW_MAX_ZOOM;
+  while (zoom > VIEW_MIN_ZOOM && (scaledSide(rows, zoom) > view->height ||
+                                  scaledSide(cols, zoom) > view->width))
+    zoom--;
+
+  view->zoom = zoom;
+  view->x = (scaledSide(cols, zoom) - view->width) / 2;
+  view->y = (scaledSide(rows, zoom) - view->height) / 2;
+}
+
+int pyramidInit(struct LifePyramid *pyramid, int rows, int cols) {
+  memset(pyramid, 0, sizeof(struct LifePyramid));
+  pyramid->rows[0] = rows;
+  pyramid->cols[0] = cols;
+  for (int k = 1; k < VIEW_LEVELS; k++) {
+    pyramid->rows[k] = (rows + (1 << k) - 1) >> k;
+    pyramid->cols[k] = (cols + (1 << k) - 1) >> k;
+    pyramid->levels[k] =
+        calloc((size_t)pyramid->rows[k] * pyramid->cols[k], 1);
+    if (pyramid->levels[k] == NULL) {
+      pyramidFree(pyramid);
+      return -1;
+    }
+  }
+
+  pyramid->tileRows = pyramid->rows[VIEW_TILE_LEVEL];
+  pyramid->tileCols = pyramid->cols[VIEW_TILE_LEVEL];
+  pyramid->dirty = calloc((size_t)pyramid->tileRows * pyramid->tileCols, 1);
+  pyramid->allDirty = 1;
+  if (pyramid->dirty == NULL) {
+    pyramidFree(pyramid);
+    return -1;
+  }
+
+  return 0;
+}
+
+void pyramidFree(struct LifePyramid *pyramid) {
+  for (int k = 1; k < VIEW_LEVELS; k++) {
+    free(pyramid->levels[k]);
+    pyramid->levels[k] = NULL;
+  }
+  free(pyramid->dirty);
+  pyramid->dirty = NULL;
+}
+
+void pyramidMarkAll(struct LifePyramid *pyramid) { pyramid->allDirty = 1; }
+
+// Only the active tiles can have changed, so this costs a fraction of the
+// step that made them
+void pyramidMarkStep(struct LifePyramid *pyramid,
+                     const struct TileTracker *tiles) {
+  if (tiles == NULL) {
+    pyramid->allDirty = 1;
+    return;
+  }
+
+  for (int i = 0; i < tiles->activeCount; i++) {
+    int tile = tiles->activeList[i];
+    pyramid->dirty[tile] |= tiles->changed[tile];
+  }
+}
+
+// Density of a 2x2 block from the live cells in it, rounded up: 0, 64, 128,
+// 192 or 255
+static uint8_t cellDensity(int count) { return count * 64 - (count >> 2); }
+
+// Folds cells [x0, x1) of two rows into level 1 blocks, out being indexed by
+// block. bottom is NULL past the last row: rows and columns past the edge
+// are dead, whatever the halo holds.
+static void foldCells(const uint8_t *top, const uint8_t *bottom, int x0,
+                      int x1, uint8_t *out) {
+  int x = x0;
+#ifdef __SSE2__
+  // 32 cells into 16 blocks: live cells per column, per pair of columns in
+  // 16-bit lanes, then count * 64 - count / 4 packed back to bytes
+  const __m128i one = _mm_set1_epi8(1);
+  const __m128i lowBytes = _mm_set1_epi16(0xff);
+  for (; x + 32 <= x1; x += 32) {
+    __m128i densities[2];
+    for (int half = 0; half < 2; half++) {
+      const uint8_t *at = top + x + 16 * half;
+      __m128i alive =
+          _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i *)at), one),
+                        one);
+      if (bottom != NULL) {
+        at = bottom + x + 16 * half;
+        alive = _mm_add_epi8(
+            alive, _mm_and_si128(
+                       _mm_cmpeq_epi8(_mm_loadu_si128((__m128i *)at), one),
+                       one));
+      }
+      __m128i counts = _mm_add_epi16(_mm_and_si128(alive, lowBytes),
+                                     _mm_srli_epi16(alive, 8));
+      densities[half] = _mm_sub_epi16(_mm_slli_epi16(counts, 6),
+                                      _mm_srli_epi16(counts, 2));
+    }
+    _mm_storeu_si128((__m128i *)(out + x / 2),
+                     _mm_packus_epi16(densities[0], densities[1]));
+  }
+#endif
+
+  for (; x < x1; x += 2) {
+    int wide = x + 1 < x1;
+    int count = (top[x] == 1) + (wide && top[x + 1] == 1);
+    if (bottom != NULL)
+      count += (bottom[x] == 1) + (wide && bottom[x + 1] == 1);
+    out[x / 2] = cellDensity(count);
+  }
+}
+
+// Same for the densities of a level into the one above, the mean of four
+// rounded up
+static void foldDensities(const uint8_t *top, const uint8_t *bottom, int x0,
+                          int x1, uint8_t *out) {
+  int x = x0;
+#ifdef __SSE2__
+  // Column sums in 16-bit lanes, pairs of them added into 32-bit ones by
+  // multiplying with 1
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i ones = _mm_set1_epi16(1);
+  const __m128i three = _mm_set1_epi32(3);
+  for (; x + 32 <= x1; x += 32) {
+    __m128i means[2];
+    for (int half = 0; half < 2; half++) {
+      __m128i upper = _mm_loadu_si128((__m128i *)(top + x + 16 * half));
+      __m128i lower = bottom != NULL ? _mm_loadu_si128(
+                                           (__m128i *)(bottom + x + 16 * half))
+                                     : zero;
+      __m128i low = _mm_add_epi16(_mm_unpacklo_epi8(upper, zero),
+                                  _mm_unpacklo_epi8(lower, zero));
+      __m128i high = _mm_add_epi16(_mm_unpackhi_epi8(upper, zero),
+                                   _mm_unpackhi_epi8(lower, zero));
+      low = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(low, ones), three), 2);
+      high =
+          _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(high, ones), three), 2);
+      means[half] = _mm_packs_epi32(low, high);
+    }
+    _mm_storeu_si128((__m128i *)(out + x / 2),
+                     _mm_packus_epi16(means[0], means[1]));
+  }
+#endif
+
+  for (; x < x1; x += 2) {
+    int wide = x + 1 < x1;
+    int sum = top[x] + (wide ? top[x + 1] : 0);
+    if (bottom != NULL)
+      sum += bottom[x] + (wide ? bottom[x + 1] : 0);
+    out[x / 2] = (sum + 3) >> 2;
+  }
+}
+
+static void buildFromCells(struct LifePyramid *pyramid,
+                           struct LifeGrid *grid, int by0, int by1, int bx0,
+                           int bx1) {
+  int x1 = 2 * bx1 < grid->cols ? 2 * bx1 : grid->cols;
+  for (int by = by0; by < by1; by++) {
+    const uint8_t *bottom =
+        2 * by + 1 < grid->rows ? lifeCell(grid, 2 * by + 1, 0) : NULL;
+    foldCells(lifeCell(grid, 2 * by, 0), bottom, 2 * bx0, x1,
+              pyramid->levels[1] + (size_t)by * pyramid->cols[1]);
+  }
+}
+
+static void buildFromLevel(struct LifePyramid *pyramid, int k, int by0,
+                           int by1, int bx0, int bx1) {
+  int belowRows = pyramid->rows[k - 1];
+  int belowCols = pyramid->cols[k - 1];
+  int x1 = 2 * bx1 < belowCols ? 2 * bx1 : belowCols;
+  for (int by = by0; by < by1; by++) {
+    const uint8_t *top =
+        pyramid->levels[k - 1] + (size_t)(2 * by) * belowCols;
+    foldDensities(top, 2 * by + 1 < belowRows ? top + belowCols : NULL,
+                  2 * bx0, x1,
+                  pyramid->levels[k] + (size_t)by * pyramid->cols[k]);
+  }
+}
+
+void pyramidBuild(struct LifePyramid *pyramid, struct LifeGrid *grid,
+                  int level, int y0, int y1, int x0, int x1) {
+  // Blocks to rebuild per level, from the top down so every block of the
+  // level above has all four of its quarters rebuilt
+  int by0[VIEW_LEVELS], by1[VIEW_LEVELS], bx0[VIEW_LEVELS], bx1[VIEW_LEVELS];
+  by0[level] = y0 >> level;
+  bx0[level] = x0 >> level;
+  by1[level] = (y1 + (1 << level) - 1) >> level;
+  bx1[level] = (x1 + (1 << level) - 1) >> level;
+  for (int k = level - 1; k >= 1; k--) {
+    by0[k] = 2 * by0[k + 1];
+    bx0[k] = 2 * bx0[k + 1];
+    by1[k] = 2 * by1[k + 1] < pyramid->rows[k] ? 2 * by1[k + 1]
+                                                : pyramid->rows[k];
+    bx1[k] = 2 * bx1[k + 1] < pyramid->cols[k] ? 2 * bx1[k + 1]
+                                                : pyramid->cols[k];
+  }
+
+  buildFromCells(pyramid, grid, by0[1], by1[1], bx0[1], bx1[1]);
+  for (int k = 2; k <= level; k++) {
+    buildFromLevel(pyramid, k, by0[k], by1[k], bx0[k], bx1[k]);
+  }
+}
+
+// Rebuilds the marked tiles among [ty0, ty1) x [tx0, tx1), a run of them
+// at a time, then the blocks above all of those at every level. Blocks
+// above that also cover marked tiles outside are rebuilt again once those
+// are.
+static void updateTiles(struct LifePyramid *pyramid, struct LifeGrid *grid,
+                        int ty0, int ty1, int tx0, int tx1) {
+  if (pyramid->allDirty) {
+    memset(pyramid->dirty, 1, (size_t)pyramid->tileRows * pyramid->tileCols);
+    pyramid->allDirty = 0;
+  }
+
+  int top = ty1, bottom = ty0, left = tx1, right = tx0;
+  for (int ty = ty0; ty < ty1; ty++) {
+    uint8_t *dirty = pyramid->dirty + (size_t)ty * pyramid->tileCols;
+    for (int tx = tx0; tx < tx1; tx++) {
+      if (!dirty[tx])
+        continue;
+
+      int end = tx;
+      while (end < tx1 && dirty[end])
+        dirty[end++] = 0;
+      int y1 = (ty + 1) << VIEW_TILE_LEVEL;
+      int x1 = end << VIEW_TILE_LEVEL;
+      pyramidBuild(pyramid, grid, VIEW_TILE_LEVEL, ty << VIEW_TILE_LEVEL,
+                   y1 < grid->rows ? y1 : grid->rows, tx << VIEW_TILE_LEVEL,
+                   x1 < grid->cols ? x1 : grid->cols);
+
+      top = ty < top ? ty : top;
+      bottom = ty + 1;
+      left = tx < left ? tx : left;
+      right = end > right ? end : right;
+      tx = end;
+    }
+  }
+
+  for (int k = VIEW_TILE_LEVEL + 1; k < VIEW_LEVELS && top < bottom; k++) {
+    int shift = k - VIEW_TILE_LEVEL;
+    buildFromLevel(pyramid, k, top >> shift, ((bottom - 1) >> shift) + 1,
+                   left >> shift, ((right - 1) >> shift) + 1);
+  }
+}
+
+// Splits a row of looks into the part before the world, the part over it
+// and the part after it
+static void spanWorld(int col0, int cols, int worldCols, int *left,
+                      int *right) {
+  *left = clamp(-col0, 0, cols);
+  *right = clamp(worldCols - col0, *left, cols);
+}
+
+void viewFill(const struct Viewport *view, struct LifeGrid *grid,
+              struct LifePyramid *pyramid, uint8_t *looks) {
+  int row0, col0, rows, cols;
+  viewportSpan(view, &row0, &col0, &rows, &cols);
+
+  // A look per cell, or per block of the pyramid level that folds a pixel
+  int level = view->zoom < 0 ? -view->zoom : 0;
+  int worldRows = pyramid->rows[level];
+  int worldCols = pyramid->cols[level];
+  int left, right;
+  spanWorld(col0, cols, worldCols, &left, &right);
+
+  if (level > 0) {
+    int top = clamp(row0, 0, worldRows);
+    int bottom = clamp(row0 + rows, 0, worldRows);
+    if (top < bottom && left < right) {
+      int y1 = (bottom << level) < grid->rows ? bottom << level : grid->rows;
+      int x1 = ((col0 + right) << level) < grid->cols
+                   ? (col0 + right) << level
+                   : grid->cols;
+      updateTiles(pyramid, grid, (top << level) >> VIEW_TILE_LEVEL,
+                  ((y1 - 1) >> VIEW_TILE_LEVEL) + 1,
+                  ((col0 + left) << level) >> VIEW_TILE_LEVEL,
+                  ((x1 - 1) >> VIEW_TILE_LEVEL) + 1);
+    }
+  }
+
+  for (int r = 0; r < rows; r++) {
+    int y = row0 + r;
+    uint8_t *out = looks + (size_t)r * cols;
+    if (y < 0 || y >= worldRows || left == right) {
+      memset(out, VIEW_OUTSIDE, cols);
+      continue;
+    }
+
+    memset(out, VIEW_OUTSIDE, left);
+    memset(out + right, VIEW_OUTSIDE, cols - right);
+    if (level == 0) {
+      memcpy(out + left, lifeCell(grid, y, col0 + left), right - left);
+      continue;
+    }
+
+    const uint8_t *density =
+        pyramid->levels[level] + (size_t)y * worldCols + col0;
+    for (int c = left; c < right; c++) {
+      out[c] = (density[c] * (VIEW_SHADES - 1) + 254) / 255;
+    }
+  }
+}
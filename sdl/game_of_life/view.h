@@ -0,0 +1,92 @@
+#ifndef VIEW_H
+#define VIEW_H
+
+#include <stdint.h>
+
+#include "life.h"
+#include "tiles.h"
+
+// Largest world side, so a world pixel always fits an int at any zoom
+#define VIEW_MAX_SIDE 65536
+
+// Closest zoom, cells 2^VIEW_MAX_ZOOM pixels wide
+#define VIEW_MAX_ZOOM 5
+// Farthest zoom, a pixel folding 2^-VIEW_MIN_ZOOM cells a side
+#define VIEW_MIN_ZOOM -16
+#define VIEW_LEVELS (1 - VIEW_MIN_ZOOM)
+
+// Zoomed out, every pixel is a shade from 0 (no live cells) to
+// VIEW_SHADES - 1 (all alive). Any live cell makes it at least 1.
+#define VIEW_SHADES 64
+// Look of whatever lies past the edge of the world
+#define VIEW_OUTSIDE 0xfd
+
+// Which part of the world the window shows. Zoom is a power of two: cells
+// are 2^zoom pixels wide, or below 0 a pixel covers 2^-zoom by 2^-zoom cells.
+struct Viewport {
+  int zoom;
+  // Top left of the window in world pixels at this zoom, so panning keeps
+  // whole pixels at any zoom
+  int x, y;
+  int width, height;
+};
+
+// The looks the window shows, one per cell when zoomed in and one per pixel
+// when zoomed out: rows by cols of them, the first one being cell or block
+// (row0, col0)
+void viewportSpan(const struct Viewport *view, int *row0, int *col0,
+                  int *rows, int *cols);
+// Window pixel of the top left corner of a look
+void viewportLookPixel(const struct Viewport *view, int row, int col, int *py,
+                       int *px);
+// Cell under window pixel (px, py). Returns 0 when zoomed out, where a
+// pixel is no single cell; the cell may still lie outside the world.
+int viewportCellAt(const struct Viewport *view, int px, int py, int *y,
+                   int *x);
+
+// Zooms in (steps > 0) or out around window pixel (px, py), which keeps
+// showing the same spot
+void viewportZoom(struct Viewport *view, int steps, int px, int py);
+void viewportPan(struct Viewport *view, int dx, int dy);
+// Closest zoom at which a rows by cols world fits, centered
+void viewportFit(struct Viewport *view, int rows, int cols);
+
+// The pyramid is kept up to date per tile of the tile engine, which is a
+// level VIEW_TILE_LEVEL block
+#define VIEW_TILE_LEVEL 6
+#if (1 << VIEW_TILE_LEVEL) != TILE_SIZE
+#error "VIEW_TILE_LEVEL does not match TILE_SIZE"
+#endif
+
+// Live cell density of 2^k by 2^k blocks at level k, 0 to 255, rounded up
+// at every level so a lone cell never fades out. Level 0 is the grid.
+struct LifePyramid {
+  int rows[VIEW_LEVELS], cols[VIEW_LEVELS];
+  uint8_t *levels[VIEW_LEVELS];
+  // Tiles whose cells may have changed since their blocks were built
+  int tileRows, tileCols;
+  uint8_t *dirty;
+  int allDirty;
+};
+
+int pyramidInit(struct LifePyramid *pyramid, int rows, int cols);
+void pyramidFree(struct LifePyramid *pyramid);
+// The grid was edited, or stepped by an engine that doesn't say where
+void pyramidMarkAll(struct LifePyramid *pyramid);
+// After a generation: tiles is stepperSteppedTiles, whose changed tiles are
+// the only ones that did, or NULL if any might have
+void pyramidMarkStep(struct LifePyramid *pyramid,
+                     const struct TileTracker *tiles);
+// Rebuilds levels 1 to level for the blocks over the cells [y0, y1) x
+// [x0, x1)
+void pyramidBuild(struct LifePyramid *pyramid, struct LifeGrid *grid,
+                  int level, int y0, int y1, int x0, int x1);
+
+// Fills looks, the span of viewportSpan row by row, from the grid: cell
+// states when zoomed in, shades from the level of the pyramid that folds a
+// pixel when zoomed out. That rebuilds the visible tiles marked since the
+// last fill, and nothing past the window.
+void viewFill(const struct Viewport *view, struct LifeGrid *grid,
+              struct LifePyramid *pyramid, uint8_t *looks);
+
+#endif